@@ -0,0 +1,120 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <string>
+#include <boost/scoped_ptr.hpp>
+
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/system_error.h>
+
+#include "codegen/llvm-codegen.h"
+#include "common/object-pool.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/path-builder.h"
+
+using namespace boost;
+using namespace impala;
+using namespace llvm;
+using namespace std;
+
+// Benchmark for the codegen setup that every fragment instance does in Prepare().
+//  - Parse Module: parses the whole cross compiled module, which is what
+//    LoadImpalaIR() did for each fragment before it parsed function bodies lazily.
+//  - LoadImpalaIR: loads the module as fragments do now.
+//  - LoadImpalaIR + Finalize: also codegens and compiles a small function that calls
+//    a cross compiled function, the minimum per fragment prepare time with codegen.
+
+struct TestData {
+  OwningPtr<MemoryBuffer> ir_file;
+};
+
+void TestParseModule(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    LLVMContext context;
+    string error;
+    scoped_ptr<Module> module(ParseBitcodeFile(data->ir_file.get(), context, &error));
+    if (module.get() == NULL) cout << "Could not parse module: " << error << endl;
+  }
+}
+
+void TestLoadImpalaIR(int batch_size, void* d) {
+  for (int i = 0; i < batch_size; ++i) {
+    ObjectPool pool;
+    scoped_ptr<LlvmCodeGen> codegen;
+    Status status = LlvmCodeGen::LoadImpalaIR(&pool, &codegen);
+    if (!status.ok()) cout << status.GetErrorMsg() << endl;
+  }
+}
+
+// Codegens a function that returns the hash of its two arguments with the cross
+// compiled FNV hash function.
+void TestLoadAndFinalize(int batch_size, void* d) {
+  for (int i = 0; i < batch_size; ++i) {
+    ObjectPool pool;
+    scoped_ptr<LlvmCodeGen> codegen;
+    Status status = LlvmCodeGen::LoadImpalaIR(&pool, &codegen);
+    if (!status.ok()) {
+      cout << status.GetErrorMsg() << endl;
+      return;
+    }
+    codegen->EnableOptimizations(true);
+
+    LlvmCodeGen::FnPrototype prototype(codegen.get(), "Hash",
+        codegen->GetType(TYPE_INT));
+    prototype.AddArgument(LlvmCodeGen::NamedVariable("data", codegen->ptr_type()));
+    prototype.AddArgument(
+        LlvmCodeGen::NamedVariable("len", codegen->GetType(TYPE_INT)));
+    LlvmCodeGen::LlvmBuilder builder(codegen->context());
+    Value* args[2];
+    Function* fn = prototype.GeneratePrototype(&builder, args);
+    Value* hash = builder.CreateCall3(codegen->GetFunction(IRFunction::HASH_FNV),
+        args[0], args[1], codegen->GetIntConstant(TYPE_INT, 0));
+    builder.CreateRet(hash);
+    fn = codegen->FinalizeFunction(fn);
+
+    void* jitted_fn;
+    codegen->AddFunctionToJit(fn, &jitted_fn);
+    status = codegen->FinalizeModule();
+    if (!status.ok()) cout << status.GetErrorMsg() << endl;
+  }
+}
+
+int main(int argc, char **argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+  LlvmCodeGen::InitializeLlvm();
+
+  TestData data;
+  string module_file;
+  PathBuilder::GetFullPath("llvm-ir/impala-sse.ll", &module_file);
+  llvm::error_code err = MemoryBuffer::getFile(module_file, data.ir_file);
+  if (err.value() != 0) {
+    cout << "Could not load module " << module_file << ": " << err.message() << endl;
+    return -1;
+  }
+
+  Benchmark suite("Codegen Setup");
+  suite.AddBenchmark("Parse Module", TestParseModule, &data);
+  suite.AddBenchmark("LoadImpalaIR", TestLoadImpalaIR, &data);
+  suite.AddBenchmark("LoadImpalaIR + Finalize", TestLoadAndFinalize, &data);
+  cout << suite.Measure();
+
+  return 0;
+}
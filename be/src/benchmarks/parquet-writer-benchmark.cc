@@ -0,0 +1,416 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <hdfs.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/init.h"
+#include "common/object-pool.h"
+#include "exec/hdfs-table-sink.h"
+#include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
+#include "runtime/hdfs-fs-cache.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/string-value.h"
+#include "runtime/tuple.h"
+#include "runtime/tuple-row.h"
+#include "testutil/desc-tbl-builder.h"
+#include "util/benchmark.h"
+#include "util/impalad-metrics.h"
+#include "util/runtime-profile.h"
+#include "util/stopwatch.h"
+
+#include "gen-cpp/DataSinks_types.h"
+#include "gen-cpp/Descriptors_types.h"
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/ImpalaInternalService_constants.h"
+
+using namespace boost;
+using namespace impala;
+using namespace std;
+
+// Benchmark for the column writers of HdfsParquetTableWriter. The rows of each schema
+// are inserted into an unpartitioned Parquet table with an HdfsTableSink, either in
+// batches of 1024 rows or in batches of a single row. With 1024 rows, the writer
+// evaluates the fixed size columns a batch at a time and appends each column with one
+// virtual call to its column writer. With single rows, each value needs its own
+// virtual call and expr evaluation. The pages are not compressed.
+// The files are written to TABLE_DIR on the default filesystem, which must be
+// reachable, and deleted after each pass over the rows. Only the sink's EncodeTimer,
+// which covers appending rows to the writer but not writing the files, is measured.
+// For each schema, the benchmark prints the throughput of both in MB/s of input
+// values (the fixed size of numeric values and the length of strings) and their ratio.
+// Results: not yet measured. To reproduce, with the minicluster running, from
+// $IMPALA_HOME:
+//   cmake -DCMAKE_BUILD_TYPE=RELEASE . && make parquet-writer-benchmark
+//   be/build/release/benchmarks/parquet-writer-benchmark
+
+const int BATCH_SIZE = 1024;
+const int NUM_BATCHES = 64;
+const int NUM_ROWS = BATCH_SIZE * NUM_BATCHES;
+
+// The values of one column of the input rows.
+class ColumnData {
+ public:
+  // 'is_null' has NUM_ROWS entries.
+  ColumnData(const ColumnType& type, const vector<bool>& is_null)
+    : type_(type), is_null_(is_null) {
+  }
+
+  virtual ~ColumnData() { }
+
+  const ColumnType& type() const { return type_; }
+  bool is_null(int row) const { return is_null_[row]; }
+
+  // Copies the value of row 'row' to 'slot'.
+  virtual void CopyValue(int row, void* slot) const = 0;
+
+  // Bytes of input values of all rows.
+  virtual int64_t input_bytes() const = 0;
+
+ private:
+  ColumnType type_;
+  const vector<bool>& is_null_;
+};
+
+template<typename T>
+class TypedColumnData : public ColumnData {
+ public:
+  // 'values' has NUM_ROWS entries.
+  TypedColumnData(const ColumnType& type, const vector<T>& values,
+      const vector<bool>& is_null)
+    : ColumnData(type, is_null), values_(values) {
+  }
+
+  virtual void CopyValue(int row, void* slot) const {
+    *reinterpret_cast<T*>(slot) = values_[row];
+  }
+
+  virtual int64_t input_bytes() const {
+    int64_t bytes = 0;
+    for (int i = 0; i < NUM_ROWS; ++i) {
+      if (!is_null(i)) bytes += InputByteSize(values_[i]);
+    }
+    return bytes;
+  }
+
+ private:
+  static int InputByteSize(const T& v) { return sizeof(T); }
+
+  const vector<T>& values_;
+};
+
+template<>
+int TypedColumnData<StringValue>::InputByteSize(const StringValue& v) { return v.len; }
+
+const char* TABLE_DIR = "/tmp/parquet-writer-benchmark";
+
+// Inserts rows with the values of 'columns' into a Parquet table in TABLE_DIR.
+class ParquetWriterBenchmark {
+ public:
+  ParquetWriterBenchmark(ExecEnv* exec_env, const vector<ColumnData*>& columns)
+    : exec_env_(exec_env), columns_(columns), num_passes_(0) {
+  }
+
+  ~ParquetWriterBenchmark() {
+    if (tuple_pool_.get() != NULL) tuple_pool_->FreeAll();
+  }
+
+  Status Init() {
+    TQueryContext query_ctxt;
+    query_ctxt.request.query_options.__set_parquet_compression_codec(
+        THdfsCompression::NONE);
+    state_.reset(new RuntimeState(TUniqueId(), TUniqueId(), query_ctxt, "", exec_env_));
+    RETURN_IF_ERROR(state_->InitMemTrackers(TUniqueId(), NULL, -1));
+    hdfs_connection_ = HdfsFsCache::instance()->GetDefaultConnection();
+    if (hdfs_connection_ == NULL) return Status("Failed to connect to the filesystem.");
+
+    // The rows have a single tuple with a slot per column, which the sink writes to an
+    // unpartitioned table with only a default partition.
+    THdfsPartition partition;
+    partition.lineDelim = '\n';
+    partition.fieldDelim = ',';
+    partition.collectionDelim = ',';
+    partition.mapKeyDelim = ':';
+    partition.escapeChar = '\\';
+    partition.fileFormat = THdfsFileFormat::PARQUET;
+    partition.blockSize = 0;
+    partition.compression = THdfsCompression::NONE;
+    TTableDescriptor ttable_desc;
+    ttable_desc.id = 0;
+    ttable_desc.tableType = TTableType::HDFS_TABLE;
+    ttable_desc.numCols = columns_.size();
+    ttable_desc.numClusteringCols = 0;
+    ttable_desc.tableName = "parquet_writer_benchmark";
+    ttable_desc.dbName = "default";
+    ttable_desc.hdfsTable.hdfsBaseDir = TABLE_DIR;
+    ttable_desc.hdfsTable.nullPartitionKeyValue = "__HIVE_DEFAULT_PARTITION__";
+    ttable_desc.hdfsTable.nullColumnValue = "\\N";
+    ttable_desc.hdfsTable.partitions[
+        g_ImpalaInternalService_constants.DEFAULT_PARTITION_ID] = partition;
+    ttable_desc.__isset.hdfsTable = true;
+
+    DescriptorTblBuilder builder(&pool_);
+    TupleDescBuilder& tuple_builder = builder.DeclareTuple();
+    for (int i = 0; i < columns_.size(); ++i) {
+      tuple_builder << columns_[i]->type();
+      stringstream col_name;
+      col_name << "col" << i;
+      ttable_desc.colNames.push_back(col_name.str());
+      ttable_desc.hdfsTable.colNames.push_back(col_name.str());
+    }
+    ttable_desc.__isset.colNames = true;
+    builder.AddTableDescriptor(ttable_desc);
+    DescriptorTbl* desc_tbl = builder.Build();
+    state_->set_desc_tbl(desc_tbl);
+    row_desc_.reset(new RowDescriptor(*desc_tbl, vector<TTupleId>(1, 0),
+        vector<bool>(1, false)));
+    TupleDescriptor* tuple_desc = desc_tbl->GetTupleDescriptor(0);
+    const vector<SlotDescriptor*>& slots = tuple_desc->slots();
+
+    for (int i = 0; i < slots.size(); ++i) {
+      TExprNode node;
+      node.node_type = TExprNodeType::SLOT_REF;
+      node.type = slots[i]->type().ToThrift();
+      node.num_children = 0;
+      TSlotRef slot_ref;
+      slot_ref.slot_id = slots[i]->id();
+      node.__set_slot_ref(slot_ref);
+      TExpr texpr;
+      texpr.nodes.push_back(node);
+      output_texprs_.push_back(texpr);
+    }
+
+    tsink_.type = TDataSinkType::TABLE_SINK;
+    tsink_.table_sink.target_table_id = ttable_desc.id;
+    tsink_.table_sink.type = TTableSinkType::HDFS;
+    tsink_.table_sink.hdfs_table_sink.overwrite = false;
+    tsink_.table_sink.__isset.hdfs_table_sink = true;
+    tsink_.__isset.table_sink = true;
+
+    tuple_pool_.reset(new MemPool(&tuple_mem_tracker_));
+    tuples_.resize(NUM_ROWS);
+    for (int row = 0; row < NUM_ROWS; ++row) {
+      Tuple* tuple = Tuple::Create(tuple_desc->byte_size(), tuple_pool_.get());
+      for (int i = 0; i < columns_.size(); ++i) {
+        if (columns_[i]->is_null(row)) {
+          tuple->SetNull(slots[i]->null_indicator_offset());
+        } else {
+          columns_[i]->CopyValue(row, tuple->GetSlot(slots[i]->tuple_offset()));
+        }
+      }
+      tuples_[row] = tuple;
+    }
+    return Status::OK;
+  }
+
+  // Inserts all rows with a new sink in batches of 'batch_size' rows, deletes the
+  // files and sets 'encode_time' to the sink's EncodeTimer in ns.
+  Status InsertRows(int batch_size, int64_t* encode_time) {
+    TUniqueId sink_id;
+    sink_id.lo = ++num_passes_;
+    HdfsTableSink sink(*row_desc_, sink_id, output_texprs_, tsink_);
+    Status status = sink.Prepare(state_.get());
+    if (status.ok()) status = sink.Open(state_.get());
+    RowBatch batch(*row_desc_, batch_size, &tuple_mem_tracker_);
+    for (int start = 0; status.ok() && start < NUM_ROWS; start += batch_size) {
+      batch.Reset();
+      for (int i = start; i < start + batch_size; ++i) {
+        int row_idx = batch.AddRow();
+        batch.GetRow(row_idx)->SetTuple(0, tuples_[i]);
+        batch.CommitLastRow();
+      }
+      status = sink.Send(state_.get(), &batch, start + batch_size == NUM_ROWS);
+    }
+    if (status.ok()) *encode_time = sink.encode_timer()->value();
+    sink.Close(state_.get());
+    // The sink leaves its files in the staging directory of TABLE_DIR.
+    hdfsDelete(hdfs_connection_, TABLE_DIR, 1);
+    return status;
+  }
+
+  // Bytes of input values of all rows.
+  int64_t input_bytes() const {
+    int64_t bytes = 0;
+    for (int i = 0; i < columns_.size(); ++i) bytes += columns_[i]->input_bytes();
+    return bytes;
+  }
+
+ private:
+  ExecEnv* exec_env_;
+  const vector<ColumnData*>& columns_;
+
+  ObjectPool pool_;
+  scoped_ptr<RuntimeState> state_;
+  hdfsFS hdfs_connection_;
+  scoped_ptr<RowDescriptor> row_desc_;
+  vector<TExpr> output_texprs_;
+  TDataSink tsink_;
+
+  // Number of calls to InsertRows(), used to give each sink a unique id.
+  int num_passes_;
+
+  // The input rows, a tuple per row.
+  MemTracker tuple_mem_tracker_;
+  scoped_ptr<MemPool> tuple_pool_;
+  vector<Tuple*> tuples_;
+};
+
+// Inserts the rows in batches of 'batch_size' rows for about a second and returns the
+// throughput of the encoding in MB/s of input values.
+double MeasureThroughput(int batch_size, ParquetWriterBenchmark* benchmark) {
+  MonotonicStopWatch sw;
+  int64_t total_encode_time = 0;
+  int iters = 0;
+  sw.Start();
+  while (sw.ElapsedTime() < 1000L * 1000 * 1000) {
+    int64_t encode_time;
+    Status status = benchmark->InsertRows(batch_size, &encode_time);
+    if (!status.ok()) {
+      cerr << status.GetErrorMsg() << endl;
+      exit(1);
+    }
+    total_encode_time += encode_time;
+    ++iters;
+  }
+  sw.Stop();
+  return static_cast<double>(benchmark->input_bytes()) * iters / (1024 * 1024) /
+      (total_encode_time / 1e9);
+}
+
+void RunSchema(const string& name, ExecEnv* exec_env,
+    const vector<ColumnData*>& columns) {
+  ParquetWriterBenchmark benchmark(exec_env, columns);
+  Status status = benchmark.Init();
+  if (!status.ok()) {
+    cerr << name << ": " << status.GetErrorMsg() << endl;
+    exit(1);
+  }
+  double row_at_a_time = MeasureThroughput(1, &benchmark);
+  double column_at_a_time = MeasureThroughput(BATCH_SIZE, &benchmark);
+  cout << name << ":" << endl << fixed << setprecision(1)
+       << "  Row at a time: " << row_at_a_time << " MB/s" << endl
+       << "  Column at a time: " << column_at_a_time << " MB/s" << endl
+       << setprecision(2) << "  Comparison: " << column_at_a_time / row_at_a_time
+       << "X" << endl << endl;
+}
+
+// Returns NUM_ROWS random values with 'ndv' distinct values.
+template<typename T>
+vector<T> MakeValues(int ndv) {
+  vector<T> values(NUM_ROWS);
+  for (int i = 0; i < NUM_ROWS; ++i) values[i] = static_cast<T>(rand() % ndv);
+  return values;
+}
+
+// Returns NUM_ROWS random strings with lengths in [min_len, max_len] and 'ndv'
+// distinct values.
+vector<StringValue> MakeStrings(MemPool* pool, int ndv, int min_len, int max_len) {
+  vector<StringValue> distinct(ndv);
+  for (int i = 0; i < ndv; ++i) {
+    int len = min_len + rand() % (max_len - min_len + 1);
+    char* ptr = reinterpret_cast<char*>(pool->Allocate(len));
+    for (int k = 0; k < len; ++k) ptr[k] = 'a' + rand() % 26;
+    distinct[i] = StringValue(ptr, len);
+  }
+  vector<StringValue> values(NUM_ROWS);
+  for (int i = 0; i < NUM_ROWS; ++i) values[i] = distinct[rand() % ndv];
+  return values;
+}
+
+vector<bool> MakeNulls(int percent) {
+  vector<bool> is_null(NUM_ROWS);
+  for (int i = 0; i < NUM_ROWS; ++i) is_null[i] = rand() % 100 < percent;
+  return is_null;
+}
+
+int main(int argc, char **argv) {
+  InitCommonRuntime(argc, argv, false);
+  cout << Benchmark::GetMachineInfo() << endl;
+  ExecEnv exec_env;
+  // The sink counts the files it has open.
+  ImpaladMetrics::CreateMetrics(exec_env.metrics());
+
+  MemTracker tracker;
+  MemPool pool(&tracker);
+  ObjectPool obj_pool;
+  vector<bool> no_nulls = MakeNulls(0);
+  vector<bool> some_nulls = MakeNulls(10);
+
+  // Narrow fact table with integer keys and measures.
+  vector<int64_t> ids = MakeValues<int64_t>(NUM_ROWS);
+  vector<int32_t> dim_keys = MakeValues<int32_t>(1000);
+  vector<int32_t> small_keys = MakeValues<int32_t>(10);
+  vector<int64_t> amounts = MakeValues<int64_t>(100000);
+  vector<ColumnData*> ints;
+  ints.push_back(obj_pool.Add(
+      new TypedColumnData<int64_t>(TYPE_BIGINT, ids, no_nulls)));
+  ints.push_back(obj_pool.Add(
+      new TypedColumnData<int32_t>(TYPE_INT, dim_keys, no_nulls)));
+  ints.push_back(obj_pool.Add(
+      new TypedColumnData<int32_t>(TYPE_INT, small_keys, no_nulls)));
+  ints.push_back(obj_pool.Add(
+      new TypedColumnData<int64_t>(TYPE_BIGINT, amounts, some_nulls)));
+  RunSchema("Integers", &exec_env, ints);
+
+  // Similar to TPC-H lineitem: keys, measures, flags and a free text comment.
+  vector<int32_t> quantities = MakeValues<int32_t>(50);
+  vector<double> prices = MakeValues<double>(NUM_ROWS);
+  vector<float> discounts = MakeValues<float>(11);
+  vector<StringValue> modes = MakeStrings(&pool, 7, 3, 7);
+  vector<StringValue> comments = MakeStrings(&pool, NUM_ROWS, 10, 43);
+  vector<ColumnData*> lineitem;
+  lineitem.push_back(obj_pool.Add(
+      new TypedColumnData<int64_t>(TYPE_BIGINT, ids, no_nulls)));
+  lineitem.push_back(obj_pool.Add(
+      new TypedColumnData<int32_t>(TYPE_INT, dim_keys, no_nulls)));
+  lineitem.push_back(obj_pool.Add(
+      new TypedColumnData<int32_t>(TYPE_INT, quantities, no_nulls)));
+  lineitem.push_back(obj_pool.Add(
+      new TypedColumnData<double>(TYPE_DOUBLE, prices, no_nulls)));
+  lineitem.push_back(obj_pool.Add(
+      new TypedColumnData<float>(TYPE_FLOAT, discounts, no_nulls)));
+  lineitem.push_back(obj_pool.Add(
+      new TypedColumnData<StringValue>(TYPE_STRING, modes, no_nulls)));
+  lineitem.push_back(obj_pool.Add(
+      new TypedColumnData<StringValue>(TYPE_STRING, comments, some_nulls)));
+  RunSchema("Lineitem", &exec_env, lineitem);
+
+  // String dimension table.
+  vector<StringValue> names = MakeStrings(&pool, NUM_ROWS, 5, 25);
+  vector<StringValue> cities = MakeStrings(&pool, 1000, 4, 15);
+  vector<StringValue> countries = MakeStrings(&pool, 50, 4, 12);
+  vector<StringValue> urls = MakeStrings(&pool, 20000, 20, 80);
+  vector<ColumnData*> strings;
+  strings.push_back(obj_pool.Add(
+      new TypedColumnData<StringValue>(TYPE_STRING, names, no_nulls)));
+  strings.push_back(obj_pool.Add(
+      new TypedColumnData<StringValue>(TYPE_STRING, cities, some_nulls)));
+  strings.push_back(obj_pool.Add(
+      new TypedColumnData<StringValue>(TYPE_STRING, countries, no_nulls)));
+  strings.push_back(obj_pool.Add(
+      new TypedColumnData<StringValue>(TYPE_STRING, urls, some_nulls)));
+  RunSchema("Strings", &exec_env, strings);
+
+  pool.FreeAll();
+  return 0;
+}
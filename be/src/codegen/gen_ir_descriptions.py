@@ -45,6 +45,9 @@ ir_functions = [
   ["HASH_FNV", "IrFnvHash"],
   ["HASH_JOIN_PROCESS_BUILD_BATCH", "ProcessBuildBatch"],
   ["HASH_JOIN_PROCESS_PROBE_BATCH", "ProcessProbeBatch"],
+  ["HASH_JOIN_JOIN_PROBE_BATCH_IN_PLACE", "JoinProbeBatchInPlace"],
+  ["CROSS_JOIN_PROCESS_LEFT_CHILD_BATCH", "ProcessLeftChildBatch"],
+  ["CROSS_JOIN_PROCESS_BAND_JOIN_BATCH", "ProcessBandJoinBatch"],
   ["DECODE_AVRO_DATA", "DecodeAvroData"],
   ["READ_UNION_TYPE", "ReadUnionType"],
   ["READ_AVRO_BOOLEAN", "ReadAvroBoolean"],
@@ -69,6 +72,16 @@ ir_functions = [
   ["STRING_TO_DOUBLE", "IrStringToDouble"],  
   ["IS_NULL_STRING", "IrIsNullString"],
   ["GENERIC_IS_NULL_STRING", "IrGenericIsNullString"],
+  ["LIKE_SUBSTRING", "IrLikeSubstring"],
+  ["LIKE_STARTS_WITH", "IrLikeStartsWith"],
+  ["LIKE_ENDS_WITH", "IrLikeEndsWith"],
+  ["LIKE_EQUALS", "IrLikeEquals"],
+  ["LIKE_REGEX_FULL_MATCH", "IrLikeRegexFullMatch"],
+  ["LIKE_REGEX_PARTIAL_MATCH", "IrLikeRegexPartialMatch"],
+  ["STRING_LENGTH", "IrStringLength"],
+  ["STRING_ASCII", "IrStringAscii"],
+  ["STRING_INSTR", "IrStringInstr"],
+  ["STRING_FIND_CONSTANT", "IrStringFindConstant"],
 ]
 
 enums_preamble = '\
@@ -19,10 +19,13 @@
 
 #ifdef IR_COMPILE
 #include "exec/aggregation-node-ir.cc"
+#include "exec/cross-join-node-ir.cc"
 #include "exec/hash-join-node-ir.cc"
 #include "exec/hdfs-avro-scanner-ir.cc"
 #include "exec/hdfs-scanner-ir.cc"
 #include "exprs/expr-ir.cc"
+#include "exprs/like-predicate-ir.cc"
+#include "exprs/string-functions-ir.cc"
 #include "exprs/udf-builtins.cc"
 #include "runtime/string-value-ir.cc"
 #include "util/hash-util-ir.cc"
@@ -436,6 +436,87 @@ TEST_F(LlvmCodeGenTest, HashTest) {
   CpuInfo::EnableFeature(CpuInfo::SSE4_2, restore_sse_support);
 }
 
+// Runs FinalizeModule() on 'codegen' and checks that it succeeded.
+static void FinalizeModuleThread(LlvmCodeGen* codegen) {
+  Status status = codegen->FinalizeModule();
+  EXPECT_TRUE(status.ok());
+}
+
+// Tests that a module can be finalized in another thread and that the function
+// pointers are set once it is done.
+TEST_F(LlvmCodeGenTest, AsyncFinalize) {
+  ObjectPool pool;
+  scoped_ptr<LlvmCodeGen> codegen;
+  Status status = LlvmCodeGen::LoadImpalaIR(&pool, &codegen);
+  ASSERT_TRUE(status.ok());
+  codegen->EnableOptimizations(true);
+
+  Function* fns[2];
+  for (int i = 0; i < 2; ++i) {
+    LlvmCodeGen::FnPrototype prototype(codegen.get(), "ReturnConstant",
+        codegen->GetType(TYPE_INT));
+    LlvmCodeGen::LlvmBuilder builder(codegen->context());
+    fns[i] = prototype.GeneratePrototype(&builder);
+    builder.CreateRet(codegen->GetIntConstant(TYPE_INT, i + 1));
+    fns[i] = codegen->FinalizeFunction(fns[i]);
+    ASSERT_TRUE(fns[i] != NULL);
+  }
+
+  void* jitted_fns[2] = { NULL, NULL };
+  codegen->AddFunctionToJit(fns[0], &jitted_fns[0], true);
+  EXPECT_TRUE(codegen->CanFinalizeAsync());
+  codegen->AddFunctionToJit(fns[1], &jitted_fns[1], true);
+  EXPECT_TRUE(codegen->CanFinalizeAsync());
+  EXPECT_FALSE(codegen->jitted_fns_ready());
+
+  thread finalize_thread(FinalizeModuleThread, codegen.get());
+  finalize_thread.join();
+  EXPECT_TRUE(codegen->jitted_fns_ready());
+  typedef int (*ReturnConstantFn)();
+  ASSERT_TRUE(jitted_fns[0] != NULL);
+  ASSERT_TRUE(jitted_fns[1] != NULL);
+  EXPECT_EQ(reinterpret_cast<ReturnConstantFn>(jitted_fns[0])(), 1);
+  EXPECT_EQ(reinterpret_cast<ReturnConstantFn>(jitted_fns[1])(), 2);
+
+  // A function without an interpreted fallback must be compiled before the fragment
+  // runs.
+  scoped_ptr<LlvmCodeGen> codegen2;
+  status = LlvmCodeGen::LoadImpalaIR(&pool, &codegen2);
+  ASSERT_TRUE(status.ok());
+  void* jitted_fn = NULL;
+  codegen2->AddFunctionToJit(codegen2->GetFunction(IRFunction::HASH_FNV), &jitted_fn);
+  EXPECT_FALSE(codegen2->CanFinalizeAsync());
+}
+
+// Tests that function bodies of the cross compiled module are only parsed when they
+// are used, and that modules loaded after the first one find the same functions.
+TEST_F(LlvmCodeGenTest, LazyImpalaIR) {
+  ObjectPool pool;
+  for (int i = 0; i < 2; ++i) {
+    scoped_ptr<LlvmCodeGen> codegen;
+    Status status = LlvmCodeGen::LoadImpalaIR(&pool, &codegen);
+    ASSERT_TRUE(status.ok());
+    // No function bodies are parsed yet.
+    vector<Function*> functions;
+    codegen->GetFunctions(&functions);
+    ASSERT_GT(functions.size(), 0);
+    for (int j = 0; j < functions.size(); ++j) {
+      EXPECT_TRUE(functions[j]->isMaterializable());
+    }
+
+    Function* hash_fn = codegen->GetFunction(IRFunction::HASH_FNV);
+    ASSERT_TRUE(hash_fn != NULL);
+    EXPECT_FALSE(hash_fn->isMaterializable());
+    EXPECT_FALSE(hash_fn->empty());
+
+    void* jitted_fn = NULL;
+    codegen->AddFunctionToJit(hash_fn, &jitted_fn);
+    status = codegen->FinalizeModule();
+    ASSERT_TRUE(status.ok());
+    EXPECT_TRUE(jitted_fn != NULL);
+  }
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -39,6 +39,7 @@
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
 #include <llvm/Transforms/Utils/Cloning.h>
 
+#include "common/atomic.h"
 #include "common/logging.h"
 #include "codegen/subexpr-elimination.h"
 #include "impala-ir/impala-ir-names.h"
@@ -63,6 +64,43 @@ namespace impala {
 static mutex llvm_initialization_lock;
 static bool llvm_initialized = false;
 
+// The cross compiled IR module, read from disk once per process. Each LlvmCodeGen
+// parses it lazily from this buffer.
+struct ImpalaIRFile {
+  boost::scoped_ptr<MemoryBuffer> buffer;
+
+  // Names of the functions in LlvmCodeGen::loaded_functions_, indexed by
+  // IRFunction::Type. Empty until the module was parsed once.
+  vector<string> fn_names;
+};
+
+// Protects impala_ir_files. The entries are never removed.
+static mutex impala_ir_files_lock;
+
+// Keyed by path. There is a file with and one without sse instructions.
+static map<string, ImpalaIRFile*> impala_ir_files;
+
+// Returns the ImpalaIRFile for 'path', reading the file if this is the first call.
+static Status GetImpalaIRFile(const string& path, ImpalaIRFile** ir_file) {
+  lock_guard<mutex> l(impala_ir_files_lock);
+  map<string, ImpalaIRFile*>::iterator it = impala_ir_files.find(path);
+  if (it != impala_ir_files.end()) {
+    *ir_file = it->second;
+    return Status::OK;
+  }
+  OwningPtr<MemoryBuffer> file_buffer;
+  llvm::error_code err = MemoryBuffer::getFile(path, file_buffer);
+  if (err.value() != 0) {
+    stringstream ss;
+    ss << "Could not load module " << path << ": " << err.message();
+    return Status(ss.str());
+  }
+  *ir_file = new ImpalaIRFile();
+  (*ir_file)->buffer.reset(file_buffer.take());
+  impala_ir_files[path] = *ir_file;
+  return Status::OK;
+}
+
 void LlvmCodeGen::InitializeLlvm(bool load_backend) {
   mutex::scoped_lock initialization_lock(llvm_initialization_lock);
   if (llvm_initialized) return;
@@ -90,9 +128,10 @@ LlvmCodeGen::LlvmCodeGen(ObjectPool* pool, const string& name) :
   optimizations_enabled_(false),
   is_corrupt_(false),
   is_compiled_(false),
+  all_fns_have_fallback_(true),
+  jitted_fns_ready_(false),
   context_(new llvm::LLVMContext()),
   module_(NULL),
-  execution_engine_(NULL),
   scratch_buffer_offset_(0),
   debug_trace_fn_(NULL) {
 
@@ -149,6 +188,13 @@ Status LlvmCodeGen::LinkModule(const string& file) {
   Module* new_module;
   RETURN_IF_ERROR(LoadModule(this, file, &new_module));
   string error_msg;
+  // The linker only copies function bodies that are materialized.
+  if (module_->MaterializeAll(&error_msg)) {
+    delete new_module;
+    stringstream ss;
+    ss << "Could not materialize module " << name_ << ": " << error_msg;
+    return Status(ss.str());
+  }
   bool error =
       Linker::LinkModules(module_, new_module, Linker::DestroySource, &error_msg);
   if (error) {
@@ -170,11 +216,32 @@ Status LlvmCodeGen::LoadImpalaIR(ObjectPool* pool, scoped_ptr<LlvmCodeGen>* code
   } else {
     PathBuilder::GetFullPath("llvm-ir/impala-no-sse.ll", &module_file);
   }
-  RETURN_IF_ERROR(LoadFromFile(pool, module_file, codegen_ret));
+  ImpalaIRFile* ir_file;
+  RETURN_IF_ERROR(GetImpalaIRFile(module_file, &ir_file));
+
+  codegen_ret->reset(new LlvmCodeGen(pool, ""));
   LlvmCodeGen* codegen = codegen_ret->get();
+  SCOPED_TIMER(codegen->profile_.total_time_counter());
+  {
+    SCOPED_TIMER(codegen->load_module_timer_);
+    COUNTER_UPDATE(codegen->module_file_size_, ir_file->buffer->getBufferSize());
+    // Only the module's globals and function declarations are parsed here. Function
+    // bodies are materialized when they are first used, see MaterializeFunction().
+    // The reader does not copy the buffer, which is never freed.
+    MemoryBuffer* buffer = MemoryBuffer::getMemBuffer(
+        ir_file->buffer->getBuffer(), module_file, false);
+    string error;
+    codegen->module_ = getLazyBitcodeModule(buffer, codegen->context(), &error);
+    if (codegen->module_ == NULL) {
+      delete buffer;
+      stringstream ss;
+      ss << "Could not parse module " << module_file << ": " << error;
+      return Status(ss.str());
+    }
+  }
+  RETURN_IF_ERROR(codegen->Init());
 
   // Parse module for cross compiled functions and types
-  SCOPED_TIMER(codegen->profile_.total_time_counter());
   SCOPED_TIMER(codegen->load_module_timer_);
 
   // Get type for StringValue
@@ -192,6 +259,21 @@ Status LlvmCodeGen::LoadImpalaIR(ObjectPool* pool, scoped_ptr<LlvmCodeGen>* code
     return Status("Could not create llvm struct type for StringVal");
   }
 
+  // After the module was parsed once, the cross compiled functions are looked up by
+  // their mangled names instead of matching every function in the module.
+  vector<string> fn_names;
+  {
+    lock_guard<mutex> l(impala_ir_files_lock);
+    fn_names = ir_file->fn_names;
+  }
+  if (!fn_names.empty()) {
+    for (int i = IRFunction::FN_START; i < IRFunction::FN_END; ++i) {
+      codegen->loaded_functions_[i] = codegen->module_->getFunction(fn_names[i]);
+      DCHECK(codegen->loaded_functions_[i] != NULL) << fn_names[i];
+    }
+    return Status::OK;
+  }
+
   // Parse functions from module
   vector<Function*> functions;
   codegen->GetFunctions(&functions);
@@ -227,6 +309,11 @@ Status LlvmCodeGen::LoadImpalaIR(ObjectPool* pool, scoped_ptr<LlvmCodeGen>* code
     return Status(ss.str());
   }
 
+  for (int i = IRFunction::FN_START; i < IRFunction::FN_END; ++i) {
+    fn_names.push_back(codegen->loaded_functions_[i]->getName());
+  }
+  lock_guard<mutex> l(impala_ir_files_lock);
+  ir_file->fn_names = fn_names;
   return Status::OK;
 }
 
@@ -377,9 +464,22 @@ Function* LlvmCodeGen::GetLibCFunction(FnPrototype* prototype) {
 
 Function* LlvmCodeGen::GetFunction(IRFunction::Type function) {
   DCHECK(loaded_functions_[function] != NULL);
+  MaterializeFunction(loaded_functions_[function]);
   return loaded_functions_[function];
 }
 
+bool LlvmCodeGen::MaterializeFunction(Function* fn) {
+  if (!fn->isMaterializable()) return true;
+  string error;
+  if (fn->Materialize(&error)) {
+    string fn_name = fn->getName();
+    LOG(ERROR) << "Could not materialize function " << fn_name << ": " << error;
+    is_corrupt_ = true;
+    return false;
+  }
+  return true;
+}
+
 // There is an llvm bug (#10957) that causes the first step of the verifier to always
 // abort the process if it runs into an issue and ignores ReturnStatusAction.  This
 // would cause impalad to go down if one query has a problem.
@@ -448,6 +548,7 @@ Function* LlvmCodeGen::ReplaceCallSites(Function* caller, bool update_in_place,
   DCHECK(caller->getParent() == module_);
   DCHECK(caller != NULL);
   DCHECK(new_fn != NULL);
+  MaterializeFunction(caller);
 
   if (!update_in_place) {
     caller = CloneFunction(caller);
@@ -484,6 +585,7 @@ Function* LlvmCodeGen::ReplaceCallSites(Function* caller, bool update_in_place,
 }
 
 Function* LlvmCodeGen::CloneFunction(Function* fn) {
+  MaterializeFunction(fn);
   ValueToValueMapTy dummy_vmap;
   // CloneFunction() automatically gives the new function a unique name
   Function* fn_clone = llvm::CloneFunction(fn, dummy_vmap, false);
@@ -525,6 +627,8 @@ int LlvmCodeGen::InlineAllCallSites(Function* fn, bool skip_registered_fns) {
   // Inline all call sites.  InlineFunction can still fail (function is recursive, etc)
   // but that always leaves the original function in a consistent state
   for (int i = 0; i < call_sites.size(); ++i) {
+    Function* called_fn = call_sites[i]->getCalledFunction();
+    if (called_fn != NULL) MaterializeFunction(called_fn);
     llvm::InlineFunctionInfo info;
     if (llvm::InlineFunction(call_sites[i], info)) {
       ++functions_inlined;
@@ -566,11 +670,17 @@ Status LlvmCodeGen::FinalizeModule() {
   SCOPED_TIMER(profile_.total_time_counter());
   SCOPED_TIMER(compile_timer_);
 
+  // Only the cross compiled functions that are reachable from the functions to JIT are
+  // parsed. The remaining function bodies are never loaded.
+  MaterializeReachableFunctions();
+  if (is_corrupt_) return Status("Module is corrupt.");
+
   if (optimizations_enabled_) OptimizeModule();
 
   // JIT compile all codegen'd functions
+  vector<void*> fn_ptrs;
   for (int i = 0; i < fns_to_jit_compile_.size(); ++i) {
-    *fns_to_jit_compile_[i].second = JitFunction(fns_to_jit_compile_[i].first);
+    fn_ptrs.push_back(JitFunction(fns_to_jit_compile_[i].first));
   }
 
   if (FLAGS_opt_module.size() != 0) {
@@ -583,6 +693,13 @@ Status LlvmCodeGen::FinalizeModule() {
     }
   }
 
+  // Publish the function pointers only once everything is compiled. If the module was
+  // finalized in the background, the fragment may already be running and pick up each
+  // pointer at its next check, which must load it with AtomicUtil::AcquireLoad().
+  for (int i = 0; i < fns_to_jit_compile_.size(); ++i) {
+    AtomicUtil::ReleaseStore(fns_to_jit_compile_[i].second, fn_ptrs[i]);
+  }
+  AtomicUtil::ReleaseStore(&jitted_fns_ready_, true);
   return Status::OK;
 }
 
@@ -638,8 +755,60 @@ void LlvmCodeGen::OptimizeModule() {
   module_pass_manager->run(*module_);
 }
 
-void LlvmCodeGen::AddFunctionToJit(Function* fn, void** result) {
+// Adds the globals referenced by 'value', looking through constant expressions and
+// aggregates, to 'globals'.
+static void AddReferencedGlobals(const Value* value,
+    vector<const GlobalValue*>* globals) {
+  const GlobalValue* global = dyn_cast<GlobalValue>(value);
+  if (global != NULL) {
+    globals->push_back(global);
+    return;
+  }
+  const Constant* constant = dyn_cast<Constant>(value);
+  if (constant == NULL) return;
+  for (User::const_op_iterator it = constant->op_begin(); it != constant->op_end();
+      ++it) {
+    AddReferencedGlobals(*it, globals);
+  }
+}
+
+void LlvmCodeGen::MaterializeReachableFunctions() {
+  vector<const GlobalValue*> to_visit;
+  for (int i = fns_to_jit_compile_.size() - 1; i >= 0; --i) {
+    to_visit.push_back(fns_to_jit_compile_[i].first);
+  }
+  set<const GlobalValue*> visited;
+  while (!to_visit.empty()) {
+    const GlobalValue* global = to_visit.back();
+    to_visit.pop_back();
+    if (!visited.insert(global).second) continue;
+
+    const Function* fn = dyn_cast<Function>(global);
+    if (fn != NULL) {
+      if (!MaterializeFunction(const_cast<Function*>(fn))) return;
+      for (Function::const_iterator bb = fn->begin(); bb != fn->end(); ++bb) {
+        for (BasicBlock::const_iterator inst = bb->begin(); inst != bb->end(); ++inst) {
+          for (User::const_op_iterator op = inst->op_begin(); op != inst->op_end();
+              ++op) {
+            AddReferencedGlobals(*op, &to_visit);
+          }
+        }
+      }
+    }
+    const GlobalVariable* var = dyn_cast<GlobalVariable>(global);
+    if (var != NULL && var->hasInitializer()) {
+      AddReferencedGlobals(var->getInitializer(), &to_visit);
+    }
+    const GlobalAlias* alias = dyn_cast<GlobalAlias>(global);
+    if (alias != NULL) AddReferencedGlobals(alias->getAliasee(), &to_visit);
+  }
+}
+
+void LlvmCodeGen::AddFunctionToJit(Function* fn, void** result,
+    bool has_interpreted_fallback) {
+  DCHECK(!is_compiled_);
   fns_to_jit_compile_.push_back(make_pair(fn, result));
+  if (!has_interpreted_fallback) all_fns_have_fallback_ = false;
 }
 
 void* LlvmCodeGen::JitFunction(Function* function, int* scratch_size) {
@@ -712,7 +881,7 @@ void LlvmCodeGen::GetFunctions(vector<Function*>* functions) {
   Module::iterator fn_iter = module_->begin();
   while (fn_iter != module_->end()) {
     Function* fn = fn_iter++;
-    if (!fn->empty()) functions->push_back(fn);
+    if (!fn->empty() || fn->isMaterializable()) functions->push_back(fn);
   }
 }
 
@@ -720,7 +889,7 @@ void LlvmCodeGen::GetSymbols(unordered_set<string>* symbols) {
   Module::iterator fn_iter = module_->begin();
   while (fn_iter != module_->end()) {
     Function* fn = fn_iter++;
-    if (!fn->empty()) symbols->insert(fn->getName());
+    if (!fn->empty() || fn->isMaterializable()) symbols->insert(fn->getName());
   }
 }
 
@@ -823,6 +992,34 @@ Value* LlvmCodeGen::CodegenEquals(LlvmBuilder* builder, Value* v1, Value* v2,
   }
 }
 
+Value* LlvmCodeGen::CodegenLessThan(LlvmBuilder* builder, Value* v1, Value* v2,
+    const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_BOOLEAN:
+      return builder->CreateICmpULT(v1, v2, "tmp_lt");
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+      return builder->CreateICmpSLT(v1, v2, "tmp_lt");
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE: {
+      // RawValue::Compare() orders NaN before all other values.
+      Value* v1_is_nan = builder->CreateFCmpUNO(v1, v1, "v1_is_nan");
+      Value* v2_not_nan = builder->CreateFCmpORD(v2, v2, "v2_not_nan");
+      Value* nan_lt = builder->CreateAnd(v1_is_nan, v2_not_nan, "nan_lt");
+      return builder->CreateOr(nan_lt, builder->CreateFCmpOLT(v1, v2), "tmp_lt");
+    }
+    case TYPE_STRING: {
+      Function* str_fn = GetFunction(IRFunction::STRING_VALUE_LT);
+      return builder->CreateCall2(str_fn, v1, v2, "tmp_lt");
+    }
+    default:
+      DCHECK(false) << "Type is not implemented for codegen.";
+      return NULL;
+  }
+}
+
 // Intrinsics are loaded one by one.  Some are overloaded (e.g. memcpy) and the types must
 // be specified.
 // TODO: is there a better way to do this?
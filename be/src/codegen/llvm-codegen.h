@@ -16,6 +16,7 @@
 #ifndef IMPALA_CODEGEN_LLVM_CODEGEN_H
 #define IMPALA_CODEGEN_LLVM_CODEGEN_H
 
+#include "common/atomic.h"
 #include "common/status.h"
 
 #include <map>
@@ -46,6 +47,7 @@ namespace llvm {
   class ExecutionEngine;
   class Function;
   class FunctionPassManager;
+  class GlobalValue;
   class LLVMContext;
   class Module;
   class NoFolder;
@@ -94,9 +96,11 @@ class SubExprElimination;
 // AddFunctionToJit() will be pointing to the appropriate JIT'd function.
 //
 // Currently, each query will create and initialize one of these
-// objects.  This requires loading and parsing the cross compiled modules.
-// TODO: we should be able to do this once per process and let llvm compile
-// functions from across modules.
+// objects. The cross compiled module is read from disk once per process, and each
+// object parses it lazily: only the module's globals and function declarations are
+// parsed up front, and a function's body is parsed the first time it is used (e.g.
+// by GetFunction() or because a codegen'd function calls it). Functions that are not
+// reachable from the functions registered with AddFunctionToJit() are never parsed.
 //
 // LLVM has a nontrivial memory management scheme and objects will take
 // ownership of others.  The document is pretty good about being explicit with this
@@ -115,7 +119,8 @@ class LlvmCodeGen {
   // side is not loading the be explicitly anymore.
   static void InitializeLlvm(bool load_backend = false);
 
-  // Loads and parses the precompiled impala IR module
+  // Loads the precompiled impala IR module. The file is only read the first time this
+  // is called, and function bodies are parsed lazily.
   // codegen will contain the created object on success.
   static Status LoadImpalaIR(ObjectPool*, boost::scoped_ptr<LlvmCodeGen>* codegen);
 
@@ -231,8 +236,21 @@ class LlvmCodeGen {
   // Optimize and compile the module. This should be called after all functions to JIT
   // have been added to the module via AddFunctionToJit(). If optimizations_enabled_ is
   // false, the module will not be optimized before compilation.
+  // The registered function pointers are only set once all functions are compiled, so
+  // this may run in a background thread while the fragment executes if
+  // CanFinalizeAsync() is true.
   Status FinalizeModule();
 
+  // Returns true if every function passed to AddFunctionToJit() has an interpreted
+  // fallback, i.e. the fragment can start executing before FinalizeModule() returns.
+  bool CanFinalizeAsync() const { return all_fns_have_fallback_; }
+
+  // Returns true once FinalizeModule() has set all registered function pointers. Safe to
+  // call from any thread.
+  // Loads with acquire semantics, so the registered function pointers can be read with
+  // plain loads once this returned true.
+  bool jitted_fns_ready() const { return AtomicUtil::AcquireLoad(&jitted_fns_ready_); }
+
   // Replaces all instructions that call 'target_name' with a call instruction
   // to the new_fn.  Returns the modified function.
   // - target_name is the unmangled function name that should be replaced.
@@ -299,7 +317,14 @@ class LlvmCodeGen {
   //
   // In addition, any functions not registered with AddFunctionToJit() are marked as
   // internal in FinalizeModule() and may be removed as part of optimization.
-  void AddFunctionToJit(llvm::Function* fn, void** result_fn_ptr);
+  //
+  // If 'has_interpreted_fallback' is true, the caller checks *result_fn_ptr each time
+  // before using it and runs the interpreted code path while it is still NULL. The
+  // pointer is set at most once, from a different thread if the module is finalized
+  // in the background. It is stored with AtomicUtil::ReleaseStore(), so the caller must
+  // read it with AtomicUtil::AcquireLoad() before calling it.
+  void AddFunctionToJit(llvm::Function* fn, void** result_fn_ptr,
+      bool has_interpreted_fallback = false);
 
   // Verfies the function if the verfier is enabled.  Returns false if function
   // is invalid.
@@ -320,8 +345,8 @@ class LlvmCodeGen {
   // Returns the libc function, adding it to the module if it has not already been.
   llvm::Function* GetLibCFunction(FnPrototype* prototype);
 
-  // Returns the cross compiled function. IRFunction::Type is an enum which is
-  // defined in 'impala-ir/impala-ir-functions.h'
+  // Returns the cross compiled function, parsing its body if necessary. IRFunction::Type
+  // is an enum which is defined in 'impala-ir/impala-ir-functions.h'
   llvm::Function* GetFunction(IRFunction::Type);
 
   // Returns the hash function with signature:
@@ -383,7 +408,8 @@ class LlvmCodeGen {
   llvm::PointerType* ptr_type() { return ptr_type_; }
   llvm::Type* void_type() { return void_type_; }
 
-  // Fills 'functions' with all the functions that are defined in the module.
+  // Fills 'functions' with all the functions that are defined in the module, including
+  // ones whose bodies have not been parsed yet.
   // Note: this does not include functions that are just declared
   void GetFunctions(std::vector<llvm::Function*>* functions);
 
@@ -401,6 +427,12 @@ class LlvmCodeGen {
   llvm::Value* CodegenEquals(LlvmBuilder*, llvm::Value* v1, llvm::Value* v2,
       const ColumnType& type);
 
+  // Codegen computing v1 < v2, with the same semantics as RawValue::Compare() < 0.
+  // Returns the result. v1 and v2 must be the same type, which must be supported by
+  // CodegenEquals() (but not TYPE_NULL).
+  llvm::Value* CodegenLessThan(LlvmBuilder*, llvm::Value* v1, llvm::Value* v2,
+      const ColumnType& type);
+
   // Codegen for do *dst = src.  For native types, this is just a store, for structs
   // we need to assign the fields one by one
   void CodegenAssign(LlvmBuilder*, llvm::Value* dst, llvm::Value* src,
@@ -414,6 +446,7 @@ class LlvmCodeGen {
 
   // Loads a module at 'file' and links it to the module associated with
   // this LlvmCodeGen object. The module must be on the local filesystem.
+  // This parses all function bodies of this object's module.
   Status LinkModule(const std::string& file);
 
  private:
@@ -451,6 +484,14 @@ class LlvmCodeGen {
   // Optimizes the module. This includes pruning the module of any unused functions.
   void OptimizeModule();
 
+  // Parses the body of 'fn' if it has not been parsed yet. Returns false and marks the
+  // module as corrupt if the body cannot be parsed.
+  bool MaterializeFunction(llvm::Function* fn);
+
+  // Parses the bodies of the functions reachable from the functions in
+  // fns_to_jit_compile_.
+  void MaterializeReachableFunctions();
+
   // Clears generated hash fns.  This is only used for testing.
   void ClearHashFns();
 
@@ -477,6 +518,13 @@ class LlvmCodeGen {
   // functions after this point.
   bool is_compiled_;
 
+  // False if any function was added with AddFunctionToJit() without an interpreted
+  // fallback.
+  bool all_fns_have_fallback_;
+
+  // Set by FinalizeModule() after the registered function pointers are set.
+  volatile bool jitted_fns_ready_;
+
   // Error string that llvm will write to
   std::string error_string_;
 
@@ -36,6 +36,25 @@ class AtomicUtil {
   static inline void MemoryBarrier() {
     __sync_synchronize();
   }
+
+  // Stores 'val' to '*ptr' with release semantics: a thread that reads the value with
+  // AcquireLoad() also sees all memory writes done before the store, e.g. when one
+  // thread publishes a pointer to data it initialized. x86 doesn't reorder stores with
+  // earlier loads or stores, so only the compiler has to be kept from doing so.
+  template <typename T>
+  static inline void ReleaseStore(volatile T* ptr, T val) {
+    asm volatile("" : : : "memory");
+    *ptr = val;
+  }
+
+  // Loads '*ptr' with acquire semantics, see ReleaseStore(). x86 doesn't reorder loads
+  // with later loads or stores.
+  template <typename T>
+  static inline T AcquireLoad(const volatile T* ptr) {
+    T val = *ptr;
+    asm volatile("" : : : "memory");
+    return val;
+  }
 };
 
 // Wrapper for atomic integers.  This should be switched to c++ 11 when
@@ -24,8 +24,10 @@
 #include "codegen/llvm-codegen.h"
 #include "exec/hash-table.inline.h"
 #include "exprs/agg-fn-evaluator.h"
+#include "exprs/batched-expr.h"
 #include "exprs/expr.h"
 #include "runtime/descriptors.h"
+#include "runtime/free-pool.h"
 #include "runtime/mem-pool.h"
 #include "runtime/raw-value.h"
 #include "runtime/row-batch.h"
@@ -34,6 +36,8 @@
 #include "runtime/tuple.h"
 #include "runtime/tuple-row.h"
 #include "util/debug-util.h"
+#include "util/periodic-counter-updater.h"
+#include "udf/udf-internal.h"
 #include "util/runtime-profile.h"
 
 #include "gen-cpp/Exprs_types.h"
@@ -61,7 +65,8 @@ AggregationNode::AggregationNode(ObjectPool* pool, const TPlanNode& tnode,
     needs_finalize_(tnode.agg_node.need_finalize),
     build_timer_(NULL),
     get_results_timer_(NULL),
-    hash_table_buckets_counter_(NULL) {
+    hash_table_buckets_counter_(NULL),
+    tuple_pool_allocation_rate_counter_(NULL) {
 }
 
 Status AggregationNode::Init(const TPlanNode& tnode) {
@@ -74,6 +79,13 @@ Status AggregationNode::Init(const TPlanNode& tnode) {
         pool_, tnode.agg_node.aggregate_functions[i], &evaluator));
     aggregate_evaluators_.push_back(evaluator);
   }
+
+  // The grouping exprs are evaluated before the aggregate functions' inputs.
+  vector<vector<Expr*>*> expr_lists(1, &probe_exprs_);
+  for (int i = 0; i < aggregate_evaluators_.size(); ++i) {
+    expr_lists.push_back(aggregate_evaluators_[i]->mutable_input_exprs());
+  }
+  subexprs_.Init(pool_, expr_lists);
   return Status::OK;
 }
 
@@ -88,6 +100,16 @@ Status AggregationNode::Prepare(RuntimeState* state) {
       ADD_COUNTER(runtime_profile(), "BuildBuckets", TCounterType::UNIT);
   hash_table_load_factor_counter_ =
       ADD_COUNTER(runtime_profile(), "LoadFactor", TCounterType::DOUBLE_VALUE);
+  tuple_pool_allocations_counter_ =
+      ADD_COUNTER(runtime_profile(), "TuplePoolAllocations", TCounterType::UNIT);
+  tuple_pool_allocation_rate_counter_ = runtime_profile()->AddRateCounter(
+      "TuplePoolAllocationRate", tuple_pool_allocations_counter_);
+  free_pool_allocations_counter_ =
+      ADD_COUNTER(runtime_profile(), "FreePoolAllocations", TCounterType::UNIT);
+  free_pool_requested_bytes_counter_ =
+      ADD_COUNTER(runtime_profile(), "FreePoolRequestedBytes", TCounterType::BYTES);
+  free_pool_allocated_bytes_counter_ =
+      ADD_COUNTER(runtime_profile(), "FreePoolAllocatedBytes", TCounterType::BYTES);
 
 
   agg_tuple_desc_ = state->desc_tbl().GetTupleDescriptor(agg_tuple_id_);
@@ -115,6 +137,17 @@ Status AggregationNode::Prepare(RuntimeState* state) {
     RETURN_IF_ERROR(aggregate_evaluators_[i]->Prepare(state, child(0)->row_desc(), desc));
   }
 
+  // Inputs that are much cheaper to evaluate a batch at a time, e.g. ones calling Hive
+  // UDFs, are evaluated with GetValues() before the rows of a batch are processed. This
+  // disables codegen for UpdateAggTuple(). Shared subexpressions cache their results
+  // per row, which would mix up the rows of different batches, so they rule it out.
+  if (subexprs_.num_shared() == 0) {
+    for (int i = 0; i < aggregate_evaluators_.size(); ++i) {
+      BatchedExpr::Wrap(pool_, aggregate_evaluators_[i]->mutable_input_exprs(),
+          &batched_input_exprs_);
+    }
+  }
+
   // TODO: how many buckets?
   hash_tbl_.reset(new HashTable(state, build_exprs_, probe_exprs_, 1, true, true,
       id(), mem_tracker()));
@@ -134,11 +167,13 @@ Status AggregationNode::Prepare(RuntimeState* state) {
       codegen_process_row_batch_fn_ =
           CodegenProcessRowBatch(state->codegen(), update_tuple_fn);
       if (codegen_process_row_batch_fn_ != NULL) {
-        // Update to using codegen'd process row batch.
+        // Update to using codegen'd process row batch. Until the module is compiled,
+        // the interpreted functions are used.
         state->codegen()->AddFunctionToJit(
             codegen_process_row_batch_fn_,
-            reinterpret_cast<void**>(&process_row_batch_fn_));
+            reinterpret_cast<void**>(&process_row_batch_fn_), true);
         AddRuntimeExecOption("Codegen Enabled");
+        AddCodegenTierCounters();
       }
     }
   }
@@ -173,15 +208,28 @@ Status AggregationNode::Open(RuntimeState* state) {
         VLOG_ROW << "input row: " << PrintRow(row, children_[0]->row_desc());
       }
     }
-    if (process_row_batch_fn_ != NULL) {
-      process_row_batch_fn_(this, &batch);
-    } else if (probe_exprs_.empty()) {
-      ProcessRowBatchNoGrouping(&batch);
+    // process_row_batch_fn_ is set by another thread once the module is compiled.
+    ProcessRowBatchFn process_row_batch_fn =
+        AtomicUtil::AcquireLoad(&process_row_batch_fn_);
+    if (process_row_batch_fn != NULL) {
+      process_row_batch_fn(this, &batch);
+      COUNTER_UPDATE(codegen_rows_counter_, batch.num_rows());
     } else {
-      ProcessRowBatchWithGrouping(&batch);
+      for (int i = 0; i < batched_input_exprs_.size(); ++i) {
+        batched_input_exprs_[i]->SetBatch(&batch);
+      }
+      if (probe_exprs_.empty()) {
+        ProcessRowBatchNoGrouping(&batch);
+      } else {
+        ProcessRowBatchWithGrouping(&batch);
+      }
+      if (interpreted_rows_counter_ != NULL) {
+        COUNTER_UPDATE(interpreted_rows_counter_, batch.num_rows());
+      }
     }
     COUNTER_SET(hash_table_buckets_counter_, hash_tbl_->num_buckets());
     COUNTER_SET(hash_table_load_factor_counter_, hash_tbl_->load_factor());
+    UpdateTuplePoolCounters();
     num_input_rows += batch.num_rows();
     // We must set output_iterator_ here, rather than outside the loop, because
     // output_iterator_ must be set if the function returns within the loop
@@ -244,7 +292,13 @@ void AggregationNode::Close(RuntimeState* state) {
     output_iterator_.Next<false>();
   }
 
-  if (tuple_pool_.get() != NULL) tuple_pool_->FreeAll();
+  if (tuple_pool_.get() != NULL) {
+    UpdateTuplePoolCounters();
+    tuple_pool_->FreeAll();
+  }
+  if (tuple_pool_allocation_rate_counter_ != NULL) {
+    PeriodicCounterUpdater::StopRateCounter(tuple_pool_allocation_rate_counter_);
+  }
   if (hash_tbl_.get() != NULL) hash_tbl_->Close();
   for (int i = 0; i < aggregate_evaluators_.size(); ++i) {
     aggregate_evaluators_[i]->Close(state);
@@ -254,6 +308,25 @@ void AggregationNode::Close(RuntimeState* state) {
   ExecNode::Close(state);
 }
 
+void AggregationNode::UpdateTuplePoolCounters() {
+  COUNTER_SET(tuple_pool_allocations_counter_, tuple_pool_->num_allocations());
+
+  int64_t num_allocations = 0;
+  int64_t requested_bytes = 0;
+  int64_t allocated_bytes = 0;
+  for (int i = 0; i < aggregate_evaluators_.size(); ++i) {
+    impala_udf::FunctionContext* ctx = aggregate_evaluators_[i]->ctx();
+    if (ctx == NULL) continue;
+    FreePool* pool = ctx->impl()->pool();
+    num_allocations += pool->num_allocations();
+    requested_bytes += pool->requested_bytes();
+    allocated_bytes += pool->allocated_bytes();
+  }
+  COUNTER_SET(free_pool_allocations_counter_, num_allocations);
+  COUNTER_SET(free_pool_requested_bytes_counter_, requested_bytes);
+  COUNTER_SET(free_pool_allocated_bytes_counter_, allocated_bytes);
+}
+
 Tuple* AggregationNode::ConstructAggTuple() {
   Tuple* agg_tuple = Tuple::Create(agg_tuple_desc_->byte_size(), tuple_pool_.get());
   vector<SlotDescriptor*>::const_iterator slot_desc = agg_tuple_desc_->slots().begin();
@@ -474,6 +547,12 @@ llvm::Function* AggregationNode::CodegenUpdateSlot(
 Function* AggregationNode::CodegenUpdateAggTuple(LlvmCodeGen* codegen) {
   SCOPED_TIMER(codegen->codegen_timer());
 
+  if (!batched_input_exprs_.empty()) {
+    VLOG_QUERY << "Could not codegen UpdateAggTuple because some aggregate inputs "
+               << "are evaluated a batch at a time.";
+    return NULL;
+  }
+
   for (int i = 0; i < probe_exprs_.size(); ++i) {
     if (probe_exprs_[i]->codegen_fn() == NULL) {
       VLOG_QUERY << "Could not codegen UpdateAggTuple because "
@@ -32,6 +32,7 @@ namespace llvm {
 namespace impala {
 
 class AggFnEvaluator;
+class BatchedExpr;
 class LlvmCodeGen;
 class RowBatch;
 class RuntimeState;
@@ -73,6 +74,10 @@ class AggregationNode : public ExecNode {
   // Exprs used to insert constructed aggregation tuple into the hash table.
   // All the exprs are simply SlotRefs for the agg tuple.
   std::vector<Expr*> build_exprs_;
+  // Subexpressions shared by the grouping exprs and the aggregate functions' inputs.
+  CommonSubexprs subexprs_;
+  // The aggregate functions' inputs that are evaluated a batch at a time.
+  std::vector<BatchedExpr*> batched_input_exprs_;
   TupleId agg_tuple_id_;
   TupleDescriptor* agg_tuple_desc_;
   // Result of aggregation w/o GROUP BY.
@@ -106,6 +111,17 @@ class AggregationNode : public ExecNode {
   RuntimeProfile::Counter* hash_table_buckets_counter_;
   // Load factor in hash table
   RuntimeProfile::Counter* hash_table_load_factor_counter_;
+  // Number of allocations from tuple_pool_ and how fast they are made
+  RuntimeProfile::Counter* tuple_pool_allocations_counter_;
+  RuntimeProfile::Counter* tuple_pool_allocation_rate_counter_;
+  // Allocations made by the aggregate functions from their FreePools, with the bytes
+  // they asked for and the bytes the pools' size classes rounded them up to.
+  RuntimeProfile::Counter* free_pool_allocations_counter_;
+  RuntimeProfile::Counter* free_pool_requested_bytes_counter_;
+  RuntimeProfile::Counter* free_pool_allocated_bytes_counter_;
+
+  // Updates the tuple_pool_ and FreePool counters from the pools' current state.
+  void UpdateTuplePoolCounters();
 
   // Constructs a new aggregation output tuple (allocated from tuple_pool_),
   // initialized to grouping values computed over 'current_row_'.
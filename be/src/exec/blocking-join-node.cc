@@ -16,6 +16,7 @@
 
 #include <sstream>
 
+#include "codegen/llvm-codegen.h"
 #include "exprs/expr.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
@@ -204,3 +205,100 @@ void BlockingJoinNode::CreateOutputRow(TupleRow* out, TupleRow* left, TupleRow*
     }
   }
 }
+
+// This codegen'd function assumes that the probe row is non-null.  For a left outer
+// join, the IR looks like:
+// define void @CreateOutputRow(%"class.impala::BlockingJoinNode"* %this_ptr,
+//                              %"class.impala::TupleRow"* %out_arg,
+//                              %"class.impala::TupleRow"* %probe_arg,
+//                              %"class.impala::TupleRow"* %build_arg) {
+// entry:
+//   %out = bitcast %"class.impala::TupleRow"* %out_arg to i8**
+//   %probe = bitcast %"class.impala::TupleRow"* %probe_arg to i8**
+//   %build = bitcast %"class.impala::TupleRow"* %build_arg to i8**
+//   %0 = bitcast i8** %out to i8*
+//   %1 = bitcast i8** %probe to i8*
+//   call void @llvm.memcpy.p0i8.p0i8.i32(i8* %0, i8* %1, i32 16, i32 16, i1 false)
+//   %is_build_null = icmp eq i8** %build, null
+//   br i1 %is_build_null, label %build_null, label %build_not_null
+//
+// build_not_null:                                   ; preds = %entry
+//   %dst_tuple_ptr1 = getelementptr i8** %out, i32 1
+//   %src_tuple_ptr = getelementptr i8** %build, i32 0
+//   %2 = load i8** %src_tuple_ptr
+//   store i8* %2, i8** %dst_tuple_ptr1
+//   ret void
+//
+// build_null:                                       ; preds = %entry
+//   %dst_tuple_ptr = getelementptr i8** %out, i32 1
+//   store i8* null, i8** %dst_tuple_ptr
+//   ret void
+// }
+Function* BlockingJoinNode::CodegenCreateOutputRow(LlvmCodeGen* codegen,
+    bool build_row_can_be_null) {
+  Type* tuple_row_type = codegen->GetType(TupleRow::LLVM_CLASS_NAME);
+  DCHECK(tuple_row_type != NULL);
+  PointerType* tuple_row_ptr_type = PointerType::get(tuple_row_type, 0);
+
+  Type* this_type = codegen->GetType(BlockingJoinNode::LLVM_CLASS_NAME);
+  DCHECK(this_type != NULL);
+  PointerType* this_ptr_type = PointerType::get(this_type, 0);
+
+  // TupleRows are really just an array of pointers.  Easier to work with them
+  // this way.
+  PointerType* tuple_row_working_type = PointerType::get(codegen->ptr_type(), 0);
+
+  // Construct function signature to match CreateOutputRow()
+  LlvmCodeGen::FnPrototype prototype(codegen, "CreateOutputRow", codegen->void_type());
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("this_ptr", this_ptr_type));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("out_arg", tuple_row_ptr_type));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("probe_arg", tuple_row_ptr_type));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("build_arg", tuple_row_ptr_type));
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Value* args[4];
+  Function* fn = prototype.GeneratePrototype(&builder, args);
+  Value* out_row_arg = builder.CreateBitCast(args[1], tuple_row_working_type, "out");
+  Value* probe_row_arg = builder.CreateBitCast(args[2], tuple_row_working_type, "probe");
+  Value* build_row_arg = builder.CreateBitCast(args[3], tuple_row_working_type, "build");
+
+  // Copy probe row
+  codegen->CodegenMemcpy(&builder, out_row_arg, probe_row_arg, result_tuple_row_size_);
+
+  // Copy build row.
+  BasicBlock* build_not_null_block = BasicBlock::Create(context, "build_not_null", fn);
+  BasicBlock* build_null_block = NULL;
+
+  if (build_row_can_be_null) {
+    // build tuple can be null
+    build_null_block = BasicBlock::Create(context, "build_null", fn);
+    Value* is_build_null = builder.CreateIsNull(build_row_arg, "is_build_null");
+    builder.CreateCondBr(is_build_null, build_null_block, build_not_null_block);
+
+    // Set tuple build ptrs to NULL
+    builder.SetInsertPoint(build_null_block);
+    for (int i = 0; i < build_tuple_size_; ++i) {
+      Value* array_idx[] = { codegen->GetIntConstant(TYPE_INT, build_tuple_idx_[i]) };
+      Value* dst = builder.CreateGEP(out_row_arg, array_idx, "dst_tuple_ptr");
+      builder.CreateStore(codegen->null_ptr_value(), dst);
+    }
+    builder.CreateRetVoid();
+  } else {
+    // build row can't be NULL
+    builder.CreateBr(build_not_null_block);
+  }
+
+  // Copy build tuple ptrs
+  builder.SetInsertPoint(build_not_null_block);
+  for (int i = 0; i < build_tuple_size_; ++i) {
+    Value* dst_idx[] = { codegen->GetIntConstant(TYPE_INT, build_tuple_idx_[i]) };
+    Value* src_idx[] = { codegen->GetIntConstant(TYPE_INT, i) };
+    Value* dst = builder.CreateGEP(out_row_arg, dst_idx, "dst_tuple_ptr");
+    Value* src = builder.CreateGEP(build_row_arg, src_idx, "src_tuple_ptr");
+    builder.CreateStore(builder.CreateLoad(src), dst);
+  }
+  builder.CreateRetVoid();
+
+  return codegen->FinalizeFunction(fn);
+}
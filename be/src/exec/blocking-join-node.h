@@ -122,6 +122,11 @@ class BlockingJoinNode : public ExecNode {
   // This is replaced by codegen.
   void CreateOutputRow(TupleRow* out_row, TupleRow* left_row, TupleRow* build_row);
 
+  // Codegen function to create output row. The left row can't be NULL, the build row
+  // only if 'build_row_can_be_null' is true.
+  llvm::Function* CodegenCreateOutputRow(LlvmCodeGen* codegen,
+      bool build_row_can_be_null);
+
  private:
   // Supervises ConstructBuildSide in a separate thread, and returns its status in the
   // promise parameter.
@@ -0,0 +1,97 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/impala-ir.h"
+#include "exec/cross-join-node.h"
+#include "runtime/row-batch.h"
+
+using namespace std;
+using namespace impala;
+
+// Functions in this file are cross compiled to IR with clang.
+
+// CreateOutputRow and EvalConjuncts are replaced by codegen.
+int CrossJoinNode::ProcessLeftChildBatch(RowBatch* output_batch, RowBatch* batch,
+    int max_added_rows) {
+  int row_idx = output_batch->AddRows(max_added_rows);
+  DCHECK(row_idx != RowBatch::INVALID_ROW_INDEX);
+  uint8_t* output_row_mem = reinterpret_cast<uint8_t*>(output_batch->GetRow(row_idx));
+  TupleRow* output_row = reinterpret_cast<TupleRow*>(output_row_mem);
+
+  int rows_returned = 0;
+  Expr* const* conjuncts = &conjuncts_[0];
+  int num_conjuncts = conjuncts_.size();
+
+  int num_left_rows = batch->num_rows();
+  int num_build_batches = build_batches_.num_row_batches();
+  for (; build_batch_idx_ < num_build_batches; ++build_batch_idx_) {
+    RowBatch* build_batch = build_batches_.GetRowBatch(build_batch_idx_);
+    int num_build_rows = build_batch->num_rows();
+    for (; left_row_idx_ < num_left_rows; ++left_row_idx_) {
+      TupleRow* left_row = batch->GetRow(left_row_idx_);
+      while (build_row_idx_ < num_build_rows) {
+        CreateOutputRow(output_row, left_row, build_batch->GetRow(build_row_idx_++));
+
+        if (!EvalConjuncts(conjuncts, num_conjuncts, output_row)) continue;
+        ++rows_returned;
+        // Filled up out batch or hit limit
+        if (UNLIKELY(rows_returned == max_added_rows)) goto end;
+        // Advance to next out row
+        output_row_mem += output_batch->row_byte_size();
+        output_row = reinterpret_cast<TupleRow*>(output_row_mem);
+      }
+      build_row_idx_ = 0;
+    }
+    left_row_idx_ = 0;
+  }
+
+end:
+  output_batch->CommitRows(rows_returned);
+  return rows_returned;
+}
+
+// CreateOutputRow and EvalConjuncts are replaced by codegen.
+int CrossJoinNode::ProcessBandJoinBatch(RowBatch* output_batch, RowBatch* batch,
+    int max_added_rows) {
+  int row_idx = output_batch->AddRows(max_added_rows);
+  DCHECK(row_idx != RowBatch::INVALID_ROW_INDEX);
+  uint8_t* output_row_mem = reinterpret_cast<uint8_t*>(output_batch->GetRow(row_idx));
+  TupleRow* output_row = reinterpret_cast<TupleRow*>(output_row_mem);
+
+  int rows_returned = 0;
+  Expr* const* conjuncts = &conjuncts_[0];
+  int num_conjuncts = conjuncts_.size();
+
+  int num_left_rows = batch->num_rows();
+  for (; left_row_idx_ < num_left_rows; ++left_row_idx_) {
+    TupleRow* left_row = batch->GetRow(left_row_idx_);
+    if (band_pos_ == -1) FindBandRange(left_row);
+    while (band_pos_ < band_end_) {
+      CreateOutputRow(output_row, left_row, band_rows_[band_pos_++].row);
+
+      if (!EvalConjuncts(conjuncts, num_conjuncts, output_row)) continue;
+      ++rows_returned;
+      // Filled up out batch or hit limit
+      if (UNLIKELY(rows_returned == max_added_rows)) goto end;
+      // Advance to next out row
+      output_row_mem += output_batch->row_byte_size();
+      output_row = reinterpret_cast<TupleRow*>(output_row_mem);
+    }
+    band_pos_ = -1;
+  }
+
+end:
+  output_batch->CommitRows(rows_returned);
+  return rows_returned;
+}
@@ -14,10 +14,12 @@
 
 #include "exec/cross-join-node.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include "codegen/llvm-codegen.h"
 #include "exprs/expr.h"
+#include "runtime/raw-value.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "util/debug-util.h"
@@ -32,19 +34,44 @@ using namespace std;
 
 CrossJoinNode::CrossJoinNode(
     ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
-  : BlockingJoinNode("CrossJoinNode", TJoinOp::CROSS_JOIN, pool, tnode, descs) {
+  : BlockingJoinNode("CrossJoinNode", TJoinOp::CROSS_JOIN, pool, tnode, descs),
+    build_batch_idx_(0),
+    left_row_idx_(0),
+    build_row_idx_(0),
+    band_slot_(NULL),
+    band_lower_expr_(NULL),
+    band_lower_inclusive_(false),
+    band_upper_expr_(NULL),
+    band_upper_inclusive_(false),
+    band_pos_(-1),
+    band_end_(-1),
+    codegen_process_left_child_batch_fn_(NULL),
+    process_left_child_batch_fn_(NULL) {
 }
 
 Status CrossJoinNode::Prepare(RuntimeState* state) {
   DCHECK(join_op_ == TJoinOp::CROSS_JOIN);
   RETURN_IF_ERROR(BlockingJoinNode::Prepare(state));
   build_batch_pool_.reset(new ObjectPool());
+  InitBandJoin(state);
+  if (band_slot_ != NULL) AddRuntimeExecOption("Band Join");
+
+  if (state->codegen_enabled()) {
+    codegen_process_left_child_batch_fn_ = CodegenProcessLeftChildBatch(state->codegen());
+    if (codegen_process_left_child_batch_fn_ != NULL) {
+      state->codegen()->AddFunctionToJit(codegen_process_left_child_batch_fn_,
+          reinterpret_cast<void**>(&process_left_child_batch_fn_), true);
+      AddRuntimeExecOption("Codegen Enabled");
+      AddCodegenTierCounters();
+    }
+  }
   return Status::OK;
 }
 
 void CrossJoinNode::Close(RuntimeState* state) {
   if (is_closed()) return;
   build_batches_.Reset();
+  band_rows_.clear();
   build_batch_pool_.reset();
   BlockingJoinNode::Close(state);
 }
@@ -67,11 +94,24 @@ Status CrossJoinNode::ConstructBuildSide(RuntimeState* state) {
         static_cast<int64_t>(build_batches_.total_num_rows()));
     if (eos) break;
   }
+  if (band_slot_ != NULL) {
+    SCOPED_TIMER(build_timer_);
+    BuildBandRows();
+  }
   return Status::OK;
 }
 
 void CrossJoinNode::InitGetNext(TupleRow* first_left_row) {
-  current_build_row_ = build_batches_.Iterator();
+  // The join keeps its own position in left_batch_, starting at its first row.
+  build_batch_idx_ = 0;
+  left_row_idx_ = 0;
+  build_row_idx_ = 0;
+  band_pos_ = -1;
+}
+
+bool CrossJoinNode::LeftBatchDone() {
+  if (band_slot_ != NULL) return left_row_idx_ == left_batch_->num_rows();
+  return build_batch_idx_ == build_batches_.num_row_batches();
 }
 
 Status CrossJoinNode::GetNext(RuntimeState* state, RowBatch* output_batch, bool* eos) {
@@ -90,9 +130,29 @@ Status CrossJoinNode::GetNext(RuntimeState* state, RowBatch* output_batch, bool*
     int64_t max_added_rows = output_batch->capacity() - output_batch->num_rows();
     if (limit() != -1) max_added_rows = min(max_added_rows, limit() - rows_returned());
 
-    // Continue processing this row batch
-    num_rows_returned_ +=
-        ProcessLeftChildBatch(output_batch, left_batch_.get(), max_added_rows);
+    // Continue processing this row batch. process_left_child_batch_fn_ is set by
+    // another thread once the module is compiled. Both versions keep their position in
+    // the left child batch in the same members, so we can switch between batches.
+    ProcessLeftChildBatchFn process_left_child_batch_fn =
+        AtomicUtil::AcquireLoad(&process_left_child_batch_fn_);
+    int rows_added;
+    if (process_left_child_batch_fn != NULL) {
+      rows_added = process_left_child_batch_fn(
+          this, output_batch, left_batch_.get(), max_added_rows);
+      COUNTER_UPDATE(codegen_rows_counter_, rows_added);
+    } else {
+      if (band_slot_ != NULL) {
+        rows_added =
+            ProcessBandJoinBatch(output_batch, left_batch_.get(), max_added_rows);
+      } else {
+        rows_added =
+            ProcessLeftChildBatch(output_batch, left_batch_.get(), max_added_rows);
+      }
+      if (interpreted_rows_counter_ != NULL) {
+        COUNTER_UPDATE(interpreted_rows_counter_, rows_added);
+      }
+    }
+    num_rows_returned_ += rows_added;
     COUNTER_SET(rows_returned_counter_, num_rows_returned_);
 
     if (ReachedLimit() || output_batch->AtCapacity()) {
@@ -101,9 +161,9 @@ Status CrossJoinNode::GetNext(RuntimeState* state, RowBatch* output_batch, bool*
     }
 
     // Check to see if we're done processing the current left child batch
-    if (current_build_row_.AtEnd() && left_batch_pos_ == left_batch_->num_rows()) {
+    if (LeftBatchDone()) {
       left_batch_->TransferResourceOwnership(output_batch);
-      left_batch_pos_ = 0;
+      InitGetNext(NULL);
       if (output_batch->AtCapacity()) break;
       if (left_side_eos_) {
         *eos = eos_ = true;
@@ -128,39 +188,191 @@ string CrossJoinNode::BuildListDebugString() {
   return out.str();
 }
 
-// TODO: this can be replaced with a codegen'd function
-int CrossJoinNode::ProcessLeftChildBatch(RowBatch* output_batch, RowBatch* batch,
-    int max_added_rows) {
-  int row_idx = output_batch->AddRows(max_added_rows);
-  DCHECK(row_idx != RowBatch::INVALID_ROW_INDEX);
-  uint8_t* output_row_mem = reinterpret_cast<uint8_t*>(output_batch->GetRow(row_idx));
-  TupleRow* output_row = reinterpret_cast<TupleRow*>(output_row_mem);
+// Returns true if all the slots 'expr' references are in tuples of 'row_desc'.
+static bool IsBoundByTuples(Expr* expr, const RowDescriptor& row_desc,
+    const DescriptorTbl& desc_tbl) {
+  vector<SlotId> slot_ids;
+  expr->GetSlotIds(&slot_ids);
+  const vector<TupleDescriptor*>& tuple_descs = row_desc.tuple_descriptors();
+  for (int i = 0; i < slot_ids.size(); ++i) {
+    TupleId tuple_id = desc_tbl.GetSlotDescriptor(slot_ids[i])->parent();
+    bool found = false;
+    for (int j = 0; j < tuple_descs.size(); ++j) {
+      if (tuple_descs[j]->id() == tuple_id) {
+        found = true;
+        break;
+      }
+    }
+    if (!found) return false;
+  }
+  return true;
+}
 
-  int rows_returned = 0;
-  Expr* const* conjuncts = &conjuncts_[0];
+// Returns true if the band join supports sorting by slots of 'type'.
+// RawValue::Compare() doesn't order NaNs, so floating point types are left out.
+static bool IsBandJoinType(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_TIMESTAMP:
+    case TYPE_STRING:
+      return true;
+    default:
+      return false;
+  }
+}
 
-  while (true) {
-    while (!current_build_row_.AtEnd()) {
-      CreateOutputRow(output_row, current_left_child_row_, current_build_row_.GetRow());
-      current_build_row_.Next();
-
-      if (!EvalConjuncts(conjuncts, conjuncts_.size(), output_row)) continue;
-      ++rows_returned;
-      // Filled up out batch or hit limit
-      if (UNLIKELY(rows_returned == max_added_rows)) goto end;
-      // Advance to next out row
-      output_row_mem += output_batch->row_byte_size();
-      output_row = reinterpret_cast<TupleRow*>(output_row_mem);
+// Comparison of a build slot with an expr over the left child's row, as a bound of the
+// slot.
+struct BandBound {
+  Expr* slot;
+  SlotId slot_id;
+  Expr* expr;
+  bool is_lower;
+  bool inclusive;
+};
+
+void CrossJoinNode::InitBandJoin(RuntimeState* state) {
+  vector<BandBound> bounds;
+  for (int i = 0; i < conjuncts_.size(); ++i) {
+    Expr* conjunct = conjuncts_[i];
+    const string& fn_name = conjunct->builtin_fn_name();
+    bool is_lt = fn_name == "lt" || fn_name == "le";
+    bool is_gt = fn_name == "gt" || fn_name == "ge";
+    if ((!is_lt && !is_gt) || conjunct->GetNumChildren() != 2) continue;
+    for (int slot_idx = 0; slot_idx < 2; ++slot_idx) {
+      Expr* slot = conjunct->GetChild(slot_idx);
+      Expr* expr = conjunct->GetChild(1 - slot_idx);
+      if (!slot->is_slotref() || !IsBandJoinType(slot->type())) continue;
+      if (slot->type() != expr->type()) continue;
+      if (!IsBoundByTuples(slot, child(1)->row_desc(), state->desc_tbl())) continue;
+      if (!IsBoundByTuples(expr, child(0)->row_desc(), state->desc_tbl())) continue;
+      BandBound bound;
+      bound.slot = slot;
+      bound.slot_id = static_cast<SlotRef*>(slot)->slot_id();
+      bound.expr = expr;
+      // 'slot < expr' and 'expr > slot' are upper bounds.
+      bound.is_lower = slot_idx == 0 ? is_gt : is_lt;
+      bound.inclusive = fn_name == "le" || fn_name == "ge";
+      bounds.push_back(bound);
+    }
+  }
+  if (bounds.empty()) return;
+
+  // Prefer a slot that is bounded from both sides, e.g. by a BETWEEN.
+  int slot_bound_idx = 0;
+  for (int i = 0; i < bounds.size(); ++i) {
+    for (int j = 0; j < bounds.size(); ++j) {
+      if (bounds[i].slot_id == bounds[j].slot_id &&
+          bounds[i].is_lower != bounds[j].is_lower) {
+        slot_bound_idx = i;
+      }
+    }
+  }
+  band_slot_ = bounds[slot_bound_idx].slot;
+  for (int i = 0; i < bounds.size(); ++i) {
+    if (bounds[i].slot_id != bounds[slot_bound_idx].slot_id) continue;
+    if (bounds[i].is_lower && band_lower_expr_ == NULL) {
+      band_lower_expr_ = bounds[i].expr;
+      band_lower_inclusive_ = bounds[i].inclusive;
+    } else if (!bounds[i].is_lower && band_upper_expr_ == NULL) {
+      band_upper_expr_ = bounds[i].expr;
+      band_upper_inclusive_ = bounds[i].inclusive;
     }
+  }
+  VLOG(2) << "Band join on " << band_slot_->DebugString();
+}
+
+struct CrossJoinNode::BandRowLess {
+  BandRowLess(const ColumnType& type) : type(type) { }
+  bool operator()(const BandRow& a, const BandRow& b) const {
+    return RawValue::Compare(a.value, b.value, type) < 0;
+  }
+  const ColumnType& type;
+};
+
+void CrossJoinNode::BuildBandRows() {
+  DCHECK(band_slot_ != NULL);
+  // band_slot_ is evaluated over rows of this node, which only need the build tuples.
+  // It is a slot ref, so the values stay valid as long as the build batches.
+  vector<uint8_t> row_mem(result_tuple_row_size_);
+  TupleRow* row = reinterpret_cast<TupleRow*>(&row_mem[0]);
+  band_rows_.reserve(build_batches_.total_num_rows());
+  for (RowBatchList::TupleRowIterator it = build_batches_.Iterator(); !it.AtEnd();
+      it.Next()) {
+    CreateOutputRow(row, NULL, it.GetRow());
+    BandRow band_row;
+    band_row.value = band_slot_->GetValue(row);
+    if (band_row.value == NULL) continue;
+    band_row.row = it.GetRow();
+    band_rows_.push_back(band_row);
+  }
+  sort(band_rows_.begin(), band_rows_.end(), BandRowLess(band_slot_->type()));
+}
 
-    DCHECK(current_build_row_.AtEnd());
-    // Advance to the next row in the left child batch
-    if (UNLIKELY(left_batch_pos_ == batch->num_rows())) goto end;
-    current_left_child_row_ = batch->GetRow(left_batch_pos_++);
-    current_build_row_ = build_batches_.Iterator();
+int64_t CrossJoinNode::FindBandRow(const void* value, bool after_equal) {
+  int64_t begin = 0;
+  int64_t end = band_rows_.size();
+  while (begin < end) {
+    int64_t mid = begin + (end - begin) / 2;
+    int cmp = RawValue::Compare(band_rows_[mid].value, value, band_slot_->type());
+    if (cmp < 0 || (after_equal && cmp == 0)) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
   }
+  return begin;
+}
+
+void CrossJoinNode::FindBandRange(TupleRow* left_row) {
+  band_pos_ = 0;
+  band_end_ = band_rows_.size();
+  // A comparison with NULL is never true.
+  if (band_lower_expr_ != NULL) {
+    void* value = band_lower_expr_->GetValue(left_row);
+    if (value == NULL) {
+      band_end_ = 0;
+      return;
+    }
+    band_pos_ = FindBandRow(value, !band_lower_inclusive_);
+  }
+  if (band_upper_expr_ != NULL) {
+    void* value = band_upper_expr_->GetValue(left_row);
+    if (value == NULL) {
+      band_end_ = 0;
+      return;
+    }
+    band_end_ = max(band_pos_, FindBandRow(value, band_upper_inclusive_));
+  }
+}
+
+Function* CrossJoinNode::CodegenProcessLeftChildBatch(LlvmCodeGen* codegen) {
+  // Get cross compiled function
+  Function* process_left_child_batch_fn = codegen->GetFunction(band_slot_ == NULL ?
+      IRFunction::CROSS_JOIN_PROCESS_LEFT_CHILD_BATCH :
+      IRFunction::CROSS_JOIN_PROCESS_BAND_JOIN_BATCH);
+  DCHECK(process_left_child_batch_fn != NULL);
+
+  // Codegen CreateOutputRow
+  Function* create_output_row_fn = CodegenCreateOutputRow(codegen, false);
+  if (create_output_row_fn == NULL) return NULL;
+
+  // Codegen evaluating conjuncts
+  Function* conjuncts_fn = CodegenEvalConjuncts(codegen, conjuncts_);
+  if (conjuncts_fn == NULL) return NULL;
+
+  // Replace all call sites with codegen version
+  int replaced = 0;
+  process_left_child_batch_fn = codegen->ReplaceCallSites(process_left_child_batch_fn,
+      false, create_output_row_fn, "CreateOutputRow", &replaced);
+  DCHECK_EQ(replaced, 1);
+
+  process_left_child_batch_fn = codegen->ReplaceCallSites(process_left_child_batch_fn,
+      false, conjuncts_fn, "EvalConjuncts", &replaced);
+  DCHECK_EQ(replaced, 1);
 
-end:
-  output_batch->CommitRows(rows_returned);
-  return rows_returned;
+  return codegen->OptimizeFunctionWithExprs(process_left_child_batch_fn);
 }
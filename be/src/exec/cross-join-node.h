@@ -41,6 +41,13 @@ class TupleRow;
 // build batches are kept in a list that is fully constructed from the right child in
 // ConstructBuildSide() (called by BlockingJoinNode::Open()) while rows are fetched from
 // the left child as necessary in GetNext().
+// The rows are joined block by block: each build batch is joined with all the rows of
+// the current left child batch before moving on to the next one, so that the build
+// rows stay in the cache while they are used.
+// If a conjunct compares a build slot with an expr over the left child's row, e.g.
+// 'a.ts >= b.start' or 'b.x BETWEEN a.x - 10 AND a.x + 10', this is a band join: the
+// build rows are sorted by the slot and each left child row is only joined with the
+// range of build rows that can satisfy the comparisons.
 class CrossJoinNode : public BlockingJoinNode {
  public:
   CrossJoinNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -58,7 +65,52 @@ class CrossJoinNode : public BlockingJoinNode {
   boost::scoped_ptr<ObjectPool> build_batch_pool_;
   // List of build batches, constructed in Prepare()
   RowBatchList build_batches_;
-  RowBatchList::TupleRowIterator current_build_row_;
+
+  // Position of the join in left_batch_ and the build rows: the index of the build
+  // batch, of the row in left_batch_ and of the row in the build batch. The band join
+  // only uses left_row_idx_.
+  int build_batch_idx_;
+  int left_row_idx_;
+  int build_row_idx_;
+
+  // Build row of the band join and its value of band_slot_, which is never NULL.
+  struct BandRow {
+    void* value;
+    TupleRow* row;
+  };
+
+  // Orders BandRows by their value.
+  struct BandRowLess;
+
+  // Build slot of the band join, evaluated over rows of this node. NULL if this isn't a
+  // band join.
+  Expr* band_slot_;
+
+  // Exprs over the left child's row that band_slot_ is compared with, and whether the
+  // comparison is inclusive. band_slot_ is bounded from below by band_lower_expr_ and
+  // from above by band_upper_expr_. Either may be NULL.
+  Expr* band_lower_expr_;
+  bool band_lower_inclusive_;
+  Expr* band_upper_expr_;
+  bool band_upper_inclusive_;
+
+  // The build rows sorted by value. Rows for which band_slot_ is NULL are left out,
+  // since they can't satisfy the comparisons.
+  std::vector<BandRow> band_rows_;
+
+  // Range of band_rows_ left to join with the current left child row. band_pos_ is -1
+  // if the range isn't computed yet.
+  int64_t band_pos_;
+  int64_t band_end_;
+
+  // llvm function object for processing left child batches
+  llvm::Function* codegen_process_left_child_batch_fn_;
+
+  // Signature of ProcessLeftChildBatch() and ProcessBandJoinBatch()
+  typedef int (*ProcessLeftChildBatchFn)(CrossJoinNode*, RowBatch*, RowBatch*, int);
+  // Jitted ProcessLeftChildBatch or ProcessBandJoinBatch function pointer, depending
+  // on whether this is a band join. Null if codegen is disabled.
+  ProcessLeftChildBatchFn process_left_child_batch_fn_;
 
   // Processes a batch from the left child.
   //  output_batch: the batch for resulting tuple rows
@@ -68,6 +120,31 @@ class CrossJoinNode : public BlockingJoinNode {
   // return the number of rows added to output_batch
   int ProcessLeftChildBatch(RowBatch* output_batch, RowBatch* batch, int max_added_rows);
 
+  // ProcessLeftChildBatch() for band joins.
+  int ProcessBandJoinBatch(RowBatch* output_batch, RowBatch* batch, int max_added_rows);
+
+  // Returns true if all the rows of left_batch_ were joined.
+  bool LeftBatchDone();
+
+  // Sets band_slot_ and the exprs bounding it if one of the conjuncts makes this a
+  // band join.
+  void InitBandJoin(RuntimeState* state);
+
+  // Sorts the build rows into band_rows_.
+  void BuildBandRows();
+
+  // Sets band_pos_ and band_end_ to the range of band_rows_ that can be joined with
+  // 'left_row'.
+  void FindBandRange(TupleRow* left_row);
+
+  // Returns the index of the first row in band_rows_ with a value greater than or equal
+  // to 'value', or greater than it if 'after_equal' is true.
+  int64_t FindBandRow(const void* value, bool after_equal);
+
+  // Codegen processing left child batches.  Identical signature to
+  // ProcessLeftChildBatch.  Returns NULL if codegen was not possible.
+  llvm::Function* CodegenProcessLeftChildBatch(LlvmCodeGen* codegen);
+
   // Returns a debug string for build_rows_. This is used for debugging during the
   // build list construction and before doing the join.
   std::string BuildListDebugString();
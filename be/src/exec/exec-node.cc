@@ -105,6 +105,8 @@ ExecNode::ExecNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl
     num_rows_returned_(0),
     rows_returned_counter_(NULL),
     rows_returned_rate_(NULL),
+    interpreted_rows_counter_(NULL),
+    codegen_rows_counter_(NULL),
     is_closed_(false) {
   InitRuntimeProfile(PrintPlanNodeType(tnode.node_type));
 }
@@ -113,7 +115,14 @@ ExecNode::~ExecNode() {
 }
 
 Status ExecNode::Init(const TPlanNode& tnode) {
-  return Expr::CreateExprTrees(pool_, tnode.conjuncts, &conjuncts_);
+  RETURN_IF_ERROR(Expr::CreateExprTrees(pool_, tnode.conjuncts, &conjuncts_));
+  // Scan nodes evaluate their conjuncts in several threads, which can't share the
+  // cached subexpressions.
+  if (!IsScanNode()) {
+    vector<vector<Expr*>*> expr_lists(1, &conjuncts_);
+    conjunct_subexprs_.Init(pool_, expr_lists);
+  }
+  return Status::OK;
 }
 
 Status ExecNode::Prepare(RuntimeState* state) {
@@ -169,6 +178,14 @@ void ExecNode::AddRuntimeExecOption(const string& str) {
   runtime_profile()->AddInfoString("ExecOption", runtime_exec_options_);
 }
 
+void ExecNode::AddCodegenTierCounters() {
+  if (interpreted_rows_counter_ != NULL) return;
+  interpreted_rows_counter_ =
+      ADD_COUNTER(runtime_profile(), "RowsProcessedInterpreted", TCounterType::UNIT);
+  codegen_rows_counter_ =
+      ADD_COUNTER(runtime_profile(), "RowsProcessedCodegen", TCounterType::UNIT);
+}
+
 Status ExecNode::CreateTree(ObjectPool* pool, const TPlan& plan,
                             const DescriptorTbl& descs, ExecNode** root) {
   if (plan.nodes.size() == 0) {
@@ -330,6 +347,25 @@ bool ExecNode::EvalConjuncts(Expr* const* exprs, int num_exprs, TupleRow* row) {
   return true;
 }
 
+int ExecNode::EvalBatchConjuncts(Expr* const* exprs, int num_exprs, RowBatch* batch,
+    bool* selected) {
+  int num_rows = batch->num_rows();
+  memset(selected, 1, num_rows);
+  int num_selected = num_rows;
+  for (int i = 0; i < num_exprs && num_selected > 0; ++i) {
+    // The first expr is evaluated for all rows.
+    ExprValueVector* values = exprs[i]->GetValues(batch, i == 0 ? NULL : selected);
+    const bool* value = values->values<bool>();
+    const bool* is_null = values->is_null();
+    num_selected = 0;
+    for (int j = 0; j < num_rows; ++j) {
+      selected[j] &= !is_null[j] & value[j];
+      num_selected += selected[j];
+    }
+  }
+  return num_selected;
+}
+
 // Codegen for EvalConjuncts.  The generated signature is
 // For a node with two conjunct predicates
 // define i1 @EvalConjuncts(%"class.impala::Expr"** %exprs, i32 %num_exprs,
@@ -20,6 +20,7 @@
 #include <sstream>
 
 #include "common/status.h"
+#include "exprs/common-subexprs.h"
 #include "runtime/descriptors.h"  // for RowDescriptor
 #include "util/runtime-profile.h"
 #include "util/blocking-queue.h"
@@ -119,6 +120,13 @@ class ExecNode {
   // out how to deal with declaring a templated std:vector type in IR
   static bool EvalConjuncts(Expr* const* exprs, int num_exprs, TupleRow* row);
 
+  // Evaluates exprs over all rows of 'batch' a batch at a time (see Expr::GetValues())
+  // and sets selected[i] to true if all exprs return true for row i. Each expr is only
+  // evaluated for the rows that passed the previous ones. 'selected' must have room
+  // for batch->num_rows() values. Returns the number of selected rows.
+  static int EvalBatchConjuncts(Expr* const* exprs, int num_exprs, RowBatch* batch,
+      bool* selected);
+
   // Codegen function to evaluate the conjuncts.  Returns NULL if codegen was
   // not supported for the conjunct exprs.
   // Codegen'd signature is bool EvalConjuncts(Expr** exprs, int num_exprs, TupleRow*);
@@ -199,6 +207,9 @@ class ExecNode {
   ObjectPool* pool_;
   std::vector<Expr*> conjuncts_;
 
+  // Subexpressions shared by the conjuncts.
+  CommonSubexprs conjunct_subexprs_;
+
   // True if the codegen'd function for 'conjuncts_' is thread safe.  If not, copies
   // of the conjuncts_ need to be made if the conjuncts will be evaluated by multiple
   // threads.
@@ -220,6 +231,11 @@ class ExecNode {
   RuntimeProfile::Counter* rows_returned_counter_;
   RuntimeProfile::Counter* rows_returned_rate_;
 
+  // Number of input rows processed by the interpreted and by the codegen'd versions of
+  // the node's row batch functions. NULL unless AddCodegenTierCounters() was called.
+  RuntimeProfile::Counter* interpreted_rows_counter_;
+  RuntimeProfile::Counter* codegen_rows_counter_;
+
   // Account for peak memory used by this node
   boost::scoped_ptr<MemTracker> mem_tracker_;
 
@@ -252,6 +268,10 @@ class ExecNode {
   // Appends option to 'runtime_exec_options_'
   void AddRuntimeExecOption(const std::string& option);
 
+  // Creates interpreted_rows_counter_ and codegen_rows_counter_. Called by nodes whose
+  // codegen'd functions may be swapped in while they run.
+  void AddCodegenTierCounters();
+
  private:
   // Set in ExecNode::Close(). Used to make Close() idempotent. This is not protected
   // by a lock, it assumes all calls to Close() are made by the same thread.
@@ -68,6 +68,12 @@ int HashJoinNode::ProcessProbeBatch(RowBatch* out_batch, RowBatch* probe_batch,
 
       matched_probe_ = true;
 
+      // Handle left anti-join: a probe row with a match has no output
+      if (anti_join_) {
+        hash_tbl_iterator_ = hash_tbl_->End();
+        break;
+      }
+
       if (EvalConjuncts(conjuncts, num_conjuncts, out_row)) {
         ++rows_returned;
         // Filled up out batch or hit limit
@@ -84,16 +90,18 @@ int HashJoinNode::ProcessProbeBatch(RowBatch* out_batch, RowBatch* probe_batch,
       }
     }
 
-    // Handle left outer-join
-    if (!matched_probe_ && match_all_probe_) {
-      CreateOutputRow(out_row, current_left_child_row_, NULL);
+    // Handle left outer-join and left anti-join
+    if (!matched_probe_ && (match_all_probe_ || anti_join_)) {
       matched_probe_ = true;
-      if (EvalConjuncts(conjuncts, num_conjuncts, out_row)) {
-        ++rows_returned;
-        if (UNLIKELY(rows_returned == max_added_rows)) goto end;
-        // Advance to next out row
-        out_row_mem += out_batch->row_byte_size();
-        out_row = reinterpret_cast<TupleRow*>(out_row_mem);
+      if (!null_aware_anti_join_ || !NullAwareProbeRowMatches(current_left_child_row_)) {
+        CreateOutputRow(out_row, current_left_child_row_, NULL);
+        if (EvalConjuncts(conjuncts, num_conjuncts, out_row)) {
+          ++rows_returned;
+          if (UNLIKELY(rows_returned == max_added_rows)) goto end;
+          // Advance to next out row
+          out_row_mem += out_batch->row_byte_size();
+          out_row = reinterpret_cast<TupleRow*>(out_row_mem);
+        }
       }
     }
 
@@ -112,6 +120,68 @@ end:
   return rows_returned;
 }
 
+inline void HashJoinNode::SetBuildTuples(TupleRow* row, TupleRow* build_row) {
+  if (build_row != NULL) {
+    for (int i = 0; i < build_tuple_size_; ++i) {
+      row->SetTuple(build_tuple_idx_[i], build_row->GetTuple(i));
+    }
+  } else {
+    for (int i = 0; i < build_tuple_size_; ++i) {
+      row->SetTuple(build_tuple_idx_[i], NULL);
+    }
+  }
+}
+
+// HashCurrentRow, EvalProbeRow, Equals, EvalOtherJoinConjuncts and EvalConjuncts are
+// replaced by codegen.
+int HashJoinNode::JoinProbeBatchInPlace(RowBatch* probe_batch) {
+  DCHECK(probe_in_place_);
+
+  Expr* const* other_conjuncts = &other_join_conjuncts_[0];
+  int num_other_conjuncts = other_join_conjuncts_.size();
+
+  Expr* const* conjuncts = &conjuncts_[0];
+  int num_conjuncts = conjuncts_.size();
+
+  int probe_rows = probe_batch->num_rows();
+  int rows_returned = 0;
+  for (int i = 0; i < probe_rows; ++i) {
+    TupleRow* row = probe_batch->GetRow(i);
+    // The row is joined with the first matching build row that satisfies the other
+    // join conjuncts. Unless the build keys are unique, this is a semi- or anti-join,
+    // which ignores the remaining matches.
+    bool matched = false;
+    HashTable::Iterator it = hash_tbl_->Find(row);
+    for (; !it.AtEnd(); it.Next<true>()) {
+      SetBuildTuples(row, it.GetRow());
+      if (EvalOtherJoinConjuncts(other_conjuncts, num_other_conjuncts, row)) {
+        matched = true;
+        break;
+      }
+    }
+
+    // Handle left anti-join
+    if (anti_join_) {
+      if (matched || (null_aware_anti_join_ && NullAwareProbeRowMatches(row))) continue;
+      SetBuildTuples(row, NULL);
+    } else if (!matched) {
+      // Handle left outer-join
+      if (!match_all_probe_) continue;
+      SetBuildTuples(row, NULL);
+    }
+
+    if (EvalConjuncts(conjuncts, num_conjuncts, row)) {
+      // Move the row over the rows without output before it.
+      if (rows_returned != i) {
+        probe_batch->CopyRow(row, probe_batch->GetRow(rows_returned));
+      }
+      ++rows_returned;
+    }
+  }
+  probe_batch->set_num_rows(rows_returned);
+  return rows_returned;
+}
+
 void HashJoinNode::ProcessBuildBatch(RowBatch* build_batch) {
   // insert build row into our hash table
   for (int i = 0; i < build_batch->num_rows(); ++i) {
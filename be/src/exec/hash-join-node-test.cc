@@ -0,0 +1,323 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <gtest/gtest.h>
+
+#include "common/init.h"
+#include "common/object-pool.h"
+#include "exec/hash-join-node.h"
+#include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/tuple-row.h"
+#include "testutil/desc-tbl-builder.h"
+#include "util/cpu-info.h"
+
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/PlanNodes_types.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+// Stands for NULL in the slot values of a ValuesNode.
+static const int NULL_VALUE = numeric_limits<int>::min();
+
+// Exec node that returns rows with a single tuple, whose slots are INTs or BOOLEANs.
+// values[i][j] is the value of slot i in row j. If 'acquire_state' is true, the rows
+// are handed over like a scan node does, with RowBatch::AcquireState().
+class ValuesNode : public ExecNode {
+ public:
+  ValuesNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs,
+      const vector<vector<int> >& values, bool acquire_state)
+    : ExecNode(pool, tnode, descs), values_(values), acquire_state_(acquire_state),
+      next_row_(0) {
+  }
+
+  virtual Status Open(RuntimeState* state) {
+    RETURN_IF_ERROR(ExecNode::Open(state));
+    next_row_ = 0;
+    return Status::OK;
+  }
+
+  virtual Status GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
+    if (acquire_state_) {
+      RowBatch batch(row_desc(), row_batch->capacity(), mem_tracker());
+      AddRows(&batch);
+      row_batch->AcquireState(&batch);
+    } else {
+      AddRows(row_batch);
+    }
+    int num_rows = values_.empty() ? 0 : values_[0].size();
+    *eos = next_row_ == num_rows;
+    return Status::OK;
+  }
+
+ private:
+  // Adds the next rows to 'row_batch' until it is full.
+  void AddRows(RowBatch* row_batch) {
+    TupleDescriptor* tuple_desc = row_desc().tuple_descriptors()[0];
+    const vector<SlotDescriptor*>& slots = tuple_desc->slots();
+    DCHECK_EQ(slots.size(), values_.size());
+    int num_rows = values_.empty() ? 0 : values_[0].size();
+    while (next_row_ < num_rows && !row_batch->AtCapacity()) {
+      Tuple* tuple = Tuple::Create(tuple_desc->byte_size(), row_batch->tuple_data_pool());
+      for (int i = 0; i < slots.size(); ++i) {
+        int value = values_[i][next_row_];
+        if (value == NULL_VALUE) {
+          tuple->SetNull(slots[i]->null_indicator_offset());
+        } else if (slots[i]->type().type == TYPE_BOOLEAN) {
+          *reinterpret_cast<bool*>(tuple->GetSlot(slots[i]->tuple_offset())) = value;
+        } else {
+          *reinterpret_cast<int32_t*>(tuple->GetSlot(slots[i]->tuple_offset())) = value;
+        }
+      }
+      int row_idx = row_batch->AddRow();
+      row_batch->GetRow(row_idx)->SetTuple(0, tuple);
+      row_batch->CommitLastRow();
+      ++next_row_;
+    }
+  }
+
+  vector<vector<int> > values_;
+  bool acquire_state_;
+  int next_row_;
+};
+
+// HashJoinNode with children that are set by the test instead of a plan.
+class TestHashJoinNode : public HashJoinNode {
+ public:
+  TestHashJoinNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs,
+      ExecNode* probe_child, ExecNode* build_child)
+    : HashJoinNode(pool, tnode, descs) {
+    children_.push_back(probe_child);
+    children_.push_back(build_child);
+  }
+};
+
+// Tests the join ops that HashJoinNode implements natively but the planner doesn't
+// produce yet. The probe rows have a nullable INT key, the build rows a nullable INT
+// key and a BOOLEAN flag that can be used as other join conjunct.
+class HashJoinNodeTest : public testing::Test {
+ protected:
+  // The builder numbers the slots after the tuples, starting at 3.
+  static const int PROBE_KEY_SLOT = 3;
+  static const int BUILD_KEY_SLOT = 4;
+  static const int BUILD_FLAG_SLOT = 5;
+
+  virtual void SetUp() {
+    DescriptorTblBuilder builder(&pool_);
+    builder.DeclareTuple() << TYPE_INT;
+    builder.DeclareTuple() << TYPE_INT << TYPE_BOOLEAN;
+    desc_tbl_ = builder.Build();
+  }
+
+  // Parses comma-separated INTs, "NULL" for NULL.
+  static vector<int> Values(const string& values) {
+    vector<int> result;
+    if (values.empty()) return result;
+    vector<string> tokens;
+    split(tokens, values, is_any_of(","));
+    for (int i = 0; i < tokens.size(); ++i) {
+      result.push_back(tokens[i] == "NULL" ? NULL_VALUE : atoi(tokens[i].c_str()));
+    }
+    return result;
+  }
+
+  static TExpr SlotRefExpr(int slot_id, TPrimitiveType::type type) {
+    TExprNode node;
+    node.node_type = TExprNodeType::SLOT_REF;
+    node.type.type = type;
+    node.num_children = 0;
+    TSlotRef slot_ref;
+    slot_ref.slot_id = slot_id;
+    node.__set_slot_ref(slot_ref);
+    TExpr expr;
+    expr.nodes.push_back(node);
+    return expr;
+  }
+
+  // Returns a plan node whose rows have the tuples 'first_tuple_id' to
+  // 'last_tuple_id'. Only the build tuple of a join row is nullable.
+  static TPlanNode PlanNode(int node_id, TPlanNodeType::type type, int first_tuple_id,
+      int last_tuple_id) {
+    TPlanNode tnode;
+    tnode.node_id = node_id;
+    tnode.node_type = type;
+    tnode.num_children = 0;
+    tnode.limit = -1;
+    tnode.compact_data = false;
+    for (int i = first_tuple_id; i <= last_tuple_id; ++i) {
+      tnode.row_tuples.push_back(i);
+      tnode.nullable_tuples.push_back(i > first_tuple_id);
+    }
+    return tnode;
+  }
+
+  static THashJoinNode HashJoin(TJoinOp::type join_op) {
+    THashJoinNode hash_join_node;
+    hash_join_node.join_op = join_op;
+    TEqJoinCondition eq_join_conjunct;
+    eq_join_conjunct.left = SlotRefExpr(PROBE_KEY_SLOT, TPrimitiveType::INT);
+    eq_join_conjunct.right = SlotRefExpr(BUILD_KEY_SLOT, TPrimitiveType::INT);
+    hash_join_node.eq_join_conjuncts.push_back(eq_join_conjunct);
+    hash_join_node.__set_add_probe_filters(false);
+    return hash_join_node;
+  }
+
+  // Joins the probe rows with keys 'probe_keys' and the build rows with keys
+  // 'build_keys' with 'join_op', in batches of 'batch_size' rows. If 'build_flags' is
+  // not empty, it holds the flag of each build row, which is used as other join
+  // conjunct. If 'scan_probe' is true, the probe child hands over its batches like a
+  // scan node. Returns the sorted keys of the output rows, e.g. "1,3,NULL".
+  string Join(TJoinOp::type join_op, const string& probe_keys, const string& build_keys,
+      const string& build_flags, int batch_size, bool scan_probe) {
+    TQueryContext query_ctxt;
+    query_ctxt.request.query_options.__set_batch_size(batch_size);
+    query_ctxt.request.query_options.__set_disable_codegen(true);
+    RuntimeState state(TUniqueId(), TUniqueId(), query_ctxt, "", &exec_env_);
+    EXPECT_TRUE(state.InitMemTrackers(TUniqueId(), NULL, -1).ok());
+    state.set_desc_tbl(desc_tbl_);
+    ObjectPool pool;
+
+    // The node type of the children is only used to name their profiles.
+    vector<vector<int> > probe_values(1, Values(probe_keys));
+    TPlanNode probe_tnode = PlanNode(1, TPlanNodeType::EXCHANGE_NODE, 0, 0);
+    ExecNode* probe_node = pool.Add(
+        new ValuesNode(&pool, probe_tnode, *desc_tbl_, probe_values, scan_probe));
+
+    vector<vector<int> > build_values(1, Values(build_keys));
+    if (build_flags.empty()) {
+      build_values.push_back(vector<int>(build_values[0].size(), 1));
+    } else {
+      build_values.push_back(Values(build_flags));
+    }
+    TPlanNode build_tnode = PlanNode(2, TPlanNodeType::EXCHANGE_NODE, 1, 1);
+    ExecNode* build_node =
+        pool.Add(new ValuesNode(&pool, build_tnode, *desc_tbl_, build_values, false));
+
+    TPlanNode tnode = PlanNode(0, TPlanNodeType::HASH_JOIN_NODE, 0, 1);
+    tnode.num_children = 2;
+    THashJoinNode hash_join_node = HashJoin(join_op);
+    if (!build_flags.empty()) {
+      hash_join_node.__set_other_join_conjuncts(vector<TExpr>(1,
+          SlotRefExpr(BUILD_FLAG_SLOT, TPrimitiveType::BOOLEAN)));
+    }
+    tnode.__set_hash_join_node(hash_join_node);
+    TestHashJoinNode* join_node = pool.Add(
+        new TestHashJoinNode(&pool, tnode, *desc_tbl_, probe_node, build_node));
+
+    vector<string> result;
+    EXPECT_TRUE(join_node->Init(tnode).ok());
+    EXPECT_TRUE(join_node->Prepare(&state).ok());
+    EXPECT_TRUE(join_node->Open(&state).ok());
+    SlotDescriptor* probe_key = desc_tbl_->GetSlotDescriptor(PROBE_KEY_SLOT);
+    MemTracker tracker;
+    RowBatch batch(join_node->row_desc(), batch_size, &tracker);
+    bool eos = false;
+    while (!eos) {
+      Status status = join_node->GetNext(&state, &batch, &eos);
+      EXPECT_TRUE(status.ok()) << status.GetErrorMsg();
+      if (!status.ok()) break;
+      for (int i = 0; i < batch.num_rows(); ++i) {
+        TupleRow* row = batch.GetRow(i);
+        // Anti joins don't output build tuples.
+        EXPECT_TRUE(row->GetTuple(1) == NULL);
+        Tuple* tuple = row->GetTuple(0);
+        if (tuple->IsNull(probe_key->null_indicator_offset())) {
+          result.push_back("NULL");
+        } else {
+          int32_t key =
+              *reinterpret_cast<int32_t*>(tuple->GetSlot(probe_key->tuple_offset()));
+          result.push_back(lexical_cast<string>(key));
+        }
+      }
+      batch.Reset();
+    }
+    join_node->Close(&state);
+    sort(result.begin(), result.end());
+    return join(result, ",");
+  }
+
+  // Checks that the join returns 'expected' for batches of 1, 2 and 1024 rows, with
+  // and without a scan-like probe child. With small batches, most probe batches are
+  // joined in place, i.e. the probe child fills batches with wider rows than its own.
+  void TestJoin(TJoinOp::type join_op, const string& probe_keys,
+      const string& build_keys, const string& build_flags, const string& expected) {
+    int batch_sizes[] = { 1, 2, 1024 };
+    for (int i = 0; i < 3; ++i) {
+      for (int scan_probe = 0; scan_probe < 2; ++scan_probe) {
+        EXPECT_EQ(expected, Join(join_op, probe_keys, build_keys, build_flags,
+            batch_sizes[i], scan_probe))
+            << "batch size " << batch_sizes[i] << ", scan probe " << scan_probe;
+      }
+    }
+  }
+
+  ObjectPool pool_;
+  DescriptorTbl* desc_tbl_;
+  ExecEnv exec_env_;
+};
+
+TEST_F(HashJoinNodeTest, AntiJoin) {
+  TestJoin(TJoinOp::LEFT_ANTI_JOIN, "1,2,3,NULL,2", "2,4", "", "1,3,NULL");
+  // A NULL build key matches nothing.
+  TestJoin(TJoinOp::LEFT_ANTI_JOIN, "1,2,NULL", "2,NULL", "", "1,NULL");
+  TestJoin(TJoinOp::LEFT_ANTI_JOIN, "1,NULL", "", "", "1,NULL");
+  // 3 only matches a build row that fails the other join conjuncts.
+  TestJoin(TJoinOp::LEFT_ANTI_JOIN, "1,2,3,NULL", "2,3,NULL", "1,0,0", "1,3,NULL");
+}
+
+TEST_F(HashJoinNodeTest, NullAwareAntiJoin) {
+  TestJoin(TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN, "1,2,3,NULL,2", "2,4", "", "1,3");
+  // 'x NOT IN (2, NULL)' is never true.
+  TestJoin(TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN, "1,2,NULL", "2,NULL", "", "");
+  // 'x NOT IN (<empty set>)' is true, even if x is NULL.
+  TestJoin(TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN, "1,NULL", "", "", "1,NULL");
+  // The NULL build key only counts if its row passes the other join conjuncts. A NULL
+  // probe key is dropped because the build row with key 2 passes them.
+  TestJoin(TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN, "1,2,3,NULL", "2,3,NULL", "1,0,0",
+      "1,3");
+  // No build row passes the other join conjuncts, so no probe row is dropped.
+  TestJoin(TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN, "1,NULL", "NULL", "0", "1,NULL");
+  TestJoin(TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN, "1,NULL", "NULL", "1", "");
+}
+
+// Null-aware anti joins only support a single equi-join conjunct.
+TEST_F(HashJoinNodeTest, NullAwareAntiJoinConjuncts) {
+  TPlanNode tnode = PlanNode(0, TPlanNodeType::HASH_JOIN_NODE, 0, 1);
+  THashJoinNode hash_join_node = HashJoin(TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN);
+  hash_join_node.eq_join_conjuncts.push_back(hash_join_node.eq_join_conjuncts[0]);
+  tnode.__set_hash_join_node(hash_join_node);
+  HashJoinNode join_node(&pool_, tnode, *desc_tbl_);
+  EXPECT_FALSE(join_node.Init(tnode).ok());
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, false);
+  return RUN_ALL_TESTS();
+}
@@ -42,15 +42,25 @@ HashJoinNode::HashJoinNode(
   : BlockingJoinNode("HashJoinNode", tnode.hash_join_node.join_op, pool, tnode, descs),
     codegen_process_build_batch_fn_(NULL),
     process_build_batch_fn_(NULL),
+    null_aware_eval_row_(NULL),
+    other_conjuncts_reference_probe_(false),
+    null_probe_matches_(false),
+    probe_in_place_(false),
     codegen_process_probe_batch_fn_(NULL),
-    process_probe_batch_fn_(NULL) {
+    process_probe_batch_fn_(NULL),
+    codegen_join_probe_batch_in_place_fn_(NULL),
+    join_probe_batch_in_place_fn_(NULL) {
   match_all_probe_ =
     (join_op_ == TJoinOp::LEFT_OUTER_JOIN || join_op_ == TJoinOp::FULL_OUTER_JOIN);
   match_one_build_ = (join_op_ == TJoinOp::LEFT_SEMI_JOIN);
   match_all_build_ =
     (join_op_ == TJoinOp::RIGHT_OUTER_JOIN || join_op_ == TJoinOp::FULL_OUTER_JOIN);
+  null_aware_anti_join_ = (join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN);
+  anti_join_ = (join_op_ == TJoinOp::LEFT_ANTI_JOIN || null_aware_anti_join_);
   can_add_left_child_filters_ = tnode.hash_join_node.add_probe_filters;
   can_add_left_child_filters_ &= FLAGS_enable_probe_side_filtering;
+  // The build side values of an anti join don't filter the probe side.
+  can_add_left_child_filters_ &= !anti_join_;
 }
 
 Status HashJoinNode::Init(const TPlanNode& tnode) {
@@ -68,6 +78,9 @@ Status HashJoinNode::Init(const TPlanNode& tnode) {
   RETURN_IF_ERROR(
       Expr::CreateExprTrees(pool_, tnode.hash_join_node.other_join_conjuncts,
                             &other_join_conjuncts_));
+  if (null_aware_anti_join_ && eq_join_conjuncts.size() != 1) {
+    return Status("Null-aware anti join requires exactly one equi-join conjunct.");
+  }
   return Status::OK;
 }
 
@@ -88,10 +101,28 @@ Status HashJoinNode::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(Expr::Prepare(other_join_conjuncts_, state, row_descriptor_, false));
 
   // TODO: default buckets
-  bool stores_nulls =
-      join_op_ == TJoinOp::RIGHT_OUTER_JOIN || join_op_ == TJoinOp::FULL_OUTER_JOIN;
+  // Null-aware anti joins store the build rows with a NULL key. Find() matches them to
+  // NULL probe keys, and NullAwareProbeRowMatches() compares non-NULL probe keys with
+  // them.
+  bool stores_nulls = join_op_ == TJoinOp::RIGHT_OUTER_JOIN ||
+      join_op_ == TJoinOp::FULL_OUTER_JOIN || null_aware_anti_join_;
   hash_tbl_.reset(new HashTable(state, build_exprs_, probe_exprs_, build_tuple_size_,
       stores_nulls, false, state->fragment_hash_seed(), mem_tracker()));
+  if (null_aware_anti_join_) {
+    null_aware_eval_row_ =
+        reinterpret_cast<TupleRow*>(build_pool_->Allocate(result_tuple_row_size_));
+    vector<SlotId> slot_ids;
+    for (int i = 0; i < other_join_conjuncts_.size(); ++i) {
+      other_join_conjuncts_[i]->GetSlotIds(&slot_ids);
+    }
+    for (int i = 0; i < slot_ids.size(); ++i) {
+      TupleId tuple_id = state->desc_tbl().GetSlotDescriptor(slot_ids[i])->parent();
+      if (child(0)->row_desc().GetTupleIdx(tuple_id) != RowDescriptor::INVALID_IDX) {
+        other_conjuncts_reference_probe_ = true;
+        break;
+      }
+    }
+  }
 
   if (state->codegen_enabled()) {
     // Codegen for hashing rows
@@ -103,8 +134,9 @@ Status HashJoinNode::Prepare(RuntimeState* state) {
         CodegenProcessBuildBatch(state->codegen(), hash_fn);
     if (codegen_process_build_batch_fn_ != NULL) {
       state->codegen()->AddFunctionToJit(codegen_process_build_batch_fn_,
-          reinterpret_cast<void**>(&process_build_batch_fn_));
+          reinterpret_cast<void**>(&process_build_batch_fn_), true);
       AddRuntimeExecOption("Build Side Codegen Enabled");
+      AddCodegenTierCounters();
     }
 
     // Codegen for probe path (only for left joins)
@@ -113,8 +145,18 @@ Status HashJoinNode::Prepare(RuntimeState* state) {
           CodegenProcessProbeBatch(state->codegen(), hash_fn);
       if (codegen_process_probe_batch_fn_ != NULL) {
         state->codegen()->AddFunctionToJit(codegen_process_probe_batch_fn_,
-            reinterpret_cast<void**>(&process_probe_batch_fn_));
+            reinterpret_cast<void**>(&process_probe_batch_fn_), true);
         AddRuntimeExecOption("Probe Side Codegen Enabled");
+        AddCodegenTierCounters();
+
+        // Whether probe batches are joined in place is only known once the build side
+        // is constructed.
+        codegen_join_probe_batch_in_place_fn_ =
+            CodegenJoinProbeBatchInPlace(state->codegen(), hash_fn);
+        if (codegen_join_probe_batch_in_place_fn_ != NULL) {
+          state->codegen()->AddFunctionToJit(codegen_join_probe_batch_in_place_fn_,
+              reinterpret_cast<void**>(&join_probe_batch_in_place_fn_), true);
+        }
       }
     }
   }
@@ -152,11 +194,18 @@ Status HashJoinNode::ConstructBuildSide(RuntimeState* state) {
     build_pool_->AcquireData(build_batch.tuple_data_pool(), false);
     RETURN_IF_ERROR(state->CheckQueryState());
 
-    // Call codegen version if possible
-    if (process_build_batch_fn_ == NULL) {
+    // Call codegen version if possible. process_build_batch_fn_ is set by another
+    // thread once the module is compiled.
+    ProcessBuildBatchFn process_build_batch_fn =
+        AtomicUtil::AcquireLoad(&process_build_batch_fn_);
+    if (process_build_batch_fn == NULL) {
       ProcessBuildBatch(&build_batch);
+      if (interpreted_rows_counter_ != NULL) {
+        COUNTER_UPDATE(interpreted_rows_counter_, build_batch.num_rows());
+      }
     } else {
-      process_build_batch_fn_(this, &build_batch);
+      process_build_batch_fn(this, &build_batch);
+      COUNTER_UPDATE(codegen_rows_counter_, build_batch.num_rows());
     }
     VLOG_ROW << hash_tbl_->DebugString(true, &child(1)->row_desc());
 
@@ -168,6 +217,27 @@ Status HashJoinNode::ConstructBuildSide(RuntimeState* state) {
     if (eos) break;
   }
 
+  if (null_aware_anti_join_) {
+    for (HashTable::Iterator it = hash_tbl_->Begin(); !it.AtEnd(); it.Next<false>()) {
+      TupleRow* build_row = it.GetRow();
+      if (build_exprs_[0]->GetValue(build_row) == NULL) {
+        null_build_rows_.push_back(build_row);
+      }
+    }
+    if (!other_conjuncts_reference_probe_) {
+      null_probe_matches_ = NullProbeKeyMatches(NULL);
+    }
+  }
+
+  // If each probe row can match at most one build row, the probe batches can be joined
+  // in place. This isn't possible for right and full outer joins, which also output
+  // build rows. Anti joins output each probe row at most once.
+  if (!match_all_build_ &&
+      (match_one_build_ || anti_join_ || hash_tbl_->HasUniqueKeys())) {
+    probe_in_place_ = true;
+    AddRuntimeExecOption("Probe Batches Joined In Place");
+  }
+
   // We've finished constructing the build side. Set the bitmap of the build side values
   // so that the probe side can use this as an additional predicate.
   // We only do this if the build side is sufficiently small.
@@ -184,6 +254,43 @@ Status HashJoinNode::ConstructBuildSide(RuntimeState* state) {
   return Status::OK;
 }
 
+bool HashJoinNode::NullAwareProbeRowMatches(TupleRow* probe_row) {
+  DCHECK(null_aware_anti_join_);
+  // 'x NOT IN (<empty set>)' is true, even if x is NULL.
+  if (hash_tbl_->size() == 0) return false;
+
+  Expr* const* other_conjuncts = &other_join_conjuncts_[0];
+  int num_other_conjuncts = other_join_conjuncts_.size();
+
+  if (probe_exprs_[0]->GetValue(probe_row) != NULL) {
+    // The probe row didn't match any key, but comparing it with a NULL key is NULL.
+    for (int i = 0; i < null_build_rows_.size(); ++i) {
+      CreateOutputRow(null_aware_eval_row_, probe_row, null_build_rows_[i]);
+      if (EvalConjuncts(other_conjuncts, num_other_conjuncts, null_aware_eval_row_)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  if (!other_conjuncts_reference_probe_) return null_probe_matches_;
+  return NullProbeKeyMatches(probe_row);
+}
+
+bool HashJoinNode::NullProbeKeyMatches(TupleRow* probe_row) {
+  // 'NULL NOT IN (...)' is NULL unless the other join conjuncts reject all build rows.
+  if (other_join_conjuncts_.empty()) return hash_tbl_->size() > 0;
+  Expr* const* other_conjuncts = &other_join_conjuncts_[0];
+  int num_other_conjuncts = other_join_conjuncts_.size();
+  for (HashTable::Iterator it = hash_tbl_->Begin(); !it.AtEnd(); it.Next<false>()) {
+    CreateOutputRow(null_aware_eval_row_, probe_row, it.GetRow());
+    if (EvalConjuncts(other_conjuncts, num_other_conjuncts, null_aware_eval_row_)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void HashJoinNode::InitGetNext(TupleRow* first_probe_row) {
   if (first_probe_row == NULL) {
     hash_tbl_iterator_ = hash_tbl_->Begin();
@@ -354,20 +461,65 @@ Status HashJoinNode::LeftJoinGetNext(RuntimeState* state,
 
   ScopedTimer<MonotonicStopWatch> probe_timer(left_child_timer_);
   while (!eos_) {
+    if (probe_in_place_ && left_batch_->num_rows() == 0) {
+      // The rows of left_batch_ have all been processed, the remaining probe batches are
+      // fetched into out_batch and joined in place. The probe tuples are a prefix of our
+      // rows, and the child only sets those, never copying whole rows of out_batch.
+      // Scan nodes hand over their batches with RowBatch::AcquireState(), which
+      // copies the tuples into that prefix when out_batch's rows are wider.
+      DCHECK(hash_tbl_iterator_.AtEnd());
+      DCHECK_EQ(out_batch->num_rows(), 0);
+      probe_timer.Stop();
+      RETURN_IF_ERROR(child(0)->GetNext(state, out_batch, &left_side_eos_));
+      probe_timer.Start();
+      COUNTER_UPDATE(left_child_row_counter_, out_batch->num_rows());
+
+      int probe_rows = out_batch->num_rows();
+      JoinProbeBatchInPlaceFn join_probe_batch_in_place_fn =
+          AtomicUtil::AcquireLoad(&join_probe_batch_in_place_fn_);
+      int rows_added;
+      if (join_probe_batch_in_place_fn == NULL) {
+        rows_added = JoinProbeBatchInPlace(out_batch);
+        if (interpreted_rows_counter_ != NULL) {
+          COUNTER_UPDATE(interpreted_rows_counter_, probe_rows);
+        }
+      } else {
+        rows_added = join_probe_batch_in_place_fn(this, out_batch);
+        COUNTER_UPDATE(codegen_rows_counter_, probe_rows);
+      }
+      if (limit() != -1 && num_rows_returned_ + rows_added > limit()) {
+        rows_added = limit() - num_rows_returned_;
+        out_batch->set_num_rows(rows_added);
+      }
+      num_rows_returned_ += rows_added;
+      COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+      *eos = eos_ = left_side_eos_ || ReachedLimit();
+      break;
+    }
+
     // Compute max rows that should be added to out_batch
     int64_t max_added_rows = out_batch->capacity() - out_batch->num_rows();
     if (limit() != -1) max_added_rows = min(max_added_rows, limit() - rows_returned());
 
-    // Continue processing this row batch
-    if (process_probe_batch_fn_ == NULL) {
+    // Continue processing this row batch. process_probe_batch_fn_ is set by another
+    // thread once the module is compiled. Both versions keep their position in the
+    // probe batch in the same members, so we can switch between batches.
+    ProcessProbeBatchFn process_probe_batch_fn =
+        AtomicUtil::AcquireLoad(&process_probe_batch_fn_);
+    int start_pos = left_batch_pos_;
+    if (process_probe_batch_fn == NULL) {
       num_rows_returned_ +=
           ProcessProbeBatch(out_batch, left_batch_.get(), max_added_rows);
       COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+      if (interpreted_rows_counter_ != NULL) {
+        COUNTER_UPDATE(interpreted_rows_counter_, left_batch_pos_ - start_pos);
+      }
     } else {
       // Use codegen'd function
       num_rows_returned_ +=
-          process_probe_batch_fn_(this, out_batch, left_batch_.get(), max_added_rows);
+          process_probe_batch_fn(this, out_batch, left_batch_.get(), max_added_rows);
       COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+      COUNTER_UPDATE(codegen_rows_counter_, left_batch_pos_ - start_pos);
     }
 
     if (ReachedLimit() || out_batch->AtCapacity()) {
@@ -383,6 +535,10 @@ Status HashJoinNode::LeftJoinGetNext(RuntimeState* state,
       if (left_side_eos_) {
         *eos = eos_ = true;
         break;
+      } else if (probe_in_place_) {
+        // The next probe batch is fetched straight into the next output batch, which
+        // must not hold any resources yet.
+        break;
       } else {
         probe_timer.Stop();
         RETURN_IF_ERROR(child(0)->GetNext(state, left_batch_.get(), &left_side_eos_));
@@ -404,102 +560,6 @@ void HashJoinNode::AddToDebugString(int indentation_level, stringstream* out) co
   *out << ")";
 }
 
-// This codegen'd function should only be used for left join cases so it assumes that
-// the probe row is non-null.  For a left outer join, the IR looks like:
-// define void @CreateOutputRow(%"class.impala::BlockingJoinNode"* %this_ptr,
-//                              %"class.impala::TupleRow"* %out_arg,
-//                              %"class.impala::TupleRow"* %probe_arg,
-//                              %"class.impala::TupleRow"* %build_arg) {
-// entry:
-//   %out = bitcast %"class.impala::TupleRow"* %out_arg to i8**
-//   %probe = bitcast %"class.impala::TupleRow"* %probe_arg to i8**
-//   %build = bitcast %"class.impala::TupleRow"* %build_arg to i8**
-//   %0 = bitcast i8** %out to i8*
-//   %1 = bitcast i8** %probe to i8*
-//   call void @llvm.memcpy.p0i8.p0i8.i32(i8* %0, i8* %1, i32 16, i32 16, i1 false)
-//   %is_build_null = icmp eq i8** %build, null
-//   br i1 %is_build_null, label %build_null, label %build_not_null
-//
-// build_not_null:                                   ; preds = %entry
-//   %dst_tuple_ptr1 = getelementptr i8** %out, i32 1
-//   %src_tuple_ptr = getelementptr i8** %build, i32 0
-//   %2 = load i8** %src_tuple_ptr
-//   store i8* %2, i8** %dst_tuple_ptr1
-//   ret void
-//
-// build_null:                                       ; preds = %entry
-//   %dst_tuple_ptr = getelementptr i8** %out, i32 1
-//   store i8* null, i8** %dst_tuple_ptr
-//   ret void
-// }
-Function* HashJoinNode::CodegenCreateOutputRow(LlvmCodeGen* codegen) {
-  Type* tuple_row_type = codegen->GetType(TupleRow::LLVM_CLASS_NAME);
-  DCHECK(tuple_row_type != NULL);
-  PointerType* tuple_row_ptr_type = PointerType::get(tuple_row_type, 0);
-
-  Type* this_type = codegen->GetType(BlockingJoinNode::LLVM_CLASS_NAME);
-  DCHECK(this_type != NULL);
-  PointerType* this_ptr_type = PointerType::get(this_type, 0);
-
-  // TupleRows are really just an array of pointers.  Easier to work with them
-  // this way.
-  PointerType* tuple_row_working_type = PointerType::get(codegen->ptr_type(), 0);
-
-  // Construct function signature to match CreateOutputRow()
-  LlvmCodeGen::FnPrototype prototype(codegen, "CreateOutputRow", codegen->void_type());
-  prototype.AddArgument(LlvmCodeGen::NamedVariable("this_ptr", this_ptr_type));
-  prototype.AddArgument(LlvmCodeGen::NamedVariable("out_arg", tuple_row_ptr_type));
-  prototype.AddArgument(LlvmCodeGen::NamedVariable("probe_arg", tuple_row_ptr_type));
-  prototype.AddArgument(LlvmCodeGen::NamedVariable("build_arg", tuple_row_ptr_type));
-
-  LLVMContext& context = codegen->context();
-  LlvmCodeGen::LlvmBuilder builder(context);
-  Value* args[4];
-  Function* fn = prototype.GeneratePrototype(&builder, args);
-  Value* out_row_arg = builder.CreateBitCast(args[1], tuple_row_working_type, "out");
-  Value* probe_row_arg = builder.CreateBitCast(args[2], tuple_row_working_type, "probe");
-  Value* build_row_arg = builder.CreateBitCast(args[3], tuple_row_working_type, "build");
-
-  // Copy probe row
-  codegen->CodegenMemcpy(&builder, out_row_arg, probe_row_arg, result_tuple_row_size_);
-
-  // Copy build row.
-  BasicBlock* build_not_null_block = BasicBlock::Create(context, "build_not_null", fn);
-  BasicBlock* build_null_block = NULL;
-
-  if (match_all_probe_) {
-    // build tuple can be null
-    build_null_block = BasicBlock::Create(context, "build_null", fn);
-    Value* is_build_null = builder.CreateIsNull(build_row_arg, "is_build_null");
-    builder.CreateCondBr(is_build_null, build_null_block, build_not_null_block);
-
-    // Set tuple build ptrs to NULL
-    builder.SetInsertPoint(build_null_block);
-    for (int i = 0; i < build_tuple_size_; ++i) {
-      Value* array_idx[] = { codegen->GetIntConstant(TYPE_INT, build_tuple_idx_[i]) };
-      Value* dst = builder.CreateGEP(out_row_arg, array_idx, "dst_tuple_ptr");
-      builder.CreateStore(codegen->null_ptr_value(), dst);
-    }
-    builder.CreateRetVoid();
-  } else {
-    // build row can't be NULL
-    builder.CreateBr(build_not_null_block);
-  }
-
-  // Copy build tuple ptrs
-  builder.SetInsertPoint(build_not_null_block);
-  for (int i = 0; i < build_tuple_size_; ++i) {
-    Value* dst_idx[] = { codegen->GetIntConstant(TYPE_INT, build_tuple_idx_[i]) };
-    Value* src_idx[] = { codegen->GetIntConstant(TYPE_INT, i) };
-    Value* dst = builder.CreateGEP(out_row_arg, dst_idx, "dst_tuple_ptr");
-    Value* src = builder.CreateGEP(build_row_arg, src_idx, "src_tuple_ptr");
-    builder.CreateStore(builder.CreateLoad(src), dst);
-  }
-  builder.CreateRetVoid();
-
-  return codegen->FinalizeFunction(fn);
-}
-
 Function* HashJoinNode::CodegenProcessBuildBatch(LlvmCodeGen* codegen,
     Function* hash_fn) {
   // Get cross compiled function
@@ -540,7 +600,8 @@ Function* HashJoinNode::CodegenProcessProbeBatch(LlvmCodeGen* codegen,
   if (eval_row_fn == NULL) return NULL;
 
   // Codegen CreateOutputRow
-  Function* create_output_row_fn = CodegenCreateOutputRow(codegen);
+  Function* create_output_row_fn =
+      CodegenCreateOutputRow(codegen, match_all_probe_ || anti_join_);
   if (create_output_row_fn == NULL) return NULL;
 
   // Codegen evaluating other join conjuncts
@@ -579,3 +640,51 @@ Function* HashJoinNode::CodegenProcessProbeBatch(LlvmCodeGen* codegen,
 
   return codegen->OptimizeFunctionWithExprs(process_probe_batch_fn);
 }
+
+Function* HashJoinNode::CodegenJoinProbeBatchInPlace(LlvmCodeGen* codegen,
+    Function* hash_fn) {
+  // Get cross compiled function
+  Function* join_probe_batch_fn = codegen->GetFunction(
+      IRFunction::HASH_JOIN_JOIN_PROBE_BATCH_IN_PLACE);
+  DCHECK(join_probe_batch_fn != NULL);
+
+  // Codegen HashTable::Equals
+  Function* equals_fn = hash_tbl_->CodegenEquals(codegen);
+  if (equals_fn == NULL) return NULL;
+
+  // Codegen for evaluating probe rows
+  Function* eval_row_fn = hash_tbl_->CodegenEvalTupleRow(codegen, false);
+  if (eval_row_fn == NULL) return NULL;
+
+  // Codegen evaluating other join conjuncts
+  Function* join_conjuncts_fn = CodegenEvalConjuncts(codegen, other_join_conjuncts_);
+  if (join_conjuncts_fn == NULL) return NULL;
+
+  // Codegen evaluating conjuncts
+  Function* conjuncts_fn = CodegenEvalConjuncts(codegen, conjuncts_);
+  if (conjuncts_fn == NULL) return NULL;
+
+  // Replace all call sites with codegen version
+  int replaced = 0;
+  join_probe_batch_fn = codegen->ReplaceCallSites(join_probe_batch_fn, false,
+      hash_fn, "HashCurrentRow", &replaced);
+  DCHECK_EQ(replaced, 1);
+
+  join_probe_batch_fn = codegen->ReplaceCallSites(join_probe_batch_fn, false,
+      eval_row_fn, "EvalProbeRow", &replaced);
+  DCHECK_EQ(replaced, 1);
+
+  join_probe_batch_fn = codegen->ReplaceCallSites(join_probe_batch_fn, false,
+      conjuncts_fn, "EvalConjuncts", &replaced);
+  DCHECK_EQ(replaced, 1);
+
+  join_probe_batch_fn = codegen->ReplaceCallSites(join_probe_batch_fn, false,
+      join_conjuncts_fn, "EvalOtherJoinConjuncts", &replaced);
+  DCHECK_EQ(replaced, 1);
+
+  join_probe_batch_fn = codegen->ReplaceCallSites(join_probe_batch_fn, false,
+      equals_fn, "Equals", &replaced);
+  DCHECK_EQ(replaced, 2);
+
+  return codegen->OptimizeFunctionWithExprs(join_probe_batch_fn);
+}
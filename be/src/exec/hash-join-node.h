@@ -44,8 +44,21 @@ class TupleRow;
 // - In general, we are not able to pass our output row batch on to our left child (when
 //   we're fetching the probe rows): if we have a 1xn join, our output will contain
 //   multiple rows per left input row
-// - TODO: fix this, so in the case of 1x1/nx1 joins (for instance, fact to dimension tbl)
-//   we don't do these extra copies
+// - If each probe row can match at most one build row, i.e. for left semi joins and for
+//   inner and left outer joins on unique build keys (for instance, fact to dimension
+//   tbl), the output batch is passed on to the left child instead and its rows are
+//   joined in place: the build tuples of the match are set in the probe row, which
+//   already has slots for them, and rows without output are compacted away. This
+//   avoids copying every probe row into a separate output batch.
+//
+// Anti joins:
+// - A left anti join outputs the probe rows without a match. Probing stops at the first
+//   match, so that matched probe rows cost a single hash table lookup, and since no
+//   probe row is output more than once, probe batches are always joined in place.
+// - A null-aware left anti join implements 'NOT IN': a probe row is also not output if
+//   the result of the IN predicate is NULL, i.e. if its key or the key of a build row
+//   it's compared with is NULL. NULL build keys are stored in the hash table and their
+//   rows collected in null_build_rows_.
 class HashJoinNode : public BlockingJoinNode {
  public:
   HashJoinNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -83,8 +96,28 @@ class HashJoinNode : public BlockingJoinNode {
   bool match_all_probe_;  // output all rows coming from the probe input
   bool match_one_build_;  // match at most one build row to each probe row
   bool match_all_build_;  // output all rows coming from the build input
+  bool anti_join_;  // output only the probe rows without a match
+  bool null_aware_anti_join_;  // anti join with NOT IN semantics for NULL keys
 
   bool matched_probe_;  // if true, we have matched the current probe row
+
+  // for null-aware anti joins, the build rows with a NULL key
+  std::vector<TupleRow*> null_build_rows_;
+
+  // for null-aware anti joins, row in which the other join conjuncts are evaluated
+  // against build rows that don't match on the key
+  TupleRow* null_aware_eval_row_;
+
+  // for null-aware anti joins, true if the other join conjuncts reference probe slots.
+  // Otherwise, whether a probe row with a NULL key matches doesn't depend on the probe
+  // row and is computed once per build side in null_probe_matches_.
+  bool other_conjuncts_reference_probe_;
+  bool null_probe_matches_;
+
+  // if true, each probe row matches at most one build row and probe batches are joined
+  // in place (see JoinProbeBatchInPlace()). Set once the build side is constructed.
+  bool probe_in_place_;
+
   // llvm function for build batch
   llvm::Function* codegen_process_build_batch_fn_;
 
@@ -101,6 +134,14 @@ class HashJoinNode : public BlockingJoinNode {
   // Jitted ProcessProbeBatch function pointer.  Null if codegen is disabled.
   ProcessProbeBatchFn process_probe_batch_fn_;
 
+  // llvm function object for joining probe batches in place
+  llvm::Function* codegen_join_probe_batch_in_place_fn_;
+
+  // HashJoinNode::JoinProbeBatchInPlace() exactly
+  typedef int (*JoinProbeBatchInPlaceFn)(HashJoinNode*, RowBatch*);
+  // Jitted JoinProbeBatchInPlace function pointer.  Null if codegen is disabled.
+  JoinProbeBatchInPlaceFn join_probe_batch_in_place_fn_;
+
   RuntimeProfile::Counter* build_buckets_counter_;   // num buckets in hash table
   RuntimeProfile::Counter* hash_tbl_load_factor_counter_;
 
@@ -116,12 +157,30 @@ class HashJoinNode : public BlockingJoinNode {
   // return the number of rows added to out_batch
   int ProcessProbeBatch(RowBatch* out_batch, RowBatch* probe_batch, int max_added_rows);
 
+  // Joins the rows of 'probe_batch', which were just returned by the left child, in
+  // place for the case where each probe row matches at most one build row. Rows that
+  // don't produce an output row are removed from the batch.
+  // Returns the number of rows left in 'probe_batch'.
+  int JoinProbeBatchInPlace(RowBatch* probe_batch);
+
+  // Sets the build tuples of 'row', a row of this node's output, to the tuples of
+  // 'build_row', or to NULL if 'build_row' is NULL.
+  void SetBuildTuples(TupleRow* row, TupleRow* build_row);
+
+  // For null-aware anti joins, returns true if 'probe_row', which has no match in the
+  // hash table, must not be output because 'NOT IN' is NULL for it: either its key is
+  // NULL and some build row satisfies the other join conjuncts, or some build row with
+  // a NULL key does. Returns false if the build side is empty.
+  bool NullAwareProbeRowMatches(TupleRow* probe_row);
+
+  // Returns true if some build row satisfies the other join conjuncts for
+  // 'probe_row', whose key is NULL. 'probe_row' may be NULL if the conjuncts don't
+  // reference probe slots.
+  bool NullProbeKeyMatches(TupleRow* probe_row);
+
   // Construct the build hash table, adding all the rows in 'build_batch'
   void ProcessBuildBatch(RowBatch* build_batch);
 
-  // Codegen function to create output row
-  llvm::Function* CodegenCreateOutputRow(LlvmCodeGen* codegen);
-
   // Codegen processing build batches.  Identical signature to ProcessBuildBatch.
   // hash_fn is the codegen'd function for computing hashes over tuple rows in the
   // hash table.
@@ -133,6 +192,10 @@ class HashJoinNode : public BlockingJoinNode {
   // hash table.
   // Returns NULL if codegen was not possible.
   llvm::Function* CodegenProcessProbeBatch(LlvmCodeGen*, llvm::Function* hash_fn);
+
+  // Codegen joining probe batches in place.  Identical signature to
+  // JoinProbeBatchInPlace.  Returns NULL if codegen was not possible.
+  llvm::Function* CodegenJoinProbeBatchInPlace(LlvmCodeGen*, llvm::Function* hash_fn);
 };
 
 }
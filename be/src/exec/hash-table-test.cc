@@ -260,6 +260,31 @@ TEST_F(HashTableTest, ScanTest) {
   mem_pool_.FreeAll();
 }
 
+// This tests that duplicate build keys are detected, including when the rows with
+// equal keys are not next to each other in a bucket.
+TEST_F(HashTableTest, UniqueKeysTest) {
+  MemTracker tracker;
+  HashTable hash_table(NULL, build_expr_, probe_expr_, 1, false, false, 0, &tracker);
+  EXPECT_TRUE(hash_table.HasUniqueKeys());
+  for (int val = 0; val < 10; ++val) {
+    hash_table.Insert(CreateTupleRow(val));
+  }
+  EXPECT_TRUE(hash_table.HasUniqueKeys());
+
+  // Collisions of different keys are not duplicates.
+  ResizeTable(&hash_table, 1);
+  EXPECT_TRUE(hash_table.HasUniqueKeys());
+
+  hash_table.Insert(CreateTupleRow(3));
+  hash_table.Insert(CreateTupleRow(10));
+  EXPECT_FALSE(hash_table.HasUniqueKeys());
+  ResizeTable(&hash_table, 64);
+  EXPECT_FALSE(hash_table.HasUniqueKeys());
+
+  hash_table.Close();
+  mem_pool_.FreeAll();
+}
+
 // This test continues adding to the hash table to trigger the resize code paths
 TEST_F(HashTableTest, GrowTableTest) {
   int build_row_val = 0;
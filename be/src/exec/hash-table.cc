@@ -146,6 +146,26 @@ void HashTable::AddBitmapFilters() {
   }
 }
 
+bool HashTable::HasUniqueKeys() {
+  for (int64_t bucket_idx = 0; bucket_idx < num_buckets_; ++bucket_idx) {
+    int64_t node_idx = buckets_[bucket_idx].node_idx_;
+    while (node_idx != -1) {
+      Node* node = GetNode(node_idx);
+      // Rows with equal values have the same hash and therefore end up in the same
+      // bucket.
+      EvalBuildRow(node->data());
+      int64_t other_idx = node->next_idx_;
+      while (other_idx != -1) {
+        Node* other = GetNode(other_idx);
+        if (other->hash_ == node->hash_ && Equals(other->data())) return false;
+        other_idx = other->next_idx_;
+      }
+      node_idx = node->next_idx_;
+    }
+  }
+  return true;
+}
+
 // Helper function to store a value into the results buffer if the expr
 // evaluated to NULL.  We don't want (NULL, 1) to hash to the same as (0,1) so
 // we'll pick a more random value.
@@ -163,6 +163,11 @@ class HashTable {
   // but will have false positives.
   void AddBitmapFilters();
 
+  // Returns true if no two rows in the table have equal build expr values, i.e. if
+  // each probe row matches at most one row. Compares every row with the rows chained
+  // after it in its bucket, so it should be called once, after all insert calls.
+  bool HasUniqueKeys();
+
   // Return beginning of hash table.  Advancing this iterator will traverse all
   // elements.
   Iterator Begin();
@@ -34,6 +34,7 @@
 #include "util/bit-util.h"
 #include "util/decompress.h"
 #include "util/debug-util.h"
+#include "util/delta-encoding.h"
 #include "util/dict-encoding.h"
 #include "util/rle-encoding.h"
 #include "util/runtime-profile.h"
@@ -272,12 +273,26 @@ class HdfsParquetScanner::ColumnReader : public HdfsParquetScanner::BaseColumnRe
   }
 
   virtual Status InitDataPage(uint8_t* data, int size) {
-    if (current_page_header_.data_page_header.encoding ==
-          parquet::Encoding::PLAIN_DICTIONARY) {
+    parquet::Encoding::type page_encoding =
+        current_page_header_.data_page_header.encoding;
+    if (page_encoding == parquet::Encoding::PLAIN_DICTIONARY) {
       if (dict_decoder_.get() == NULL) {
         return Status("File corrupt. Missing dictionary page.");
       }
       dict_decoder_->SetData(data, size);
+    } else if (page_encoding == parquet::Encoding::DELTA_BINARY_PACKED) {
+      int64_t unused;
+      if (!ParquetDeltaEncoding::ToInt64(T(), &unused)) {
+        return Status(Substitute("DELTA_BINARY_PACKED encoding is not supported for "
+            "column of type $0.", TypeToString(desc_->type().type)));
+      }
+      delta_decoder_ = DeltaDecoder(data, size);
+      if (!delta_decoder_.Init()) {
+        return Status("File corrupt. Invalid DELTA_BINARY_PACKED data page.");
+      }
+    } else if (page_encoding != parquet::Encoding::PLAIN) {
+      return Status(Substitute("Unsupported data page encoding: $0",
+          PrintEncoding(page_encoding)));
     }
 
     // Check if we should disable the bitmap filter. We'll do this if the filter
@@ -296,6 +311,10 @@ class HdfsParquetScanner::ColumnReader : public HdfsParquetScanner::BaseColumnRe
     bool result = true;
     if (page_encoding == parquet::Encoding::PLAIN_DICTIONARY) {
       result = dict_decoder_->GetValue(reinterpret_cast<T*>(slot));
+    } else if (page_encoding == parquet::Encoding::DELTA_BINARY_PACKED) {
+      int64_t v;
+      result = delta_decoder_.Get(&v) &&
+          ParquetDeltaEncoding::FromInt64(v, reinterpret_cast<T*>(slot));
     } else {
       DCHECK(page_encoding == parquet::Encoding::PLAIN);
       data_ += ParquetPlainEncoder::Decode<T>(data_, fixed_len_size_,
@@ -320,6 +339,9 @@ class HdfsParquetScanner::ColumnReader : public HdfsParquetScanner::BaseColumnRe
 
   scoped_ptr<DictDecoder<T> > dict_decoder_;
 
+  // Decoder for DELTA_BINARY_PACKED data pages of integer columns.
+  DeltaDecoder delta_decoder_;
+
   // The size of this column with plain encoding for FIXED_LEN_BYTE_ARRAY. Unused
   // otherwise.
   int fixed_len_size_;
@@ -349,18 +371,38 @@ class HdfsParquetScanner::BoolColumnReader : public HdfsParquetScanner::BaseColu
 
   virtual Status InitDataPage(uint8_t* data, int size) {
     // Initialize bool decoder
-    bool_values_ = BitReader(data, size);
+    rle_encoded_ =
+        current_page_header_.data_page_header.encoding == parquet::Encoding::RLE;
+    if (rle_encoded_) {
+      // RLE encoded values are prefixed with their length.
+      int32_t num_bytes;
+      int header_size = sizeof(int32_t);
+      if (size < header_size) return Status("Invalid bool column.");
+      memcpy(&num_bytes, data, header_size);
+      if (num_bytes < 0 || num_bytes > size - header_size) {
+        return Status("Invalid bool column.");
+      }
+      rle_bool_values_ = RleDecoder(data + header_size, num_bytes, 1);
+    } else {
+      bool_values_ = BitReader(data, size);
+    }
     return Status::OK;
   }
 
   virtual bool ReadSlot(void* slot, MemPool* pool, bool* conjuncts_failed)  {
-    bool valid = bool_values_.GetValue(1, reinterpret_cast<bool*>(slot));
+    bool valid = rle_encoded_ ?
+        rle_bool_values_.Get(reinterpret_cast<bool*>(slot)) :
+        bool_values_.GetValue(1, reinterpret_cast<bool*>(slot));
     if (!valid) parent_->parse_status_ = Status("Invalid bool column.");
     return valid;
   }
 
  private:
+  // True if the current data page is RLE encoded, otherwise it is bit packed
+  // (PLAIN).
+  bool rle_encoded_;
   BitReader bool_values_;
+  RleDecoder rle_bool_values_;
 };
 
 }
@@ -1068,6 +1110,7 @@ bool IsEncodingSupported(parquet::Encoding::type e) {
     case parquet::Encoding::PLAIN_DICTIONARY:
     case parquet::Encoding::BIT_PACKED:
     case parquet::Encoding::RLE:
+    case parquet::Encoding::DELTA_BINARY_PACKED:
       return true;
     default:
       return false;
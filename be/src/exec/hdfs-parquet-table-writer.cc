@@ -26,12 +26,15 @@
 #include "util/buffer-builder.h"
 #include "util/compress.h"
 #include "util/debug-util.h"
+#include "util/delta-encoding.h"
 #include "util/dict-encoding.h"
 #include "util/hdfs-util.h"
 #include "util/rle-encoding.h"
 #include "rpc/thrift-util.h"
 
+#include <algorithm>
 #include <sstream>
+#include <gutil/strings/substitute.h>
 
 #include "gen-cpp/ImpalaService_types.h"
 
@@ -40,6 +43,7 @@ using namespace boost;
 using namespace impala;
 using namespace parquet;
 using namespace apache::thrift;
+using namespace strings;
 
 // Managing file sizes: We need to estimate how big the files being buffered
 // are in order to split them correctly in HDFS. Having a file that is too big
@@ -51,6 +55,16 @@ using namespace apache::thrift;
 // The current buffered pages (one for each column) can have a very poor estimate.
 // To adjust for this, we aim for a slightly smaller file size than the ideal.
 
+// Encodings: columns start out dictionary encoded. A column falls back to plain
+// encoding for the rest of the row group if the dictionary fills up or if the first
+// dictionary encoded page plus the dictionary is not smaller than the plain encoded
+// values would be, e.g. for unique keys. If the PARQUET_REENCODE_PAGES query option is
+// set, a plain encoded page is re-encoded when it is finalized if that makes it
+// smaller: integer pages with DELTA_BINARY_PACKED, which suits sorted keys, and
+// boolean pages with RLE. This is off by default since older readers, including older
+// versions of Impala, can't read these pages. The number of data pages with each
+// encoding is reported per column in the profile.
+
 // The maximum entries in the dictionary before giving up and switching to
 // plain encoding.
 // TODO: more complicated heuristic?
@@ -74,10 +88,11 @@ static const int MAX_DICTIONARY_ENTRIES = (1 << 16) - 1;
 // keep the combined/compressed buffer until we need to flush the file. The
 // values_ and def_levels_ are then reused for the next page.
 //
-// TODO: For codegen, we would codegen the AppendRow() function for each column.
-// This codegen is specific to the column expr (and type) and encoding.  The
-// parent writer object would combine all the generated AppendRow from all
-// the columns and run that function over row batches.
+// Row batches are appended a column at a time: each column writer encodes the values
+// of a run of rows with a loop that is specialized for its type (AppendValues()), so
+// the only virtual call is the one to AppendRows() per column and run. Columns with
+// fixed size types evaluate their expr for the whole run with Expr::GetValues(),
+// which uses the batch kernels of slot refs and arithmetic exprs.
 // TODO: we need to pass in the compression from the FE/metadata
 
 namespace impala {
@@ -106,13 +121,13 @@ class HdfsParquetTableWriter::BaseColumnWriter {
 
   virtual ~BaseColumnWriter() {}
 
-  // Append the row to this column.  This buffers the value into a data page.
+  // Appends the values of this column for 'num_rows' rows of 'batch' to the current
+  // page. 'rows' contains the indices of the rows in the batch. If 'values' is not
+  // NULL, it contains the values of expr_ for these rows, indexed by row index;
+  // otherwise expr_ is evaluated for each row.
   // Returns the (estimated) delta in file size in bytes.
-  // TODO: this needs to be batch based, instead of row based for better
-  // performance.  This is a bit trickier to handle the case where only a
-  // partial row batch can be output to the current file because it reaches
-  // the max file size.  Enabling codegen would also solve this problem.
-  int AppendRow(TupleRow* row);
+  virtual int64_t AppendRows(RowBatch* batch, const int* rows, int num_rows,
+      ExprValueVector* values) = 0;
 
   // Flushes all buffered data pages to the file.
   // *file_pos is an output parameter and will be incremented by
@@ -133,6 +148,7 @@ class HdfsParquetTableWriter::BaseColumnWriter {
     num_values_ = 0;
     total_compressed_byte_size_ = 0;
     current_encoding_ = Encoding::PLAIN;
+    num_pages_by_encoding_.clear();
   }
 
   // Close this writer. This is only called after Flush() and no more rows will
@@ -153,19 +169,36 @@ class HdfsParquetTableWriter::BaseColumnWriter {
  protected:
   friend class HdfsParquetTableWriter;
 
-  // Encode value into the current page output buffer. Returns true if the
-  // value fits on the current page. If this function returned false, the
-  // caller should create a new page and try again with the same value.
-  // *bytes_added is incremented by the number of bytes used to encode this
-  // value.
-  // Implemented in the subclass.
-  virtual bool EncodeValue(void* value, int* bytes_added) = 0;
+  // Implements AppendRows() for the subclass ColumnWriterType, which must implement
+  //   bool EncodeValue(void* value, int* bytes_added)
+  // EncodeValue() encodes value into the current page output buffer. It returns true
+  // if the value fits on the current page. If it returned false, the caller creates
+  // a new page and tries again with the same value. *bytes_added is incremented by
+  // the number of bytes used to encode this value.
+  // EncodeValue() is called non-virtually, so the loop over the rows is compiled
+  // separately for each column type with the encoding inlined.
+  template<typename ColumnWriterType>
+  int64_t AppendValues(ColumnWriterType* writer, RowBatch* batch, const int* rows,
+      int num_rows, ExprValueVector* values);
+
+  // Appends a single value, which is NULL or points to a value of type(), to the
+  // current page. Returns the (estimated) delta in file size in bytes.
+  template<typename ColumnWriterType>
+  int AppendValue(ColumnWriterType* writer, void* value);
 
   // Encodes out all data for the current page and updates the metadata. Returns
   // the number of bytes added to the current page (e.g. definition/repetition bits,
   // header byte size).
   virtual int64_t FinalizeCurrentPage();
 
+  // Called when a page with plain encoded values in values_buffer_ is finalized.
+  // Subclasses can re-encode the values in place if another encoding is smaller, in
+  // which case they update the page size, subtract the bytes saved from *bytes_added
+  // and return the new encoding. Returns PLAIN if the values were not re-encoded.
+  virtual Encoding::type ReencodePlainPage(int64_t* bytes_added) {
+    return Encoding::PLAIN;
+  }
+
   // Update current_page_ to a new page, reusing pages allocated if possible.
   void NewPage();
 
@@ -213,6 +246,9 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   int64_t total_uncompressed_byte_size_;
   Encoding::type current_encoding_;
 
+  // Number of data pages of the current row group with each encoding.
+  map<Encoding::type, int> num_pages_by_encoding_;
+
   // Created and set by the base class.
   DictEncoderBase* dict_encoder_base_;
 
@@ -235,7 +271,9 @@ class HdfsParquetTableWriter::ColumnWriter :
  public:
   ColumnWriter(HdfsParquetTableWriter* parent, Expr* expr,
       const THdfsCompression::type& codec) : BaseColumnWriter(parent, expr, codec),
-      num_values_since_dict_size_check_(0) {
+      num_values_since_dict_size_check_(0),
+      dict_checked_(false),
+      dict_page_plain_size_(0) {
     DCHECK_NE(expr->type().type, TYPE_BOOLEAN);
     encoded_value_size_ = ParquetPlainEncoder::ByteSize(expr->type());
   }
@@ -248,12 +286,26 @@ class HdfsParquetTableWriter::ColumnWriter :
     dict_encoder_.reset(
         new DictEncoder<T>(parent_->per_file_mem_pool_.get(), encoded_value_size_));
     dict_encoder_base_ = dict_encoder_.get();
+    dict_checked_ = false;
+    dict_page_plain_size_ = 0;
+  }
+
+  virtual int64_t AppendRows(RowBatch* batch, const int* rows, int num_rows,
+      ExprValueVector* values) {
+    return AppendValues(this, batch, rows, num_rows, values);
   }
 
  protected:
-  virtual bool EncodeValue(void* value, int* bytes_added) {
+  friend class BaseColumnWriter;
+
+  bool EncodeValue(void* value, int* bytes_added) {
     if (current_encoding_ == Encoding::PLAIN_DICTIONARY) {
-      *bytes_added += dict_encoder_->Put(*reinterpret_cast<T*>(value));
+      T* v = reinterpret_cast<T*>(value);
+      *bytes_added += dict_encoder_->Put(*v);
+      if (!dict_checked_) {
+        dict_page_plain_size_ += encoded_value_size_ < 0 ?
+            ParquetPlainEncoder::ByteSize<T>(*v) : encoded_value_size_;
+      }
 
       // If the dictionary contains the maximum number of values, switch to plain
       // encoding.  The current dictionary encoded page is written out.
@@ -282,12 +334,52 @@ class HdfsParquetTableWriter::ColumnWriter :
       *bytes_added += written_len;
       current_page_->header.uncompressed_page_size += encoded_len;
     } else {
-      // TODO: support other encodings here
       DCHECK(false);
     }
     return true;
   }
 
+  virtual int64_t FinalizeCurrentPage() {
+    DCHECK(current_page_ != NULL);
+    if (current_page_->finalized) return 0;
+    bool dict_page = current_encoding_ == Encoding::PLAIN_DICTIONARY &&
+        current_page_->num_non_null > 0;
+    int64_t bytes_added = BaseColumnWriter::FinalizeCurrentPage();
+    if (dict_page && !dict_checked_) {
+      // Keep using the dictionary only if it made the first page smaller.
+      dict_checked_ = true;
+      int64_t dict_size = dict_encoder_->dict_encoded_size() +
+          current_page_->header.uncompressed_page_size - current_page_->num_def_bytes;
+      if (dict_size >= dict_page_plain_size_) current_encoding_ = Encoding::PLAIN;
+    }
+    return bytes_added;
+  }
+
+  virtual Encoding::type ReencodePlainPage(int64_t* bytes_added) {
+    int64_t unused;
+    if (!ParquetDeltaEncoding::ToInt64(T(), &unused)) return Encoding::PLAIN;
+    DCHECK_GT(encoded_value_size_, 0);
+    int plain_size = current_page_->header.uncompressed_page_size;
+    int num_values = plain_size / encoded_value_size_;
+    delta_values_.resize(num_values);
+    uint8_t* ptr = values_buffer_;
+    for (int i = 0; i < num_values; ++i) {
+      T v;
+      ptr += ParquetPlainEncoder::Decode(ptr, encoded_value_size_, &v);
+      ParquetDeltaEncoding::ToInt64(v, &delta_values_[i]);
+    }
+    // Only use the delta encoding if it is smaller. The deltas have the width of the
+    // physical type, INT32 or INT64.
+    parent_->reencode_buffer_.resize(plain_size);
+    int len = DeltaEncoder::Encode(&delta_values_[0], num_values, encoded_value_size_ * 8,
+        &parent_->reencode_buffer_[0], plain_size - 1);
+    if (len < 0) return Encoding::PLAIN;
+    memcpy(values_buffer_, &parent_->reencode_buffer_[0], len);
+    current_page_->header.uncompressed_page_size = len;
+    *bytes_added -= plain_size - len;
+    return Encoding::DELTA_BINARY_PACKED;
+  }
+
  private:
   // The period, in # of rows, to check the estimated dictionary page size against
   // the data page size. We want to start a new data page when the estimated size
@@ -306,6 +398,16 @@ class HdfsParquetTableWriter::ColumnWriter :
 
   // Size of each encoded value. -1 if the size is type is variable-length.
   int encoded_value_size_;
+
+  // True once the size of the first dictionary encoded page of the row group was
+  // compared to its plain encoded size.
+  bool dict_checked_;
+
+  // Plain encoded size of the values of the first dictionary encoded page.
+  int64_t dict_page_plain_size_;
+
+  // Values of the current page, used for the delta encoding.
+  vector<int64_t> delta_values_;
 };
 
 // Bools are encoded a bit differently so subclass it explicitly.
@@ -321,11 +423,21 @@ class HdfsParquetTableWriter::BoolColumnWriter :
     // the format.
     current_encoding_ = Encoding::PLAIN;
     dict_encoder_base_ = NULL;
+    num_bool_values_ = 0;
+  }
+
+  virtual int64_t AppendRows(RowBatch* batch, const int* rows, int num_rows,
+      ExprValueVector* values) {
+    return AppendValues(this, batch, rows, num_rows, values);
   }
 
  protected:
-  virtual bool EncodeValue(void* value, int* bytes_added) {
-    return bool_values_->PutValue(*reinterpret_cast<bool*>(value), 1);
+  friend class BaseColumnWriter;
+
+  bool EncodeValue(void* value, int* bytes_added) {
+    if (!bool_values_->PutValue(*reinterpret_cast<bool*>(value), 1)) return false;
+    ++num_bool_values_;
+    return true;
   }
 
   virtual int64_t FinalizeCurrentPage() {
@@ -341,20 +453,64 @@ class HdfsParquetTableWriter::BoolColumnWriter :
     bytes_added += BaseColumnWriter::FinalizeCurrentPage();
 
     bool_values_->Clear();
+    num_bool_values_ = 0;
     return bytes_added;
   }
 
+  // Uses RLE if the page has long runs of the same value. RLE encoded values are
+  // prefixed with their length as a 4 byte int.
+  virtual Encoding::type ReencodePlainPage(int64_t* bytes_added) {
+    int plain_size = current_page_->header.uncompressed_page_size;
+    int max_rle_size = plain_size - sizeof(int32_t) - 1;
+    if (max_rle_size < RleEncoder::MinBufferSize(1)) return Encoding::PLAIN;
+    parent_->reencode_buffer_.resize(max_rle_size);
+    RleEncoder encoder(&parent_->reencode_buffer_[0], max_rle_size, 1);
+    BitReader reader(values_buffer_, plain_size);
+    for (int i = 0; i < num_bool_values_; ++i) {
+      bool v;
+      reader.GetValue(1, &v);
+      if (!encoder.Put(v)) return Encoding::PLAIN;
+    }
+    int32_t len = encoder.Flush();
+    memcpy(values_buffer_, &len, sizeof(int32_t));
+    memcpy(values_buffer_ + sizeof(int32_t), &parent_->reencode_buffer_[0], len);
+    current_page_->header.uncompressed_page_size = sizeof(int32_t) + len;
+    *bytes_added -= plain_size - current_page_->header.uncompressed_page_size;
+    return Encoding::RLE;
+  }
+
  private:
   // Used to encode bools as single bit values. This is reused across pages.
   BitWriter* bool_values_;
+
+  // Number of values in bool_values_.
+  int num_bool_values_;
 };
 
 }
 
-inline int HdfsParquetTableWriter::BaseColumnWriter::AppendRow(TupleRow* row) {
+template<typename ColumnWriterType>
+int64_t HdfsParquetTableWriter::BaseColumnWriter::AppendValues(
+    ColumnWriterType* writer, RowBatch* batch, const int* rows, int num_rows,
+    ExprValueVector* values) {
+  int64_t bytes_added = 0;
+  if (values != NULL) {
+    for (int i = 0; i < num_rows; ++i) {
+      bytes_added += AppendValue(writer, values->GetValue(rows[i]));
+    }
+  } else {
+    for (int i = 0; i < num_rows; ++i) {
+      bytes_added += AppendValue(writer, expr_->GetValue(batch->GetRow(rows[i])));
+    }
+  }
+  return bytes_added;
+}
+
+template<typename ColumnWriterType>
+inline int HdfsParquetTableWriter::BaseColumnWriter::AppendValue(
+    ColumnWriterType* writer, void* value) {
   int bytes_added = 0;
   ++num_values_;
-  void* value = expr_->GetValue(row);
   if (current_page_ == NULL) NewPage();
 
   // We might need to try again if this current page is not big enough
@@ -370,7 +526,7 @@ inline int HdfsParquetTableWriter::BaseColumnWriter::AppendRow(TupleRow* row) {
     if (value == NULL) break;
     ++current_page_->num_non_null;
 
-    if (EncodeValue(value, &bytes_added)) break;
+    if (writer->EncodeValue(value, &bytes_added)) break;
 
     // Value didn't fit on page, try again on a new page.
     bytes_added += FinalizeCurrentPage();
@@ -497,12 +653,16 @@ int64_t HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   if (current_page_->num_non_null == 0) current_encoding_ = Encoding::PLAIN;
 
   int64_t bytes_added = 0;
+  Encoding::type page_encoding = current_encoding_;
   if (current_encoding_ == Encoding::PLAIN_DICTIONARY) {
     bytes_added += WriteDictDataPage();
+  } else if (current_page_->num_non_null > 0 && parent_->reencode_pages_) {
+    page_encoding = ReencodePlainPage(&bytes_added);
   }
 
   PageHeader& header = current_page_->header;
-  header.data_page_header.encoding = current_encoding_;
+  header.data_page_header.encoding = page_encoding;
+  ++num_pages_by_encoding_[page_encoding];
 
   // Compute size of definition bits
   def_levels_->Flush();
@@ -597,7 +757,9 @@ HdfsParquetTableWriter::HdfsParquetTableWriter(HdfsTableSink* parent, RuntimeSta
       file_size_limit_(0),
       reusable_col_mem_pool_(new MemPool(parent_->mem_tracker())),
       per_file_mem_pool_(new MemPool(parent_->mem_tracker())),
-      row_idx_(0) {
+      row_idx_(0),
+      selected_capacity_(0),
+      reencode_pages_(false) {
 }
 
 HdfsParquetTableWriter::~HdfsParquetTableWriter() {
@@ -622,6 +784,7 @@ Status HdfsParquetTableWriter::Init() {
     codec = query_options.parquet_compression_codec;
   }
   VLOG_FILE << "Using compression codec: " << codec;
+  reencode_pages_ = query_options.parquet_reencode_pages;
 
   // Initialize each column structure.
   for (int i = 0; i < columns_.size(); ++i) {
@@ -718,13 +881,7 @@ Status HdfsParquetTableWriter::AddRowGroup() {
   for (int i = 0; i < columns_.size(); ++i) {
     ColumnMetaData metadata;
     metadata.type = IMPALA_TO_PARQUET_TYPES[columns_[i]->expr_->type().type];
-    // Add all encodings that were used in this file.  Currently we use PLAIN and
-    // PLAIN_DICTIONARY for data values and RLE for the definition levels.
-    metadata.encodings.push_back(Encoding::RLE);
-    // Columns are initially dictionary encoded
-    // TODO: we might not have PLAIN encoding in this case
-    metadata.encodings.push_back(Encoding::PLAIN_DICTIONARY);
-    metadata.encodings.push_back(Encoding::PLAIN);
+    // The encodings are added when the row group is flushed.
     metadata.path_in_schema.push_back(table_desc_->col_names()[i + num_clustering_cols]);
     metadata.codec = columns_[i]->codec();
     current_row_group_->columns[i].__set_meta_data(metadata);
@@ -797,16 +954,52 @@ Status HdfsParquetTableWriter::AppendRowBatch(RowBatch* batch,
     limit = row_group_indices.size();
   }
 
+  if (row_idx_ >= limit) {
+    row_idx_ = 0;
+    return Status::OK;
+  }
+
+  // Collect the indices of the rows that are left to append.
   bool all_rows = row_group_indices.empty();
-  for (; row_idx_ < limit;) {
-    TupleRow* current_row = all_rows ?
-        batch->GetRow(row_idx_) : batch->GetRow(row_group_indices[row_idx_]);
+  int num_rows = limit - row_idx_;
+  rows_.resize(num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    rows_[i] = all_rows ? row_idx_ + i : row_group_indices[row_idx_ + i];
+  }
+
+  // Evaluate the exprs of columns with fixed size types for all these rows at once.
+  // The results stay valid while the rows are appended since no one else evaluates
+  // the output exprs in the meantime.
+  const bool* selected = NULL;
+  if (!all_rows || row_idx_ > 0) {
+    if (selected_capacity_ < batch->capacity()) {
+      selected_.reset(new bool[batch->capacity()]);
+      selected_capacity_ = batch->capacity();
+    }
+    memset(selected_.get(), 0, batch->num_rows());
+    for (int i = 0; i < num_rows; ++i) selected_[rows_[i]] = true;
+    selected = selected_.get();
+  }
+  column_values_.resize(columns_.size());
+  for (int j = 0; j < columns_.size(); ++j) {
+    Expr* expr = columns_[j]->expr_;
+    column_values_[j] = Expr::IsBatchEvalType(expr->type()) ?
+        expr->GetValues(batch, selected) : NULL;
+  }
+
+  // Append the rows a column at a time, in runs that are short enough to notice when
+  // the file is full.
+  int num_appended = 0;
+  while (num_appended < num_rows) {
+    int run_length = MaxRowsToAppend(num_rows - num_appended);
     for (int j = 0; j < columns_.size(); ++j) {
-      file_size_estimate_ += columns_[j]->AppendRow(current_row);
+      file_size_estimate_ += columns_[j]->AppendRows(batch, &rows_[num_appended],
+          run_length, column_values_[j]);
     }
-    ++row_idx_;
-    ++row_count_;
-    ++output_->num_rows;
+    num_appended += run_length;
+    row_idx_ += run_length;
+    row_count_ += run_length;
+    output_->num_rows += run_length;
 
     if (file_size_estimate_ > file_size_limit_) {
       // This file is full.  We need a new file.
@@ -821,8 +1014,20 @@ Status HdfsParquetTableWriter::AppendRowBatch(RowBatch* batch,
   return Status::OK;
 }
 
+int HdfsParquetTableWriter::MaxRowsToAppend(int num_rows) const {
+  // Until the first rows are appended, the row size is unknown. The file has room
+  // for at least DATA_PAGE_SIZE bytes per column at that point.
+  if (row_count_ == 0) return num_rows;
+  int64_t bytes_left = file_size_limit_ - file_size_estimate_;
+  int64_t avg_row_size = file_size_estimate_ / row_count_ + 1;
+  // Only fill half the remaining space with each run, so the runs get shorter as the
+  // file fills up and the estimate is checked more often.
+  int64_t max_rows = bytes_left / (2 * avg_row_size);
+  return max<int64_t>(1, min<int64_t>(max_rows, num_rows));
+}
+
 Status HdfsParquetTableWriter::Finalize() {
-  SCOPED_TIMER(parent_->hdfs_write_timer());
+  SCOPED_TIMER(parent_->encode_timer());
 
   // At this point we write out the rest of the file.  We first update the file
   // metadata, now that all the values have been seen.
@@ -852,6 +1057,30 @@ Status HdfsParquetTableWriter::WriteFileHeader() {
   return Status::OK;
 }
 
+void HdfsParquetTableWriter::AddEncodings(const string& col_name,
+    const BaseColumnWriter& column, ColumnMetaData* metadata) {
+  // RLE is used for the definition levels.
+  metadata->encodings.clear();
+  metadata->encodings.push_back(Encoding::RLE);
+  if (column.dict_encoder_base_ != NULL) {
+    metadata->encodings.push_back(Encoding::PLAIN_DICTIONARY);
+  }
+  RuntimeProfile* profile = parent_->profile();
+  RuntimeProfile::Counter* total_pages_counter =
+      profile->AddCounter("ParquetDataPages", TCounterType::UNIT);
+  for (map<Encoding::type, int>::const_iterator it =
+       column.num_pages_by_encoding_.begin();
+       it != column.num_pages_by_encoding_.end(); ++it) {
+    if (find(metadata->encodings.begin(), metadata->encodings.end(), it->first) ==
+        metadata->encodings.end()) {
+      metadata->encodings.push_back(it->first);
+    }
+    total_pages_counter->Update(it->second);
+    profile->AddCounter(Substitute("$0 $1", col_name, PrintEncoding(it->first)),
+        TCounterType::UNIT, "ParquetDataPages")->Update(it->second);
+  }
+}
+
 Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
   if (current_row_group_ == NULL) return Status::OK;
 
@@ -878,6 +1107,7 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
     current_row_group_->columns[i].file_offset = file_pos_;
     const string& col_name = table_desc_->col_names()[i + num_clustering_cols];
     parquet_stats_.per_column_size[col_name] += columns_[i]->total_compressed_size();
+    AddEncodings(col_name, *columns_[i], &current_row_group_->columns[i].meta_data);
 
     // Since we don't supported complex schemas, all columns should have the same
     // number of values.
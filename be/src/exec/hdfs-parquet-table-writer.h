@@ -20,6 +20,7 @@
 
 #include <hdfs.h>
 #include <map>
+#include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
 
 #include "util/compress.h"
@@ -30,6 +31,7 @@
 namespace impala {
 
 class Expr;
+class ExprValueVector;
 struct OutputPartition;
 class RuntimeState;
 class ThriftSerializer;
@@ -117,6 +119,17 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // offsets of column chunks, updating the file metadata.
   Status FlushCurrentRowGroup();
 
+  // Returns how many of the next 'num_rows' rows can be appended before checking if
+  // the file is full, based on the average size of the rows appended so far. Returns
+  // at least 1.
+  int MaxRowsToAppend(int num_rows) const;
+
+  // Sets the encodings of the column chunk 'metadata' to the encodings used by
+  // 'column' in the current row group and adds the number of data pages with each
+  // encoding to the profile.
+  void AddEncodings(const std::string& col_name, const BaseColumnWriter& column,
+      parquet::ColumnMetaData* metadata);
+
   // Adds a row group to the metadata and updates current_row_group_ to the
   // new row group.  current_row_group_ will be flushed.
   Status AddRowGroup();
@@ -163,6 +176,27 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // file.
   int row_idx_;
 
+  // Indices of the rows of the current batch that are left to append, starting at
+  // row_idx_.
+  std::vector<int> rows_;
+
+  // selected_[i] is true if row i of the current batch is in rows_. Only used if
+  // rows_ doesn't cover the whole batch. Has room for selected_capacity_ rows.
+  boost::scoped_array<bool> selected_;
+  int selected_capacity_;
+
+  // For each column, its values for the rows in rows_ if they were evaluated a batch
+  // at a time, otherwise NULL. Owned by the column exprs.
+  std::vector<ExprValueVector*> column_values_;
+
+  // If true, the column writers re-encode plain data pages with DELTA_BINARY_PACKED
+  // or RLE if that is smaller. Set from the PARQUET_REENCODE_PAGES query option.
+  bool reencode_pages_;
+
+  // Buffer used by the column writers to re-encode pages. Reused between all data
+  // pages.
+  std::vector<uint8_t> reencode_buffer_;
+
   // Staging buffer to use to compress data.  This is used only if compression is
   // enabled and is reused between all data pages.
   std::vector<uint8_t> compression_staging_buffer_;
@@ -37,6 +37,7 @@
 #include "runtime/mem-pool.h"
 #include "runtime/raw-value.h"
 #include "runtime/row-batch.h"
+#include "runtime/slot-bound-filter.h"
 #include "util/bit-util.h"
 #include "util/container-util.h"
 #include "util/debug-util.h"
@@ -82,6 +83,7 @@ HdfsScanNode::HdfsScanNode(ObjectPool* pool, const TPlanNode& tnode,
       scanner_thread_bytes_required_(0),
       num_interpreted_conjuncts_copies_(0),
       num_partition_keys_(0),
+      bound_filter_rows_rejected_counter_(NULL),
       disks_accessed_bitmap_(TCounterType::UNIT, 0),
       done_(false),
       all_ranges_started_(false),
@@ -149,6 +151,7 @@ Status HdfsScanNode::GetNextInternal(RuntimeState* state, RowBatch* row_batch, b
   if (materialized_batch != NULL) {
     num_owned_io_buffers_ -= materialized_batch->num_io_buffers();
     row_batch->AcquireState(materialized_batch);
+    if (!batch_conjuncts_.empty()) ApplyBatchConjuncts(row_batch);
     // Update the number of materialized rows instead of when they are materialized.
     // This means that scanners might process and queue up more rows than are necessary
     // for the limit case but we want to avoid the synchronized writes to
@@ -180,12 +183,27 @@ Status HdfsScanNode::CreateConjuncts(vector<Expr*>* expr, bool disable_codegen)
   // codegen the copy of the expr.
   // TODO: we really need to stop having to create copies of exprs
   RETURN_IF_ERROR(Expr::CreateExprTrees(runtime_state_->obj_pool(),
-      thrift_plan_node_->conjuncts, expr));
+      scanner_conjunct_texprs_, expr));
   all_conjuncts_copies_.push_back(expr);
   RETURN_IF_ERROR(Expr::Prepare(*expr, runtime_state_, row_desc(), disable_codegen));
   return Status::OK;
 }
 
+void HdfsScanNode::ApplyBatchConjuncts(RowBatch* batch) {
+  DCHECK_LE(batch->capacity(), runtime_state_->batch_size());
+  int num_rows = batch->num_rows();
+  if (num_rows == 0) return;
+  ExecNode::EvalBatchConjuncts(&batch_conjuncts_[0], batch_conjuncts_.size(), batch,
+      batch_selected_.get());
+  int num_selected = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    if (!batch_selected_[i]) continue;
+    if (num_selected != i) batch->CopyRow(batch->GetRow(i), batch->GetRow(num_selected));
+    ++num_selected;
+  }
+  batch->set_num_rows(num_selected);
+}
+
 DiskIoMgr::ScanRange* HdfsScanNode::AllocateScanRange(const char* file, int64_t len,
     int64_t offset, int64_t partition_id, int disk_id, bool try_cache) {
   DCHECK_GE(disk_id, -1);
@@ -228,6 +246,9 @@ void* HdfsScanNode::GetFileMetadata(const string& filename) {
 void* HdfsScanNode::GetCodegenFn(THdfsFileFormat::type type) {
   CodegendFnMap::iterator it = codegend_fn_map_.find(type);
   if (it == codegend_fn_map_.end()) return NULL;
+  // The module may still be compiling in the background. The functions in
+  // codegend_fn_map_ must not be handed out before then.
+  if (!runtime_state_->codegen()->jitted_fns_ready()) return NULL;
   if (codegend_conjuncts_thread_safe_) {
     DCHECK_EQ(it->second.size(), 1);
     return it->second.front();
@@ -338,6 +359,20 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
   runtime_state_ = state;
   RETURN_IF_ERROR(ScanNode::Prepare(state));
 
+  // Split off the conjuncts that are cheaper to evaluate a batch at a time.
+  vector<Expr*> row_conjuncts;
+  for (int i = 0; i < conjuncts_.size(); ++i) {
+    if (conjuncts_[i]->PrefersBatchEval()) {
+      batch_conjuncts_.push_back(conjuncts_[i]);
+    } else {
+      row_conjuncts.push_back(conjuncts_[i]);
+      scanner_conjunct_texprs_.push_back(thrift_plan_node_->conjuncts[i]);
+    }
+  }
+  conjuncts_.swap(row_conjuncts);
+  // The batches returned by GetNext() have the capacity of the materialized batches.
+  if (!batch_conjuncts_.empty()) batch_selected_.reset(new bool[state->batch_size()]);
+
   tuple_desc_ = state->desc_tbl().GetTupleDescriptor(tuple_id_);
   DCHECK(tuple_desc_ != NULL);
 
@@ -535,6 +570,7 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
 // to queue up a non-zero number of those splits to the io mgr (via the ScanNode).
 Status HdfsScanNode::Open(RuntimeState* state) {
   RETURN_IF_ERROR(ExecNode::Open(state));
+  RETURN_IF_ERROR(Expr::Open(batch_conjuncts_, state));
 
   if (file_descs_.empty()) {
     SetDone();
@@ -584,6 +620,21 @@ Status HdfsScanNode::Open(RuntimeState* state) {
   bytes_read_dn_cache_ = ADD_COUNTER(runtime_profile(), "BytesReadDataNodeCache",
       TCounterType::BYTES);
 
+  // Parent nodes add their bound filters before opening this node.
+  const vector<SlotDescriptor*>& slots = tuple_desc_->slots();
+  for (int i = 0; i < slots.size(); ++i) {
+    if (!slots[i]->is_materialized()) continue;
+    SlotBoundFilter* filter = state->GetSlotBoundFilter(slots[i]->id());
+    if (filter == NULL) continue;
+    bound_filters_.push_back(make_pair(slots[i], filter));
+    VLOG(2) << "Bound filter on slot " << slots[i]->id() << " of scan node " << id();
+  }
+  if (!bound_filters_.empty()) {
+    AddRuntimeExecOption("Bound Filter Pushed Down");
+    bound_filter_rows_rejected_counter_ =
+        ADD_COUNTER(runtime_profile(), "BoundFilterRowsRejected", TCounterType::UNIT);
+  }
+
   // Create num_disks+1 bucket counters
   for (int i = 0; i < state->io_mgr()->num_disks() + 1; ++i) {
     hdfs_read_thread_concurrency_bucket_.push_back(
@@ -648,6 +699,7 @@ void HdfsScanNode::Close(RuntimeState* state) {
      it != all_conjuncts_copies_.end(); ++it) {
     Expr::Close(**it, state);
   }
+  Expr::Close(batch_conjuncts_, state);
 
   ScanNode::Close(state);
 }
@@ -1070,9 +1122,11 @@ Status HdfsScanNode::CreateConjunctsCopies(THdfsFileFormat::type format) {
         fn = NULL;
     }
     if (fn != NULL) {
-      // This pointer will be updated to the JIT'd function in FinalizeModule().
+      // This pointer will be updated to the JIT'd function in FinalizeModule(). Until
+      // then, GetCodegenFn() returns NULL and scanners use the interpreted path.
       codegend_fn_map_[format].push_back(NULL);
-      runtime_state_->codegen()->AddFunctionToJit(fn, &codegend_fn_map_[format].back());
+      runtime_state_->codegen()->AddFunctionToJit(
+          fn, &codegend_fn_map_[format].back(), true);
     } else {
       break;
     }
@@ -21,6 +21,7 @@
 #include <stdint.h>
 
 #include <boost/unordered_map.hpp>
+#include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
@@ -41,6 +42,7 @@ namespace impala {
 class DescriptorTbl;
 class HdfsScanner;
 class RowBatch;
+class SlotBoundFilter;
 class Status;
 class Tuple;
 class TPlanNode;
@@ -109,6 +111,15 @@ class HdfsScanNode : public ScanNode {
   const std::vector<SlotDescriptor*>& materialized_slots()
       const { return materialized_slots_; }
 
+  // Bound filters on the slots of tuple_desc_, set in Open(). Scanners evaluate them
+  // over the rows they materialize. See SlotBoundFilter.
+  const std::vector<std::pair<const SlotDescriptor*, SlotBoundFilter*> >& bound_filters()
+      const { return bound_filters_; }
+
+  RuntimeProfile::Counter* bound_filter_rows_rejected_counter() const {
+    return bound_filter_rows_rejected_counter_;
+  }
+
   // Returns the tuple idx into the row for this scan node to output to.
   // Currently this is always 0.
   int tuple_idx() const { return 0; }
@@ -147,7 +158,8 @@ class HdfsScanNode : public ScanNode {
   }
 
   // Returns the per format codegen'd function.  Scanners call this to get the
-  // codegen'd function to use.  Returns NULL if codegen should not be used.
+  // codegen'd function to use.  Returns NULL if codegen should not be used or the
+  // codegen'd functions are still being compiled.
   void* GetCodegenFn(THdfsFileFormat::type);
 
   // Each call to GetCodegenFn() must call ReleaseCodegenFn().
@@ -340,6 +352,18 @@ class HdfsScanNode : public ScanNode {
   // for debugging.
   int num_interpreted_conjuncts_copies_;
 
+  // Conjuncts for which Expr::PrefersBatchEval() is true, e.g. ones calling Hive UDFs.
+  // The scanners don't evaluate them for each row; GetNext() evaluates them over the
+  // materialized batches with ExecNode::EvalBatchConjuncts() instead. conjuncts_ only
+  // holds the other conjuncts, which the scanners evaluate.
+  std::vector<Expr*> batch_conjuncts_;
+
+  // The thrift exprs of conjuncts_, from which the scanners' copies are created.
+  std::vector<TExpr> scanner_conjunct_texprs_;
+
+  // Result of evaluating batch_conjuncts_ for the rows of a batch.
+  boost::scoped_array<bool> batch_selected_;
+
   // Total number of partition slot descriptors, including non-materialized ones.
   int num_partition_keys_;
 
@@ -364,6 +388,12 @@ class HdfsScanNode : public ScanNode {
   // These descriptors are sorted in order of increasing col_pos
   std::vector<SlotDescriptor*> partition_key_slots_;
 
+  // Bound filters added by the parent nodes, with the slots they filter.
+  std::vector<std::pair<const SlotDescriptor*, SlotBoundFilter*> > bound_filters_;
+
+  // Number of rows the scanners discarded because of bound_filters_.
+  RuntimeProfile::Counter* bound_filter_rows_rejected_counter_;
+
   // Keeps track of total splits and the number finished.
   ProgressUpdater progress_;
 
@@ -450,9 +480,13 @@ class HdfsScanNode : public ScanNode {
   // stored in conjuncts_copies_.
   Status CreateConjunctsCopies(THdfsFileFormat::type format);
 
-  // Create a prepared copy of the conjuncts for this node.
+  // Create a prepared copy of the conjuncts the scanners evaluate.
   Status CreateConjuncts(std::vector<Expr*>* exprs, bool disable_codegen);
 
+  // Evaluates batch_conjuncts_ over the rows of 'batch' and removes the rows that
+  // don't pass.
+  void ApplyBatchConjuncts(RowBatch* batch);
+
   // Called when scanner threads are available for this scan node. This will
   // try to spin up as many scanner threads as the quota allows.
   // This is also called whenever a new range is added to the IoMgr to 'pull'
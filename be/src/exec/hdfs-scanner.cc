@@ -75,6 +75,10 @@ Status HdfsScanner::Prepare(ScannerContext* context) {
       state_, context_->partition_descriptor()->partition_key_values());
   conjuncts_ = scan_node_->GetConjuncts();
   num_conjuncts_ = conjuncts_->size();
+  bound_filter_snapshots_.resize(scan_node_->bound_filters().size());
+  for (int i = 0; i < bound_filter_snapshots_.size(); ++i) {
+    scan_node_->bound_filters()[i].second->InitSnapshot(&bound_filter_snapshots_[i]);
+  }
   StartNewRowBatch();
   return Status::OK;
 }
@@ -133,6 +137,7 @@ Status HdfsScanner::CommitRows(int num_rows) {
   // which can happen if the query is very selective.
   if (batch_->AtCapacity() || context_->num_completed_io_buffers() > 0) {
     context_->AttachCompletedResources(batch_, /* done */ false);
+    ApplyBoundFilters();
     scan_node_->AddMaterializedRowBatch(batch_);
     StartNewRowBatch();
   }
@@ -145,10 +150,40 @@ Status HdfsScanner::CommitRows(int num_rows) {
 void HdfsScanner::AddFinalRowBatch() {
   DCHECK(batch_ != NULL);
   context_->AttachCompletedResources(batch_, /* done */ true);
+  ApplyBoundFilters();
   scan_node_->AddMaterializedRowBatch(batch_);
   batch_ = NULL;
 }
 
+void HdfsScanner::ApplyBoundFilters() {
+  if (bound_filter_snapshots_.empty() || batch_->num_rows() == 0) return;
+  const vector<pair<const SlotDescriptor*, SlotBoundFilter*> >& filters =
+      scan_node_->bound_filters();
+  for (int i = 0; i < filters.size(); ++i) {
+    filters[i].second->Refresh(&bound_filter_snapshots_[i]);
+  }
+
+  int tuple_idx = scan_node_->tuple_idx();
+  int num_rows = batch_->num_rows();
+  int num_kept = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    TupleRow* row = batch_->GetRow(i);
+    Tuple* tuple = row->GetTuple(tuple_idx);
+    bool rejected = false;
+    for (int j = 0; j < filters.size() && !rejected; ++j) {
+      const SlotDescriptor* slot = filters[j].first;
+      const void* value = tuple->IsNull(slot->null_indicator_offset()) ?
+          NULL : tuple->GetSlot(slot->tuple_offset());
+      rejected = bound_filter_snapshots_[j].Rejects(value);
+    }
+    if (rejected) continue;
+    if (num_kept != i) batch_->CopyRow(row, batch_->GetRow(num_kept));
+    ++num_kept;
+  }
+  batch_->set_num_rows(num_kept);
+  COUNTER_UPDATE(scan_node_->bound_filter_rows_rejected_counter(), num_rows - num_kept);
+}
+
 // In this code path, no slots were materialized from the input files.  The only
 // slots are from partition keys.  This lets us simplify writing out the batches.
 //   1. template_tuple_ is the complete tuple.
@@ -27,6 +27,7 @@
 #include "exec/scanner-context.h"
 #include "runtime/disk-io-mgr.h"
 #include "runtime/row-batch.h"
+#include "runtime/slot-bound-filter.h"
 
 namespace impala {
 
@@ -199,6 +200,10 @@ class HdfsScanner {
   // Jitted write tuples function pointer.  Null if codegen is disabled.
   WriteTuplesFn write_tuples_fn_;
 
+  // Copies of the scan node's bound filters, in the same order, refreshed for every
+  // row batch.
+  std::vector<SlotBoundFilter::Snapshot> bound_filter_snapshots_;
+
   // Initializes write_tuples_fn_ to the jitted function if codegen is possible.
   // - partition - partition descriptor for this scanner/scan range
   // - type - type for this scanner
@@ -226,6 +231,11 @@ class HdfsScanner {
   // and io buffers) to minimize memory consumption.
   Status CommitRows(int num_rows);
 
+  // Removes the rows of batch_ that the scan node's bound filters reject. Called
+  // before batch_ is passed to the scan node, rather than on every commit, since the
+  // tuple memory of the removed rows can't be reused.
+  void ApplyBoundFilters();
+
   // Attach all remaining resources from context_ to batch_ and send batch_ to the scan
   // node. This must be called after all rows have been committed and no further resources
   // are needed from context_ (in practice this will in each scanner subclass's Close()
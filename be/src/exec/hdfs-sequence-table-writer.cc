@@ -0,0 +1,286 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exec/hdfs-sequence-table-writer.h"
+#include "exec/exec-node.h"
+#include "exec/hdfs-sequence-scanner.h"
+#include "exec/read-write-util.h"
+#include "exprs/expr.h"
+#include "runtime/raw-value.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/string-value.h"
+#include "util/block-compressor.h"
+#include "util/codec.h"
+
+#include <vector>
+#include <stdlib.h>
+
+using namespace std;
+
+namespace impala {
+
+const char* const HdfsSequenceTableWriter::KEY_CLASS_NAME =
+    "org.apache.hadoop.io.BytesWritable";
+const char* const HdfsSequenceTableWriter::VALUE_CLASS_NAME =
+    "org.apache.hadoop.io.Text";
+
+// Size of the serialized empty BytesWritable key: its length.
+static const int KEY_LENGTH = sizeof(int32_t);
+
+// Appends 'v' in big endian order (Hadoop's Int) to 'buffer'.
+static inline void AppendInt(string* buffer, int32_t v) {
+  uint8_t bytes[sizeof(int32_t)];
+  ReadWriteUtil::PutInt(bytes, static_cast<uint32_t>(v));
+  buffer->append(reinterpret_cast<char*>(bytes), sizeof(int32_t));
+}
+
+// Appends 'v' as a Hadoop VInt to 'buffer' and returns its length.
+static inline int AppendVInt(string* buffer, int32_t v) {
+  uint8_t bytes[ReadWriteUtil::MAX_VINT_LEN];
+  int len = ReadWriteUtil::PutVInt(v, bytes);
+  buffer->append(reinterpret_cast<char*>(bytes), len);
+  return len;
+}
+
+// Appends 'text' as a Hadoop Text (VInt length followed by the bytes) to 'buffer'.
+static inline void AppendText(string* buffer, const char* text, int len) {
+  AppendVInt(buffer, len);
+  buffer->append(text, len);
+}
+
+HdfsSequenceTableWriter::HdfsSequenceTableWriter(HdfsTableSink* parent,
+    RuntimeState* state, OutputPartition* output,
+    const HdfsPartitionDescriptor* partition, const HdfsTableDescriptor* table_desc,
+    const vector<Expr*>& output_exprs)
+  : HdfsTableWriter(parent, state, output, partition, table_desc, output_exprs),
+    bytes_since_sync_(0),
+    num_block_records_(0),
+    num_pending_records_(0) {
+  field_delim_ = partition->field_delim();
+  escape_char_ = partition->escape_char();
+  // See HdfsTextTableWriter.
+  row_stream_.precision(RawValue::ASCII_PRECISION);
+}
+
+HdfsSequenceTableWriter::~HdfsSequenceTableWriter() {
+}
+
+Status HdfsSequenceTableWriter::Init() {
+  THdfsCompression::type codec = GetHadoopCompressionCodec();
+  if (codec == THdfsCompression::NONE) return Status::OK;
+  compressor_.reset(
+      new BlockCompressor(codec, parent_->mem_tracker(), parent_->profile()));
+  return compressor_->Init();
+}
+
+void HdfsSequenceTableWriter::Close() {
+  if (compressor_.get() != NULL) compressor_->Close();
+}
+
+Status HdfsSequenceTableWriter::InitNewFile() {
+  // Hadoop uses a hash of a unique id and the time, which readers don't interpret.
+  for (int i = 0; i < SYNC_HASH_SIZE; ++i) sync_[i] = rand();
+  out_buffer_.clear();
+  bytes_since_sync_ = 0;
+  block_.assign(NUM_BLOCK_BUFFERS, string());
+  num_block_records_ = 0;
+  return WriteFileHeader();
+}
+
+Status HdfsSequenceTableWriter::WriteFileHeader() {
+  const uint8_t* version = HdfsSequenceScanner::SEQFILE_VERSION_HEADER;
+  string header(reinterpret_cast<const char*>(version),
+      sizeof(HdfsSequenceScanner::SEQFILE_VERSION_HEADER));
+  AppendText(&header, KEY_CLASS_NAME, strlen(KEY_CLASS_NAME));
+  AppendText(&header, VALUE_CLASS_NAME, strlen(VALUE_CLASS_NAME));
+  // Whether the file is compressed and whether it is block compressed.
+  bool compressed = compressor_.get() != NULL;
+  header.push_back(compressed);
+  header.push_back(compressed);
+  if (compressed) {
+    const Codec::CodecMap& codecs = Codec::CODEC_MAP;
+    Codec::CodecMap::const_iterator it = codecs.begin();
+    while (it != codecs.end() && it->second != compressor_->codec()) ++it;
+    DCHECK(it != codecs.end());
+    AppendText(&header, it->first.data(), it->first.size());
+  }
+  // Empty metadata.
+  AppendInt(&header, 0);
+  header.append(reinterpret_cast<char*>(sync_), SYNC_HASH_SIZE);
+
+  return Write(header.data(), header.size());
+}
+
+Status HdfsSequenceTableWriter::AppendRowBatch(RowBatch* batch,
+    const vector<int32_t>& row_group_indices, bool* new_file) {
+  int32_t limit;
+  if (row_group_indices.empty()) {
+    limit = batch->num_rows();
+  } else {
+    limit = row_group_indices.size();
+  }
+  COUNTER_UPDATE(parent_->rows_inserted_counter(), limit);
+  bool all_rows = row_group_indices.empty();
+
+  {
+    SCOPED_TIMER(parent_->encode_timer());
+    // Format all rows first, so the text is copied out of the stream once per batch.
+    row_stream_.str(string());
+    row_ends_.clear();
+    for (int row_idx = 0; row_idx < limit; ++row_idx) {
+      TupleRow* current_row = all_rows ?
+          batch->GetRow(row_idx) : batch->GetRow(row_group_indices[row_idx]);
+      EncodeRow(current_row);
+      row_ends_.push_back(row_stream_.tellp());
+    }
+    string rows = row_stream_.str();
+    int row_start = 0;
+    for (int i = 0; i < row_ends_.size(); ++i) {
+      const char* text = rows.data() + row_start;
+      int len = row_ends_[i] - row_start;
+      if (compressor_.get() == NULL) {
+        AppendRecord(text, len);
+      } else {
+        AppendBlockRecord(text, len);
+      }
+      row_start = row_ends_[i];
+    }
+    output_->num_rows += limit;
+  }
+
+  if (compressor_.get() == NULL ? out_buffer_.size() >= HDFS_FLUSH_WRITE_SIZE :
+      block_[VALUES].size() >= COMPRESSED_BLOCK_SIZE) {
+    RETURN_IF_ERROR(Flush());
+  }
+  *new_file = false;
+  return Status::OK;
+}
+
+void HdfsSequenceTableWriter::EncodeRow(TupleRow* row) {
+  // Partition cols are not written, see HdfsTextTableWriter::AppendRowBatch().
+  int num_non_partition_cols =
+      table_desc_->num_cols() - table_desc_->num_clustering_cols();
+  DCHECK_GE(output_exprs_.size(), num_non_partition_cols) << parent_->DebugString();
+  for (int j = 0; j < num_non_partition_cols; ++j) {
+    void* value = output_exprs_[j]->GetValue(row);
+    if (value != NULL) {
+      if (output_exprs_[j]->type().type == TYPE_STRING) {
+        PrintEscaped(reinterpret_cast<const StringValue*>(value));
+      } else {
+        output_exprs_[j]->PrintValue(value, &row_stream_);
+      }
+    } else {
+      row_stream_ << table_desc_->null_column_value();
+    }
+    if (j + 1 < num_non_partition_cols) row_stream_ << field_delim_;
+  }
+}
+
+inline void HdfsSequenceTableWriter::PrintEscaped(const StringValue* str_val) {
+  for (int i = 0; i < str_val->len; ++i) {
+    if (UNLIKELY(str_val->ptr[i] == field_delim_ || str_val->ptr[i] == escape_char_)) {
+      row_stream_ << escape_char_;
+    }
+    row_stream_ << str_val->ptr[i];
+  }
+}
+
+void HdfsSequenceTableWriter::AppendRecord(const char* text, int len) {
+  int start = out_buffer_.size();
+  if (bytes_since_sync_ >= SYNC_INTERVAL) {
+    AppendInt(&out_buffer_, SYNC_ESCAPE);
+    out_buffer_.append(reinterpret_cast<char*>(sync_), SYNC_HASH_SIZE);
+    bytes_since_sync_ = 0;
+  }
+  uint8_t len_bytes[ReadWriteUtil::MAX_VINT_LEN];
+  int value_length = ReadWriteUtil::PutVInt(len, len_bytes) + len;
+  // Record length (key and value), key length, key and value.
+  AppendInt(&out_buffer_, KEY_LENGTH + value_length);
+  AppendInt(&out_buffer_, KEY_LENGTH);
+  AppendInt(&out_buffer_, 0);
+  AppendText(&out_buffer_, text, len);
+  bytes_since_sync_ += out_buffer_.size() - start;
+}
+
+void HdfsSequenceTableWriter::AppendBlockRecord(const char* text, int len) {
+  AppendVInt(&block_[KEY_LENGTHS], KEY_LENGTH);
+  AppendInt(&block_[KEYS], 0);
+  int start = block_[VALUES].size();
+  AppendText(&block_[VALUES], text, len);
+  AppendVInt(&block_[VALUE_LENGTHS], block_[VALUES].size() - start);
+  ++num_block_records_;
+}
+
+Status HdfsSequenceTableWriter::Flush() {
+  if (compressor_.get() == NULL) {
+    RETURN_IF_ERROR(Write(out_buffer_.data(), out_buffer_.size()));
+    out_buffer_.clear();
+    return Status::OK;
+  }
+
+  // Collect the previous block before handing in this one. It stays valid while this
+  // block is compressed, so writing it overlaps with the compression.
+  vector<StringValue> compressed;
+  int num_records = num_pending_records_;
+  if (compressor_->has_pending_blocks()) {
+    RETURN_IF_ERROR(compressor_->GetCompressedBlocks(&compressed));
+  }
+  compressor_->Compress(&block_);
+  // The compressor hands back the buffers of the previous block.
+  block_.resize(NUM_BLOCK_BUFFERS);
+  num_pending_records_ = num_block_records_;
+  num_block_records_ = 0;
+  if (compressed.empty()) return Status::OK;
+  return WriteCompressedBlock(compressed, num_records);
+}
+
+Status HdfsSequenceTableWriter::WritePendingBlock() {
+  if (compressor_.get() == NULL || !compressor_->has_pending_blocks()) {
+    return Status::OK;
+  }
+  vector<StringValue> compressed;
+  RETURN_IF_ERROR(compressor_->GetCompressedBlocks(&compressed));
+  return WriteCompressedBlock(compressed, num_pending_records_);
+}
+
+Status HdfsSequenceTableWriter::WriteCompressedBlock(
+    const vector<StringValue>& compressed, int num_records) {
+  DCHECK_EQ(compressed.size(), static_cast<size_t>(NUM_BLOCK_BUFFERS));
+  string header;
+  AppendInt(&header, SYNC_ESCAPE);
+  header.append(reinterpret_cast<char*>(sync_), SYNC_HASH_SIZE);
+  AppendVInt(&header, num_records);
+
+  RETURN_IF_ERROR(Write(header.data(), header.size()));
+  for (int i = 0; i < compressed.size(); ++i) {
+    // Each buffer is preceded by its compressed length.
+    header.clear();
+    AppendVInt(&header, compressed[i].len);
+    RETURN_IF_ERROR(Write(header.data(), header.size()));
+    RETURN_IF_ERROR(Write(compressed[i].ptr, compressed[i].len));
+  }
+  return Status::OK;
+}
+
+Status HdfsSequenceTableWriter::Finalize() {
+  if (compressor_.get() == NULL) {
+    if (out_buffer_.empty()) return Status::OK;
+    return Flush();
+  }
+  if (num_block_records_ > 0) RETURN_IF_ERROR(Flush());
+  return WritePendingBlock();
+}
+
+}
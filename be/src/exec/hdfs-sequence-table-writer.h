@@ -0,0 +1,159 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_EXEC_HDFS_SEQUENCE_TABLE_WRITER_H
+#define IMPALA_EXEC_HDFS_SEQUENCE_TABLE_WRITER_H
+
+#include <hdfs.h>
+
+#include <sstream>
+#include <boost/scoped_ptr.hpp>
+
+#include "runtime/descriptors.h"
+#include "exec/hdfs-table-sink.h"
+#include "exec/hdfs-table-writer.h"
+
+namespace impala {
+
+class BlockCompressor;
+class Expr;
+class TupleRow;
+class RuntimeState;
+struct StringValue;
+struct OutputPartition;
+
+// Consumes rows and writes them as SequenceFiles, in the format read by
+// HdfsSequenceScanner (see hdfs-sequence-scanner.h for the grammar). Like Hive, each
+// row is a record with an empty BytesWritable key and a Text value that holds the
+// row as delimited text.
+// Without compression, the records are written one after the other with a sync
+// marker every SYNC_INTERVAL bytes. If the COMPRESSION_CODEC query option is set, the
+// file is block compressed: the records are buffered into blocks of about
+// COMPRESSED_BLOCK_SIZE bytes of values and each block is compressed by a
+// BlockCompressor while the next block is buffered.
+class HdfsSequenceTableWriter : public HdfsTableWriter {
+ public:
+  HdfsSequenceTableWriter(HdfsTableSink* parent,
+                          RuntimeState* state, OutputPartition* output,
+                          const HdfsPartitionDescriptor* partition,
+                          const HdfsTableDescriptor* table_desc,
+                          const std::vector<Expr*>& output_exprs);
+
+  ~HdfsSequenceTableWriter();
+
+  virtual Status Init();
+  virtual Status Finalize();
+  virtual Status InitNewFile();
+  virtual void Close();
+  virtual uint64_t default_block_size() { return 0; }
+
+  // Appends the rows in the batch as records. The records are buffered until
+  // HDFS_FLUSH_WRITE_SIZE bytes (or a full block if compressed) before being written
+  // to HDFS.
+  Status AppendRowBatch(RowBatch* batch,
+                        const std::vector<int32_t>& row_group_indices, bool* new_file);
+
+ private:
+  // The key and value class names in the file header.
+  static const char* const KEY_CLASS_NAME;
+  static const char* const VALUE_CLASS_NAME;
+
+  // Size of the sync hash and the escape that precedes it in a sync marker.
+  static const int SYNC_HASH_SIZE = 16;
+  static const int32_t SYNC_ESCAPE = -1;
+
+  // Minimum number of bytes between sync markers of uncompressed files. Same as
+  // Hadoop's SequenceFile.
+  static const int SYNC_INTERVAL = 100 * (sizeof(int32_t) + SYNC_HASH_SIZE);
+
+  // Size of the values of a compressed block.
+  static const int COMPRESSED_BLOCK_SIZE = 1024 * 1024;
+
+  // The buffers of a compressed block, in the order they are written. Each is
+  // compressed separately.
+  enum BlockBuffer {
+    KEY_LENGTHS,
+    KEYS,
+    VALUE_LENGTHS,
+    VALUES,
+    NUM_BLOCK_BUFFERS
+  };
+
+  // Writes the file header, which ends with the sync hash of the file.
+  Status WriteFileHeader();
+
+  // Appends the value of 'row', i.e. its delimited text, to row_stream_.
+  void EncodeRow(TupleRow* row);
+
+  // Escapes occurrences of field_delim_ and escape_char_ with escape_char_ and
+  // writes the escaped result into row_stream_.
+  inline void PrintEscaped(const StringValue* str_val);
+
+  // Appends a record with the value 'text' to out_buffer_, preceded by a sync marker
+  // if SYNC_INTERVAL bytes were appended since the last one.
+  void AppendRecord(const char* text, int len);
+
+  // Appends a record with the value 'text' to the buffers of the current block.
+  void AppendBlockRecord(const char* text, int len);
+
+  // Writes the buffered records to HDFS. If compressed, hands the current block to
+  // the compressor and writes the previous one.
+  Status Flush();
+
+  // Writes the block that the compressor is working on, if any, to HDFS.
+  Status WritePendingBlock();
+
+  // Writes a compressed block of 'num_records' records, preceded by a sync marker.
+  Status WriteCompressedBlock(const std::vector<StringValue>& compressed,
+      int num_records);
+
+  // Character delimiting fields (to become slots).
+  char field_delim_;
+
+  // Escape character.
+  char escape_char_;
+
+  // Sync hash of the current file.
+  uint8_t sync_[SYNC_HASH_SIZE];
+
+  // Delimited text of the rows of the current batch. Cleared for every batch to
+  // reuse its internal buffers.
+  std::stringstream row_stream_;
+
+  // End offsets of the rows in row_stream_.
+  std::vector<int> row_ends_;
+
+  // Uncompressed records that haven't been written to HDFS.
+  std::string out_buffer_;
+
+  // Number of bytes appended to the file since the last sync marker.
+  int bytes_since_sync_;
+
+  // Compresses the blocks if the COMPRESSION_CODEC query option is set, NULL
+  // otherwise.
+  boost::scoped_ptr<BlockCompressor> compressor_;
+
+  // Buffers of the current block, indexed by BlockBuffer.
+  std::vector<std::string> block_;
+
+  // Number of records in the current block.
+  int num_block_records_;
+
+  // Number of records in the block that compressor_ is working on.
+  int num_pending_records_;
+};
+
+}
+#endif
@@ -15,6 +15,8 @@
 #include "exec/hdfs-table-sink.h"
 #include "exec/hdfs-text-table-writer.h"
 #include "exec/hdfs-parquet-table-writer.h"
+#include "exec/hdfs-sequence-table-writer.h"
+#include "exec/hdfs-write-queue.h"
 #include "exec/exec-node.h"
 #include "gen-cpp/ImpalaInternalService_constants.h"
 #include "util/hdfs-util.h"
@@ -51,7 +53,10 @@ HdfsTableSink::HdfsTableSink(const RowDescriptor& row_desc,
        table_id_(tsink.table_sink.target_table_id),
        select_list_texprs_(select_list_texprs),
        partition_key_texprs_(tsink.table_sink.hdfs_table_sink.partition_key_exprs),
-       overwrite_(tsink.table_sink.hdfs_table_sink.overwrite) {
+       overwrite_(tsink.table_sink.hdfs_table_sink.overwrite),
+       input_is_clustered_(tsink.table_sink.hdfs_table_sink.__isset.input_is_clustered &&
+           tsink.table_sink.hdfs_table_sink.input_is_clustered),
+       clustered_fallback_(false) {
   DCHECK(tsink.__isset.table_sink);
   unique_id_str_ = PrintId(unique_id, "-");
 }
@@ -199,9 +204,11 @@ Status HdfsTableSink::Prepare(RuntimeState* state) {
   bytes_written_counter_ =
       ADD_COUNTER(profile(), "BytesWritten", TCounterType::BYTES);
   encode_timer_ = ADD_TIMER(profile(), "EncodeTimer");
-  hdfs_write_timer_ = ADD_TIMER(profile(), "HdfsWriteTimer");
+  open_partitions_counter_ =
+      profile()->AddHighWaterMarkCounter("MaxOpenPartitions", TCounterType::UNIT);
 
-  return Status::OK;
+  write_queue_.reset(new HdfsWriteQueue(state, state->block_mgr(), profile()));
+  return write_queue_->Init();
 }
 
 Status HdfsTableSink::Open(RuntimeState* state) {
@@ -285,6 +292,8 @@ Status HdfsTableSink::CreateNewTmpFile(RuntimeState* state,
   Status status = output_partition->writer->InitNewFile();
   if (!status.ok()) {
     ClosePartitionFile(state, output_partition);
+    // Wait for the file to be closed before deleting it.
+    write_queue_->Flush();
     hdfsDelete(hdfs_connection_, output_partition->current_file_name.c_str(), 0);
   }
   return status;
@@ -340,16 +349,23 @@ Status HdfsTableSink::InitOutputPartition(RuntimeState* state,
                                     &partition_descriptor, table_desc_, output_exprs_));
       break;
     }
+    case THdfsFileFormat::SEQUENCE_FILE: {
+      output_partition->writer.reset(
+          new HdfsSequenceTableWriter(this, state, output_partition,
+                                      &partition_descriptor, table_desc_, output_exprs_));
+      break;
+    }
     default:
       stringstream error_msg;
       map<int, const char*>::const_iterator i =
           _THdfsFileFormat_VALUES_TO_NAMES.find(partition_descriptor.file_format());
       if (i != _THdfsFileFormat_VALUES_TO_NAMES.end()) {
         error_msg << "Cannot write to table with format " << i->second << ". "
-                  << "Impala only supports writing to TEXT and PARQUET tables.";
+                  << "Impala only supports writing to TEXT, SEQUENCE_FILE and PARQUET "
+                  << "tables.";
       } else {
-        error_msg << "Cannot write to table. Impala only supports writing to TEXT"
-                  << " and PARQUET tables. (Unknown file format: "
+        error_msg << "Cannot write to table. Impala only supports writing to TEXT,"
+                  << " SEQUENCE_FILE and PARQUET tables. (Unknown file format: "
                   << partition_descriptor.file_format() << ")";
       }
       return Status(error_msg.str());
@@ -394,11 +410,13 @@ inline Status HdfsTableSink::GetOutputPartition(
     }
 
     // Save the partition name so that the coordinator can create partition
-    // directory structure if needed
+    // directory structure if needed. A clustered insert opens a partition again if its
+    // key shows up again.
     if (overwrite_) {
-      DCHECK(state->num_appended_rows()->find(partition->partition_name) ==
+      DCHECK(input_is_clustered_ ||
+          state->num_appended_rows()->find(partition->partition_name) ==
           state->num_appended_rows()->end());
-      (*state->num_appended_rows())[partition->partition_name] = 0L;
+      state->num_appended_rows()->insert(make_pair(partition->partition_name, 0L));
     }
 
     // Indicate that temporary directory is to be deleted after execution
@@ -406,6 +424,7 @@ inline Status HdfsTableSink::GetOutputPartition(
 
     partition_keys_to_output_partitions_[key].first = partition;
     *partition_pair = &partition_keys_to_output_partitions_[key];
+    open_partitions_counter_->Update(1);
   } else {
     // Use existing output_partition partition.
     *partition_pair = &existing_partition->second;
@@ -421,45 +440,11 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch, bool eos) {
     // If there are no dynamic keys just use an empty key.
     PartitionPair* partition_pair;
     RETURN_IF_ERROR(GetOutputPartition(state, "", &partition_pair));
-    // Pass the row batch to the writer. If new_file is returned true then the current
-    // file is finalized and a new file is opened.
-    // The writer tracks where it is in the batch when it returns with new_file set.
-    OutputPartition* output_partition = partition_pair->first;
-    bool new_file;
-    do {
-      RETURN_IF_ERROR(output_partition->writer->AppendRowBatch(
-              batch, partition_pair->second, &new_file));
-      if (new_file) {
-        RETURN_IF_ERROR(FinalizePartitionFile(state, output_partition));
-        RETURN_IF_ERROR(CreateNewTmpFile(state, output_partition));
-      }
-    } while (new_file);
+    RETURN_IF_ERROR(WriteRowsToPartition(state, batch, partition_pair));
+  } else if (input_is_clustered_ && !clustered_fallback_) {
+    RETURN_IF_ERROR(SendClustered(state, batch));
   } else {
-    for (int i = 0; i < batch->num_rows(); ++i) {
-      current_row_ = batch->GetRow(i);
-
-      string key;
-      GetHashTblKey(dynamic_partition_key_exprs_, &key);
-      PartitionPair* partition_pair = NULL;
-      RETURN_IF_ERROR(GetOutputPartition(state, key, &partition_pair));
-      partition_pair->second.push_back(i);
-    }
-    for (PartitionMap::iterator partition = partition_keys_to_output_partitions_.begin();
-         partition != partition_keys_to_output_partitions_.end(); ++partition) {
-      OutputPartition* output_partition = partition->second.first;
-      if (partition->second.second.empty()) continue;
-
-      bool new_file;
-      do {
-        RETURN_IF_ERROR(output_partition->writer->AppendRowBatch(
-                batch, partition->second.second, &new_file));
-        if (new_file) {
-          RETURN_IF_ERROR(FinalizePartitionFile(state, output_partition));
-          RETURN_IF_ERROR(CreateNewTmpFile(state, output_partition));
-        }
-      } while (new_file);
-      partition->second.second.clear();
-    }
+    RETURN_IF_ERROR(SendUnclustered(state, batch, 0));
   }
 
   if (eos) {
@@ -470,6 +455,93 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch, bool eos) {
         ++cur_partition) {
       RETURN_IF_ERROR(FinalizePartitionFile(state, cur_partition->second.first));
     }
+    // All files must be written and closed before the coordinator moves them.
+    RETURN_IF_ERROR(write_queue_->Flush());
+  }
+  return Status::OK;
+}
+
+Status HdfsTableSink::WriteRowsToPartition(RuntimeState* state, RowBatch* batch,
+    PartitionPair* partition_pair) {
+  // Pass the row batch to the writer. If new_file is returned true then the current
+  // file is finalized and a new file is opened.
+  // The writer tracks where it is in the batch when it returns with new_file set.
+  OutputPartition* output_partition = partition_pair->first;
+  bool new_file;
+  do {
+    RETURN_IF_ERROR(output_partition->writer->AppendRowBatch(
+            batch, partition_pair->second, &new_file));
+    if (new_file) {
+      RETURN_IF_ERROR(FinalizePartitionFile(state, output_partition));
+      RETURN_IF_ERROR(CreateNewTmpFile(state, output_partition));
+    }
+  } while (new_file);
+  partition_pair->second.clear();
+  return Status::OK;
+}
+
+Status HdfsTableSink::SendClustered(RuntimeState* state, RowBatch* batch) {
+  PartitionPair* partition_pair = NULL;
+  if (!current_clustered_key_.empty()) {
+    partition_pair = &partition_keys_to_output_partitions_[current_clustered_key_];
+  }
+  string key;
+  for (int i = 0; i < batch->num_rows(); ++i) {
+    current_row_ = batch->GetRow(i);
+    GetHashTblKey(dynamic_partition_key_exprs_, &key);
+    if (partition_pair == NULL || key != current_clustered_key_) {
+      if (closed_clustered_keys_.find(key) != closed_clustered_keys_.end()) {
+        // The input is not grouped by partition key. Closing a partition on every key
+        // change would write a file per run of rows, so keep all partitions open from
+        // now on.
+        LOG(WARNING) << "Input of clustered insert into table " << table_desc_->name()
+                     << " is not grouped by partition key. Keeping all partitions open.";
+        runtime_profile_->AddInfoString("ClusteredFallback", "true");
+        clustered_fallback_ = true;
+        if (partition_pair != NULL) {
+          RETURN_IF_ERROR(WriteRowsToPartition(state, batch, partition_pair));
+        }
+        return SendUnclustered(state, batch, i);
+      }
+      if (partition_pair != NULL) {
+        // The key changed: write the rows of the previous partition and close it.
+        OutputPartition* output_partition = partition_pair->first;
+        RETURN_IF_ERROR(WriteRowsToPartition(state, batch, partition_pair));
+        RETURN_IF_ERROR(FinalizePartitionFile(state, output_partition));
+        output_partition->writer->Close();
+        // Free the writer's buffers now rather than when the sink is closed.
+        output_partition->writer.reset();
+        partition_keys_to_output_partitions_.erase(current_clustered_key_);
+        closed_clustered_keys_.insert(current_clustered_key_);
+        open_partitions_counter_->Update(-1);
+      }
+      RETURN_IF_ERROR(GetOutputPartition(state, key, &partition_pair));
+      current_clustered_key_ = key;
+    }
+    partition_pair->second.push_back(i);
+  }
+  // The current partition stays open for the next batch.
+  if (partition_pair != NULL) {
+    RETURN_IF_ERROR(WriteRowsToPartition(state, batch, partition_pair));
+  }
+  return Status::OK;
+}
+
+Status HdfsTableSink::SendUnclustered(RuntimeState* state, RowBatch* batch,
+    int start_row) {
+  for (int i = start_row; i < batch->num_rows(); ++i) {
+    current_row_ = batch->GetRow(i);
+
+    string key;
+    GetHashTblKey(dynamic_partition_key_exprs_, &key);
+    PartitionPair* partition_pair = NULL;
+    RETURN_IF_ERROR(GetOutputPartition(state, key, &partition_pair));
+    partition_pair->second.push_back(i);
+  }
+  for (PartitionMap::iterator partition = partition_keys_to_output_partitions_.begin();
+       partition != partition_keys_to_output_partitions_.end(); ++partition) {
+    if (partition->second.second.empty()) continue;
+    RETURN_IF_ERROR(WriteRowsToPartition(state, batch, &partition->second));
   }
   return Status::OK;
 }
@@ -493,11 +565,8 @@ Status HdfsTableSink::FinalizePartitionFile(RuntimeState* state,
 
 void HdfsTableSink::ClosePartitionFile(RuntimeState* state, OutputPartition* partition) {
   if (partition->tmp_hdfs_file == NULL) return;
-  int hdfs_ret = hdfsCloseFile(hdfs_connection_, partition->tmp_hdfs_file);
-  if (hdfs_ret != 0) {
-    state->LogError(GetHdfsErrorMsg("Failed to close HDFS file: ",
-        partition->current_file_name));
-  }
+  // The file is closed once the data written to it so far is in HDFS.
+  write_queue_->CloseFile(partition);
   partition->tmp_hdfs_file = NULL;
   ImpaladMetrics::NUM_FILES_OPEN_FOR_INSERT->Increment(-1);
 }
@@ -513,6 +582,8 @@ void HdfsTableSink::Close(RuntimeState* state) {
     ClosePartitionFile(state, cur_partition->second.first);
   }
   partition_keys_to_output_partitions_.clear();
+  // Waits for the files to be closed, discarding any data that wasn't written.
+  if (write_queue_.get() != NULL) write_queue_->Close();
   Expr::Close(output_exprs_, state);
   Expr::Close(partition_key_exprs_, state);
   closed_ = true;
@@ -18,6 +18,7 @@
 
 #include <hdfs.h>
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 #include <boost/scoped_ptr.hpp>
 
 // needed for scoped_ptr to work on ObjectPool
@@ -33,6 +34,7 @@ class TupleDescriptor;
 class TupleRow;
 class RuntimeState;
 class HdfsTableWriter;
+class HdfsWriteQueue;
 class MemTracker;
 
 // Records the temporary and final Hdfs file name, the opened temporary Hdfs file, and the
@@ -107,6 +109,15 @@ struct OutputPartition {
 // A map of opened Hdfs files (corresponding to partitions) is maintained.
 // Each row may belong to different partition than the one before it.
 //
+// Clustered inserts:
+// Each open partition buffers data in its writer (e.g. a whole row group per column for
+// Parquet), so inserts into many partitions need a lot of memory. If the planner
+// indicates that the input is grouped by partition key (input_is_clustered), only the
+// partition of the current key is kept open and its file is finalized as soon as the key
+// changes. If a key shows up again anyway, the input was not grouped after all: a new
+// file is started for that partition and the sink falls back to keeping all partitions
+// open for the rest of the input, so that it does not end up writing many tiny files.
+//
 // Failure behavior:
 // In Exec() all data is written to Hdfs files in a temporary directory.
 // In Close() all temporary Hdfs files are moved to their final locations,
@@ -151,7 +162,8 @@ class HdfsTableSink : public DataSink {
   RuntimeProfile::Counter* rows_inserted_counter() { return rows_inserted_counter_; }
   RuntimeProfile::Counter* bytes_written_counter() { return bytes_written_counter_; }
   RuntimeProfile::Counter* encode_timer() { return encode_timer_; }
-  RuntimeProfile::Counter* hdfs_write_timer() { return hdfs_write_timer_; }
+
+  HdfsWriteQueue* write_queue() { return write_queue_.get(); }
 
   std::string DebugString() const;
 
@@ -196,6 +208,19 @@ class HdfsTableSink : public DataSink {
   void BuildHdfsFileNames(const HdfsPartitionDescriptor& partition_descriptor,
       OutputPartition* output);
 
+  // Appends the rows of 'batch' in partition_pair->second to the partition's files,
+  // starting new files as the writer requests them, and clears the rows.
+  Status WriteRowsToPartition(RuntimeState* state, RowBatch* batch,
+      PartitionPair* partition_pair);
+
+  // Send() for clustered inserts with dynamic partition keys. Keeps only the partition
+  // of the current key open. Switches to SendUnclustered() when a key reappears.
+  Status SendClustered(RuntimeState* state, RowBatch* batch);
+
+  // Send() for dynamic partition keys without clustering, starting at row 'start_row'
+  // of 'batch'. All partitions stay open until eos.
+  Status SendUnclustered(RuntimeState* state, RowBatch* batch, int start_row);
+
   // Updates runtime stats of HDFS with rows written, then closes the file associated with
   // the partition by calling ClosePartitionFile()
   Status FinalizePartitionFile(RuntimeState* state, OutputPartition* partition);
@@ -238,6 +263,19 @@ class HdfsTableSink : public DataSink {
   // Indicates whether the existing partitions should be overwritten.
   bool overwrite_;
 
+  // True if the input rows are grouped by partition key. See class comment.
+  bool input_is_clustered_;
+
+  // Key of the only open partition in clustered mode. Empty if no partition is open.
+  std::string current_clustered_key_;
+
+  // Keys of the partitions closed in clustered mode.
+  boost::unordered_set<std::string> closed_clustered_keys_;
+
+  // True once a closed key reappeared in clustered mode. From then on, the input is
+  // treated as unclustered.
+  bool clustered_fallback_;
+
   // The directory in which to write intermediate results. Set to
   // <hdfs_table_base_dir>/.impala_insert_staging/ during Prepare()
   std::string staging_dir_;
@@ -267,6 +305,10 @@ class HdfsTableSink : public DataSink {
 
   boost::scoped_ptr<MemTracker> mem_tracker_;
 
+  // Writes the output of the table writers to HDFS in the background and closes their
+  // files. Declared after mem_tracker_, which it uses until it is destroyed.
+  boost::scoped_ptr<HdfsWriteQueue> write_queue_;
+
   // Allocated from runtime state's pool.
   RuntimeProfile* runtime_profile_;
   RuntimeProfile::Counter* rows_inserted_counter_;
@@ -274,8 +316,9 @@ class HdfsTableSink : public DataSink {
 
   // Time spent converting tuple to on disk format.
   RuntimeProfile::Counter* encode_timer_;
-  // Time spent writing to hdfs
-  RuntimeProfile::Counter* hdfs_write_timer_;
+
+  // Number of partitions with an open writer. The value of the counter is the maximum.
+  RuntimeProfile::HighWaterMarkCounter* open_partitions_counter_;
 };
 }
 #endif
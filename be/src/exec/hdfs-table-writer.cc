@@ -14,6 +14,9 @@
 
 #include "exec/hdfs-table-writer.h"
 
+#include "exec/hdfs-write-queue.h"
+#include "runtime/runtime-state.h"
+
 using namespace std;
 
 namespace impala {
@@ -30,17 +33,17 @@ HdfsTableWriter::HdfsTableWriter(HdfsTableSink* parent,
     output_exprs_(output_exprs) {
 }
 
-Status HdfsTableWriter::Write(const uint8_t* data, int32_t len) {
-  DCHECK_GE(len, 0);
-  int ret = hdfsWrite(output_->hdfs_connection, output_->tmp_hdfs_file, data, len);
-  if (ret == -1) {
-    string error_msg = GetHdfsErrorMsg("");
-    stringstream msg;
-    msg << "Failed to write row (length: " << len
-        << ") to Hdfs file: " << output_->current_file_name
-        << " " << error_msg;
-    return Status(msg.str());
+THdfsCompression::type HdfsTableWriter::GetHadoopCompressionCodec() const {
+  const TQueryOptions& query_options = state_->query_options();
+  if (!query_options.__isset.compression_codec) return THdfsCompression::NONE;
+  if (query_options.compression_codec == THdfsCompression::SNAPPY) {
+    return THdfsCompression::SNAPPY_BLOCKED;
   }
+  return query_options.compression_codec;
+}
+
+Status HdfsTableWriter::Write(const uint8_t* data, int32_t len) {
+  RETURN_IF_ERROR(parent_->write_queue()->Write(output_, data, len));
   COUNTER_UPDATE(parent_->bytes_written_counter(), len);
   stats_.bytes_written += len;
   return Status::OK;
@@ -90,11 +90,12 @@ class HdfsTableWriter {
   virtual uint64_t default_block_size() = 0;
 
  protected:
-  // Size to buffer output before calling Write() (which calls hdfsWrite), in bytes
-  // to minimize the overhead of Write()
+  // Size to buffer output before calling Write(), in bytes to minimize the overhead of
+  // Write()
   static const int HDFS_FLUSH_WRITE_SIZE = 50 * 1024;
 
-  // Write to the current hdfs file.
+  // Write to the current hdfs file. The data is copied and written to HDFS
+  // asynchronously by the sink's HdfsWriteQueue.
   Status Write(const char* data, int32_t len) {
     return Write(reinterpret_cast<const uint8_t*>(data), len);
   }
@@ -105,6 +106,11 @@ class HdfsTableWriter {
     return Write(reinterpret_cast<uint8_t*>(&v), sizeof(T));
   }
 
+  // Returns the codec set by the COMPRESSION_CODEC query option, for file formats that
+  // use Hadoop's codecs. Snappy is returned as SNAPPY_BLOCKED, the block format of
+  // Hadoop's SnappyCodec.
+  THdfsCompression::type GetHadoopCompressionCodec() const;
+
   // Parent table sink object
   HdfsTableSink* parent_;
 
@@ -47,6 +47,15 @@ HdfsTextTableWriter::HdfsTextTableWriter(HdfsTableSink* parent,
   rowbatch_stringstream_.precision(RawValue::ASCII_PRECISION);
 }
 
+Status HdfsTextTableWriter::Init() {
+  // Impala can't scan compressed text files (other than LZO), so don't write any.
+  if (GetHadoopCompressionCodec() != THdfsCompression::NONE) {
+    return Status("Writing compressed text files is not supported. Set "
+        "COMPRESSION_CODEC to 'none' to insert into TEXT tables.");
+  }
+  return Status::OK;
+}
+
 Status HdfsTableWriter::Init() {
   parent_->mem_tracker()->Consume(HDFS_FLUSH_WRITE_SIZE);
   return Status::OK;
@@ -108,7 +117,6 @@ Status HdfsTextTableWriter::AppendRowBatch(RowBatch* batch,
 
   if (rowbatch_stringstream_.tellp() >= HDFS_FLUSH_WRITE_SIZE) {
     string rowbatch_string = rowbatch_stringstream_.str();
-    SCOPED_TIMER(parent_->hdfs_write_timer());
     RETURN_IF_ERROR(Write(rowbatch_string.data(), rowbatch_string.size()));
     rowbatch_stringstream_.str(string());
   }
@@ -120,7 +128,6 @@ Status HdfsTextTableWriter::AppendRowBatch(RowBatch* batch,
 Status HdfsTextTableWriter::Finalize() {
   // Write the remaining buffered bytes to hdfs.
   string rowbatch_string = rowbatch_stringstream_.str();
-  SCOPED_TIMER(parent_->hdfs_write_timer());
   RETURN_IF_ERROR(Write(rowbatch_string.data(), rowbatch_string.size()));
   rowbatch_stringstream_.str(string());
   return Status::OK;
@@ -45,8 +45,8 @@ class HdfsTextTableWriter : public HdfsTableWriter {
 
   ~HdfsTextTableWriter() { }
 
-  // There is nothing to do for text.
-  virtual Status Init() { return Status::OK; }
+  // Returns an error if the COMPRESSION_CODEC query option is set.
+  virtual Status Init();
   virtual Status Finalize();
   virtual Status InitNewFile() { return Status::OK; }
   virtual void Close() { }
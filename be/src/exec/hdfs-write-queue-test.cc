@@ -0,0 +1,295 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "common/object-pool.h"
+#include "exec/hdfs-table-sink.h"
+#include "exec/hdfs-write-queue.h"
+#include "runtime/buffered-block-mgr.h"
+#include "runtime/mem-tracker.h"
+#include "util/cpu-info.h"
+#include "util/runtime-profile.h"
+#include "util/thread.h"
+#include "util/time.h"
+
+DECLARE_int32(hdfs_sink_max_queued_write_bytes);
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+// Write queue that records writes and closes in memory instead of doing them in HDFS.
+// Writes can be blocked and made to fail.
+class TestWriteQueue : public HdfsWriteQueue {
+ public:
+  TestWriteQueue(BufferedBlockMgr* block_mgr, RuntimeProfile* profile)
+    : HdfsWriteQueue(NULL, block_mgr, profile), blocked_(false), fail_writes_(false) {
+  }
+
+  // The writer thread calls the overridden functions, so it must be stopped before this
+  // object is destroyed.
+  virtual ~TestWriteQueue() { Close(); }
+
+  void set_blocked(bool blocked) {
+    lock_guard<mutex> l(test_lock_);
+    blocked_ = blocked;
+    blocked_cv_.notify_all();
+  }
+
+  void set_fail_writes(bool fail_writes) {
+    lock_guard<mutex> l(test_lock_);
+    fail_writes_ = fail_writes;
+  }
+
+  // Returns the writes and closes done so far, e.g. "write f1", "close f1".
+  vector<string> ops() {
+    lock_guard<mutex> l(test_lock_);
+    return ops_;
+  }
+
+  // Returns the data written to 'file_name'.
+  string data(const string& file_name) {
+    lock_guard<mutex> l(test_lock_);
+    return data_[file_name];
+  }
+
+ protected:
+  virtual Status WriteToHdfs(hdfsFS hdfs_connection, hdfsFile hdfs_file,
+      const string& file_name, const uint8_t* data, int32_t len) {
+    unique_lock<mutex> l(test_lock_);
+    while (blocked_) blocked_cv_.wait(l);
+    if (fail_writes_) return Status("Test write failure");
+    data_[file_name].append(reinterpret_cast<const char*>(data), len);
+    ops_.push_back("write " + file_name);
+    return Status::OK;
+  }
+
+  virtual void CloseHdfsFile(hdfsFS hdfs_connection, hdfsFile hdfs_file,
+      const string& file_name) {
+    lock_guard<mutex> l(test_lock_);
+    ops_.push_back("close " + file_name);
+  }
+
+ private:
+  mutex test_lock_;
+  condition_variable blocked_cv_;
+  bool blocked_;
+  bool fail_writes_;
+  vector<string> ops_;
+  map<string, string> data_;
+};
+
+class HdfsWriteQueueTest : public testing::Test {
+ protected:
+  static const int BLOCK_SIZE = 1024;
+
+  HdfsWriteQueueTest()
+    : profile_(&pool_, "HdfsWriteQueueTest"),
+      block_mgr_(&mem_tracker_, 16 * BLOCK_SIZE, BLOCK_SIZE) {
+    InitPartition("f1", 1, &partition1_);
+    InitPartition("f2", 2, &partition2_);
+  }
+
+  virtual void TearDown() {
+    FLAGS_hdfs_sink_max_queued_write_bytes = 16 * 1024 * 1024;
+  }
+
+  // Sets up 'partition' to write to a fake file that TestWriteQueue knows as
+  // 'file_name'.
+  static void InitPartition(const string& file_name, intptr_t file_id,
+      OutputPartition* partition) {
+    partition->current_file_name = file_name;
+    partition->hdfs_connection = NULL;
+    partition->tmp_hdfs_file = reinterpret_cast<hdfsFile>(file_id);
+  }
+
+  static Status Write(HdfsWriteQueue* queue, OutputPartition* partition,
+      const string& data) {
+    return queue->Write(partition, reinterpret_cast<const uint8_t*>(data.data()),
+        data.size());
+  }
+
+  static void WriteAsync(HdfsWriteQueue* queue, OutputPartition* partition,
+      const string* data, Status* status) {
+    *status = Write(queue, partition, *data);
+  }
+
+  static void UnblockAfterDelay(TestWriteQueue* queue) {
+    SleepForMs(100);
+    queue->set_blocked(false);
+  }
+
+  static vector<string> Ops(const char* op1, const char* op2 = NULL,
+      const char* op3 = NULL, const char* op4 = NULL, const char* op5 = NULL) {
+    const char* ops[] = { op1, op2, op3, op4, op5 };
+    vector<string> result;
+    for (int i = 0; i < 5 && ops[i] != NULL; ++i) result.push_back(ops[i]);
+    return result;
+  }
+
+  ObjectPool pool_;
+  RuntimeProfile profile_;
+  MemTracker mem_tracker_;
+  BufferedBlockMgr block_mgr_;
+  OutputPartition partition1_;
+  OutputPartition partition2_;
+};
+
+// Without a writer thread, data is written and files are closed by the caller.
+TEST_F(HdfsWriteQueueTest, Synchronous) {
+  FLAGS_hdfs_sink_max_queued_write_bytes = 0;
+  TestWriteQueue queue(&block_mgr_, &profile_);
+  EXPECT_TRUE(queue.Init().ok());
+
+  EXPECT_TRUE(Write(&queue, &partition1_, "ab").ok());
+  EXPECT_EQ(queue.ops(), Ops("write f1"));
+  queue.set_fail_writes(true);
+  // The error is returned right away.
+  EXPECT_FALSE(Write(&queue, &partition1_, "cd").ok());
+  queue.CloseFile(&partition1_);
+  EXPECT_EQ(queue.ops(), Ops("write f1", "close f1"));
+  EXPECT_TRUE(queue.Flush().ok());
+  queue.Close();
+  EXPECT_EQ(queue.data("f1"), "ab");
+  EXPECT_EQ(mem_tracker_.consumption(), 0);
+}
+
+// Writes and closes of several files are done in the order they were queued.
+TEST_F(HdfsWriteQueueTest, Ordering) {
+  TestWriteQueue queue(&block_mgr_, &profile_);
+  EXPECT_TRUE(queue.Init().ok());
+  // The reserved buffers are allocated right away.
+  EXPECT_EQ(mem_tracker_.consumption(), 2 * BLOCK_SIZE);
+
+  EXPECT_TRUE(Write(&queue, &partition1_, "ab").ok());
+  EXPECT_TRUE(Write(&queue, &partition2_, "cd").ok());
+  EXPECT_TRUE(Write(&queue, &partition1_, "ef").ok());
+  queue.CloseFile(&partition1_);
+  queue.CloseFile(&partition2_);
+  EXPECT_TRUE(queue.Flush().ok());
+  EXPECT_EQ(queue.ops(), Ops("write f1", "write f2", "write f1", "close f1", "close f2"));
+  EXPECT_EQ(queue.data("f1"), "abef");
+  EXPECT_EQ(queue.data("f2"), "cd");
+  queue.Close();
+  EXPECT_EQ(mem_tracker_.consumption(), 0);
+}
+
+// Once all buffers are in use, writes wait for the writer thread to free one.
+TEST_F(HdfsWriteQueueTest, Backpressure) {
+  FLAGS_hdfs_sink_max_queued_write_bytes = 2 * BLOCK_SIZE;
+  TestWriteQueue queue(&block_mgr_, &profile_);
+  EXPECT_TRUE(queue.Init().ok());
+  queue.set_blocked(true);
+
+  // The writer thread blocks writing the first buffer, the second one is queued.
+  string data(BLOCK_SIZE, 'x');
+  EXPECT_TRUE(Write(&queue, &partition1_, data).ok());
+  EXPECT_TRUE(Write(&queue, &partition1_, data).ok());
+  // There is no buffer left for the third write.
+  Status status;
+  thread writer(&HdfsWriteQueueTest::WriteAsync, &queue, &partition1_, &data, &status);
+  EXPECT_FALSE(writer.timed_join(posix_time::milliseconds(100)));
+
+  queue.set_blocked(false);
+  writer.join();
+  EXPECT_TRUE(status.ok());
+  queue.CloseFile(&partition1_);
+  EXPECT_TRUE(queue.Flush().ok());
+  EXPECT_EQ(queue.data("f1").size(), 3 * BLOCK_SIZE);
+  EXPECT_EQ(queue.ops().back(), "close f1");
+}
+
+// Writes larger than a buffer are split across several buffers.
+TEST_F(HdfsWriteQueueTest, LargeWrite) {
+  TestWriteQueue queue(&block_mgr_, &profile_);
+  EXPECT_TRUE(queue.Init().ok());
+
+  string data;
+  for (int i = 0; i < 5 * BLOCK_SIZE / 2; ++i) data.push_back('a' + i % 26);
+  EXPECT_TRUE(Write(&queue, &partition1_, data).ok());
+  queue.CloseFile(&partition1_);
+  EXPECT_TRUE(queue.Flush().ok());
+  EXPECT_EQ(queue.ops(), Ops("write f1", "write f1", "write f1", "close f1"));
+  EXPECT_EQ(queue.data("f1"), data);
+  queue.Close();
+  EXPECT_EQ(mem_tracker_.consumption(), 0);
+}
+
+// Init() fails if the block mgr can't reserve the buffers.
+TEST_F(HdfsWriteQueueTest, ReservationFails) {
+  BufferedBlockMgr block_mgr(&mem_tracker_, BLOCK_SIZE, BLOCK_SIZE);
+  TestWriteQueue queue(&block_mgr, &profile_);
+  EXPECT_FALSE(queue.Init().ok());
+  queue.Close();
+  EXPECT_EQ(mem_tracker_.consumption(), 0);
+}
+
+// Errors of the writer thread are returned by later calls. Files are still closed, but
+// no more data is written.
+TEST_F(HdfsWriteQueueTest, WriteError) {
+  TestWriteQueue queue(&block_mgr_, &profile_);
+  EXPECT_TRUE(queue.Init().ok());
+  queue.set_fail_writes(true);
+
+  EXPECT_TRUE(Write(&queue, &partition1_, "ab").ok());
+  queue.CloseFile(&partition1_);
+  EXPECT_FALSE(queue.Flush().ok());
+
+  queue.set_fail_writes(false);
+  // The error is returned when the next buffer is started.
+  EXPECT_FALSE(Write(&queue, &partition2_, "cd").ok());
+  queue.CloseFile(&partition2_);
+  EXPECT_FALSE(queue.Flush().ok());
+  EXPECT_EQ(queue.ops(), Ops("close f1", "close f2"));
+  queue.Close();
+  EXPECT_EQ(mem_tracker_.consumption(), 0);
+}
+
+// Close() discards data that wasn't written yet, but closes the files that were passed
+// to CloseFile(), after the data that was written to them.
+TEST_F(HdfsWriteQueueTest, CloseDiscardsData) {
+  TestWriteQueue queue(&block_mgr_, &profile_);
+  EXPECT_TRUE(queue.Init().ok());
+  queue.set_blocked(true);
+
+  // The writer thread blocks writing f1, f2 is queued.
+  EXPECT_TRUE(Write(&queue, &partition1_, "ab").ok());
+  queue.CloseFile(&partition1_);
+  EXPECT_TRUE(Write(&queue, &partition2_, "cd").ok());
+  queue.CloseFile(&partition2_);
+
+  // Unblock the writer thread after Close() has told it to stop.
+  thread unblocker(&HdfsWriteQueueTest::UnblockAfterDelay, &queue);
+  queue.Close();
+  unblocker.join();
+  EXPECT_EQ(queue.ops(), Ops("write f1", "close f1", "close f2"));
+  EXPECT_EQ(mem_tracker_.consumption(), 0);
+}
+
+}
+
+int main(int argc, char **argv) {
+  google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  impala::InitThreading();
+  return RUN_ALL_TESTS();
+}
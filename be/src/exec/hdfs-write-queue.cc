@@ -0,0 +1,258 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exec/hdfs-write-queue.h"
+
+#include <sstream>
+#include <gflags/gflags.h>
+
+#include "common/logging.h"
+#include "exec/hdfs-table-sink.h"
+#include "runtime/runtime-state.h"
+#include "util/hdfs-util.h"
+#include "util/stopwatch.h"
+#include "util/thread.h"
+
+using namespace boost;
+using namespace std;
+
+DEFINE_int32(hdfs_sink_max_queued_write_bytes, 16 * 1024 * 1024,
+    "(Advanced) Maximum number of bytes an HDFS table sink buffers for its background "
+    "writer thread. If 0, table sinks write to HDFS on the fragment thread.");
+
+namespace impala {
+
+HdfsWriteQueue::HdfsWriteQueue(RuntimeState* state, BufferedBlockMgr* block_mgr,
+    RuntimeProfile* profile)
+  : state_(state),
+    block_mgr_(block_mgr),
+    client_(NULL),
+    max_buffers_(0),
+    num_buffers_(0),
+    current_(NULL),
+    shutdown_(false) {
+  write_timer_ = ADD_TIMER(profile, "HdfsWriteTimer");
+  write_wait_timer_ = ADD_TIMER(profile, "HdfsWriteWaitTimer");
+  if (FLAGS_hdfs_sink_max_queued_write_bytes > 0) {
+    max_buffers_ = max<int64_t>(MIN_BUFFERS,
+        FLAGS_hdfs_sink_max_queued_write_bytes / block_mgr_->block_size());
+  }
+}
+
+HdfsWriteQueue::~HdfsWriteQueue() {
+  Close();
+}
+
+Status HdfsWriteQueue::Init() {
+  DCHECK(writer_thread_.get() == NULL);
+  if (max_buffers_ == 0) return Status::OK;
+  RETURN_IF_ERROR(block_mgr_->RegisterClient(MIN_BUFFERS, "HDFS write queue", &client_));
+  // Get the reserved blocks up front, so that there is always a buffer to wait for.
+  for (int i = 0; i < MIN_BUFFERS; ++i) {
+    BufferedBlockMgr::Block* block;
+    RETURN_IF_ERROR(block_mgr_->GetNewBlock(client_, &block));
+    DCHECK(block != NULL);
+    Buffer* buffer = buffer_pool_.Add(new Buffer());
+    buffer->block = block;
+    free_buffers_.push_back(buffer);
+    ++num_buffers_;
+  }
+  writer_thread_.reset(
+      new Thread("hdfs-table-sink", "hdfs-writer", &HdfsWriteQueue::WriterLoop, this));
+  return Status::OK;
+}
+
+Status HdfsWriteQueue::Write(OutputPartition* partition, const uint8_t* data,
+    int32_t len) {
+  DCHECK_GE(len, 0);
+  if (writer_thread_.get() == NULL) {
+    SCOPED_TIMER(write_timer_);
+    return WriteToHdfs(partition->hdfs_connection, partition->tmp_hdfs_file,
+        partition->current_file_name, data, len);
+  }
+  // Writes that don't fit into the current buffer are split across several buffers.
+  do {
+    if (current_ != NULL && (current_->hdfs_file != partition->tmp_hdfs_file ||
+        current_->block->BytesRemaining() == 0)) {
+      EnqueueCurrentBuffer();
+    }
+    if (current_ == NULL) {
+      GetBuffer(partition);
+      // Errors of earlier writes are returned whenever a new buffer is started.
+      lock_guard<mutex> l(lock_);
+      RETURN_IF_ERROR(status_);
+    }
+    int32_t bytes = min<int64_t>(len, current_->block->BytesRemaining());
+    memcpy(current_->block->Allocate<uint8_t>(bytes), data, bytes);
+    data += bytes;
+    len -= bytes;
+  } while (len > 0);
+  return Status::OK;
+}
+
+void HdfsWriteQueue::CloseFile(OutputPartition* partition) {
+  if (writer_thread_.get() == NULL) {
+    CloseHdfsFile(partition->hdfs_connection, partition->tmp_hdfs_file,
+        partition->current_file_name);
+    return;
+  }
+  if (current_ != NULL && current_->hdfs_file != partition->tmp_hdfs_file) {
+    EnqueueCurrentBuffer();
+  }
+  if (current_ == NULL) GetBuffer(partition);
+  current_->close_file = true;
+  EnqueueCurrentBuffer();
+}
+
+Status HdfsWriteQueue::Flush() {
+  if (writer_thread_.get() == NULL) return Status::OK;
+  if (current_ != NULL) EnqueueCurrentBuffer();
+  SCOPED_TIMER(write_wait_timer_);
+  unique_lock<mutex> l(lock_);
+  while (free_buffers_.size() < num_buffers_) free_cv_.wait(l);
+  return status_;
+}
+
+void HdfsWriteQueue::Close() {
+  if (writer_thread_.get() != NULL) {
+    {
+      lock_guard<mutex> l(lock_);
+      shutdown_ = true;
+    }
+    queue_cv_.notify_one();
+    writer_thread_->Join();
+    writer_thread_.reset();
+  }
+  DCHECK(queue_.empty());
+  // The writer thread has stopped, so free_buffers_ can be modified without lock_. The
+  // current buffer can't hold a file to close, CloseFile() always queues it.
+  if (current_ != NULL) {
+    DCHECK(!current_->close_file);
+    free_buffers_.push_back(current_);
+    current_ = NULL;
+  }
+  if (client_ == NULL) return;
+  DCHECK_EQ(static_cast<int>(free_buffers_.size()), num_buffers_);
+  for (int i = 0; i < free_buffers_.size(); ++i) {
+    free_buffers_[i]->block->Delete();
+  }
+  free_buffers_.clear();
+  num_buffers_ = 0;
+  block_mgr_->UnregisterClient(client_);
+  client_ = NULL;
+}
+
+void HdfsWriteQueue::GetBuffer(OutputPartition* partition) {
+  DCHECK(current_ == NULL);
+  bool get_new_block;
+  {
+    lock_guard<mutex> l(lock_);
+    get_new_block = free_buffers_.empty() && num_buffers_ < max_buffers_;
+  }
+  if (get_new_block) {
+    BufferedBlockMgr::Block* block;
+    Status status = block_mgr_->GetNewBlock(client_, &block);
+    if (!status.ok()) {
+      lock_guard<mutex> l(lock_);
+      if (status_.ok()) status_ = status;
+    } else if (block != NULL) {
+      current_ = buffer_pool_.Add(new Buffer());
+      current_->block = block;
+      ++num_buffers_;
+    }
+  }
+  if (current_ == NULL) {
+    SCOPED_TIMER(write_wait_timer_);
+    unique_lock<mutex> l(lock_);
+    while (free_buffers_.empty()) free_cv_.wait(l);
+    current_ = free_buffers_.back();
+    free_buffers_.pop_back();
+  }
+  current_->hdfs_connection = partition->hdfs_connection;
+  current_->hdfs_file = partition->tmp_hdfs_file;
+  current_->file_name = partition->current_file_name;
+  current_->close_file = false;
+  DCHECK_EQ(current_->block->valid_data_len(), 0);
+}
+
+void HdfsWriteQueue::EnqueueCurrentBuffer() {
+  DCHECK(current_ != NULL);
+  {
+    lock_guard<mutex> l(lock_);
+    queue_.push_back(current_);
+  }
+  current_ = NULL;
+  queue_cv_.notify_one();
+}
+
+void HdfsWriteQueue::WriterLoop() {
+  while (true) {
+    Buffer* buffer;
+    bool write_data;
+    {
+      unique_lock<mutex> l(lock_);
+      while (queue_.empty() && !shutdown_) queue_cv_.wait(l);
+      if (queue_.empty()) return;
+      buffer = queue_.front();
+      queue_.pop_front();
+      write_data = status_.ok() && !shutdown_;
+    }
+
+    // The fragment thread doesn't touch the buffer until it is freed.
+    Status status;
+    BufferedBlockMgr::Block* block = buffer->block;
+    if (write_data && block->valid_data_len() > 0) {
+      MonotonicStopWatch timer;
+      timer.Start();
+      status = WriteToHdfs(buffer->hdfs_connection, buffer->hdfs_file,
+          buffer->file_name, block->buffer(), block->valid_data_len());
+      COUNTER_UPDATE(write_timer_, timer.ElapsedTime());
+    }
+    if (buffer->close_file) {
+      CloseHdfsFile(buffer->hdfs_connection, buffer->hdfs_file, buffer->file_name);
+    }
+    block->ReturnAllocation(block->valid_data_len());
+
+    {
+      lock_guard<mutex> l(lock_);
+      if (status_.ok()) status_ = status;
+      free_buffers_.push_back(buffer);
+    }
+    free_cv_.notify_one();
+  }
+}
+
+Status HdfsWriteQueue::WriteToHdfs(hdfsFS hdfs_connection, hdfsFile hdfs_file,
+    const string& file_name, const uint8_t* data, int32_t len) {
+  int ret = hdfsWrite(hdfs_connection, hdfs_file, data, len);
+  if (ret == -1) {
+    string error_msg = GetHdfsErrorMsg("");
+    stringstream msg;
+    msg << "Failed to write row (length: " << len
+        << ") to Hdfs file: " << file_name
+        << " " << error_msg;
+    return Status(msg.str());
+  }
+  return Status::OK;
+}
+
+void HdfsWriteQueue::CloseHdfsFile(hdfsFS hdfs_connection, hdfsFile hdfs_file,
+    const string& file_name) {
+  int hdfs_ret = hdfsCloseFile(hdfs_connection, hdfs_file);
+  if (hdfs_ret != 0) {
+    state_->LogError(GetHdfsErrorMsg("Failed to close HDFS file: ", file_name));
+  }
+}
+
+}
@@ -0,0 +1,165 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_EXEC_HDFS_WRITE_QUEUE_H
+#define IMPALA_EXEC_HDFS_WRITE_QUEUE_H
+
+#include <hdfs.h>
+#include <list>
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/object-pool.h"
+#include "common/status.h"
+#include "runtime/buffered-block-mgr.h"
+#include "util/runtime-profile.h"
+
+namespace impala {
+
+class RuntimeState;
+class Thread;
+struct OutputPartition;
+
+// Writes the output of an HdfsTableSink's table writers to HDFS on a background thread,
+// so the fragment thread can encode the next rows while the previous ones are written.
+// Writes are copied into buffers, which the writer thread writes to HDFS in order.
+// Files are also closed by the writer thread, after their last buffer, so the fragment
+// thread can continue with the next file right away.
+// The buffers are blocks from the query's BufferedBlockMgr. Init() reserves
+// the MIN_BUFFERS blocks needed to fill one buffer while another one is written. Up to
+// --hdfs_sink_max_queued_write_bytes are buffered if the block mgr has blocks to spare.
+// If all buffers are in use, the fragment thread waits for the writer thread to free
+// one. If the flag is 0, data is written and files are closed synchronously.
+// The time the writer thread spends writing is added to the HdfsWriteTimer of the
+// profile, the time the fragment thread waits for it to the HdfsWriteWaitTimer.
+// Errors of the writer thread are returned by a later call to Write() or by Flush().
+// After an error, no more data is written but files are still closed.
+// This class is not thread safe: all calls must be made from the fragment thread.
+class HdfsWriteQueue {
+ public:
+  // The buffers are allocated from 'block_mgr'. Errors closing files are logged to
+  // 'state'.
+  HdfsWriteQueue(RuntimeState* state, BufferedBlockMgr* block_mgr,
+      RuntimeProfile* profile);
+
+  // Stops the writer thread, if Close() wasn't called.
+  virtual ~HdfsWriteQueue();
+
+  // Reserves the buffers and starts the writer thread, unless writes are synchronous.
+  // Returns MEM_LIMIT_EXCEEDED if the buffers can't be reserved.
+  Status Init();
+
+  // Appends 'data' to the current file of 'partition'. May return the error of an
+  // earlier write.
+  Status Write(OutputPartition* partition, const uint8_t* data, int32_t len);
+
+  // Closes the current file of 'partition' after the data written to it so far. The
+  // caller may open a new file for 'partition' once this returns.
+  void CloseFile(OutputPartition* partition);
+
+  // Waits until all data is written and all files passed to CloseFile() are closed.
+  // Returns the first error writing the data.
+  Status Flush();
+
+  // Stops the writer thread and returns the buffers to the block mgr. Data that hasn't
+  // been written yet is discarded, but files passed to CloseFile() are closed.
+  // Subsequent calls are done synchronously.
+  void Close();
+
+ protected:
+  // Writes 'data' to 'hdfs_file'. Virtual so that tests can write elsewhere.
+  virtual Status WriteToHdfs(hdfsFS hdfs_connection, hdfsFile hdfs_file,
+      const std::string& file_name, const uint8_t* data, int32_t len);
+
+  // Closes 'hdfs_file', logging an error to state_ if that fails.
+  virtual void CloseHdfsFile(hdfsFS hdfs_connection, hdfsFile hdfs_file,
+      const std::string& file_name);
+
+ private:
+  // Number of buffers reserved from the block mgr.
+  static const int MIN_BUFFERS = 2;
+
+  struct Buffer {
+    // File to write 'data' to.
+    hdfsFS hdfs_connection;
+    hdfsFile hdfs_file;
+    std::string file_name;
+
+    // Holds the data to write. Pinned until Close().
+    BufferedBlockMgr::Block* block;
+
+    // If true, the file is closed after the data is written.
+    bool close_file;
+  };
+
+  // Sets current_ to a free buffer for the current file of 'partition'. Gets a new
+  // block if the queue can have more buffers, otherwise or if the block mgr has none
+  // left, waits for the writer thread to free a buffer.
+  void GetBuffer(OutputPartition* partition);
+
+  // Hands current_ to the writer thread.
+  void EnqueueCurrentBuffer();
+
+  // Main loop of writer_thread_: writes the queued buffers until Close() is called.
+  void WriterLoop();
+
+  RuntimeState* state_;
+  BufferedBlockMgr* block_mgr_;
+
+  // Client of block_mgr_, NULL if writes are synchronous or after Close().
+  BufferedBlockMgr::Client* client_;
+
+  RuntimeProfile::Counter* write_timer_;
+  RuntimeProfile::Counter* write_wait_timer_;
+
+  // Maximum number of buffers. 0 if writes are synchronous.
+  int max_buffers_;
+
+  // Owns all buffers. Only accessed by the fragment thread.
+  ObjectPool buffer_pool_;
+  int num_buffers_;
+
+  // Buffer being filled by the fragment thread, NULL if there is none.
+  Buffer* current_;
+
+  // Protects the state below, which is shared with writer_thread_.
+  boost::mutex lock_;
+
+  // Signalled when a buffer is queued or the thread should stop.
+  boost::condition_variable queue_cv_;
+
+  // Signalled when the writer thread frees a buffer.
+  boost::condition_variable free_cv_;
+
+  // Buffers to write, in order.
+  std::list<Buffer*> queue_;
+
+  std::vector<Buffer*> free_buffers_;
+
+  // First error writing to HDFS.
+  Status status_;
+
+  // Set by Close(). Once set, the writer thread only closes files.
+  bool shutdown_;
+
+  boost::scoped_ptr<Thread> writer_thread_;
+};
+
+}
+
+#endif
@@ -354,6 +354,61 @@ inline int ParquetPlainEncoder::Decode(
       buffer, fixed_len_size, reinterpret_cast<int128_t*>(v));
 }
 
+
+// Integer columns can also be DELTA_BINARY_PACKED encoded (see util/delta-encoding.h),
+// which encodes int64_t values. These functions convert values of the integer types
+// to and from int64_t. They return false for all other types.
+class ParquetDeltaEncoding {
+ public:
+  template<typename T>
+  static bool ToInt64(const T& v, int64_t* result) { return false; }
+
+  template<typename T>
+  static bool FromInt64(int64_t v, T* result) { return false; }
+};
+
+template<>
+inline bool ParquetDeltaEncoding::ToInt64(const int8_t& v, int64_t* result) {
+  *result = v;
+  return true;
+}
+template<>
+inline bool ParquetDeltaEncoding::ToInt64(const int16_t& v, int64_t* result) {
+  *result = v;
+  return true;
+}
+template<>
+inline bool ParquetDeltaEncoding::ToInt64(const int32_t& v, int64_t* result) {
+  *result = v;
+  return true;
+}
+template<>
+inline bool ParquetDeltaEncoding::ToInt64(const int64_t& v, int64_t* result) {
+  *result = v;
+  return true;
+}
+
+template<>
+inline bool ParquetDeltaEncoding::FromInt64(int64_t v, int8_t* result) {
+  *result = v;
+  return true;
+}
+template<>
+inline bool ParquetDeltaEncoding::FromInt64(int64_t v, int16_t* result) {
+  *result = v;
+  return true;
+}
+template<>
+inline bool ParquetDeltaEncoding::FromInt64(int64_t v, int32_t* result) {
+  *result = v;
+  return true;
+}
+template<>
+inline bool ParquetDeltaEncoding::FromInt64(int64_t v, int64_t* result) {
+  *result = v;
+  return true;
+}
+
 }
 
 #endif
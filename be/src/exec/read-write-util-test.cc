@@ -53,6 +53,39 @@ TEST(ReadWriteUtil, BigEndian) {
   TestBigEndian<uint64_t>(0xffffffffffffff);
 }
 
+void TestVLong(int64_t value) {
+  uint8_t buffer[ReadWriteUtil::MAX_VINT_LEN];
+  int len = ReadWriteUtil::PutVLong(value, buffer);
+  EXPECT_EQ(len, ReadWriteUtil::DecodeVIntSize(buffer[0]));
+  int64_t result;
+  EXPECT_EQ(len, ReadWriteUtil::GetVLong(buffer, &result));
+  EXPECT_EQ(value, result);
+}
+
+// Test put and get of Writable variable-length longs
+TEST(ReadWriteUtil, VLong) {
+  TestVLong(0);
+  TestVLong(1);
+  TestVLong(-1);
+  TestVLong(127);
+  TestVLong(128);
+  TestVLong(-112);
+  TestVLong(-113);
+  TestVLong(0xffff);
+  TestVLong(-0x10000);
+  TestVLong(INT_MAX);
+  TestVLong(INT_MIN);
+  TestVLong(LLONG_MAX);
+  TestVLong(LLONG_MIN);
+
+  uint8_t buffer[ReadWriteUtil::MAX_VINT_LEN];
+  EXPECT_EQ(1, ReadWriteUtil::PutVInt(100, buffer));
+  EXPECT_EQ(5, ReadWriteUtil::PutVInt(INT_MAX, buffer));
+  int32_t result;
+  EXPECT_EQ(5, ReadWriteUtil::GetVInt(buffer, &result));
+  EXPECT_EQ(INT_MAX, result);
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -68,6 +68,32 @@ int ReadWriteUtil::PutZLong(int64_t longint, uint8_t* buf) {
   return len;
 }
 
+int ReadWriteUtil::PutVLong(int64_t vlong, uint8_t* buf) {
+  // Small values are stored in a single byte.
+  if (vlong >= -112 && vlong <= 127) {
+    buf[0] = static_cast<int8_t>(vlong);
+    return 1;
+  }
+  // Otherwise the first byte encodes the sign and the number of bytes that follow,
+  // see DecodeVIntSize() and IsNegativeVInt().
+  int8_t first_byte = -112;
+  if (vlong < 0) {
+    vlong = ~vlong;
+    first_byte = -120;
+  }
+  int num_bytes = 0;
+  for (uint64_t tmp = vlong; tmp != 0; tmp >>= 8) ++num_bytes;
+  buf[0] = first_byte - num_bytes;
+  for (int i = 0; i < num_bytes; ++i) {
+    buf[1 + i] = static_cast<uint64_t>(vlong) >> ((num_bytes - 1 - i) * 8);
+  }
+  return num_bytes + 1;
+}
+
+int ReadWriteUtil::PutVInt(int32_t vint, uint8_t* buf) {
+  return PutVLong(vint, buf);
+}
+
 string ReadWriteUtil::HexDump(const uint8_t* buf, int64_t length) {
   stringstream ss;
   ss << std::hex;
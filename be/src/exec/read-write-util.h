@@ -46,6 +46,12 @@ class ReadWriteUtil {
   // Put a zigzag encoded long integer into a buffer and return its length.
   static int PutZLong(int64_t longint, uint8_t* buf);
 
+  // Put a variable-length Long or int value, in the format of Hadoop's
+  // WritableUtils.writeVLong(), into a buffer and return its length. The buffer must
+  // have room for MAX_VINT_LEN bytes.
+  static int PutVLong(int64_t vlong, uint8_t* buf);
+  static int PutVInt(int32_t vint, uint8_t* buf);
+
   // Get a big endian integer from a buffer.  The buffer does not have to be word aligned.
   template<typename T>
   static T GetInt(const uint8_t* buffer);
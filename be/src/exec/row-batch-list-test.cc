@@ -105,6 +105,7 @@ TEST_F(RowBatchListTest, EmptyBatchTest) {
   RowBatch* batch = pool_.Add(new RowBatch(*desc_, 1, &tracker_));
   row_list.AddRowBatch(batch);
   EXPECT_EQ(row_list.total_num_rows(), 0);
+  EXPECT_EQ(row_list.num_row_batches(), 0);
   RowBatchList::TupleRowIterator it = row_list.Iterator();
   EXPECT_TRUE(it.AtEnd());
 }
@@ -121,6 +122,8 @@ TEST_F(RowBatchListTest, MultipleRowBatchesTest) {
     RowBatch* batch = CreateRowBatch(batch_start, batch_end);
     row_list.AddRowBatch(batch);
     EXPECT_EQ(row_list.total_num_rows(), batch_end + 1);
+    EXPECT_EQ(row_list.num_row_batches(), batch_idx + 1);
+    EXPECT_TRUE(row_list.GetRowBatch(batch_idx) == batch);
     FullScan(&row_list, 0, batch_end);
   }
 }
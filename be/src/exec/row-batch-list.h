@@ -107,6 +107,16 @@ class RowBatchList {
   // Returns the total number of rows in all row batches.
   int64_t total_num_rows() { return total_num_rows_; }
 
+  // Returns the number of row batches in the list.
+  int num_row_batches() const { return row_batches_.size(); }
+
+  // Returns the row batch at 'idx', in the order they were added.
+  RowBatch* GetRowBatch(int idx) {
+    DCHECK_GE(idx, 0);
+    DCHECK_LT(idx, row_batches_.size());
+    return row_batches_[idx];
+  }
+
   // Returns a new iterator over all the tuple rows.
   TupleRowIterator Iterator() {
     return TupleRowIterator(this);
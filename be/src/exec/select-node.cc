@@ -35,6 +35,7 @@ Status SelectNode::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(ExecNode::Prepare(state));
   child_row_batch_.reset(
       new RowBatch(child(0)->row_desc(), state->batch_size(), mem_tracker()));
+  selected_.reset(new bool[state->batch_size()]);
   return Status::OK;
 }
 
@@ -65,6 +66,8 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
       child_row_batch_->Reset();
       RETURN_IF_ERROR(child(0)->GetNext(state, child_row_batch_.get(), &child_eos_));
       child_row_idx_ = 0;
+      EvalBatchConjuncts(&conjuncts_[0], conjuncts_.size(), child_row_batch_.get(),
+          selected_.get());
     }
 
     if (CopyRows(row_batch)) {
@@ -82,9 +85,6 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
 }
 
 bool SelectNode::CopyRows(RowBatch* output_batch) {
-  Expr** conjuncts = &conjuncts_[0];
-  int num_conjuncts = conjuncts_.size();
-
   for (; child_row_idx_ < child_row_batch_->num_rows(); ++child_row_idx_) {
     // Add a new row to output_batch
     int dst_row_idx = output_batch->AddRow();
@@ -92,8 +92,10 @@ bool SelectNode::CopyRows(RowBatch* output_batch) {
     TupleRow* dst_row = output_batch->GetRow(dst_row_idx);
     TupleRow* src_row = child_row_batch_->GetRow(child_row_idx_);
 
-    if (EvalConjuncts(conjuncts, num_conjuncts, src_row)) {
-      output_batch->CopyRow(src_row, dst_row);
+    if (selected_[child_row_idx_]) {
+      // Copy only the tuples of the child's row. A parent join that probes in place
+      // passes output batches with wider rows.
+      child_row_batch_->CopyRow(src_row, dst_row);
       output_batch->CommitLastRow();
       ++num_rows_returned_;
       COUNTER_SET(rows_returned_counter_, num_rows_returned_);
@@ -16,6 +16,7 @@
 #ifndef IMPALA_EXEC_SELECT_NODE_H
 #define IMPALA_EXEC_SELECT_NODE_H
 
+#include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
 
 #include "exec/exec-node.h"
@@ -48,6 +49,10 @@ class SelectNode : public ExecNode {
   // true if last GetNext() call on child signalled eos
   bool child_eos_;
 
+  // selected_[i] is true if row i of child_row_batch_ passes the conjuncts. The
+  // conjuncts are evaluated for the whole batch when it is fetched.
+  boost::scoped_array<bool> selected_;
+
   // Copy rows from child_row_batch_ for which conjuncts_ evaluate to true to
   // output_batch, up to limit_.
   // Return true if limit was hit or output_batch should be returned, otherwise false.
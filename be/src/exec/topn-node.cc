@@ -14,14 +14,17 @@
 
 #include "exec/topn-node.h"
 
+#include <algorithm>
 #include <sstream>
 
+#include "codegen/llvm-codegen.h"
 #include "exprs/expr.h"
 #include "runtime/descriptors.h"
 #include "runtime/mem-pool.h"
 #include "runtime/raw-value.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "runtime/slot-bound-filter.h"
 #include "runtime/tuple.h"
 #include "runtime/tuple-row.h"
 #include "util/debug-util.h"
@@ -31,12 +34,41 @@
 #include "gen-cpp/PlanNodes_types.h"
 
 using namespace impala;
+using namespace llvm;
 using namespace std;
 
+const int64_t TopNNode::MIN_COMPACTION_BYTES;
+
+// Heap comparator that calls the codegen'd comparator if there is one. Cheap to copy,
+// unlike TupleRowComparator, since the STL heap functions take it by value.
+class TopNNode::HeapComparator {
+ public:
+  HeapComparator(const TupleRowComparator* interpreted_fn, CompareFn codegend_fn)
+    : interpreted_fn_(interpreted_fn), codegend_fn_(codegend_fn) {
+  }
+
+  bool operator()(TupleRow* lhs, TupleRow* rhs) const {
+    if (codegend_fn_ != NULL) return codegend_fn_(lhs, rhs);
+    return (*interpreted_fn_)(lhs, rhs);
+  }
+
+ private:
+  const TupleRowComparator* interpreted_fn_;
+  CompareFn codegend_fn_;
+};
+
 TopNNode::TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
   : ExecNode(pool, tnode, descs),
     offset_(tnode.sort_node.__isset.offset ? tnode.sort_node.offset : 0),
-    num_rows_skipped_(0) {
+    num_rows_skipped_(0),
+    threshold_expr_(NULL),
+    compare_fn_(NULL),
+    threshold_(NULL),
+    bound_filter_(NULL),
+    has_string_slots_(false),
+    live_bytes_(-1),
+    rows_pruned_counter_(NULL),
+    num_compactions_counter_(NULL) {
 }
 
 Status TopNNode::Init(const TPlanNode& tnode) {
@@ -45,6 +77,9 @@ Status TopNNode::Init(const TPlanNode& tnode) {
       Expr::CreateExprTrees(pool_, tnode.sort_node.ordering_exprs, &lhs_ordering_exprs_));
   RETURN_IF_ERROR(
       Expr::CreateExprTrees(pool_, tnode.sort_node.ordering_exprs, &rhs_ordering_exprs_));
+  DCHECK(!tnode.sort_node.ordering_exprs.empty());
+  RETURN_IF_ERROR(Expr::CreateExprTree(
+      pool_, tnode.sort_node.ordering_exprs[0], &threshold_expr_));
   is_asc_order_.insert(
       is_asc_order_.begin(), tnode.sort_node.is_asc_order.begin(),
       tnode.sort_node.is_asc_order.end());
@@ -61,9 +96,6 @@ Status TopNNode::Init(const TPlanNode& tnode) {
 
   tuple_row_less_than_.reset(new TupleRowComparator(
       lhs_ordering_exprs_, rhs_ordering_exprs_, is_asc_order_, nulls_first_));
-  priority_queue_.reset(
-      new priority_queue<TupleRow*, vector<TupleRow*>, TupleRowComparator>(
-          *tuple_row_less_than_));
   return Status::OK;
 }
 
@@ -72,10 +104,31 @@ Status TopNNode::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(ExecNode::Prepare(state));
   tuple_pool_.reset(new MemPool(mem_tracker()));
   tuple_descs_ = child(0)->row_desc().tuple_descriptors();
-  RETURN_IF_ERROR(Expr::Prepare(lhs_ordering_exprs_, state, child(0)->row_desc()));
-  RETURN_IF_ERROR(Expr::Prepare(rhs_ordering_exprs_, state, child(0)->row_desc()));
+  for (int i = 0; i < tuple_descs_.size(); ++i) {
+    if (!tuple_descs_[i]->string_slots().empty()) has_string_slots_ = true;
+  }
+  RETURN_IF_ERROR(
+      Expr::Prepare(lhs_ordering_exprs_, state, child(0)->row_desc(), false));
+  RETURN_IF_ERROR(
+      Expr::Prepare(rhs_ordering_exprs_, state, child(0)->row_desc(), false));
+  RETURN_IF_ERROR(Expr::Prepare(threshold_expr_, state, child(0)->row_desc()));
   abort_on_default_limit_exceeded_ = abort_on_default_limit_exceeded_ &&
       state->abort_on_default_limit_exceeded();
+  rows_pruned_counter_ = ADD_COUNTER(runtime_profile(), "RowsPruned", TCounterType::UNIT);
+  num_compactions_counter_ =
+      ADD_COUNTER(runtime_profile(), "TupleCompactions", TCounterType::UNIT);
+  AddBoundFilter(state);
+
+  if (state->codegen_enabled()) {
+    Function* compare_fn = CodegenCompare(state->codegen());
+    if (compare_fn != NULL) {
+      // Until the module is compiled, the interpreted comparator is used.
+      state->codegen()->AddFunctionToJit(
+          compare_fn, reinterpret_cast<void**>(&compare_fn_), true);
+      AddRuntimeExecOption("Codegen Enabled");
+      AddCodegenTierCounters();
+    }
+  }
   return Status::OK;
 }
 
@@ -86,6 +139,7 @@ Status TopNNode::Open(RuntimeState* state) {
   RETURN_IF_ERROR(state->CheckQueryState());
   RETURN_IF_ERROR(Expr::Open(lhs_ordering_exprs_, state));
   RETURN_IF_ERROR(Expr::Open(rhs_ordering_exprs_, state));
+  RETURN_IF_ERROR(threshold_expr_->Open(state));
   RETURN_IF_ERROR(child(0)->Open(state));
 
   // Limit of 0, no need to fetch anything from children.
@@ -99,13 +153,12 @@ Status TopNNode::Open(RuntimeState* state) {
         DCHECK(offset_ == 0); // Offset should be 0 when the default limit is set.
         return Status("DEFAULT_ORDER_BY_LIMIT has been exceeded.");
       }
-      for (int i = 0; i < batch.num_rows(); ++i) {
-        InsertTupleRow(batch.GetRow(i));
-      }
+      InsertBatch(&batch);
+      CompactTuplesIfNeeded();
       RETURN_IF_ERROR(state->CheckQueryState());
     } while (!eos);
   }
-  DCHECK_LE(priority_queue_->size(), limit_ + offset_);
+  DCHECK_LE(heap_.size(), limit_ + offset_);
   PrepareForOutput();
   child(0)->Close(state);
   return Status::OK;
@@ -125,7 +178,9 @@ Status TopNNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
     int row_idx = row_batch->AddRow();
     TupleRow* dst_row = row_batch->GetRow(row_idx);
     TupleRow* src_row = *get_next_iter_;
-    row_batch->CopyRow(src_row, dst_row);
+    // src_row only has tuple_descs_.size() tuples. row_batch may have wider rows if a
+    // parent join probes in place.
+    memcpy(dst_row, src_row, tuple_descs_.size() * sizeof(Tuple*));
     ++get_next_iter_;
     row_batch->CommitLastRow();
     ++num_rows_returned_;
@@ -140,47 +195,236 @@ void TopNNode::Close(RuntimeState* state) {
   if (tuple_pool_.get() != NULL) tuple_pool_->FreeAll();
   Expr::Close(lhs_ordering_exprs_, state);
   Expr::Close(rhs_ordering_exprs_, state);
+  if (threshold_expr_ != NULL) threshold_expr_->Close(state);
   ExecNode::Close(state);
 }
 
-// Insert if either not at the limit or it's a new TopN tuple_row
-void TopNNode::InsertTupleRow(TupleRow* input_row) {
-  TupleRow* insert_tuple_row = NULL;
+void TopNNode::AddBoundFilter(RuntimeState* state) {
+  // Rows are only filtered out by a scan that is the child of this node: any node in
+  // between could change which rows reach it, e.g. an outer join would output a NULL
+  // row instead of the filtered one.
+  // The default limit check needs to see all the rows of the child.
+  if (child(0)->type() != TPlanNodeType::HDFS_SCAN_NODE ||
+      abort_on_default_limit_exceeded_ || limit_ == 0) {
+    return;
+  }
+  if (!threshold_expr_->is_slotref()) return;
+  if (!SlotBoundFilter::IsSupportedType(threshold_expr_->type())) return;
+  SlotId slot_id = reinterpret_cast<SlotRef*>(threshold_expr_)->slot_id();
+  SlotBoundFilter* filter = pool_->Add(
+      new SlotBoundFilter(threshold_expr_->type(), is_asc_order_[0], nulls_first_[0]));
+  if (!state->AddSlotBoundFilter(slot_id, filter)) return;
+  bound_filter_ = filter;
+  bound_filter_->InitSnapshot(&published_bound_);
+  AddRuntimeExecOption("Bound Filter Pushed Down");
+  VLOG(2) << "TopN bound filter added on slot: " << slot_id;
+}
+
+void TopNNode::InsertBatch(RowBatch* batch) {
+  // compare_fn_ is set by another thread once the module is compiled.
+  CompareFn compare_fn = AtomicUtil::AcquireLoad(&compare_fn_);
+  HeapComparator less_than(tuple_row_less_than_.get(), compare_fn);
+  int num_rows = batch->num_rows();
+  int i = 0;
+  // Fill the heap up to LIMIT + OFFSET rows.
+  for (; i < num_rows && heap_.size() < limit_ + offset_; ++i) {
+    heap_.push_back(batch->GetRow(i)->DeepCopy(tuple_descs_, tuple_pool_.get()));
+    push_heap(heap_.begin(), heap_.end(), less_than);
+  }
 
-  if (priority_queue_->size() < limit_ + offset_) {
-    insert_tuple_row = input_row->DeepCopy(tuple_descs_, tuple_pool_.get());
-  } else {
-    DCHECK(!priority_queue_->empty());
-    TupleRow* top_tuple_row = priority_queue_->top();
-    if ((*tuple_row_less_than_)(input_row, top_tuple_row)) {
-      // TODO: DeepCopy will allocate new buffers for the string data.  This needs
-      // to be fixed to use a freelist
-      input_row->DeepCopy(top_tuple_row, tuple_descs_, tuple_pool_.get(), true);
-      insert_tuple_row = top_tuple_row;
-      priority_queue_->pop();
+  if (i < num_rows) {
+    // Everything allocated so far is live, replacements allocate garbage.
+    if (live_bytes_ == -1) live_bytes_ = tuple_pool_->total_allocated_bytes();
+    UpdateThreshold();
+    Expr* key_expr = lhs_ordering_exprs_[0];
+    ExprValueVector* keys = NULL;
+    if (Expr::IsBatchEvalType(key_expr->type())) keys = key_expr->GetValues(batch, NULL);
+    int num_pruned = 0;
+    for (; i < num_rows; ++i) {
+      TupleRow* input_row = batch->GetRow(i);
+      void* key = keys != NULL ? keys->GetValue(i) : key_expr->GetValue(input_row);
+      int cmp = CompareToThreshold(key);
+      if (cmp > 0) {
+        ++num_pruned;
+        continue;
+      }
+      if (cmp == 0 && !less_than(input_row, heap_.front())) continue;
+      // Replace the top of the heap with the input row, reusing its tuples.
+      pop_heap(heap_.begin(), heap_.end(), less_than);
+      input_row->DeepCopy(heap_.back(), tuple_descs_, tuple_pool_.get(), true);
+      push_heap(heap_.begin(), heap_.end(), less_than);
+      UpdateThreshold();
+    }
+    COUNTER_UPDATE(rows_pruned_counter_, num_pruned);
+  }
+
+  if (bound_filter_ != NULL && heap_.size() == limit_ + offset_) {
+    // Publish the bound at most once per batch rather than every time the top changes,
+    // and not at all if the batch didn't change it, so that the scanners only copy
+    // bounds that can reject more rows.
+    UpdateThreshold();
+    if (!published_bound_.IsBound(threshold_)) {
+      bound_filter_->SetBound(threshold_);
+      bound_filter_->Refresh(&published_bound_);
     }
   }
 
-  if (insert_tuple_row != NULL) {
-    priority_queue_->push(insert_tuple_row);
+  if (compare_fn != NULL) {
+    COUNTER_UPDATE(codegen_rows_counter_, num_rows);
+  } else if (interpreted_rows_counter_ != NULL) {
+    COUNTER_UPDATE(interpreted_rows_counter_, num_rows);
   }
 }
 
-// Reverse the order of the tuples in the priority queue
-void TopNNode::PrepareForOutput() {
-  sorted_top_n_.resize(priority_queue_->size());
-  int index = sorted_top_n_.size() - 1;
+void TopNNode::UpdateThreshold() {
+  DCHECK(!heap_.empty());
+  threshold_ = threshold_expr_->GetValue(heap_.front());
+}
 
-  while (priority_queue_->size() > 0) {
-    TupleRow* tuple_row = priority_queue_->top();
-    priority_queue_->pop();
-    sorted_top_n_[index] = tuple_row;
-    --index;
+int TopNNode::CompareToThreshold(void* key) const {
+  if (key == NULL || threshold_ == NULL) return 0;
+  int result = RawValue::Compare(key, threshold_, threshold_expr_->type());
+  return is_asc_order_[0] ? result : -result;
+}
+
+void TopNNode::CompactTuplesIfNeeded() {
+  // Without strings, replacing a row doesn't allocate any memory.
+  if (!has_string_slots_ || live_bytes_ == -1) return;
+  int64_t garbage_bytes = tuple_pool_->total_allocated_bytes() - live_bytes_;
+  if (garbage_bytes < max(live_bytes_, MIN_COMPACTION_BYTES)) return;
+
+  boost::scoped_ptr<MemPool> new_pool(new MemPool(mem_tracker()));
+  // Copying the rows doesn't change their order, so the heap stays valid.
+  for (int i = 0; i < heap_.size(); ++i) {
+    heap_[i] = heap_[i]->DeepCopy(tuple_descs_, new_pool.get());
   }
+  tuple_pool_->FreeAll();
+  tuple_pool_.swap(new_pool);
+  live_bytes_ = tuple_pool_->total_allocated_bytes();
+  // threshold_ may point into the old pool. It is updated before the next batch.
+  threshold_ = NULL;
+  COUNTER_UPDATE(num_compactions_counter_, 1);
+}
 
+void TopNNode::PrepareForOutput() {
+  // Sorting the heap with its comparator puts the rows in output order.
+  HeapComparator less_than(tuple_row_less_than_.get(),
+      AtomicUtil::AcquireLoad(&compare_fn_));
+  sort_heap(heap_.begin(), heap_.end(), less_than);
+  sorted_top_n_.swap(heap_);
   get_next_iter_ = sorted_top_n_.begin();
 }
 
+// Codegens a comparator for the ordering exprs. For ORDER BY a ASC NULLS LAST, b DESC,
+// the generated function is equivalent to:
+// bool Compare(TupleRow* lhs, TupleRow* rhs) {
+//   a_lhs = a(lhs); a_rhs = a(rhs);
+//   if (a_lhs is NULL) {
+//     if (!(a_rhs is NULL)) return false;
+//   } else if (a_rhs is NULL) {
+//     return true;
+//   } else {
+//     if (a_lhs < a_rhs) return true;
+//     if (a_rhs < a_lhs) return false;
+//   }
+//   (same for b, with the values swapped in the comparisons)
+//   return false;
+// }
+Function* TopNNode::CodegenCompare(LlvmCodeGen* codegen) {
+  if (!Expr::IsCodegenAvailable(lhs_ordering_exprs_) ||
+      !Expr::IsCodegenAvailable(rhs_ordering_exprs_)) {
+    VLOG_QUERY << "Could not codegen TopN comparator because one of the exprs "
+               << "could not be codegen'd.";
+    return NULL;
+  }
+  for (int i = 0; i < lhs_ordering_exprs_.size(); ++i) {
+    switch (lhs_ordering_exprs_[i]->type().type) {
+      case TYPE_BOOLEAN:
+      case TYPE_TINYINT:
+      case TYPE_SMALLINT:
+      case TYPE_INT:
+      case TYPE_BIGINT:
+      case TYPE_FLOAT:
+      case TYPE_DOUBLE:
+      case TYPE_STRING:
+        break;
+      default:
+        VLOG_QUERY << "Could not codegen TopN comparator for ordering expr type "
+                   << lhs_ordering_exprs_[i]->type().DebugString();
+        return NULL;
+    }
+  }
+
+  Type* tuple_row_type = codegen->GetType(TupleRow::LLVM_CLASS_NAME);
+  DCHECK(tuple_row_type != NULL);
+  PointerType* tuple_row_ptr_type = PointerType::get(tuple_row_type, 0);
+
+  LlvmCodeGen::FnPrototype prototype(codegen, "Compare", codegen->GetType(TYPE_BOOLEAN));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("lhs", tuple_row_ptr_type));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("rhs", tuple_row_ptr_type));
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Value* args[2];
+  Function* fn = prototype.GeneratePrototype(&builder, args);
+
+  Type* tuple_row_llvm_type = PointerType::get(codegen->ptr_type(), 0);
+  Value* lhs_row = builder.CreateBitCast(args[0], tuple_row_llvm_type);
+  Value* rhs_row = builder.CreateBitCast(args[1], tuple_row_llvm_type);
+
+  LlvmCodeGen::NamedVariable null_var("is_null_ptr", codegen->boolean_type());
+  Value* is_null_ptr = codegen->CreateEntryBlockAlloca(fn, null_var);
+
+  BasicBlock* true_block = BasicBlock::Create(context, "ret_true", fn);
+  BasicBlock* false_block = BasicBlock::Create(context, "ret_false", fn);
+
+  for (int i = 0; i < lhs_ordering_exprs_.size(); ++i) {
+    const ColumnType& type = lhs_ordering_exprs_[i]->type();
+    BasicBlock* lhs_null_block = BasicBlock::Create(context, "lhs_null", fn);
+    BasicBlock* lhs_not_null_block = BasicBlock::Create(context, "lhs_not_null", fn);
+    BasicBlock* cmp_block = BasicBlock::Create(context, "cmp", fn);
+    BasicBlock* not_before_block = BasicBlock::Create(context, "not_before", fn);
+    BasicBlock* next_block = BasicBlock::Create(context, "next", fn);
+
+    Value* lhs_args[] = { lhs_row, codegen->null_ptr_value(), is_null_ptr };
+    Value* lhs_val = builder.CreateCall(lhs_ordering_exprs_[i]->codegen_fn(), lhs_args);
+    Value* lhs_is_null = builder.CreateLoad(is_null_ptr);
+    Value* rhs_args[] = { rhs_row, codegen->null_ptr_value(), is_null_ptr };
+    Value* rhs_val = builder.CreateCall(rhs_ordering_exprs_[i]->codegen_fn(), rhs_args);
+    Value* rhs_is_null = builder.CreateLoad(is_null_ptr);
+    builder.CreateCondBr(lhs_is_null, lhs_null_block, lhs_not_null_block);
+
+    // The sort order of NULLs is independent of asc/desc.
+    builder.SetInsertPoint(lhs_null_block);
+    builder.CreateCondBr(rhs_is_null, next_block,
+        nulls_first_[i] ? true_block : false_block);
+    builder.SetInsertPoint(lhs_not_null_block);
+    builder.CreateCondBr(rhs_is_null, nulls_first_[i] ? false_block : true_block,
+        cmp_block);
+
+    // For descending order, lhs sorts before rhs if rhs < lhs.
+    Value* first = is_asc_order_[i] ? lhs_val : rhs_val;
+    Value* second = is_asc_order_[i] ? rhs_val : lhs_val;
+    builder.SetInsertPoint(cmp_block);
+    Value* before = codegen->CodegenLessThan(&builder, first, second, type);
+    builder.CreateCondBr(before, true_block, not_before_block);
+    builder.SetInsertPoint(not_before_block);
+    Value* after = codegen->CodegenLessThan(&builder, second, first, type);
+    builder.CreateCondBr(after, false_block, next_block);
+
+    builder.SetInsertPoint(next_block);
+  }
+  // Fully equivalent keys: lhs is not strictly before rhs.
+  builder.CreateRet(codegen->false_value());
+
+  builder.SetInsertPoint(true_block);
+  builder.CreateRet(codegen->true_value());
+  builder.SetInsertPoint(false_block);
+  builder.CreateRet(codegen->false_value());
+
+  return codegen->FinalizeFunction(fn);
+}
+
 void TopNNode::DebugString(int indentation_level, stringstream* out) const {
   *out << string(indentation_level * 2, ' ');
   *out << "TopNNode("
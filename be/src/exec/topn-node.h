@@ -16,15 +16,20 @@
 #ifndef IMPALA_EXEC_TOPN_NODE_H
 #define IMPALA_EXEC_TOPN_NODE_H
 
-#include <queue>
 #include <boost/scoped_ptr.hpp>
 
 #include "exec/exec-node.h"
 #include "runtime/descriptors.h"  // for TupleId
+#include "runtime/slot-bound-filter.h"
 #include "util/tuple-row-compare.h"
 
+namespace llvm {
+  class Function;
+}
+
 namespace impala {
 
+class LlvmCodeGen;
 class MemPool;
 class RuntimeState;
 class Tuple;
@@ -32,7 +37,13 @@ class Tuple;
 // Node for in-memory TopN (ORDER BY ... LIMIT)
 // This handles the case where the result fits in memory.  This node will do a deep
 // copy of the tuples that are necessary for the output.
-// This is implemented by storing rows in a priority queue.
+// This is implemented by storing rows in a heap whose top is the last row of the TopN.
+// Once the heap is full, input rows are compared to the top first by the value of the
+// first ordering expr only, which is evaluated a batch at a time if possible. Rows that
+// sort after the top on that value are skipped without comparing the whole rows.
+// Replacing the top row reuses its tuples, but not the memory of its strings, so the
+// heap's rows are copied into a new pool whenever the pool holds more garbage than
+// live data.
 class TopNNode : public ExecNode {
  public:
   TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -48,15 +59,44 @@ class TopNNode : public ExecNode {
 
  private:
 
-  friend class TupleLessThan;
+  class HeapComparator;
+
+  // Signature of the codegen'd comparator, see CodegenCompare().
+  typedef bool (*CompareFn)(TupleRow*, TupleRow*);
+
+  // Minimum number of bytes of garbage in tuple_pool_ before it is compacted.
+  static const int64_t MIN_COMPACTION_BYTES = 1024 * 1024;
+
+  // If the first ordering expr is a slot of the scan that is the child of this node,
+  // adds a bound filter on it that rejects the rows sorting after the top of the full
+  // heap, so the scan can discard them.
+  void AddBoundFilter(RuntimeState* state);
+
+  // Inserts the rows of 'batch' that are in the TopN into the heap. Creates deep
+  // copies of the rows, which it stores in tuple_pool_.
+  void InsertBatch(RowBatch* batch);
 
-  // Inserts a tuple row into the priority queue if it's in the TopN.  Creates a deep
-  // copy of tuple_row, which it stores in tuple_pool_.
-  void InsertTupleRow(TupleRow* tuple_row);
+  // Sets threshold_ to the value of the first ordering expr for the top of the heap.
+  void UpdateThreshold();
 
-  // Flatten and reverse the priority queue.
+  // Returns how a row whose first ordering expr evaluates to 'key' compares to the top
+  // of the heap: < 0 if it sorts before the top, > 0 if it sorts after it and 0 if
+  // the whole rows need to be compared, i.e. if the values are equal or either is NULL.
+  int CompareToThreshold(void* key) const;
+
+  // Copies the rows in the heap into a new pool and frees the old one, if the heap is
+  // full and the garbage in tuple_pool_ exceeds both the live data and
+  // MIN_COMPACTION_BYTES.
+  void CompactTuplesIfNeeded();
+
+  // Sorts the heap into output order.
   void PrepareForOutput();
 
+  // Codegens a function with the signature of CompareFn that returns the same result
+  // as tuple_row_less_than_. Returns NULL if the ordering exprs or their types are not
+  // supported by codegen.
+  llvm::Function* CodegenCompare(LlvmCodeGen* codegen);
+
   // Number of rows to skip.
   int64_t offset_;
   int64_t num_rows_skipped_;
@@ -75,22 +115,53 @@ class TopNNode : public ExecNode {
   std::vector<Expr*> lhs_ordering_exprs_;
   std::vector<Expr*> rhs_ordering_exprs_;
 
+  // A third copy of the first ordering expr, which is only evaluated over the top of
+  // the heap so that its result stays valid until the top changes.
+  Expr* threshold_expr_;
+
   boost::scoped_ptr<TupleRowComparator> tuple_row_less_than_;
 
-  // The priority queue will never have more elements in it than the LIMIT + OFFSET.
-  // The stl priority queue doesn't support a max size, so to get that functionality,
-  // the order of the queue is the opposite of what the ORDER BY clause specifies, such
-  // that the top of the queue is the last sorted element.
-  boost::scoped_ptr<
-      std::priority_queue<TupleRow*, std::vector<TupleRow*>, TupleRowComparator> >
-          priority_queue_;
+  // Codegen'd version of tuple_row_less_than_. Set by another thread once the module
+  // is compiled, NULL until then or if the comparator could not be codegen'd.
+  CompareFn compare_fn_;
 
-  // After computing the TopN in the priority_queue, pop them and put them in this vector
+  // Heap of the rows in the TopN, ordered with tuple_row_less_than_ such that the top
+  // (the first element) is the last sorted row. The heap never has more elements than
+  // LIMIT + OFFSET.
+  std::vector<TupleRow*> heap_;
+
+  // Value of threshold_expr_ for the top of the heap. Only valid while the heap is
+  // full and its top doesn't change.
+  void* threshold_;
+
+  // Filter on the slot of threshold_expr_ that is set to threshold_ after a batch if
+  // threshold_ changed. NULL if there is none, see AddBoundFilter(). Owned by pool_.
+  SlotBoundFilter* bound_filter_;
+
+  // Copy of the last bound set on bound_filter_, used to only publish a new bound when
+  // it differs from it.
+  SlotBoundFilter::Snapshot published_bound_;
+
+  // After computing the TopN in the heap, it is sorted into this vector.
   std::vector<TupleRow*> sorted_top_n_;
   std::vector<TupleRow*>::iterator get_next_iter_;
 
-  // Stores everything referenced in priority_queue_
+  // Stores everything referenced in heap_
   boost::scoped_ptr<MemPool> tuple_pool_;
+
+  // True if the tuples have string slots, whose memory is not reused when a row in the
+  // heap is replaced.
+  bool has_string_slots_;
+
+  // Bytes allocated from tuple_pool_ when the heap was filled or last compacted. -1 until
+  // the heap is full.
+  int64_t live_bytes_;
+
+  // Number of input rows skipped by comparing only the first ordering expr.
+  RuntimeProfile::Counter* rows_pruned_counter_;
+
+  // Number of times tuple_pool_ was compacted.
+  RuntimeProfile::Counter* num_compactions_counter_;
 };
 
 };
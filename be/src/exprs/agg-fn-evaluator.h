@@ -81,10 +81,13 @@ class AggFnEvaluator {
 
   AggregationOp agg_op() const { return agg_op_; }
   const std::vector<Expr*>& input_exprs() const { return input_exprs_; }
+  std::vector<Expr*>* mutable_input_exprs() { return &input_exprs_; }
   bool is_count_star() const {
     return agg_op_ == COUNT && input_exprs_.empty();
   }
   bool is_builtin() const { return fn_.binary_type == TFunctionBinaryType::BUILTIN; }
+  // NULL before Prepare().
+  impala_udf::FunctionContext* ctx() { return ctx_.get(); }
 
   static std::string DebugString(const std::vector<AggFnEvaluator*>& exprs);
   std::string DebugString() const;
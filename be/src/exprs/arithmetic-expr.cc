@@ -16,6 +16,7 @@
 
 #include "codegen/llvm-codegen.h"
 #include "exprs/arithmetic-expr.h"
+#include "runtime/row-batch.h"
 #include "util/debug-util.h"
 #include "gen-cpp/Exprs_types.h"
 
@@ -25,12 +26,277 @@ using namespace std;
 namespace impala {
 
 ArithmeticExpr::ArithmeticExpr(const TExprNode& node)
-  : Expr(node) {
+  : Expr(node),
+    batch_op_(NO_BATCH_OP) {
+}
+
+static bool IsIntType(PrimitiveType type) {
+  return type == TYPE_TINYINT || type == TYPE_SMALLINT || type == TYPE_INT ||
+      type == TYPE_BIGINT;
 }
 
 Status ArithmeticExpr::Prepare(RuntimeState* state, const RowDescriptor& desc) {
   DCHECK_LE(children_.size(), 2);
-  return Expr::Prepare(state, desc);
+  RETURN_IF_ERROR(Expr::Prepare(state, desc));
+
+  // The kernels operate on children of the same type as the result.
+  for (int i = 0; i < children_.size(); ++i) {
+    if (children_[i]->type() != type_) return Status::OK;
+  }
+  const string& fn_name = fn_.name.function_name;
+  PrimitiveType t = type_.type;
+  bool is_numeric = IsIntType(t) || t == TYPE_FLOAT || t == TYPE_DOUBLE;
+  if (fn_name == "add" && is_numeric) {
+    batch_op_ = ADD;
+  } else if (fn_name == "subtract" && is_numeric) {
+    batch_op_ = SUBTRACT;
+  } else if (fn_name == "multiply" && is_numeric) {
+    batch_op_ = MULTIPLY;
+  } else if (fn_name == "divide" && t == TYPE_DOUBLE) {
+    batch_op_ = DIVIDE;
+  } else if (fn_name == "int_divide" && IsIntType(t)) {
+    batch_op_ = INT_DIVIDE;
+  } else if (fn_name == "mod" && IsIntType(t)) {
+    batch_op_ = MOD;
+  } else if (fn_name == "bitand" && IsIntType(t)) {
+    batch_op_ = BITAND;
+  } else if (fn_name == "bitor" && IsIntType(t)) {
+    batch_op_ = BITOR;
+  } else if (fn_name == "bitxor" && IsIntType(t)) {
+    batch_op_ = BITXOR;
+  } else if (fn_name == "bitnot" && IsIntType(t)) {
+    batch_op_ = BITNOT;
+  }
+  if (children_.size() != (batch_op_ == BITNOT ? 1 : 2)) batch_op_ = NO_BATCH_OP;
+  return Status::OK;
+}
+
+namespace {
+
+// Add, subtract and multiply. Integer overflow wraps around: the operation is done on
+// an unsigned type U that is at least as wide as T, because signed overflow is
+// undefined.
+template<typename T> struct Arith {
+  static T Add(T a, T b) { return a + b; }
+  static T Subtract(T a, T b) { return a - b; }
+  static T Multiply(T a, T b) { return a * b; }
+};
+template<typename T, typename U> struct WrappingArith {
+  static T Add(T a, T b) { return static_cast<T>(static_cast<U>(a) + static_cast<U>(b)); }
+  static T Subtract(T a, T b) {
+    return static_cast<T>(static_cast<U>(a) - static_cast<U>(b));
+  }
+  static T Multiply(T a, T b) {
+    return static_cast<T>(static_cast<U>(a) * static_cast<U>(b));
+  }
+  static T Negate(T a) { return static_cast<T>(static_cast<U>(0) - static_cast<U>(a)); }
+};
+template<> struct Arith<int8_t> : WrappingArith<int8_t, uint32_t> {};
+template<> struct Arith<int16_t> : WrappingArith<int16_t, uint32_t> {};
+template<> struct Arith<int32_t> : WrappingArith<int32_t, uint32_t> {};
+template<> struct Arith<int64_t> : WrappingArith<int64_t, uint64_t> {};
+
+struct AddOp {
+  template<typename T> static T Apply(T a, T b) { return Arith<T>::Add(a, b); }
+};
+struct SubtractOp {
+  template<typename T> static T Apply(T a, T b) { return Arith<T>::Subtract(a, b); }
+};
+struct MultiplyOp {
+  template<typename T> static T Apply(T a, T b) { return Arith<T>::Multiply(a, b); }
+};
+struct DivideOp {
+  template<typename T> static T Apply(T a, T b) { return a / b; }
+};
+struct BitAndOp {
+  template<typename T> static T Apply(T a, T b) { return a & b; }
+};
+struct BitOrOp {
+  template<typename T> static T Apply(T a, T b) { return a | b; }
+};
+struct BitXorOp {
+  template<typename T> static T Apply(T a, T b) { return a ^ b; }
+};
+
+}
+
+// Computes Op for each row. The result is NULL if either input is NULL. Values are
+// computed for NULL rows as well, which avoids a branch per row.
+template<typename T, typename Op>
+static void BinaryKernel(int num_rows, ExprValueVector* lhs, ExprValueVector* rhs,
+    ExprValueVector* result) {
+  const T* a = lhs->values<T>();
+  const T* b = rhs->values<T>();
+  const bool* a_null = lhs->is_null();
+  const bool* b_null = rhs->is_null();
+  T* r = result->values<T>();
+  bool* r_null = result->is_null();
+  for (int i = 0; i < num_rows; ++i) {
+    r[i] = Op::Apply(a[i], b[i]);
+    r_null[i] = a_null[i] | b_null[i];
+  }
+}
+
+// Integer division and modulo. The result is NULL if the divisor is 0. The values of
+// NULL and unselected rows are arbitrary, so their divisor is replaced with 1, as is a
+// divisor of 0. The minimum value of T divided by -1 traps, so a divisor of -1 is
+// special-cased: the quotient is the wrapping negation of the dividend, the remainder
+// is 0.
+template<typename T, bool is_mod>
+static void IntDivideKernel(int num_rows, const bool* selected, ExprValueVector* lhs,
+    ExprValueVector* rhs, ExprValueVector* result) {
+  const T* a = lhs->values<T>();
+  const T* b = rhs->values<T>();
+  const bool* a_null = lhs->is_null();
+  const bool* b_null = rhs->is_null();
+  T* r = result->values<T>();
+  bool* r_null = result->is_null();
+  for (int i = 0; i < num_rows; ++i) {
+    bool is_null = a_null[i] | b_null[i] | (b[i] == 0);
+    bool skip = is_null | (selected != NULL && !selected[i]);
+    bool minus_one = !skip & (b[i] == -1);
+    T divisor = (skip | minus_one) ? 1 : b[i];
+    if (is_mod) {
+      r[i] = minus_one ? 0 : a[i] % divisor;
+    } else {
+      r[i] = minus_one ? Arith<T>::Negate(a[i]) : a[i] / divisor;
+    }
+    r_null[i] = is_null;
+  }
+}
+
+template<typename T>
+static void BitNotKernel(int num_rows, ExprValueVector* child, ExprValueVector* result) {
+  const T* a = child->values<T>();
+  T* r = result->values<T>();
+  memcpy(result->is_null(), child->is_null(), num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    r[i] = ~a[i];
+  }
+}
+
+template<typename Op>
+static void IntKernel(PrimitiveType type, int num_rows, ExprValueVector* lhs,
+    ExprValueVector* rhs, ExprValueVector* result) {
+  switch (type) {
+    case TYPE_TINYINT:
+      BinaryKernel<int8_t, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_SMALLINT:
+      BinaryKernel<int16_t, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_INT:
+      BinaryKernel<int32_t, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_BIGINT:
+      BinaryKernel<int64_t, Op>(num_rows, lhs, rhs, result);
+      break;
+    default:
+      DCHECK(false) << type;
+  }
+}
+
+template<typename Op>
+static void NumericKernel(PrimitiveType type, int num_rows, ExprValueVector* lhs,
+    ExprValueVector* rhs, ExprValueVector* result) {
+  switch (type) {
+    case TYPE_FLOAT:
+      BinaryKernel<float, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_DOUBLE:
+      BinaryKernel<double, Op>(num_rows, lhs, rhs, result);
+      break;
+    default:
+      IntKernel<Op>(type, num_rows, lhs, rhs, result);
+  }
+}
+
+template<bool is_mod>
+static void IntDivide(PrimitiveType type, int num_rows, const bool* selected,
+    ExprValueVector* lhs, ExprValueVector* rhs, ExprValueVector* result) {
+  switch (type) {
+    case TYPE_TINYINT:
+      IntDivideKernel<int8_t, is_mod>(num_rows, selected, lhs, rhs, result);
+      break;
+    case TYPE_SMALLINT:
+      IntDivideKernel<int16_t, is_mod>(num_rows, selected, lhs, rhs, result);
+      break;
+    case TYPE_INT:
+      IntDivideKernel<int32_t, is_mod>(num_rows, selected, lhs, rhs, result);
+      break;
+    case TYPE_BIGINT:
+      IntDivideKernel<int64_t, is_mod>(num_rows, selected, lhs, rhs, result);
+      break;
+    default:
+      DCHECK(false) << type;
+  }
+}
+
+static void BitNot(PrimitiveType type, int num_rows, ExprValueVector* child,
+    ExprValueVector* result) {
+  switch (type) {
+    case TYPE_TINYINT:
+      BitNotKernel<int8_t>(num_rows, child, result);
+      break;
+    case TYPE_SMALLINT:
+      BitNotKernel<int16_t>(num_rows, child, result);
+      break;
+    case TYPE_INT:
+      BitNotKernel<int32_t>(num_rows, child, result);
+      break;
+    case TYPE_BIGINT:
+      BitNotKernel<int64_t>(num_rows, child, result);
+      break;
+    default:
+      DCHECK(false) << type;
+  }
+}
+
+void ArithmeticExpr::EvalBatch(RowBatch* batch, const bool* selected,
+    ExprValueVector* result) {
+  if (batch_op_ == NO_BATCH_OP) {
+    Expr::EvalBatch(batch, selected, result);
+    return;
+  }
+  int num_rows = batch->num_rows();
+  PrimitiveType t = type_.type;
+  ExprValueVector* lhs = children_[0]->GetValues(batch, selected);
+  if (batch_op_ == BITNOT) {
+    BitNot(t, num_rows, lhs, result);
+    return;
+  }
+  ExprValueVector* rhs = children_[1]->GetValues(batch, selected);
+  switch (batch_op_) {
+    case ADD:
+      NumericKernel<AddOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case SUBTRACT:
+      NumericKernel<SubtractOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case MULTIPLY:
+      NumericKernel<MultiplyOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case DIVIDE:
+      BinaryKernel<double, DivideOp>(num_rows, lhs, rhs, result);
+      break;
+    case INT_DIVIDE:
+      IntDivide<false>(t, num_rows, selected, lhs, rhs, result);
+      break;
+    case MOD:
+      IntDivide<true>(t, num_rows, selected, lhs, rhs, result);
+      break;
+    case BITAND:
+      IntKernel<BitAndOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case BITOR:
+      IntKernel<BitOrOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case BITXOR:
+      IntKernel<BitXorOp>(t, num_rows, lhs, rhs, result);
+      break;
+    default:
+      DCHECK(false) << batch_op_;
+  }
 }
 
 string ArithmeticExpr::DebugString() const {
@@ -27,6 +27,9 @@ class TExprNode;
 class ArithmeticExpr: public Expr {
  public:
   virtual llvm::Function* Codegen(LlvmCodeGen* code_gen);
+  virtual bool PrefersBatchEval() const {
+    return batch_op_ != NO_BATCH_OP && AnyChildPrefersBatchEval();
+  }
 
  protected:
   friend class Expr;
@@ -35,6 +38,27 @@ class ArithmeticExpr: public Expr {
   ArithmeticExpr(const TExprNode& node);
 
   virtual std::string DebugString() const;
+
+  virtual void EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result);
+
+ private:
+  // Functions with a batch kernel.
+  enum BatchOp {
+    NO_BATCH_OP,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    INT_DIVIDE,
+    MOD,
+    BITAND,
+    BITOR,
+    BITXOR,
+    BITNOT,
+  };
+
+  // Set in Prepare(). NO_BATCH_OP if there is no kernel for the function and types.
+  BatchOp batch_op_;
 };
 
 }
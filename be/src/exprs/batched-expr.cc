@@ -0,0 +1,74 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exprs/batched-expr.h"
+
+#include <sstream>
+
+#include "common/object-pool.h"
+#include "runtime/row-batch.h"
+
+using namespace std;
+
+namespace impala {
+
+BatchedExpr::BatchedExpr(Expr* child)
+  : Expr(child->type()),
+    first_row_(NULL),
+    row_byte_size_(0),
+    num_rows_(0),
+    values_(NULL) {
+  AddChild(child);
+  // The child is already prepared, so this expr is not.
+  compute_fn_ = ComputeFn;
+}
+
+void BatchedExpr::Wrap(ObjectPool* pool, vector<Expr*>* exprs,
+    vector<BatchedExpr*>* batched) {
+  for (int i = 0; i < exprs->size(); ++i) {
+    Expr* expr = (*exprs)[i];
+    if (!IsBatchEvalType(expr->type()) || !expr->PrefersBatchEval()) continue;
+    BatchedExpr* batched_expr = pool->Add(new BatchedExpr(expr));
+    (*exprs)[i] = batched_expr;
+    batched->push_back(batched_expr);
+  }
+}
+
+void BatchedExpr::SetBatch(RowBatch* batch) {
+  num_rows_ = batch->num_rows();
+  if (num_rows_ == 0) return;
+  first_row_ = reinterpret_cast<uint8_t*>(batch->GetRow(0));
+  row_byte_size_ = batch->row_byte_size();
+  values_ = GetChild(0)->GetValues(batch, NULL);
+}
+
+void* BatchedExpr::ComputeFn(Expr* e, TupleRow* row) {
+  BatchedExpr* batched = static_cast<BatchedExpr*>(e);
+  if (batched->values_ != NULL) {
+    int64_t offset = reinterpret_cast<uint8_t*>(row) - batched->first_row_;
+    if (offset >= 0 && offset < batched->num_rows_ * batched->row_byte_size_) {
+      DCHECK_EQ(offset % batched->row_byte_size_, 0);
+      return batched->values_->GetValue(offset / batched->row_byte_size_);
+    }
+  }
+  return e->GetChild(0)->GetValue(row);
+}
+
+string BatchedExpr::DebugString() const {
+  stringstream out;
+  out << "BatchedExpr(child=" << GetChild(0)->DebugString() << ")";
+  return out.str();
+}
+
+}
@@ -0,0 +1,67 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_EXPRS_BATCHED_EXPR_H
+#define IMPALA_EXPRS_BATCHED_EXPR_H
+
+#include <string>
+#include <vector>
+
+#include "exprs/expr.h"
+
+namespace impala {
+
+class ObjectPool;
+
+// Evaluates an expr tree that an exec node evaluates one row at a time, e.g. an
+// aggregate function's input, a batch at a time instead (see Expr::PrefersBatchEval()).
+// Before the node evaluates the tree for the rows of a batch, it calls SetBatch(),
+// which evaluates the child for all rows of the batch with GetValues(). GetValue()
+// then returns the value computed for the row. Rows of other batches evaluate the
+// child directly.
+// BatchedExprs wrap prepared trees and can't be codegen'd, so a node only uses them
+// on its interpreted path.
+class BatchedExpr : public Expr {
+ public:
+  // Replaces the prepared exprs in 'exprs' for which PrefersBatchEval() is true with
+  // BatchedExprs allocated from 'pool' and adds those to 'batched'.
+  static void Wrap(ObjectPool* pool, std::vector<Expr*>* exprs,
+      std::vector<BatchedExpr*>* batched);
+
+  // Evaluates the child for all rows of 'batch'. The values are valid until the next
+  // call.
+  void SetBatch(RowBatch* batch);
+
+  virtual bool IsConstant() const { return false; }
+  virtual bool IsJittable(LlvmCodeGen* codegen) const { return false; }
+  virtual std::string DebugString() const;
+
+ private:
+  BatchedExpr(Expr* child);
+
+  static void* ComputeFn(Expr* e, TupleRow* row);
+
+  // The first row of the batch passed to SetBatch(), the distance between its rows and
+  // the number of rows. values_ holds the child's values for these rows. NULL before
+  // SetBatch() is called.
+  uint8_t* first_row_;
+  int row_byte_size_;
+  int num_rows_;
+  ExprValueVector* values_;
+};
+
+}
+
+#endif
@@ -16,6 +16,7 @@
 
 #include "codegen/llvm-codegen.h"
 #include "exprs/binary-predicate.h"
+#include "runtime/row-batch.h"
 #include "util/debug-util.h"
 #include "gen-cpp/Exprs_types.h"
 
@@ -25,12 +26,147 @@ using namespace std;
 namespace impala {
 
 BinaryPredicate::BinaryPredicate(const TExprNode& node)
-  : Predicate(node) {
+  : Predicate(node),
+    batch_op_(NO_BATCH_OP) {
 }
 
 Status BinaryPredicate::Prepare(RuntimeState* state, const RowDescriptor& desc) {
   DCHECK_EQ(children_.size(), 2);
-  return Expr::Prepare(state, desc);
+  RETURN_IF_ERROR(Expr::Prepare(state, desc));
+
+  // Only comparisons of native types have kernels.
+  const ColumnType& t = children_[0]->type();
+  if (t != children_[1]->type()) return Status::OK;
+  switch (t.type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+      break;
+    default:
+      return Status::OK;
+  }
+  const string& fn_name = fn_.name.function_name;
+  if (fn_name == "eq") {
+    batch_op_ = EQ;
+  } else if (fn_name == "ne") {
+    batch_op_ = NE;
+  } else if (fn_name == "lt") {
+    batch_op_ = LT;
+  } else if (fn_name == "le") {
+    batch_op_ = LE;
+  } else if (fn_name == "gt") {
+    batch_op_ = GT;
+  } else if (fn_name == "ge") {
+    batch_op_ = GE;
+  }
+  return Status::OK;
+}
+
+namespace {
+
+struct EqOp {
+  template<typename T> static bool Apply(T a, T b) { return a == b; }
+};
+struct NeOp {
+  template<typename T> static bool Apply(T a, T b) { return a != b; }
+};
+struct LtOp {
+  template<typename T> static bool Apply(T a, T b) { return a < b; }
+};
+struct LeOp {
+  template<typename T> static bool Apply(T a, T b) { return a <= b; }
+};
+struct GtOp {
+  template<typename T> static bool Apply(T a, T b) { return a > b; }
+};
+struct GeOp {
+  template<typename T> static bool Apply(T a, T b) { return a >= b; }
+};
+
+}
+
+// Compares the values of each row. The result is NULL if either input is NULL.
+template<typename T, typename Op>
+static void CompareKernel(int num_rows, ExprValueVector* lhs, ExprValueVector* rhs,
+    ExprValueVector* result) {
+  const T* a = lhs->values<T>();
+  const T* b = rhs->values<T>();
+  const bool* a_null = lhs->is_null();
+  const bool* b_null = rhs->is_null();
+  bool* r = result->values<bool>();
+  bool* r_null = result->is_null();
+  for (int i = 0; i < num_rows; ++i) {
+    r[i] = Op::Apply(a[i], b[i]);
+    r_null[i] = a_null[i] | b_null[i];
+  }
+}
+
+template<typename Op>
+static void Compare(PrimitiveType type, int num_rows, ExprValueVector* lhs,
+    ExprValueVector* rhs, ExprValueVector* result) {
+  switch (type) {
+    case TYPE_BOOLEAN:
+      CompareKernel<bool, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_TINYINT:
+      CompareKernel<int8_t, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_SMALLINT:
+      CompareKernel<int16_t, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_INT:
+      CompareKernel<int32_t, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_BIGINT:
+      CompareKernel<int64_t, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_FLOAT:
+      CompareKernel<float, Op>(num_rows, lhs, rhs, result);
+      break;
+    case TYPE_DOUBLE:
+      CompareKernel<double, Op>(num_rows, lhs, rhs, result);
+      break;
+    default:
+      DCHECK(false) << type;
+  }
+}
+
+void BinaryPredicate::EvalBatch(RowBatch* batch, const bool* selected,
+    ExprValueVector* result) {
+  if (batch_op_ == NO_BATCH_OP) {
+    Expr::EvalBatch(batch, selected, result);
+    return;
+  }
+  int num_rows = batch->num_rows();
+  PrimitiveType t = children_[0]->type().type;
+  ExprValueVector* lhs = children_[0]->GetValues(batch, selected);
+  ExprValueVector* rhs = children_[1]->GetValues(batch, selected);
+  switch (batch_op_) {
+    case EQ:
+      Compare<EqOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case NE:
+      Compare<NeOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case LT:
+      Compare<LtOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case LE:
+      Compare<LeOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case GT:
+      Compare<GtOp>(t, num_rows, lhs, rhs, result);
+      break;
+    case GE:
+      Compare<GeOp>(t, num_rows, lhs, rhs, result);
+      break;
+    default:
+      DCHECK(false) << batch_op_;
+  }
 }
 
 string BinaryPredicate::DebugString() const {
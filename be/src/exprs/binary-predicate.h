@@ -26,6 +26,9 @@ namespace impala {
 class BinaryPredicate : public Predicate {
  public:
   virtual llvm::Function* Codegen(LlvmCodeGen* code_gen);
+  virtual bool PrefersBatchEval() const {
+    return batch_op_ != NO_BATCH_OP && AnyChildPrefersBatchEval();
+  }
  
  protected:
   friend class Expr;
@@ -34,6 +37,23 @@ class BinaryPredicate : public Predicate {
 
   virtual Status Prepare(RuntimeState* state, const RowDescriptor& desc);
   virtual std::string DebugString() const;
+
+  virtual void EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result);
+
+ private:
+  // Comparisons with a batch kernel.
+  enum BatchOp {
+    NO_BATCH_OP,
+    EQ,
+    NE,
+    LT,
+    LE,
+    GT,
+    GE,
+  };
+
+  // Set in Prepare(). NO_BATCH_OP if there is no kernel for the function and types.
+  BatchOp batch_op_;
 };
 
 }
@@ -13,10 +13,13 @@
 // limitations under the License.
 
 #include "exprs/case-expr.h"
+
+#include "codegen/llvm-codegen.h"
 #include "exprs/conditional-functions.h"
 
 #include "gen-cpp/Exprs_types.h"
 
+using namespace llvm;
 using namespace std;
 
 namespace impala {
@@ -37,6 +40,98 @@ Status CaseExpr::Prepare(RuntimeState* state, const RowDescriptor& row_desc) {
   return Status::OK;
 }
 
+// Example IR for 'case int_col when 1 then 10 when 2 then 20 else 30 end':
+//
+// define i32 @CaseExpr(i8** %row, i8* %state_data, i1* %is_null) {
+// entry:
+//   %case_val = call i32 @SlotRef(i8** %row, i8* %state_data, i1* %is_null)
+//   %child_null = load i1* %is_null
+//   br i1 %child_null, label %else, label %when
+//
+// when:                                             ; preds = %entry
+//   %when_val = call i32 @IntLiteral(i8** %row, i8* %state_data, i1* %is_null)
+//   %child_null1 = load i1* %is_null
+//   br i1 %child_null1, label %next, label %compare
+//
+// compare:                                          ; preds = %when
+//   %tmp_eq = icmp eq i32 %case_val, %when_val
+//   br i1 %tmp_eq, label %then, label %next
+//
+// then:                                             ; preds = %compare
+//   %then_val = call i32 @IntLiteral1(i8** %row, i8* %state_data, i1* %is_null)
+//   ret i32 %then_val
+//
+// next:                                             ; preds = %compare, %when
+//   %when_val2 = call i32 @IntLiteral2(i8** %row, i8* %state_data, i1* %is_null)
+//   ...
+//
+// else:                                             ; preds = %next3, %entry, ...
+//   %else_val = call i32 @IntLiteral4(i8** %row, i8* %state_data, i1* %is_null)
+//   ret i32 %else_val
+// }
+//
+// The then and else exprs set the is_null arg themselves. Without a case expr, the
+// when exprs are booleans and there is no compare block.
+Function* CaseExpr::Codegen(LlvmCodeGen* codegen) {
+  for (int i = 0; i < GetNumChildren(); ++i) {
+    if (children()[i]->Codegen(codegen) == NULL) return NULL;
+  }
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Function* function = CreateComputeFnPrototype(codegen, "CaseExpr");
+  Function::arg_iterator fn_args = function->arg_begin();
+  Value* args[3] = { fn_args++, fn_args++, fn_args };
+
+  BasicBlock* entry_block = BasicBlock::Create(context, "entry", function);
+  BasicBlock* else_block = BasicBlock::Create(context, "else", function);
+
+  int num_children = GetNumChildren();
+  int loop_end = has_else_expr_ ? num_children - 1 : num_children;
+  int first_when = has_case_expr_ ? 1 : 0;
+  const ColumnType& when_type = children()[first_when]->type();
+
+  BasicBlock* current_block = entry_block;
+  Value* case_val = NULL;
+  if (has_case_expr_) {
+    BasicBlock* when_block = BasicBlock::Create(context, "when", function, else_block);
+    case_val = children()[0]->CodegenGetValue(codegen, current_block, else_block,
+        when_block, "case_val");
+    current_block = when_block;
+  }
+
+  for (int i = first_when; i < loop_end; i += 2) {
+    BasicBlock* compare_block =
+        BasicBlock::Create(context, "compare", function, else_block);
+    BasicBlock* then_block = BasicBlock::Create(context, "then", function, else_block);
+    BasicBlock* next_block = (i + 2 < loop_end) ?
+        BasicBlock::Create(context, "next", function, else_block) : else_block;
+
+    Value* when_val = children()[i]->CodegenGetValue(codegen, current_block,
+        next_block, compare_block, "when_val");
+    builder.SetInsertPoint(compare_block);
+    Value* is_match = has_case_expr_ ?
+        codegen->CodegenEquals(&builder, case_val, when_val, when_type) : when_val;
+    builder.CreateCondBr(is_match, then_block, next_block);
+
+    builder.SetInsertPoint(then_block);
+    builder.CreateRet(builder.CreateCall3(children()[i + 1]->codegen_fn(),
+        args[0], args[1], args[2], "then_val"));
+    current_block = next_block;
+  }
+
+  builder.SetInsertPoint(else_block);
+  if (has_else_expr_) {
+    builder.CreateRet(builder.CreateCall3(children()[num_children - 1]->codegen_fn(),
+        args[0], args[1], args[2], "else_val"));
+  } else {
+    CodegenSetIsNullArg(codegen, else_block, true);
+    builder.CreateRet(GetNullReturnValue(codegen));
+  }
+
+  return codegen->FinalizeFunction(function);
+}
+
 string CaseExpr::DebugString() const {
   stringstream out;
   out << "CaseExpr(has_case_expr=" << has_case_expr_
@@ -16,6 +16,7 @@
 
 #include "codegen/llvm-codegen.h"
 #include "exprs/cast-expr.h"
+#include "runtime/row-batch.h"
 #include "util/string-parser.h"
 #include "gen-cpp/Exprs_types.h"
 
@@ -39,6 +40,106 @@ string CastExpr::DebugString() const {
   return out.str();
 }
 
+template<typename From, typename To>
+static void CastKernel(int num_rows, ExprValueVector* child, ExprValueVector* result) {
+  const From* a = child->values<From>();
+  To* r = result->values<To>();
+  memcpy(result->is_null(), child->is_null(), num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    r[i] = static_cast<To>(a[i]);
+  }
+}
+
+// Returns false if 'to' is not a native type.
+template<typename From>
+static bool CastFrom(PrimitiveType to, int num_rows, ExprValueVector* child,
+    ExprValueVector* result) {
+  switch (to) {
+    case TYPE_BOOLEAN:
+      CastKernel<From, bool>(num_rows, child, result);
+      return true;
+    case TYPE_TINYINT:
+      CastKernel<From, int8_t>(num_rows, child, result);
+      return true;
+    case TYPE_SMALLINT:
+      CastKernel<From, int16_t>(num_rows, child, result);
+      return true;
+    case TYPE_INT:
+      CastKernel<From, int32_t>(num_rows, child, result);
+      return true;
+    case TYPE_BIGINT:
+      CastKernel<From, int64_t>(num_rows, child, result);
+      return true;
+    case TYPE_FLOAT:
+      CastKernel<From, float>(num_rows, child, result);
+      return true;
+    case TYPE_DOUBLE:
+      CastKernel<From, double>(num_rows, child, result);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns false if there is no kernel for casting 'from' to 'to'. Must not evaluate
+// the child in that case.
+static bool CastBatch(PrimitiveType from, PrimitiveType to, Expr* child_expr,
+    RowBatch* batch, const bool* selected, ExprValueVector* result) {
+  switch (to) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+      break;
+    default:
+      return false;
+  }
+  switch (from) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+      break;
+    default:
+      return false;
+  }
+  int num_rows = batch->num_rows();
+  ExprValueVector* child = child_expr->GetValues(batch, selected);
+  switch (from) {
+    case TYPE_BOOLEAN:
+      return CastFrom<bool>(to, num_rows, child, result);
+    case TYPE_TINYINT:
+      return CastFrom<int8_t>(to, num_rows, child, result);
+    case TYPE_SMALLINT:
+      return CastFrom<int16_t>(to, num_rows, child, result);
+    case TYPE_INT:
+      return CastFrom<int32_t>(to, num_rows, child, result);
+    case TYPE_BIGINT:
+      return CastFrom<int64_t>(to, num_rows, child, result);
+    case TYPE_FLOAT:
+      return CastFrom<float>(to, num_rows, child, result);
+    case TYPE_DOUBLE:
+      return CastFrom<double>(to, num_rows, child, result);
+    default:
+      DCHECK(false) << from;
+      return false;
+  }
+}
+
+void CastExpr::EvalBatch(RowBatch* batch, const bool* selected,
+    ExprValueVector* result) {
+  if (!CastBatch(children_[0]->type().type, type_.type, children_[0], batch, selected,
+      result)) {
+    Expr::EvalBatch(batch, selected, result);
+  }
+}
+
 bool CastExpr::IsJittable(LlvmCodeGen* codegen) const {
   // TODO: casts to and from StringValue are not yet done.
   if (type().type == TYPE_STRING || children()[0]->type().type == TYPE_STRING) {
@@ -35,6 +35,9 @@ class CastExpr: public Expr {
  protected:
   friend class Expr;
   CastExpr(const TExprNode& node);
+
+  // Casts between native types have a batch kernel.
+  virtual void EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result);
 };
 
 }
@@ -0,0 +1,393 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exprs/common-subexprs.h"
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+#include "codegen/llvm-codegen.h"
+#include "common/object-pool.h"
+#include "runtime/row-batch.h"
+
+using namespace llvm;
+using namespace std;
+
+namespace impala {
+
+// Entry in the map of shareable subexpressions, used to process larger subexpressions
+// first.
+struct SubexprOccurrences {
+  const string* key;
+  const vector<Expr**>* occurrences;
+
+  bool operator<(const SubexprOccurrences& other) const {
+    return key->size() > other.key->size();
+  }
+};
+
+// Adds all exprs in the tree rooted at 'expr' to 'exprs'.
+static void CollectTree(Expr* expr, set<Expr*>* exprs) {
+  exprs->insert(expr);
+  for (int i = 0; i < expr->GetNumChildren(); ++i) {
+    CollectTree(expr->GetChild(i), exprs);
+  }
+}
+
+void CommonSubexprs::Init(ObjectPool* pool, const vector<vector<Expr*>*>& expr_lists) {
+  OccurrenceMap occurrences;
+  for (int i = 0; i < expr_lists.size(); ++i) {
+    for (int j = 0; j < expr_lists[i]->size(); ++j) {
+      CollectSubexprs(&(*expr_lists[i])[j], &occurrences);
+    }
+  }
+
+  // Occurrences are in evaluation order. Sharing a subexpression makes the
+  // subexpressions inside the replaced occurrences go away, so larger subexpressions
+  // are shared first and the occurrences of smaller ones are checked again before they
+  // are replaced.
+  vector<SubexprOccurrences> candidates;
+  for (OccurrenceMap::const_iterator it = occurrences.begin();
+       it != occurrences.end(); ++it) {
+    if (it->second.size() < 2) continue;
+    SubexprOccurrences candidate;
+    candidate.key = &it->first;
+    candidate.occurrences = &it->second;
+    candidates.push_back(candidate);
+  }
+  stable_sort(candidates.begin(), candidates.end());
+
+  // Exprs in replaced occurrences, which are no longer part of any tree.
+  set<Expr*> removed_exprs;
+  for (int i = 0; i < candidates.size(); ++i) {
+    vector<Expr**> live;
+    for (int j = 0; j < candidates[i].occurrences->size(); ++j) {
+      Expr** occurrence = (*candidates[i].occurrences)[j];
+      if (removed_exprs.find(*occurrence) == removed_exprs.end()) {
+        live.push_back(occurrence);
+      }
+    }
+    if (live.size() < 2) continue;
+
+    // The first occurrence becomes the shared copy.
+    Subexpr* subexpr = pool->Add(new Subexpr(*live[0]));
+    for (int j = 0; j < live.size(); ++j) {
+      if (j > 0) CollectTree(*live[j], &removed_exprs);
+      *live[j] = pool->Add(new CachedSubexpr(this, subexpr));
+    }
+    ++num_shared_;
+  }
+  if (num_shared_ == 0) return;
+
+  for (int i = 0; i < expr_lists.size(); ++i) {
+    if (expr_lists[i]->empty()) continue;
+    Expr** first = &(*expr_lists[i])[0];
+    *first = pool->Add(new NewRowExpr(this, *first));
+    break;
+  }
+  VLOG_QUERY << "Shared " << num_shared_ << " common subexpressions";
+}
+
+string CommonSubexprs::CollectSubexprs(Expr** expr_ptr, OccurrenceMap* occurrences) {
+  Expr* expr = *expr_ptr;
+  bool shareable = !expr->thrift_node_.empty() && expr->IsDeterministicNode();
+
+  stringstream key;
+  key << expr->thrift_node_ << "(";
+  for (int i = 0; i < expr->children_.size(); ++i) {
+    // Subexpressions of an unshareable tree may still be shared.
+    string child_key = CollectSubexprs(&expr->children_[i], occurrences);
+    if (child_key.empty()) shareable = false;
+    key << (i == 0 ? "" : ",") << child_key;
+  }
+  key << ")";
+  if (!shareable) return "";
+
+  if (!expr->is_slotref() && !expr->children_.empty() && !expr->IsConstant() &&
+      IsCacheableType(expr->type())) {
+    (*occurrences)[key.str()].push_back(expr_ptr);
+  }
+  return key.str();
+}
+
+bool CommonSubexprs::IsCacheableType(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+    case TYPE_STRING:
+    case TYPE_TIMESTAMP:
+    case TYPE_DECIMAL:
+      DCHECK_LE(type.GetByteSize(), Subexpr::MAX_VALUE_SIZE);
+      return true;
+    default:
+      return false;
+  }
+}
+
+CachedSubexpr::CachedSubexpr(CommonSubexprs* subexprs, CommonSubexprs::Subexpr* subexpr)
+  : Expr(subexpr->expr->type()),
+    subexprs_(subexprs),
+    subexpr_(subexpr) {
+}
+
+Status CachedSubexpr::Prepare(RuntimeState* state, const RowDescriptor& row_desc) {
+  compute_fn_ = ComputeFn;
+  if (subexpr_->prepared) return Status::OK;
+  subexpr_->prepared = true;
+  RETURN_IF_ERROR(subexpr_->expr->Prepare(state, row_desc));
+  // The shared expr isn't a child, so its constant subtrees aren't folded otherwise.
+  if (state != NULL) subexpr_->expr->FoldConstantChildren(state, row_desc);
+  return Status::OK;
+}
+
+Status CachedSubexpr::Open(RuntimeState* state) {
+  if (!subexpr_->opened) {
+    subexpr_->opened = true;
+    RETURN_IF_ERROR(subexpr_->expr->Open(state));
+  }
+  return Expr::Open(state);
+}
+
+void CachedSubexpr::Close(RuntimeState* state) {
+  if (!subexpr_->closed) {
+    subexpr_->closed = true;
+    subexpr_->expr->Close(state);
+  }
+  Expr::Close(state);
+}
+
+int CachedSubexpr::GetSlotIds(vector<SlotId>* slot_ids) const {
+  return subexpr_->expr->GetSlotIds(slot_ids);
+}
+
+bool CachedSubexpr::IsJittable(LlvmCodeGen* codegen) const {
+  return subexpr_->expr->IsJittable(codegen);
+}
+
+void* CachedSubexpr::ComputeFn(Expr* e, TupleRow* row) {
+  CachedSubexpr* cached = static_cast<CachedSubexpr*>(e);
+  CommonSubexprs::Subexpr* subexpr = cached->subexpr_;
+  int64_t generation = cached->subexprs_->generation_;
+  if (subexpr->row != row || subexpr->generation != generation) {
+    void* value = subexpr->expr->GetValue(row);
+    subexpr->row = row;
+    subexpr->generation = generation;
+    subexpr->is_null = value == NULL;
+    if (value != NULL) memcpy(subexpr->value, value, e->type().GetByteSize());
+  }
+  return subexpr->is_null ? NULL : subexpr->value;
+}
+
+// Codegens a function that returns the cached result for the row or evaluates the
+// shared subexpression and caches its result. For an int subexpression:
+// define i32 @CachedSubexpr(i8** %row, i8* %state_data, i1* %is_null) {
+// entry:
+//   %0 = bitcast i8** %row to i8*
+//   %cached_row = load i8** inttoptr (i64 96076048 to i8**)
+//   %generation = load i64* inttoptr (i64 96075904 to i64*)
+//   %cached_generation = load i64* inttoptr (i64 96076056 to i64*)
+//   %same_row = icmp eq i8* %0, %cached_row
+//   %same_generation = icmp eq i64 %generation, %cached_generation
+//   %hit = and i1 %same_row, %same_generation
+//   br i1 %hit, label %hit, label %miss
+//
+// hit:                                              ; preds = %entry
+//   %cached_is_null = load i1* inttoptr (i64 96076064 to i1*)
+//   store i1 %cached_is_null, i1* %is_null
+//   br i1 %cached_is_null, label %null, label %cached
+//
+// cached:                                           ; preds = %hit
+//   %cached_value = load i32* inttoptr (i64 96076072 to i32*)
+//   ret i32 %cached_value
+//
+// miss:                                             ; preds = %entry
+//   %result = call i32 @FunctionCall(i8** %row, i8* %state_data, i1* %is_null)
+//   store i8* %0, i8** inttoptr (i64 96076048 to i8**)
+//   store i64 %generation, i64* inttoptr (i64 96076056 to i64*)
+//   %result_is_null = load i1* %is_null
+//   store i1 %result_is_null, i1* inttoptr (i64 96076064 to i1*)
+//   br i1 %result_is_null, label %null, label %store
+//
+// store:                                            ; preds = %miss
+//   store i32 %result, i32* inttoptr (i64 96076072 to i32*)
+//   ret i32 %result
+//
+// null:                                             ; preds = %miss, %hit
+//   ret i32 0
+// }
+Function* CachedSubexpr::Codegen(LlvmCodeGen* codegen) {
+  if (!subexpr_->codegen_done) {
+    subexpr_->codegen_done = true;
+    subexpr_->codegen_fn = subexpr_->expr->Codegen(codegen);
+  }
+  Function* subexpr_fn = subexpr_->codegen_fn;
+  if (subexpr_fn == NULL) return NULL;
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Function* function = CreateComputeFnPrototype(codegen, "CachedSubexpr");
+  Function::arg_iterator args_it = function->arg_begin();
+  Value* args[3] = { args_it++, args_it++, args_it };
+
+  BasicBlock* entry_block = BasicBlock::Create(context, "entry", function);
+  BasicBlock* hit_block = BasicBlock::Create(context, "hit", function);
+  BasicBlock* cached_block = BasicBlock::Create(context, "cached", function);
+  BasicBlock* miss_block = BasicBlock::Create(context, "miss", function);
+  BasicBlock* store_block = BasicBlock::Create(context, "store", function);
+  BasicBlock* null_block = BasicBlock::Create(context, "null", function);
+
+  Type* ptr_ptr_type = PointerType::get(codegen->ptr_type(), 0);
+  Type* bigint_ptr_type = codegen->GetPtrType(TYPE_BIGINT);
+  Type* bool_ptr_type = codegen->GetPtrType(TYPE_BOOLEAN);
+  Value* cached_row_ptr = codegen->CastPtrToLlvmPtr(ptr_ptr_type, &subexpr_->row);
+  Value* generation_ptr =
+      codegen->CastPtrToLlvmPtr(bigint_ptr_type, &subexprs_->generation_);
+  Value* cached_generation_ptr =
+      codegen->CastPtrToLlvmPtr(bigint_ptr_type, &subexpr_->generation);
+  Value* cached_is_null_ptr =
+      codegen->CastPtrToLlvmPtr(bool_ptr_type, &subexpr_->is_null);
+  Value* cached_value_ptr =
+      codegen->CastPtrToLlvmPtr(codegen->GetPtrType(type()), subexpr_->value);
+
+  builder.SetInsertPoint(entry_block);
+  Value* row = builder.CreateBitCast(args[0], codegen->ptr_type());
+  Value* cached_row = builder.CreateLoad(cached_row_ptr, "cached_row");
+  Value* generation = builder.CreateLoad(generation_ptr, "generation");
+  Value* cached_generation =
+      builder.CreateLoad(cached_generation_ptr, "cached_generation");
+  Value* same_row = builder.CreateICmpEQ(row, cached_row, "same_row");
+  Value* same_generation =
+      builder.CreateICmpEQ(generation, cached_generation, "same_generation");
+  Value* hit = builder.CreateAnd(same_row, same_generation, "hit");
+  builder.CreateCondBr(hit, hit_block, miss_block);
+
+  builder.SetInsertPoint(hit_block);
+  Value* cached_is_null = builder.CreateLoad(cached_is_null_ptr, "cached_is_null");
+  builder.CreateStore(cached_is_null, args[2]);
+  builder.CreateCondBr(cached_is_null, null_block, cached_block);
+
+  // String results are returned as StringValue*. The cache holds a copy of the
+  // StringValue, which is returned instead of the shared subexpression's.
+  builder.SetInsertPoint(cached_block);
+  if (type().type == TYPE_STRING) {
+    builder.CreateRet(cached_value_ptr);
+  } else {
+    builder.CreateRet(builder.CreateLoad(cached_value_ptr, "cached_value"));
+  }
+
+  builder.SetInsertPoint(miss_block);
+  Value* result = builder.CreateCall(subexpr_fn, args, "result");
+  builder.CreateStore(row, cached_row_ptr);
+  builder.CreateStore(generation, cached_generation_ptr);
+  Value* result_is_null = builder.CreateLoad(args[2], "result_is_null");
+  builder.CreateStore(result_is_null, cached_is_null_ptr);
+  builder.CreateCondBr(result_is_null, null_block, store_block);
+
+  builder.SetInsertPoint(store_block);
+  if (type().type == TYPE_STRING) {
+    builder.CreateStore(builder.CreateLoad(result, "string_val"), cached_value_ptr);
+  } else {
+    builder.CreateStore(result, cached_value_ptr);
+  }
+  builder.CreateRet(result);
+
+  builder.SetInsertPoint(null_block);
+  builder.CreateRet(GetNullReturnValue(codegen));
+
+  // The function uses the cache, so it's not thread safe.
+  adapter_fn_used_ = true;
+  return codegen->FinalizeFunction(function);
+}
+
+string CachedSubexpr::DebugString() const {
+  stringstream out;
+  out << "CachedSubexpr(subexpr=" << subexpr_->expr->DebugString() << ")";
+  return out.str();
+}
+
+NewRowExpr::NewRowExpr(CommonSubexprs* subexprs, Expr* child)
+  : Expr(child->type()),
+    subexprs_(subexprs) {
+  AddChild(child);
+}
+
+Status NewRowExpr::Prepare(RuntimeState* state, const RowDescriptor& row_desc) {
+  RETURN_IF_ERROR(Expr::PrepareChildren(state, row_desc));
+  compute_fn_ = ComputeFn;
+  return Status::OK;
+}
+
+void* NewRowExpr::ComputeFn(Expr* e, TupleRow* row) {
+  NewRowExpr* new_row = static_cast<NewRowExpr*>(e);
+  ++new_row->subexprs_->generation_;
+  return e->GetChild(0)->GetValue(row);
+}
+
+void NewRowExpr::EvalBatch(RowBatch* batch, const bool* selected,
+    ExprValueVector* result) {
+  // The rows of a batch are all different, so one generation is enough.
+  ++subexprs_->generation_;
+  ExprValueVector* values = GetChild(0)->GetValues(batch, selected);
+  int num_rows = batch->num_rows();
+  for (int i = 0; i < num_rows; ++i) {
+    if (selected != NULL && !selected[i]) continue;
+    result->SetValue(i, values->GetValue(i));
+  }
+}
+
+// define i32 @NewRowExpr(i8** %row, i8* %state_data, i1* %is_null) {
+// entry:
+//   %generation = load i64* inttoptr (i64 96075904 to i64*)
+//   %next_generation = add i64 %generation, 1
+//   store i64 %next_generation, i64* inttoptr (i64 96075904 to i64*)
+//   %result = call i32 @BinaryPredicate(i8** %row, i8* %state_data, i1* %is_null)
+//   ret i32 %result
+// }
+Function* NewRowExpr::Codegen(LlvmCodeGen* codegen) {
+  Function* child_fn = GetChild(0)->Codegen(codegen);
+  if (child_fn == NULL) return NULL;
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Function* function = CreateComputeFnPrototype(codegen, "NewRowExpr");
+  Function::arg_iterator args_it = function->arg_begin();
+  Value* args[3] = { args_it++, args_it++, args_it };
+
+  BasicBlock* entry_block = BasicBlock::Create(context, "entry", function);
+  builder.SetInsertPoint(entry_block);
+  Value* generation_ptr = codegen->CastPtrToLlvmPtr(
+      codegen->GetPtrType(TYPE_BIGINT), &subexprs_->generation_);
+  Value* generation = builder.CreateLoad(generation_ptr, "generation");
+  builder.CreateStore(builder.CreateAdd(generation,
+      codegen->GetIntConstant(TYPE_BIGINT, 1), "next_generation"), generation_ptr);
+  builder.CreateRet(builder.CreateCall(child_fn, args, "result"));
+
+  // The function updates the generation, so it's not thread safe.
+  adapter_fn_used_ = true;
+  return codegen->FinalizeFunction(function);
+}
+
+string NewRowExpr::DebugString() const {
+  stringstream out;
+  out << "NewRowExpr(" << Expr::DebugString() << ")";
+  return out.str();
+}
+
+}
@@ -0,0 +1,162 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_EXPRS_COMMON_SUBEXPRS_H
+#define IMPALA_EXPRS_COMMON_SUBEXPRS_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "exprs/expr.h"
+
+namespace impala {
+
+class ObjectPool;
+
+// Eliminates common subexpressions across the expr trees an exec node evaluates over
+// the same row, e.g. lower(url) in a grouping expr and in an aggregate function's
+// input. Init() replaces every occurrence of a subexpression that appears more than
+// once with a CachedSubexpr. All CachedSubexprs for the same subexpression evaluate a
+// single copy of it, at most once per row, and cache the result. This works in both
+// the interpreted and the codegen'd paths.
+//
+// Rows are reused, e.g. row batches are reset and joins rewrite their output row for
+// every candidate match, so the row pointer alone doesn't identify a row. Init()
+// therefore also wraps the first expr tree in a NewRowExpr, which starts a new
+// generation every time it is evaluated, and cached results are only used for the
+// same row in the same generation. The first tree must be evaluated before any of the
+// other trees for every row. Trees may also be evaluated a batch at a time; this is
+// correct but only the last row's result is cached.
+//
+// Only non-constant, deterministic subexpressions of builtins with fixed size results
+// that aren't slot refs are shared. The codegen'd functions of the rewritten trees
+// read and write the cache, so they are not thread safe.
+class CommonSubexprs {
+ public:
+  // A subexpression that is shared by several trees and its cached result.
+  struct Subexpr {
+    // Largest result that can be cached.
+    static const int MAX_VALUE_SIZE = 16;
+
+    Expr* expr;
+
+    // Set by the first CachedSubexpr to prepare/open/close/codegen 'expr'.
+    bool prepared;
+    bool opened;
+    bool closed;
+    bool codegen_done;
+
+    // Codegen'd function of 'expr', or NULL if it couldn't be codegen'd.
+    llvm::Function* codegen_fn;
+
+    // The row and generation 'value' was computed for.
+    TupleRow* row;
+    int64_t generation;
+
+    // Result for 'row'. Only valid if is_null is false. String results point to memory
+    // owned by 'expr', which stays valid since 'expr' is only evaluated when the cached
+    // result is replaced.
+    bool is_null;
+    union {
+      int128_t align;
+      uint8_t value[MAX_VALUE_SIZE];
+    };
+
+    Subexpr(Expr* e)
+      : expr(e), prepared(false), opened(false), closed(false), codegen_done(false),
+        codegen_fn(NULL), row(NULL), generation(-1), is_null(true) {
+    }
+  };
+
+  CommonSubexprs() : generation_(0), num_shared_(0) { }
+
+  // Rewrites the expr trees in 'expr_lists', which must be listed in the order they
+  // are evaluated for each row. Must be called after the trees are created and before
+  // they are prepared. The new exprs are allocated from 'pool'.
+  void Init(ObjectPool* pool, const std::vector<std::vector<Expr*>*>& expr_lists);
+
+  // Number of distinct subexpressions that are shared.
+  int num_shared() const { return num_shared_; }
+
+ private:
+  friend class CachedSubexpr;
+  friend class NewRowExpr;
+
+  typedef std::map<std::string, std::vector<Expr**> > OccurrenceMap;
+
+  // Returns a string that is equal for two trees iff they compute the same value.
+  // Adds the occurrences of all subtrees of '*expr' that can be shared to
+  // 'occurrences', keyed by that string. Returns an empty string if the tree
+  // can't be shared, in which case its parents can't be shared either.
+  static std::string CollectSubexprs(Expr** expr, OccurrenceMap* occurrences);
+
+  // Returns true if results of 'expr' can be cached.
+  static bool IsCacheableType(const ColumnType& type);
+
+  // Incremented by the NewRowExpr every time it is evaluated.
+  int64_t generation_;
+
+  int num_shared_;
+};
+
+// Replaces an occurrence of a shared subexpression. Evaluates the shared subexpression
+// unless its result for the row is cached.
+class CachedSubexpr : public Expr {
+ public:
+  CachedSubexpr(CommonSubexprs* subexprs, CommonSubexprs::Subexpr* subexpr);
+
+  virtual Status Open(RuntimeState* state);
+  virtual void Close(RuntimeState* state);
+  virtual bool IsConstant() const { return false; }
+  virtual int GetSlotIds(std::vector<SlotId>* slot_ids) const;
+  virtual bool IsJittable(LlvmCodeGen* codegen) const;
+  virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
+  virtual std::string DebugString() const;
+
+ protected:
+  virtual Status Prepare(RuntimeState* state, const RowDescriptor& row_desc);
+
+ private:
+  static void* ComputeFn(Expr* e, TupleRow* row);
+
+  CommonSubexprs* subexprs_;
+  CommonSubexprs::Subexpr* subexpr_;
+};
+
+// Wraps the first expr tree evaluated for each row. Starts a new generation, which
+// invalidates all cached results, and then evaluates its child.
+class NewRowExpr : public Expr {
+ public:
+  NewRowExpr(CommonSubexprs* subexprs, Expr* child);
+
+  virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
+  virtual std::string DebugString() const;
+
+ protected:
+  virtual Status Prepare(RuntimeState* state, const RowDescriptor& row_desc);
+
+  // Starts a new generation and evaluates the child a batch at a time.
+  virtual void EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result);
+
+ private:
+  static void* ComputeFn(Expr* e, TupleRow* row);
+
+  CommonSubexprs* subexprs_;
+};
+
+}
+
+#endif
@@ -16,6 +16,7 @@
 
 #include "codegen/llvm-codegen.h"
 #include "exprs/compound-predicate.h"
+#include "runtime/row-batch.h"
 #include "util/debug-util.h"
 
 using namespace std;
@@ -24,7 +25,8 @@ using namespace llvm;
 namespace impala {
 
 CompoundPredicate::CompoundPredicate(const TExprNode& node)
-  : Predicate(node) {
+  : Predicate(node),
+    rhs_selected_capacity_(0) {
 }
 
 Status CompoundPredicate::Prepare(RuntimeState* state, const RowDescriptor& desc) {
@@ -82,6 +84,57 @@ void* CompoundPredicate::NotComputeFn(Expr* e, TupleRow* row) {
   return &p->result_.bool_val;
 }
 
+void CompoundPredicate::EvalBatch(RowBatch* batch, const bool* selected,
+    ExprValueVector* result) {
+  int num_rows = batch->num_rows();
+  ExprValueVector* lhs = children_[0]->GetValues(batch, selected);
+  const bool* a = lhs->values<bool>();
+  const bool* a_null = lhs->is_null();
+  bool* r = result->values<bool>();
+  bool* r_null = result->is_null();
+  if (children_.size() == 1) {
+    DCHECK_EQ(fn_.name.function_name, "not");
+    for (int i = 0; i < num_rows; ++i) {
+      r[i] = !a[i];
+    }
+    memcpy(r_null, a_null, num_rows);
+    return;
+  }
+
+  bool is_and = fn_.name.function_name == "and";
+  DCHECK(is_and || fn_.name.function_name == "or");
+  // A false lhs determines the result of AND and a true lhs the result of OR, so the
+  // rhs is only evaluated for the other rows.
+  if (rhs_selected_capacity_ < batch->capacity()) {
+    rhs_selected_.reset(new bool[batch->capacity()]);
+    rhs_selected_capacity_ = batch->capacity();
+  }
+  for (int i = 0; i < num_rows; ++i) {
+    rhs_selected_[i] =
+        (selected == NULL || selected[i]) && (a_null[i] | (a[i] == is_and));
+  }
+  ExprValueVector* rhs = children_[1]->GetValues(batch, rhs_selected_.get());
+  const bool* b = rhs->values<bool>();
+  const bool* b_null = rhs->is_null();
+  if (is_and) {
+    // false AND <anything> is false, true AND NULL is NULL.
+    for (int i = 0; i < num_rows; ++i) {
+      bool a_false = !a_null[i] & !a[i];
+      bool b_false = rhs_selected_[i] & !b_null[i] & !b[i];
+      r[i] = !(a_false | b_false);
+      r_null[i] = r[i] & (a_null[i] | (rhs_selected_[i] & b_null[i]));
+    }
+  } else {
+    // true OR <anything> is true, false OR NULL is NULL.
+    for (int i = 0; i < num_rows; ++i) {
+      bool a_true = !a_null[i] & a[i];
+      bool b_true = rhs_selected_[i] & !b_null[i] & b[i];
+      r[i] = a_true | b_true;
+      r_null[i] = !r[i] & (a_null[i] | (rhs_selected_[i] & b_null[i]));
+    }
+  }
+}
+
 string CompoundPredicate::DebugString() const {
   stringstream out;
   out << "CompoundPredicate(" << Expr::DebugString() << ")";
@@ -25,6 +25,7 @@ namespace impala {
 class CompoundPredicate: public Predicate {
  public:
   virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
+  virtual bool PrefersBatchEval() const { return AnyChildPrefersBatchEval(); }
 
  protected:
   friend class Expr;
@@ -34,6 +35,8 @@ class CompoundPredicate: public Predicate {
   virtual Status Prepare(RuntimeState* state, const RowDescriptor& desc);
   virtual std::string DebugString() const;
 
+  virtual void EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result);
+
  private:
   friend class OpcodeRegistry;
 
@@ -43,6 +46,11 @@ class CompoundPredicate: public Predicate {
   static void* AndComputeFn(Expr* e, TupleRow* row);
   static void* OrComputeFn(Expr* e, TupleRow* row);
   static void* NotComputeFn(Expr* e, TupleRow* row);
+
+  // Rows for which the rhs of AND/OR needs to be evaluated by EvalBatch(), i.e. the
+  // selected rows for which the lhs does not determine the result.
+  boost::scoped_array<bool> rhs_selected_;
+  int rhs_selected_capacity_;
 };
 
 }
@@ -6,6 +6,8 @@
 #include <thrift/protocol/TDebugProtocol.h>
 
 #include "exprs/expr.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
 #include "util/benchmark.h"
 #include "util/cpu-info.h"
 #include "util/debug-util.h"
@@ -125,8 +127,39 @@ void BenchmarkQueryFn(int batch_size, void* d) {
   }
 }
 
+// Returns a batch of ITERATIONS empty rows for evaluating the constant exprs.
+static RowBatch* GetRowBatch() {
+  static MemTracker tracker;
+  static RowBatch* batch = NULL;
+  if (batch == NULL) {
+    batch = new RowBatch(RowDescriptor(), ITERATIONS, &tracker);
+    batch->AddRows(ITERATIONS);
+    batch->CommitRows(ITERATIONS);
+  }
+  return batch;
+}
+
+// Benchmark driver to run expr over a batch of ITERATIONS rows with
+// Expr::GetValues().
+void BenchmarkBatchQueryFn(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  RowBatch* batch = GetRowBatch();
+  for (int i = 0; i < batch_size; ++i) {
+    ExprValueVector* values = data->root->GetValues(batch, NULL);
+    // Dummy result to prevent this from being optimized away
+    data->dummy_result += reinterpret_cast<int64_t>(values->GetValue(ITERATIONS - 1));
+  }
+}
+
 #define BENCHMARK(name, stmt)\
   suite->AddBenchmark(name, BenchmarkQueryFn, GenerateBenchmarkExprs(stmt, false))
+
+// Adds benchmarks for evaluating 'stmt' a row at a time and a batch at a time.
+#define BENCHMARK_ROW_AND_BATCH(name, stmt)\
+  suite->AddBenchmark(name, BenchmarkQueryFn, GenerateBenchmarkExprs(stmt, false));\
+  suite->AddBenchmark(name "-batch", BenchmarkBatchQueryFn,\
+      GenerateBenchmarkExprs(stmt, false))
+
 // Machine Info: Intel(R) Core(TM) i7-2600 CPU @ 3.40GHz
 // Literals:             Function                Rate          Comparison
 // ----------------------------------------------------------------------
@@ -221,6 +254,20 @@ Benchmark* BenchmarkCast() {
 //                   if_timestamp               70.19            0.07996X
 //                  coalesce_bool               194.2             0.2213X
 //                       case_int                 259             0.2951X
+// Compares evaluating exprs a row at a time with GetValue() to evaluating them a
+// batch at a time with GetValues(). The last case has no batch kernel and shows the
+// overhead of the row by row fallback.
+Benchmark* BenchmarkBatchEval() {
+  Benchmark* suite = new Benchmark("BatchEval");
+  BENCHMARK_ROW_AND_BATCH("int-add", "1 + 2");
+  BENCHMARK_ROW_AND_BATCH("double-multiply", "1.1 * 2.2 + 3.3");
+  BENCHMARK_ROW_AND_BATCH("int-lt", "1 < 2");
+  BENCHMARK_ROW_AND_BATCH("int_to_double", "cast(1 as DOUBLE)");
+  BENCHMARK_ROW_AND_BATCH("compound", "1 < 2 and 2.5 > 1.5 or 3 = 4");
+  BENCHMARK_ROW_AND_BATCH("string_eq", "'abc' = 'abd'");
+  return suite;
+}
+
 Benchmark* BenchmarkConditionalFunctions() {
 // TODO: expand these cases when the parser issues are fixed (see corresponding tests
 // in expr-test).
@@ -505,6 +552,7 @@ int main(int argc, char** argv) {
   Benchmark* arithmetics = BenchmarkArithmetic();
   Benchmark* like = BenchmarkLike();
   Benchmark* cast = BenchmarkCast();
+  Benchmark* batch_eval = BenchmarkBatchEval();
   Benchmark* conditional_fns = BenchmarkConditionalFunctions();
   Benchmark* string_fns = BenchmarkStringFunctions();
   Benchmark* url_fns = BenchmarkUrlFunctions();
@@ -516,6 +564,7 @@ int main(int argc, char** argv) {
   cout << arithmetics->Measure() << endl;
   cout << like->Measure() << endl;
   cout << cast->Measure() << endl;
+  cout << batch_eval->Measure() << endl;
   cout << conditional_fns->Measure() << endl;
   cout << string_fns->Measure() << endl;
   cout << url_fns->Measure() << endl;
@@ -15,31 +15,40 @@
 #include <string>
 #include <math.h>
 #include <gtest/gtest.h>
+#include <boost/algorithm/string.hpp>
 #include <boost/assign/list_of.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/random/mersenne_twister.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
 #include "common/init.h"
 #include "common/object-pool.h"
+#include "runtime/mem-tracker.h"
 #include "runtime/raw-value.h"
+#include "runtime/row-batch.h"
 #include "runtime/string-value.h"
+#include "runtime/tuple-row.h"
 #include "gen-cpp/Exprs_types.h"
 #include "exprs/bool-literal.h"
 #include "exprs/char-literal.h"
+#include "exprs/common-subexprs.h"
 #include "exprs/float-literal.h"
 #include "exprs/function-call.h"
 #include "exprs/int-literal.h"
 #include "exprs/is-null-predicate.h"
 #include "exprs/like-predicate.h"
 #include "exprs/null-literal.h"
+#include "exprs/slot-ref.h"
 #include "exprs/string-literal.h"
+#include "exprs/timestamp-literal.h"
 #include "codegen/llvm-codegen.h"
 #include "util/debug-util.h"
 #include "util/string-parser.h"
 #include "rpc/thrift-server.h"
 #include "rpc/thrift-client.h"
 #include "testutil/in-process-servers.h"
+#include "testutil/desc-tbl-builder.h"
 #include "testutil/impalad-query-executor.h"
 #include "service/impala-server.h"
 #include "service/fe-support.h"
@@ -652,6 +661,379 @@ TEST_F(ExprTest, NullLiteral) {
   }
 }
 
+// Tests that literals evaluated a batch at a time return their value for each row.
+TEST_F(ExprTest, BatchEvalLiterals) {
+  ObjectPool pool;
+  MemTracker tracker;
+  RuntimeState state(TUniqueId(), TUniqueId(), TQueryContext(), "", NULL);
+  RowBatch batch(RowDescriptor(), 16, &tracker);
+  batch.AddRows(10);
+  batch.CommitRows(10);
+  ASSERT_EQ(batch.num_rows(), 10);
+
+  int32_t i_val = 234;
+  double d_val = 1.23;
+  bool b_val = true;
+  vector<Expr*> exprs;
+  exprs.push_back(Expr::CreateLiteral(&pool, TYPE_INT, &i_val));
+  exprs.push_back(Expr::CreateLiteral(&pool, TYPE_DOUBLE, &d_val));
+  exprs.push_back(Expr::CreateLiteral(&pool, TYPE_BOOLEAN, &b_val));
+  for (int i = 0; i < exprs.size(); ++i) {
+    ASSERT_TRUE(Expr::Prepare(exprs[i], &state, RowDescriptor(), true).ok());
+    ExprValueVector* values = exprs[i]->GetValues(&batch, NULL);
+    for (int j = 0; j < batch.num_rows(); ++j) {
+      ASSERT_TRUE(values->GetValue(j) != NULL);
+      EXPECT_EQ(RawValue::Compare(values->GetValue(j), exprs[i]->GetValue(NULL),
+          exprs[i]->type()), 0);
+    }
+  }
+
+  NullLiteral null_expr(TYPE_INT);
+  ASSERT_TRUE(Expr::Prepare(&null_expr, &state, RowDescriptor(), true).ok());
+  ExprValueVector* values = null_expr.GetValues(&batch, NULL);
+  for (int j = 0; j < batch.num_rows(); ++j) {
+    EXPECT_TRUE(values->GetValue(j) == NULL);
+  }
+}
+
+// Evaluates exprs over slots a (INT), b (INT), p (BOOLEAN), q (BOOLEAN) and d (DOUBLE)
+// a batch at a time, to test the batch kernels. The exprs only name their functions,
+// so they have no row-at-a-time compute functions.
+class BatchEvalTest : public testing::Test {
+ protected:
+  // The builder numbers the slots after the tuple.
+  enum { A = 2, B, P, Q, D };
+
+  BatchEvalTest() : state_(TUniqueId(), TUniqueId(), QueryContext(), "", NULL) {}
+
+  // now() returns the start time of the query.
+  static TQueryContext QueryContext() {
+    TQueryContext query_ctxt;
+    query_ctxt.now_string = "2014-06-01 12:00:00";
+    return query_ctxt;
+  }
+
+  virtual void SetUp() {
+    DescriptorTblBuilder builder(&pool_);
+    builder.DeclareTuple() << TYPE_INT << TYPE_INT << TYPE_BOOLEAN << TYPE_BOOLEAN
+                           << TYPE_DOUBLE;
+    DescriptorTbl* desc_tbl = builder.Build();
+    state_.set_desc_tbl(desc_tbl);
+    tuple_desc_ = desc_tbl->GetTupleDescriptor(0);
+    row_desc_ = pool_.Add(new RowDescriptor(*desc_tbl, vector<TTupleId>(1, 0),
+        vector<bool>(1, false)));
+    batch_.reset(new RowBatch(*row_desc_, 16, &tracker_));
+  }
+
+  // Adds a row with the comma-separated values of a, b, p, q and d, "NULL" for NULL.
+  void AddRow(const string& values) {
+    vector<string> tokens;
+    split(tokens, values, is_any_of(","));
+    const vector<SlotDescriptor*>& slots = tuple_desc_->slots();
+    ASSERT_EQ(tokens.size(), slots.size());
+    Tuple* tuple =
+        Tuple::Create(tuple_desc_->byte_size(), batch_->tuple_data_pool());
+    for (int i = 0; i < slots.size(); ++i) {
+      void* slot = tuple->GetSlot(slots[i]->tuple_offset());
+      if (tokens[i] == "NULL") {
+        tuple->SetNull(slots[i]->null_indicator_offset());
+      } else if (slots[i]->type().type == TYPE_INT) {
+        *reinterpret_cast<int32_t*>(slot) = lexical_cast<int32_t>(tokens[i]);
+      } else if (slots[i]->type().type == TYPE_BOOLEAN) {
+        *reinterpret_cast<bool*>(slot) = tokens[i] == "1";
+      } else {
+        *reinterpret_cast<double*>(slot) = strtod(tokens[i].c_str(), NULL);
+      }
+    }
+    int row_idx = batch_->AddRow();
+    batch_->GetRow(row_idx)->SetTuple(0, tuple);
+    batch_->CommitLastRow();
+  }
+
+  static TExpr Slot(int slot_id) {
+    TExprNode node;
+    node.node_type = TExprNodeType::SLOT_REF;
+    PrimitiveType type = slot_id == A || slot_id == B ? TYPE_INT :
+        (slot_id == D ? TYPE_DOUBLE : TYPE_BOOLEAN);
+    node.type = ColumnType(type).ToThrift();
+    node.num_children = 0;
+    TSlotRef slot_ref;
+    slot_ref.slot_id = slot_id;
+    node.__set_slot_ref(slot_ref);
+    TExpr expr;
+    expr.nodes.push_back(node);
+    return expr;
+  }
+
+  // Returns the expr 'fn_name'('child') or 'fn_name'('child', 'rhs').
+  static TExpr Fn(TExprNodeType::type node_type, PrimitiveType type,
+      const string& fn_name, const TExpr& child, const TExpr& rhs = TExpr()) {
+    TExprNode node;
+    node.node_type = node_type;
+    node.type = ColumnType(type).ToThrift();
+    node.num_children = rhs.nodes.empty() ? 1 : 2;
+    TFunction fn;
+    fn.name.function_name = fn_name;
+    node.__set_fn(fn);
+    TExpr expr;
+    expr.nodes.push_back(node);
+    expr.nodes.insert(expr.nodes.end(), child.nodes.begin(), child.nodes.end());
+    expr.nodes.insert(expr.nodes.end(), rhs.nodes.begin(), rhs.nodes.end());
+    return expr;
+  }
+
+  // Returns the builtin 'fn_name'() or 'fn_name'('arg'), which is implemented by the
+  // function 'symbol_name' of the class 'class_name'.
+  static TExpr Builtin(PrimitiveType type, const string& fn_name,
+      const string& class_name, const string& symbol_name, const TExpr& arg = TExpr()) {
+    TExprNode node;
+    node.node_type = TExprNodeType::COMPUTE_FUNCTION_CALL;
+    node.type = ColumnType(type).ToThrift();
+    node.num_children = arg.nodes.empty() ? 0 : 1;
+    TFunction fn;
+    fn.name.function_name = fn_name;
+    fn.binary_type = TFunctionBinaryType::BUILTIN;
+    TScalarFunction scalar_fn;
+    scalar_fn.symbol = "_ZN6impala" + lexical_cast<string>(class_name.size()) +
+        class_name + lexical_cast<string>(symbol_name.size()) + symbol_name +
+        "EPNS_4ExprEPNS_8TupleRowE";
+    fn.__set_scalar_fn(scalar_fn);
+    node.__set_fn(fn);
+    TExpr expr;
+    expr.nodes.push_back(node);
+    expr.nodes.insert(expr.nodes.end(), arg.nodes.begin(), arg.nodes.end());
+    return expr;
+  }
+
+  static TExpr IntLit(int32_t value) {
+    TExprNode node;
+    node.node_type = TExprNodeType::INT_LITERAL;
+    node.type = ColumnType(TYPE_INT).ToThrift();
+    node.num_children = 0;
+    TIntLiteral int_literal;
+    int_literal.value = value;
+    node.__set_int_literal(int_literal);
+    TExpr expr;
+    expr.nodes.push_back(node);
+    return expr;
+  }
+
+  static TExpr Arithmetic(const string& fn_name, const TExpr& lhs, const TExpr& rhs) {
+    return Fn(TExprNodeType::ARITHMETIC_EXPR, TYPE_INT, fn_name, lhs, rhs);
+  }
+
+  static TExpr Compare(const string& fn_name, const TExpr& lhs, const TExpr& rhs) {
+    return Fn(TExprNodeType::BINARY_PRED, TYPE_BOOLEAN, fn_name, lhs, rhs);
+  }
+
+  Expr* Create(const TExpr& texpr) {
+    Expr* expr;
+    EXPECT_TRUE(Expr::CreateExprTree(&pool_, texpr, &expr).ok());
+    return expr;
+  }
+
+  // Creates and prepares 'texpr', which folds its constant subtrees.
+  Expr* Prepare(const TExpr& texpr) {
+    Expr* expr = Create(texpr);
+    EXPECT_TRUE(Expr::Prepare(expr, &state_, *row_desc_, true).ok());
+    return expr;
+  }
+
+  static bool IsFoldable(Expr* expr) { return expr->IsFoldable(); }
+
+  // Evaluates 'texpr' over the batch and returns the comma-separated values of the
+  // rows in 'selected', or of all rows if it is NULL.
+  string Eval(const TExpr& texpr, const bool* selected = NULL) {
+    Expr* expr;
+    EXPECT_TRUE(Expr::CreateExprTree(&pool_, texpr, &expr).ok());
+    EXPECT_TRUE(Expr::Prepare(expr, &state_, *row_desc_, true).ok());
+    ExprValueVector* values = expr->GetValues(batch_.get(), selected);
+    vector<string> result;
+    for (int i = 0; i < batch_->num_rows(); ++i) {
+      if (selected != NULL && !selected[i]) continue;
+      string value = "NULL";
+      if (values->GetValue(i) != NULL) {
+        RawValue::PrintValue(values->GetValue(i), expr->type(), -1, &value);
+      }
+      result.push_back(value);
+    }
+    return join(result, ",");
+  }
+
+  ObjectPool pool_;
+  MemTracker tracker_;
+  RuntimeState state_;
+  TupleDescriptor* tuple_desc_;
+  RowDescriptor* row_desc_;
+  scoped_ptr<RowBatch> batch_;
+};
+
+// Integer overflow wraps around, division by zero is NULL.
+TEST_F(BatchEvalTest, Arithmetic) {
+  AddRow("2147483647,1,1,1,0");
+  AddRow("-2147483648,-1,1,1,0");
+  AddRow("7,-2,1,1,0");
+  AddRow("7,0,1,1,0");
+  AddRow("NULL,3,1,1,0");
+  AddRow("5,NULL,1,1,0");
+  EXPECT_EQ(Eval(Arithmetic("add", Slot(A), Slot(B))),
+      "-2147483648,2147483647,5,7,NULL,NULL");
+  EXPECT_EQ(Eval(Arithmetic("subtract", Slot(A), Slot(B))),
+      "2147483646,-2147483647,9,7,NULL,NULL");
+  EXPECT_EQ(Eval(Arithmetic("multiply", Slot(A), Slot(B))),
+      "2147483647,-2147483648,-14,0,NULL,NULL");
+  EXPECT_EQ(Eval(Arithmetic("int_divide", Slot(A), Slot(B))),
+      "2147483647,-2147483648,-3,NULL,NULL,NULL");
+  EXPECT_EQ(Eval(Arithmetic("mod", Slot(A), Slot(B))), "0,0,1,NULL,NULL,NULL");
+  EXPECT_EQ(Eval(Fn(TExprNodeType::ARITHMETIC_EXPR, TYPE_INT, "bitnot", Slot(A))),
+      "-2147483648,2147483647,-8,-8,NULL,-6");
+}
+
+// Rows that an earlier conjunct rejected may hold any values. Dividing them must not
+// trap.
+TEST_F(BatchEvalTest, IntDivideUnselectedRows) {
+  AddRow("-2147483648,-1,1,1,0");
+  AddRow("8,2,1,1,0");
+  AddRow("-2147483648,0,1,1,0");
+  AddRow("9,-3,1,1,0");
+  bool selected[] = { false, true, false, true };
+  EXPECT_EQ(Eval(Arithmetic("int_divide", Slot(A), Slot(B)), selected), "4,-3");
+  EXPECT_EQ(Eval(Arithmetic("mod", Slot(A), Slot(B)), selected), "0,0");
+}
+
+// AND and OR follow three-valued logic.
+TEST_F(BatchEvalTest, CompoundPredicates) {
+  const char* pq[] = { "1,1", "1,0", "1,NULL", "0,1", "0,0", "0,NULL", "NULL,1",
+      "NULL,0", "NULL,NULL" };
+  for (int i = 0; i < 9; ++i) AddRow(string("0,0,") + pq[i] + ",0");
+  EXPECT_EQ(Eval(Fn(TExprNodeType::COMPOUND_PRED, TYPE_BOOLEAN, "and", Slot(P), Slot(Q))),
+      "true,false,NULL,false,false,false,NULL,false,NULL");
+  EXPECT_EQ(Eval(Fn(TExprNodeType::COMPOUND_PRED, TYPE_BOOLEAN, "or", Slot(P), Slot(Q))),
+      "true,true,true,true,false,NULL,true,NULL,NULL");
+  EXPECT_EQ(Eval(Fn(TExprNodeType::COMPOUND_PRED, TYPE_BOOLEAN, "not", Slot(P))),
+      "false,false,false,true,true,true,NULL,NULL,NULL");
+
+  // Only the selected rows are evaluated.
+  bool selected[] = { true, false, false, true, false, false, false, false, true };
+  EXPECT_EQ(Eval(Fn(TExprNodeType::COMPOUND_PRED, TYPE_BOOLEAN, "and", Slot(P), Slot(Q)),
+      selected), "true,false,NULL");
+}
+
+TEST_F(BatchEvalTest, Casts) {
+  AddRow("300,0,1,0,2.75");
+  AddRow("-2147483648,0,0,0,-2.75");
+  AddRow("NULL,0,0,NULL,NULL");
+  EXPECT_EQ(Eval(Fn(TExprNodeType::CAST_EXPR, TYPE_BIGINT, "casttobigint", Slot(A))),
+      "300,-2147483648,NULL");
+  EXPECT_EQ(Eval(Fn(TExprNodeType::CAST_EXPR, TYPE_TINYINT, "casttotinyint", Slot(A))),
+      "44,0,NULL");
+  EXPECT_EQ(Eval(Fn(TExprNodeType::CAST_EXPR, TYPE_INT, "casttoint", Slot(D))),
+      "2,-2,NULL");
+  EXPECT_EQ(Eval(Fn(TExprNodeType::CAST_EXPR, TYPE_DOUBLE, "casttodouble", Slot(P))),
+      "1,0,0");
+  EXPECT_EQ(Eval(Fn(TExprNodeType::CAST_EXPR, TYPE_BOOLEAN, "casttoboolean", Slot(Q))),
+      "false,false,NULL");
+}
+
+TEST_F(BatchEvalTest, BinaryPredicates) {
+  AddRow("1,2,1,1,0.5");
+  AddRow("2,2,1,0,nan");
+  AddRow("3,2,0,1,-0.5");
+  AddRow("NULL,2,NULL,1,NULL");
+  EXPECT_EQ(Eval(Compare("eq", Slot(A), Slot(B))), "false,true,false,NULL");
+  EXPECT_EQ(Eval(Compare("ne", Slot(A), Slot(B))), "true,false,true,NULL");
+  EXPECT_EQ(Eval(Compare("lt", Slot(A), Slot(B))), "true,false,false,NULL");
+  EXPECT_EQ(Eval(Compare("le", Slot(A), Slot(B))), "true,true,false,NULL");
+  EXPECT_EQ(Eval(Compare("gt", Slot(A), Slot(B))), "false,false,true,NULL");
+  EXPECT_EQ(Eval(Compare("ge", Slot(A), Slot(B))), "false,true,true,NULL");
+  EXPECT_EQ(Eval(Compare("eq", Slot(P), Slot(Q))), "true,false,false,NULL");
+  // NaN is not equal to itself.
+  EXPECT_EQ(Eval(Compare("eq", Slot(D), Slot(D))), "true,false,true,NULL");
+  EXPECT_EQ(Eval(Compare("lt", Slot(D), Slot(D))), "false,false,false,NULL");
+}
+
+// A subexpression computed by several trees is replaced by CachedSubexprs that share
+// one copy of it, and the first tree starts a new row. Slot refs aren't shared.
+TEST_F(BatchEvalTest, CommonSubexprs) {
+  TExpr sum = Arithmetic("add", Slot(A), Slot(B));
+  vector<Expr*> conjuncts(1, Create(Compare("gt", sum, Slot(A))));
+  vector<Expr*> exprs(1, Create(Arithmetic("multiply", sum, Slot(B))));
+  exprs.push_back(Create(Slot(A)));
+  exprs.push_back(Create(Slot(A)));
+  vector<vector<Expr*>*> expr_lists;
+  expr_lists.push_back(&conjuncts);
+  expr_lists.push_back(&exprs);
+  CommonSubexprs subexprs;
+  subexprs.Init(&pool_, expr_lists);
+  EXPECT_EQ(subexprs.num_shared(), 1);
+
+  ASSERT_TRUE(dynamic_cast<NewRowExpr*>(conjuncts[0]) != NULL);
+  EXPECT_TRUE(
+      dynamic_cast<CachedSubexpr*>(conjuncts[0]->GetChild(0)->GetChild(0)) != NULL);
+  EXPECT_TRUE(dynamic_cast<CachedSubexpr*>(exprs[0]->GetChild(0)) != NULL);
+  EXPECT_TRUE(dynamic_cast<SlotRef*>(exprs[1]) != NULL);
+  EXPECT_TRUE(dynamic_cast<SlotRef*>(exprs[2]) != NULL);
+}
+
+// Nondeterministic functions and the exprs containing them are evaluated for every
+// occurrence.
+TEST_F(BatchEvalTest, CommonSubexprsNondeterministic) {
+  TExpr random = Fn(TExprNodeType::COMPUTE_FUNCTION_CALL, TYPE_DOUBLE, "rand", Slot(A));
+  TExpr noisy = Fn(TExprNodeType::ARITHMETIC_EXPR, TYPE_DOUBLE, "add", random, Slot(D));
+  vector<Expr*> conjuncts(1, Create(Compare("gt", noisy, Slot(D))));
+  vector<Expr*> exprs(1, Create(noisy));
+  vector<vector<Expr*>*> expr_lists;
+  expr_lists.push_back(&conjuncts);
+  expr_lists.push_back(&exprs);
+  CommonSubexprs subexprs;
+  subexprs.Init(&pool_, expr_lists);
+  EXPECT_EQ(subexprs.num_shared(), 0);
+  EXPECT_TRUE(dynamic_cast<NewRowExpr*>(conjuncts[0]) == NULL);
+  EXPECT_TRUE(dynamic_cast<CachedSubexpr*>(exprs[0]) == NULL);
+}
+
+// Constant subtrees are replaced by a single literal, also below exprs that aren't
+// constant, and their values are used for all rows.
+TEST_F(BatchEvalTest, FoldConstants) {
+  AddRow("2013,0,1,0,0");
+  AddRow("2014,0,1,0,0");
+  AddRow("2015,0,0,0,0");
+  TExpr now = Builtin(TYPE_TIMESTAMP, "now", "TimestampFunctions", "Now");
+  TExpr year = Builtin(TYPE_INT, "year", "TimestampFunctions", "Year", now);
+  TExpr lt = Compare("lt", Slot(A), year);
+  TExpr p_and_lt =
+      Fn(TExprNodeType::COMPOUND_PRED, TYPE_BOOLEAN, "and", Slot(P), lt);
+
+  Expr* expr = Prepare(p_and_lt);
+  Expr* folded = expr->GetChild(1)->GetChild(1);
+  ASSERT_TRUE(dynamic_cast<IntLiteral*>(folded) != NULL);
+  EXPECT_EQ(*reinterpret_cast<int32_t*>(folded->GetValue(NULL)), 2014);
+  EXPECT_EQ(Eval(lt), "true,false,false");
+  EXPECT_EQ(Eval(p_and_lt), "true,false,false");
+
+  // now() on its own is folded to the start time of the query.
+  expr = Prepare(Compare("lt", Slot(A), now));
+  EXPECT_TRUE(dynamic_cast<TimestampLiteral*>(expr->GetChild(1)) != NULL);
+}
+
+// rand() returns a different value for every row and UDFs may do so, even if their
+// arguments are constant.
+TEST_F(BatchEvalTest, NondeterministicNotFolded) {
+  TExpr random = Builtin(TYPE_DOUBLE, "rand", "MathFunctions", "Rand");
+  Expr* expr = Prepare(Compare("lt", Slot(D), random));
+  EXPECT_TRUE(dynamic_cast<FunctionCall*>(expr->GetChild(1)) != NULL);
+  expr = Prepare(Compare("lt", Slot(D),
+      Fn(TExprNodeType::ARITHMETIC_EXPR, TYPE_DOUBLE, "add", random, Slot(D))));
+  EXPECT_TRUE(dynamic_cast<FunctionCall*>(expr->GetChild(1)->GetChild(0)) != NULL);
+
+  TExpr udf = Fn(TExprNodeType::FUNCTION_CALL, TYPE_INT, "udf", IntLit(1));
+  udf.nodes[0].fn.binary_type = TFunctionBinaryType::NATIVE;
+  Expr* udf_expr = Create(udf);
+  EXPECT_TRUE(udf_expr->IsConstant());
+  EXPECT_FALSE(IsFoldable(udf_expr));
+  EXPECT_TRUE(IsFoldable(Create(Arithmetic("add", IntLit(1), IntLit(2)))));
+}
+
 TEST_F(ExprTest, LiteralConstruction) {
   bool b_val = true;
   int8_t c_val = 'f';
@@ -1099,7 +1481,6 @@ TEST_F(ExprTest, BetweenPredicate) {
   TestIsNull("NULL between NULL and NULL", TYPE_BOOLEAN);
 }
 
-// Tests with NULLs are in the FE QueryTest.
 TEST_F(ExprTest, InPredicate) {
   // Test integers.
   unordered_map<int, int64_t>::iterator int_iter;
@@ -1156,6 +1537,31 @@ TEST_F(ExprTest, InPredicate) {
   // Test operator precedence.
   TestValue("5+1 in (3, 6, 10)", TYPE_BOOLEAN, true);
   TestValue("5+1 not in (3, 6, 10)", TYPE_BOOLEAN, false);
+
+  // Test NULLs in constant lists.
+  TestValue("1 in (1, NULL)", TYPE_BOOLEAN, true);
+  TestIsNull("1 in (2, NULL)", TYPE_BOOLEAN);
+  TestIsNull("1 not in (2, NULL)", TYPE_BOOLEAN);
+  TestIsNull("'ab' in ('cd', NULL)", TYPE_BOOLEAN);
+  TestIsNull("NULL in (1, 2)", TYPE_BOOLEAN);
+
+  // Test lists that are long enough to be probed with a hash set, with duplicates.
+  stringstream int_list;
+  stringstream string_list;
+  for (int i = 0; i < 200; ++i) {
+    int_list << (i == 0 ? "" : ", ") << (i * 7) % 1000;
+    string_list << (i == 0 ? "" : ", ") << "'v" << i % 150 << "'";
+  }
+  TestValue("700 in (" + int_list.str() + ")", TYPE_BOOLEAN, true);
+  TestValue("701 in (" + int_list.str() + ")", TYPE_BOOLEAN, false);
+  TestValue("701 not in (" + int_list.str() + ")", TYPE_BOOLEAN, true);
+  TestValue("cast(700 as bigint) in (" + int_list.str() + ")", TYPE_BOOLEAN, true);
+  TestValue("cast(700 as double) in (" + int_list.str() + ")", TYPE_BOOLEAN, true);
+  TestValue("cast(700.5 as double) in (" + int_list.str() + ")", TYPE_BOOLEAN, false);
+  TestIsNull("701 in (" + int_list.str() + ", NULL)", TYPE_BOOLEAN);
+  TestValue("'v149' in (" + string_list.str() + ")", TYPE_BOOLEAN, true);
+  TestValue("'v150' in (" + string_list.str() + ")", TYPE_BOOLEAN, false);
+  TestValue("'v150' not in (" + string_list.str() + ")", TYPE_BOOLEAN, true);
 }
 
 TEST_F(ExprTest, StringFunctions) {
@@ -3263,6 +3669,34 @@ TEST_F(ExprTest, UdfInterfaceBuiltins) {
   TestValue("min_bigint()", TYPE_BIGINT, numeric_limits<int64_t>::min());
 }
 
+// Repeated subexpressions in the conjuncts of a select node and in the grouping exprs
+// and aggregate function inputs of an aggregation node are evaluated once per row. The
+// limit keeps the conjuncts out of the union.
+TEST_F(ExprTest, CommonSubexprs) {
+  const string ints = "(select 1 y union all select 2 union all select 3 union all "
+      "select NULL union all select 2 limit 10) t";
+  const string strings = "(select 'a' s union all select 'B' union all select NULL "
+      "union all select 'b' limit 10) t";
+  // A cached result from the previous row would give the wrong answer.
+  TestValue("sum(y * y) from " + ints + " where y * y > 1 and y * y < 9",
+      TYPE_BIGINT, 8);
+  TestValue("count(*) from " + ints + " where y * y > 1 and y * y < 9 and y = 2",
+      TYPE_BIGINT, 2);
+  TestValue("count(*) from " + strings +
+      " where lower(s) = 'b' and length(lower(s)) = 1", TYPE_BIGINT, 2);
+  // Cached NULL results.
+  TestValue("count(*) from " + ints + " where y * y is null or y * y = 1", TYPE_BIGINT, 2);
+  TestValue("count(*) from " + strings + " where lower(s) is null and upper(lower(s)) "
+      "is null", TYPE_BIGINT, 1);
+  // The same subexpression in the select list and the where clause.
+  TestValue("count(y * y) from " + ints + " where y * y < 9", TYPE_BIGINT, 3);
+  // Grouping expr and aggregate function input, with a NULL group.
+  TestValue("sum(k) from (select y * y k, max(y * y) m, count(y * y) c from " + ints +
+      " group by y * y) v where k = m", TYPE_BIGINT, 14);
+  TestValue("count(*) from (select y * y k, count(y * y) c from " + ints +
+      " group by y * y) v where k is null and c = 0", TYPE_BIGINT, 1);
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -53,6 +53,7 @@
 #include "gen-cpp/Exprs_types.h"
 #include "gen-cpp/Data_types.h"
 #include "runtime/lib-cache.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/raw-value.h"
 
@@ -66,6 +67,9 @@ using namespace llvm;
 
 const char* Expr::LLVM_CLASS_NAME = "class.impala::Expr";
 
+// Returned by builtin_fn_name() for exprs that don't evaluate a builtin.
+static const string EMPTY_FN_NAME;
+
 namespace impala {
 
 template<class T>
@@ -160,6 +164,9 @@ Expr* Expr::CreateLiteral(ObjectPool* pool, const ColumnType& type, void* data)
     case TYPE_STRING:
       result = new StringLiteral(*reinterpret_cast<StringValue*>(data));
       break;
+    case TYPE_TIMESTAMP:
+      result = new TimestampLiteral(*reinterpret_cast<TimestampValue*>(data));
+      break;
     case TYPE_CHAR:
       result = new CharLiteral(reinterpret_cast<uint8_t*>(data), type.len);
       break;
@@ -245,6 +252,7 @@ Status Expr::CreateTreeFromThrift(ObjectPool* pool, const vector<TExprNode>& nod
   int num_children = nodes[*node_idx].num_children;
   Expr* expr = NULL;
   RETURN_IF_ERROR(CreateExpr(pool, nodes[*node_idx], &expr));
+  expr->thrift_node_ = apache::thrift::ThriftDebugString(nodes[*node_idx]);
   // assert(parent != NULL || (node_idx == 0 && root_expr != NULL));
   if (parent != NULL) {
     parent->AddChild(expr);
@@ -491,6 +499,8 @@ Status Expr::PrepareChildren(RuntimeState* state, const RowDescriptor& row_desc)
 Status Expr::Prepare(Expr* root, RuntimeState* state, const RowDescriptor& row_desc,
     bool disable_codegen, bool* thread_safe) {
   RETURN_IF_ERROR(root->Prepare(state, row_desc));
+  // state might be NULL when called from tests
+  if (state != NULL) root->FoldConstantChildren(state, row_desc);
   LlvmCodeGen* codegen = NULL;
   // state might be NULL when called from tests
   if (state != NULL && state->codegen_enabled() && !disable_codegen) {
@@ -505,6 +515,72 @@ Status Expr::Prepare(Expr* root, RuntimeState* state, const RowDescriptor& row_d
   return Status::OK;
 }
 
+void Expr::FoldConstantChildren(RuntimeState* state, const RowDescriptor& row_desc) {
+  for (int i = 0; i < children_.size(); ++i) {
+    Expr* child = children_[i];
+    if (!child->IsFoldable()) {
+      child->FoldConstantChildren(state, row_desc);
+      continue;
+    }
+    // The child is prepared, which is all builtins need to be evaluated.
+    void* value = child->GetValue(NULL);
+    Expr* literal = value == NULL ?
+        state->obj_pool()->Add(new NullLiteral(child->type().type)) :
+        CreateLiteral(state->obj_pool(), child->type(), value);
+    Status status = literal->Prepare(state, row_desc);
+    DCHECK(status.ok());
+    VLOG_FILE << "Folded constant expr " << child->DebugString();
+    // The literal holds a copy of the value, so the subtree can release its resources.
+    child->Close(state);
+    children_[i] = literal;
+  }
+}
+
+const string& Expr::builtin_fn_name() const {
+  if (is_udf_call_ || fn_.binary_type != TFunctionBinaryType::BUILTIN) {
+    return EMPTY_FN_NAME;
+  }
+  return fn_.name.function_name;
+}
+
+bool Expr::IsDeterministicNode() const {
+  if (is_udf_call_) return false;
+  // Exprs without a function have an empty name. sleep() is only called for its side
+  // effect.
+  const string& fn_name = fn_.name.function_name;
+  return fn_name.empty() || (fn_.binary_type == TFunctionBinaryType::BUILTIN &&
+      fn_name != "rand" && fn_name != "sleep");
+}
+
+bool Expr::IsFoldable() const {
+  if (!IsConstant()) return false;
+  // Literals can't be folded any further. Functions without arguments, e.g. now(), can.
+  if (children_.empty() && fn_.name.function_name.empty()) return false;
+  switch (type_.type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+    case TYPE_STRING:
+    case TYPE_TIMESTAMP:
+      break;
+    default:
+      return false;
+  }
+  // IsConstant() is true for rand(), so the whole tree needs to be checked.
+  vector<const Expr*> exprs(1, this);
+  while (!exprs.empty()) {
+    const Expr* expr = exprs.back();
+    exprs.pop_back();
+    if (!expr->IsDeterministicNode()) return false;
+    exprs.insert(exprs.end(), expr->children_.begin(), expr->children_.end());
+  }
+  return true;
+}
+
 bool Expr::codegend_fn_thread_safe() const {
   if (adapter_fn_used_) return false;
   for (int i = 0; i < children_.size(); ++i) {
@@ -604,6 +680,74 @@ bool Expr::IsConstant() const {
   return true;
 }
 
+ExprValueVector::ExprValueVector(const ColumnType& type, int capacity)
+  : type_(type),
+    capacity_(capacity),
+    byte_size_(type.GetByteSize()),
+    values_(new uint8_t[capacity * byte_size_]),
+    is_null_(new bool[capacity]) {
+  DCHECK(Expr::IsBatchEvalType(type));
+  // Kernels compute values for NULL and unselected rows too, so the values must be
+  // valid (e.g. bools that are 0 or 1).
+  memset(values_.get(), 0, capacity * byte_size_);
+  memset(is_null_.get(), 0, capacity);
+}
+
+bool Expr::IsBatchEvalType(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_NULL:
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+    case TYPE_TIMESTAMP:
+    case TYPE_DECIMAL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+ExprValueVector* Expr::GetValues(RowBatch* batch, const bool* selected) {
+  DCHECK(IsBatchEvalType(type_)) << DebugString();
+  if (batch_values_.get() == NULL || batch_values_->capacity() < batch->capacity()) {
+    batch_values_.reset(new ExprValueVector(type_, batch->capacity()));
+  }
+  EvalBatch(batch, selected, batch_values_.get());
+  return batch_values_.get();
+}
+
+void Expr::EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result) {
+  int num_rows = batch->num_rows();
+  for (int i = 0; i < num_rows; ++i) {
+    if (selected != NULL && !selected[i]) continue;
+    result->SetValue(i, GetValue(batch->GetRow(i)));
+  }
+}
+
+bool Expr::AnyChildPrefersBatchEval() const {
+  for (int i = 0; i < children_.size(); ++i) {
+    if (children_[i]->PrefersBatchEval()) return true;
+  }
+  return false;
+}
+
+void Expr::EvalConstantBatch(RowBatch* batch, ExprValueVector* result) {
+  DCHECK(IsConstant());
+  void* value = GetValue(NULL);
+  int num_rows = batch->num_rows();
+  if (value == NULL) {
+    memset(result->is_null(), 1, num_rows);
+    return;
+  }
+  for (int i = 0; i < num_rows; ++i) {
+    result->SetValue(i, value);
+  }
+}
+
 int Expr::GetSlotIds(vector<SlotId>* slot_ids) const {
   int n = 0;
   for (int i = 0; i < children_.size(); ++i) {
@@ -697,6 +841,63 @@ Value* Expr::CodegenGetValue(LlvmCodeGen* codegen, BasicBlock* parent,
       codegen, parent, args, null_block, not_null_block, result_var_name);
 }
 
+// Example IR for LIKE 'abc%', where the state is the pattern:
+//
+// define i1 @LikePredicate(i8** %row, i8* %state_data, i1* %is_null) {
+// entry:
+//   %arg = call %"struct.impala::StringValue"* @SlotRef(i8** %row, i8* %state_data,
+//       i1* %is_null)
+//   %child_null = load i1* %is_null
+//   br i1 %child_null, label %null, label %call
+//
+// call:                                             ; preds = %entry
+//   %result = call i1 @IrLikeStartsWith(%"struct.impala::StringValue"* inttoptr
+//       (i64 67436256 to %"struct.impala::StringValue"*),
+//       %"struct.impala::StringValue"* %arg)
+//   ret i1 %result
+//
+// null:                                             ; preds = %entry
+//   ret i1 false
+// }
+Function* Expr::CodegenCallIrFn(LlvmCodeGen* codegen, const string& name,
+    Function* ir_fn, const void* state, const vector<int>& child_idxs) {
+  DCHECK(ir_fn != NULL);
+  DCHECK(!child_idxs.empty());
+  for (int i = 0; i < child_idxs.size(); ++i) {
+    if (children_[child_idxs[i]]->Codegen(codegen) == NULL) return NULL;
+  }
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Function* function = CreateComputeFnPrototype(codegen, name);
+  BasicBlock* entry_block = BasicBlock::Create(context, "entry", function);
+  BasicBlock* call_block = BasicBlock::Create(context, "call", function);
+  BasicBlock* null_block = BasicBlock::Create(context, "null", function);
+
+  vector<Value*> args;
+  if (state != NULL) {
+    Type* state_type = ir_fn->getFunctionType()->getParamType(0);
+    args.push_back(codegen->CastPtrToLlvmPtr(state_type, state));
+  }
+  // The children set the is_null arg, so it is already correct when returning.
+  BasicBlock* current_block = entry_block;
+  for (int i = 0; i < child_idxs.size(); ++i) {
+    BasicBlock* not_null_block = (i == child_idxs.size() - 1) ? call_block :
+        BasicBlock::Create(context, "not_null", function, call_block);
+    args.push_back(children_[child_idxs[i]]->CodegenGetValue(
+        codegen, current_block, null_block, not_null_block, "arg"));
+    current_block = not_null_block;
+  }
+
+  builder.SetInsertPoint(call_block);
+  builder.CreateRet(builder.CreateCall(ir_fn, args, "result"));
+
+  builder.SetInsertPoint(null_block);
+  builder.CreateRet(GetNullReturnValue(codegen));
+
+  return codegen->FinalizeFunction(function);
+}
+
 // typedefs for jitted compute functions
 typedef bool (*BoolComputeFn)(TupleRow*, char* , bool*);
 typedef int8_t (*TinyIntComputeFn)(TupleRow*, char*, bool*);
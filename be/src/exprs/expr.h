@@ -18,6 +18,8 @@
 
 #include <string>
 #include <vector>
+#include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "common/status.h"
 #include "runtime/descriptors.h"
@@ -41,6 +43,7 @@ namespace impala {
 class Expr;
 class LlvmCodeGen;
 class ObjectPool;
+class RowBatch;
 class RowDescriptor;
 class RuntimeState;
 class TColumnValue;
@@ -222,6 +225,43 @@ struct ExprValue {
   }
 };
 
+// The values of an expr for the rows of a row batch, returned by Expr::GetValues().
+// Holds one value of the expr's type and one null indicator for each row, indexed by
+// the row's index in the batch. Values are stored as their native type (e.g. an
+// int64_t array for BIGINT) so that batch kernels can loop over them directly.
+// Only types for which Expr::IsBatchEvalType() returns true can be stored.
+class ExprValueVector {
+ public:
+  ExprValueVector(const ColumnType& type, int capacity);
+
+  const ColumnType& type() const { return type_; }
+  int capacity() const { return capacity_; }
+
+  template<typename T> T* values() { return reinterpret_cast<T*>(values_.get()); }
+  bool* is_null() { return is_null_.get(); }
+
+  // Returns a pointer to the value for row 'i', or NULL if the value is NULL.
+  void* GetValue(int i) {
+    DCHECK_LT(i, capacity_);
+    return is_null_[i] ? NULL : values_.get() + i * byte_size_;
+  }
+
+  // Sets the value for row 'i' to the value of type() pointed to by 'value', or to
+  // NULL if 'value' is NULL.
+  void SetValue(int i, const void* value) {
+    DCHECK_LT(i, capacity_);
+    is_null_[i] = value == NULL;
+    if (value != NULL) memcpy(values_.get() + i * byte_size_, value, byte_size_);
+  }
+
+ private:
+  const ColumnType type_;
+  const int capacity_;
+  const int byte_size_;
+  boost::scoped_array<uint8_t> values_;
+  boost::scoped_array<bool> is_null_;
+};
+
 // This is the superclass of all expr evaluation nodes.
 //
 // If codegen is enabled for the query, we will codegen as much of the expr evaluation
@@ -263,6 +303,29 @@ class Expr {
   // requires timestamp in a string format.
   void GetValue(TupleRow* row, bool as_ascii, TColumnValue* col_val);
 
+  // Evaluates the expr for all rows of 'batch' and returns the results, which are
+  // owned by this expr and valid until the next call. If 'selected' is not NULL, only
+  // rows i for which selected[i] is true need to be evaluated and the results for the
+  // other rows are undefined.
+  // Exprs with batch kernels (slot refs, numeric literals, arithmetic exprs, binary
+  // predicates, casts between numeric types and compound predicates) evaluate the
+  // batch with type-specialized loops over the value vectors of their children,
+  // without a function call per row. All other exprs are evaluated by calling
+  // GetValue() for each row. IsBatchEvalType(type()) must be true.
+  ExprValueVector* GetValues(RowBatch* batch, const bool* selected);
+
+  // Returns true if values of 'type' can be stored in an ExprValueVector, i.e. they
+  // are fixed length and don't point to other memory.
+  static bool IsBatchEvalType(const ColumnType& type);
+
+  // Returns true if evaluating this prepared expr with GetValues() is much cheaper than
+  // calling GetValue() for each row, i.e. if the tree contains an expr whose batch path
+  // saves more than a function call per row (a Hive UDF crosses JNI once per batch
+  // instead of once per row) and all exprs above it have batch kernels. Exec nodes that
+  // evaluate exprs one row at a time use this to pick the exprs to evaluate a batch at
+  // a time instead.
+  virtual bool PrefersBatchEval() const { return false; }
+
   // Convenience functions: print value into 'str' or 'stream'.
   // NULL turns into "NULL".
   void PrintValue(TupleRow* row, std::string* str) {
@@ -291,6 +354,10 @@ class Expr {
   const ColumnType& type() const { return type_; }
   bool is_slotref() const { return is_slotref_; }
 
+  // Returns the name of the builtin function this expr evaluates, e.g. "lt" for a '<'
+  // comparison, or an empty string if it doesn't evaluate a builtin.
+  const std::string& builtin_fn_name() const;
+
   const std::vector<Expr*>& children() const { return children_; }
 
   // Returns true if expr doesn't contain slotrefs, ie, can be evaluated
@@ -441,6 +508,8 @@ class Expr {
   friend class ConditionalFunctions;
   friend class UtilityFunctions;
   friend class CaseExpr;
+  friend class CachedSubexpr;
+  friend class CommonSubexprs;
   friend class InPredicate;
   friend class FunctionCall;
   friend class NativeUdfExpr;
@@ -457,6 +526,30 @@ class Expr {
   // Return OK if successful, otherwise return error status.
   Status PrepareChildren(RuntimeState* state, const RowDescriptor& row_desc);
 
+  // Evaluates this expr for the rows of 'batch' into 'result'. See GetValues(). The
+  // default implementation calls GetValue() for each selected row. Subclasses with a
+  // batch kernel override this and call Expr::EvalBatch() for types the kernel does
+  // not support.
+  virtual void EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result);
+
+  // Returns true if PrefersBatchEval() is true for any child. For exprs whose batch
+  // kernel evaluates the children with GetValues().
+  bool AnyChildPrefersBatchEval() const;
+
+  // Sets the values for the rows of 'batch' in 'result' to this constant expr's value.
+  void EvalConstantBatch(RowBatch* batch, ExprValueVector* result);
+
+  // Replaces the constant subtrees below this prepared expr with literals holding their
+  // values, e.g. the now() in 'ts < now()', so they are evaluated once instead of for
+  // every row. Must be called before the tree is codegen'd, so the codegen'd function
+  // uses IR constants. The literals are allocated from the state's object pool.
+  void FoldConstantChildren(RuntimeState* state, const RowDescriptor& row_desc);
+
+  // Returns false if this node may return different results for the same arguments or
+  // has side effects, i.e. if it calls a UDF, rand() or sleep(). Only looks at this
+  // node, not at its children.
+  bool IsDeterministicNode() const;
+
   // Cache entry for the library implementing this function.
   LibCache::LibCacheEntry* cache_entry_;
 
@@ -495,6 +588,14 @@ class Expr {
   // Set to true after Open() has been called.
   bool opened_;
 
+  // Results of the last GetValues() call. Allocated by the first call.
+  boost::scoped_ptr<ExprValueVector> batch_values_;
+
+  // Debug string of the thrift node this expr was created from, or empty if it wasn't
+  // created from thrift. Exprs with the same thrift node and equal children compute the
+  // same value; used by CommonSubexprs.
+  std::string thrift_node_;
+
   // Returns an llvm::Function* with signature:
   // <subclass of AnyVal> ComputeFn(int8_t* context, TupleRow* row)
   //
@@ -535,6 +636,14 @@ class Expr {
       llvm::Function* child, llvm::BasicBlock* null_block,
       llvm::BasicBlock* not_null_block);
 
+  // Codegens a compute function named 'name' that evaluates the children at
+  // 'child_idxs', in order, and returns NULL if any of them is NULL. Otherwise it
+  // returns the result of calling the cross-compiled function 'ir_fn' with the
+  // children's values. If 'state' is not NULL, it is passed as the first argument.
+  // Returns NULL if any of the children can't be codegen'd.
+  llvm::Function* CodegenCallIrFn(LlvmCodeGen* codegen, const std::string& name,
+      llvm::Function* ir_fn, const void* state, const std::vector<int>& child_idxs);
+
   // Returns if the codegen function rooted at this node is thread safe.
   bool codegend_fn_thread_safe() const;
 
@@ -547,6 +656,7 @@ class Expr {
 
  private:
   friend class ExprTest;
+  friend class BatchEvalTest;
 
   // Create a new Expr based on texpr_node.node_type within 'pool'.
   static Status CreateExpr(ObjectPool* pool, const TExprNode& texpr_node, Expr** expr);
@@ -569,6 +679,10 @@ class Expr {
   // Update the compute function with the jitted function.
   void SetComputeFn(void* jitted_function, int scratch_size);
 
+  // Returns true if this prepared expr tree is constant, deterministic and has a type
+  // that can be represented by a literal.
+  bool IsFoldable() const;
+
   // Jit compile expr tree.  Returns a function pointer to the jitted function.
   // scratch_size is an out parameter for the required size of the scratch buffer
   // to call the jitted function.
@@ -610,6 +724,13 @@ class SlotRef : public Expr {
   virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
 
  protected:
+  // Copies the slot of each row into 'result'.
+  virtual void EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result);
+
+  // Batch kernel for slots of 'T', a type with the same size as the slot.
+  template<typename T>
+  void GatherSlots(RowBatch* batch, ExprValueVector* result);
+
   int tuple_idx_;  // within row
   int slot_offset_;  // within tuple
   NullIndicatorOffset null_indicator_offset_;  // within tuple
@@ -60,10 +60,48 @@ Status FunctionCall::Prepare(RuntimeState* state, const RowDescriptor& row_desc)
     } else {
       SetDateTimeFormatCtx(NULL);
     }
+  } else if ((name == "instr" || name == "locate") && children_.size() == 2) {
+    // The string to find is the second argument of instr() and the first of locate().
+    Expr* substr_expr = children_[name == "instr" ? 1 : 0];
+    if (substr_expr->IsConstant()) {
+      StringValue* substr = reinterpret_cast<StringValue*>(substr_expr->GetValue(NULL));
+      if (substr != NULL) {
+        search_string_.assign(substr->ptr, substr->len);
+        search_string_sv_ = StringValue(search_string_);
+        search_.reset(new StringSearch(&search_string_sv_));
+      }
+    }
   }
   return Status::OK;
 }
 
+Function* FunctionCall::Codegen(LlvmCodeGen* codegen) {
+  if (is_udf_call_) return Expr::Codegen(codegen);
+  const string& name = fn_.name.function_name;
+  if (name == "length" || name == "ascii") {
+    IRFunction::Type ir_fn =
+        (name == "length") ? IRFunction::STRING_LENGTH : IRFunction::STRING_ASCII;
+    return CodegenCallIrFn(codegen, "FunctionCall", codegen->GetFunction(ir_fn), NULL,
+        vector<int>(1, 0));
+  }
+  if ((name == "instr" || name == "locate") && children_.size() == 2) {
+    // Index of the child that is searched, and of the string to find.
+    int str_idx = (name == "instr") ? 0 : 1;
+    int substr_idx = 1 - str_idx;
+    if (search_.get() != NULL) {
+      return CodegenCallIrFn(codegen, "FunctionCall",
+          codegen->GetFunction(IRFunction::STRING_FIND_CONSTANT), search_.get(),
+          vector<int>(1, str_idx));
+    }
+    vector<int> child_idxs;
+    child_idxs.push_back(str_idx);
+    child_idxs.push_back(substr_idx);
+    return CodegenCallIrFn(codegen, "FunctionCall",
+        codegen->GetFunction(IRFunction::STRING_INSTR), NULL, child_idxs);
+  }
+  return Expr::Codegen(codegen);
+}
+
 string FunctionCall::DebugString() const {
   stringstream out;
   out << "FunctionCall("
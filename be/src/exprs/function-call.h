@@ -21,6 +21,7 @@
 #include <boost/regex.hpp>
 
 #include "exprs/expr.h"
+#include "runtime/string-search.h"
 #include "runtime/timestamp-parse-util.h"
 
 namespace impala {
@@ -29,6 +30,12 @@ class TExprNode;
 class RuntimeState;
 
 class FunctionCall: public Expr {
+ public:
+  // String functions that return non-string values (length(), ascii(), instr() and
+  // locate()) are codegen'd to calls to cross-compiled functions. All others use the
+  // interpreted compute function.
+  virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
+
  protected:
   friend class Expr;
   friend class StringFunctions;
@@ -54,6 +61,10 @@ class FunctionCall: public Expr {
     return date_time_format_ctx_.get();
   }
 
+  // Returns the search for the constant string to find in instr() and locate(), or
+  // NULL if it is not constant.
+  const StringSearch* GetConstantSearch() const { return search_.get(); }
+
  private:
   // Used in regexp string functions to avoid re-compiling
   // a constant regexp for every function invocation.
@@ -63,6 +74,12 @@ class FunctionCall: public Expr {
   // Used in timestamp date/time parsing with custom formats to avoid
   // parsing for every function invocation.
   boost::scoped_ptr<DateTimeFormatContext> date_time_format_ctx_;
+
+  // The constant string to find in instr() and locate(), and the search for it, which
+  // is only built once.
+  std::string search_string_;
+  StringValue search_string_sv_;
+  boost::scoped_ptr<StringSearch> search_;
 };
 
 }
@@ -21,6 +21,7 @@
 #include "codegen/llvm-codegen.h"
 #include "rpc/thrift-util.h"
 #include "runtime/lib-cache.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "util/bit-util.h"
 #include "util/jni-util.h"
@@ -33,6 +34,7 @@ using namespace boost;
 const char* EXECUTOR_CLASS = "com/cloudera/impala/hive/executor/UdfExecutor";
 const char* EXECUTOR_CTOR_SIGNATURE ="([B)V";
 const char* EXECUTOR_EVALUATE_SIGNATURE = "()V";
+const char* EXECUTOR_EVALUATE_BATCH_SIGNATURE = "(I)V";
 const char* EXECUTOR_CLOSE_SIGNATURE = "()V";
 
 namespace impala {
@@ -43,6 +45,7 @@ struct HiveUdfCall::JniContext {
   jclass class_;
   jobject executor_;
   jmethodID evaluate_id_;
+  jmethodID evaluate_batch_id_;
   jmethodID close_id_;
 
   uint8_t* input_values_buffer_;
@@ -50,17 +53,34 @@ struct HiveUdfCall::JniContext {
   uint8_t* output_value_buffer_;
   uint8_t output_null_value_;
 
+  // Maximum number of rows evaluated by one evaluateBatch() call. 0 if batches are
+  // not supported for the return type.
+  int batch_size_;
+
+  // Columnar buffers for evaluateBatch(), see THiveUdfExecutorCtorParams.
+  uint8_t* batch_input_values_buffer_;
+  uint8_t* batch_input_nulls_buffer_;
+  uint8_t* batch_output_values_buffer_;
+  uint8_t* batch_output_nulls_buffer_;
+
   JniContext() {
     executor_ = NULL;
     input_values_buffer_ = NULL;
     input_nulls_buffer_ = NULL;
     output_value_buffer_ = NULL;
+    batch_size_ = 0;
+    batch_input_values_buffer_ = NULL;
+    batch_input_nulls_buffer_ = NULL;
+    batch_output_values_buffer_ = NULL;
+    batch_output_nulls_buffer_ = NULL;
   }
 };
 
 HiveUdfCall::HiveUdfCall(const TExprNode& node)
   : Expr(node),
-    jni_context_(new JniContext) {
+    jni_context_(new JniContext),
+    batch_jni_timer_(NULL),
+    num_batch_jni_calls_(NULL) {
   is_udf_call_ = true;
   DCHECK_EQ(node.node_type, TExprNodeType::FUNCTION_CALL);
   DCHECK_EQ(node.fn.binary_type, TFunctionBinaryType::HIVE);
@@ -79,6 +99,10 @@ HiveUdfCall::~HiveUdfCall() {
   delete[] jni_context_->input_values_buffer_;
   delete[] jni_context_->input_nulls_buffer_;
   delete[] jni_context_->output_value_buffer_;
+  delete[] jni_context_->batch_input_values_buffer_;
+  delete[] jni_context_->batch_input_nulls_buffer_;
+  delete[] jni_context_->batch_output_values_buffer_;
+  delete[] jni_context_->batch_output_nulls_buffer_;
 }
 
 void* HiveUdfCall::Evaluate(Expr* e, TupleRow* row) {
@@ -132,17 +156,112 @@ void* HiveUdfCall::Evaluate(Expr* e, TupleRow* row) {
   env->CallNonvirtualVoidMethodA(ctx->executor_, ctx->class_, ctx->evaluate_id_, NULL);
   Status status = JniUtil::GetJniExceptionMsg(env);
   if (!status.ok()) {
-    stringstream ss;
-    ss << "Hive UDF path=" << udf->fn_.hdfs_location << " class="
-       << udf->fn_.scalar_fn.symbol
-       << " failed due to: " << status.GetErrorMsg();
-    udf->state_->LogError(ss.str());
+    udf->LogUdfError(status);
     return NULL;
   }
   if (ctx->output_null_value_) return NULL;
   return ctx->output_value_buffer_;
 }
 
+bool HiveUdfCall::PrefersBatchEval() const {
+  return jni_context_->batch_size_ > 0;
+}
+
+void HiveUdfCall::EvalBatch(RowBatch* batch, const bool* selected,
+    ExprValueVector* result) {
+  JniContext* ctx = jni_context_.get();
+  if (ctx->batch_size_ == 0) {
+    Expr::EvalBatch(batch, selected, result);
+    return;
+  }
+  int num_rows = batch->num_rows();
+  int row_idx = 0;
+  while (row_idx < num_rows) {
+    batch_rows_.clear();
+    for (; row_idx < num_rows && batch_rows_.size() < ctx->batch_size_; ++row_idx) {
+      if (selected == NULL || selected[row_idx]) batch_rows_.push_back(row_idx);
+    }
+    if (!batch_rows_.empty()) EvaluateBatch(batch, result);
+  }
+}
+
+void HiveUdfCall::EvaluateBatch(RowBatch* batch, ExprValueVector* result) {
+  JniContext* ctx = jni_context_.get();
+  int num_rows = batch_rows_.size();
+  JNIEnv* env = getJNIEnv();
+  if (env == NULL) {
+    VLOG_QUERY << "Could not get JNIEnv.";
+    for (int i = 0; i < num_rows; ++i) result->SetValue(batch_rows_[i], NULL);
+    return;
+  }
+
+  // Evaluate the children for all rows into the columnar input buffers.
+  batch_string_data_.clear();
+  for (int i = 0; i < GetNumChildren(); ++i) {
+    Expr* child = GetChild(i);
+    bool is_string = child->type().type == TYPE_STRING;
+    int slot_size = child->type().GetSlotSize();
+    uint8_t* values =
+        ctx->batch_input_values_buffer_ + input_byte_offsets_[i] * ctx->batch_size_;
+    uint8_t* nulls = ctx->batch_input_nulls_buffer_ + i * ctx->batch_size_;
+    for (int j = 0; j < num_rows; ++j) {
+      void* v = child->GetValue(batch->GetRow(batch_rows_[j]));
+      nulls[j] = v == NULL;
+      if (v == NULL) continue;
+      if (is_string) {
+        // Store the offset of the copy until all strings are copied, since the
+        // buffer may still be reallocated.
+        const StringValue* str = reinterpret_cast<StringValue*>(v);
+        StringValue copy(reinterpret_cast<char*>(batch_string_data_.size()), str->len);
+        batch_string_data_.append(str->ptr, str->len);
+        memcpy(values + j * slot_size, &copy, slot_size);
+      } else {
+        memcpy(values + j * slot_size, v, slot_size);
+      }
+    }
+  }
+  if (!batch_string_data_.empty()) {
+    char* string_data = const_cast<char*>(batch_string_data_.data());
+    for (int i = 0; i < GetNumChildren(); ++i) {
+      if (GetChild(i)->type().type != TYPE_STRING) continue;
+      StringValue* values = reinterpret_cast<StringValue*>(
+          ctx->batch_input_values_buffer_ + input_byte_offsets_[i] * ctx->batch_size_);
+      uint8_t* nulls = ctx->batch_input_nulls_buffer_ + i * ctx->batch_size_;
+      for (int j = 0; j < num_rows; ++j) {
+        if (nulls[j]) continue;
+        values[j].ptr = string_data + reinterpret_cast<size_t>(values[j].ptr);
+      }
+    }
+  }
+
+  // The executor NULLs the rows the UDF fails on and still evaluates the rest of the
+  // batch. Rows it never got to, e.g. if it threw before the first row, are NULL too.
+  memset(ctx->batch_output_nulls_buffer_, 1, num_rows);
+  jvalue num_rows_arg;
+  num_rows_arg.i = num_rows;
+  {
+    SCOPED_TIMER(batch_jni_timer_);
+    env->CallNonvirtualVoidMethodA(
+        ctx->executor_, ctx->class_, ctx->evaluate_batch_id_, &num_rows_arg);
+  }
+  COUNTER_UPDATE(num_batch_jni_calls_, 1);
+  Status status = JniUtil::GetJniExceptionMsg(env);
+  if (!status.ok()) LogUdfError(status);
+
+  int result_size = type().GetSlotSize();
+  for (int i = 0; i < num_rows; ++i) {
+    result->SetValue(batch_rows_[i], ctx->batch_output_nulls_buffer_[i] ? NULL :
+        ctx->batch_output_values_buffer_ + i * result_size);
+  }
+}
+
+void HiveUdfCall::LogUdfError(const Status& status) {
+  stringstream ss;
+  ss << "Hive UDF path=" << fn_.hdfs_location << " class=" << fn_.scalar_fn.symbol
+     << " failed due to: " << status.GetErrorMsg();
+  state_->LogError(ss.str());
+}
+
 Status HiveUdfCall::Prepare(RuntimeState* state, const RowDescriptor& row_desc) {
   RETURN_IF_ERROR(PrepareChildren(state, row_desc));
   state_ = state;
@@ -162,6 +281,9 @@ Status HiveUdfCall::Prepare(RuntimeState* state, const RowDescriptor& row_desc)
   jni_context_->evaluate_id_ = env->GetMethodID(
       jni_context_->class_, "evaluate", EXECUTOR_EVALUATE_SIGNATURE);
   RETURN_ERROR_IF_EXC(env);
+  jni_context_->evaluate_batch_id_ = env->GetMethodID(
+      jni_context_->class_, "evaluateBatch", EXECUTOR_EVALUATE_BATCH_SIGNATURE);
+  RETURN_ERROR_IF_EXC(env);
   jni_context_->close_id_ = env->GetMethodID(
       jni_context_->class_, "close", EXECUTOR_CLOSE_SIGNATURE);
   RETURN_ERROR_IF_EXC(env);
@@ -188,6 +310,30 @@ Status HiveUdfCall::Prepare(RuntimeState* state, const RowDescriptor& row_desc)
   ctor_params.output_buffer_ptr = (int64_t)jni_context_->output_value_buffer_;
   ctor_params.output_null_ptr = (int64_t)&jni_context_->output_null_value_;
 
+  // Batches are evaluated through ExprValueVectors, which only hold fixed size types.
+  if (IsBatchEvalType(type())) {
+    int batch_size = state->batch_size();
+    jni_context_->batch_size_ = batch_size;
+    jni_context_->batch_input_values_buffer_ =
+        new uint8_t[input_buffer_size * batch_size];
+    jni_context_->batch_input_nulls_buffer_ = new uint8_t[GetNumChildren() * batch_size];
+    jni_context_->batch_output_values_buffer_ =
+        new uint8_t[type().GetSlotSize() * batch_size];
+    jni_context_->batch_output_nulls_buffer_ = new uint8_t[batch_size];
+    ctor_params.__set_batch_size(batch_size);
+    ctor_params.__set_batch_input_nulls_ptr(
+        (int64_t)jni_context_->batch_input_nulls_buffer_);
+    ctor_params.__set_batch_input_buffer_ptr(
+        (int64_t)jni_context_->batch_input_values_buffer_);
+    ctor_params.__set_batch_output_nulls_ptr(
+        (int64_t)jni_context_->batch_output_nulls_buffer_);
+    ctor_params.__set_batch_output_buffer_ptr(
+        (int64_t)jni_context_->batch_output_values_buffer_);
+    batch_jni_timer_ = ADD_TIMER(state->runtime_profile(), "HiveUdfBatchJniTime");
+    num_batch_jni_calls_ =
+        ADD_COUNTER(state->runtime_profile(), "HiveUdfBatchJniCalls", TCounterType::UNIT);
+  }
+
   jbyteArray ctor_params_bytes;
 
   // Add a scoped cleanup jni reference object. This cleans up local refs made
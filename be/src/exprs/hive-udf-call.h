@@ -17,9 +17,11 @@
 #define IMPALA_EXPRS_HIVE_UDF_CALL_H
 
 #include <string>
+#include <vector>
 #include <boost/scoped_ptr.hpp>
 
 #include "exprs/expr.h"
+#include "util/runtime-profile.h"
 
 namespace impala {
 
@@ -51,12 +53,24 @@ class RuntimeState;
 // populates the StringValue with the buffer it allocated from its native heap.
 // The BE reads the StringValue as normal.
 //
+// Crossing JNI for every row dominates the cost of simple UDFs, so when the expr is
+// evaluated a batch at a time (see Expr::GetValues()), EvalBatch() instead fills
+// columnar input buffers for up to batch_size rows, calls UdfExecutor.evaluateBatch()
+// once and reads the results from a columnar output buffer. This is only supported
+// for fixed size return types. String arguments are copied into a buffer that stays
+// valid for the whole batch, since the children's results are only valid until they
+// are evaluated for the next row. Scan nodes and aggregation nodes evaluate conjuncts
+// and aggregate inputs that call such UDFs a batch at a time (see PrefersBatchEval()).
+//
 // If the UDF ran into an error, the FE throws an exception.
 class HiveUdfCall : public Expr {
  public:
   virtual ~HiveUdfCall();
   virtual Status Prepare(RuntimeState* state, const RowDescriptor& row_desc);
 
+  // True if the UDF can be evaluated with one JNI call per batch.
+  virtual bool PrefersBatchEval() const;
+
  protected:
   friend class Expr;
   friend class StringFunctions;
@@ -64,9 +78,18 @@ class HiveUdfCall : public Expr {
   HiveUdfCall(const TExprNode& node);
   virtual std::string DebugString() const;
 
+  virtual void EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result);
+
  private:
   static void* Evaluate(Expr* e, TupleRow* row);
 
+  // Evaluates the rows of 'batch' in batch_rows_ with one JNI call and sets their
+  // results in 'result'.
+  void EvaluateBatch(RowBatch* batch, ExprValueVector* result);
+
+  // Logs 'status', the exception thrown by the UDF, as an error of the query.
+  void LogUdfError(const Status& status);
+
   RuntimeState* state_;
 
   struct JniContext;
@@ -75,6 +98,17 @@ class HiveUdfCall : public Expr {
   // input_byte_offsets_[i] is the byte offset child ith's input argument should
   // be written to.
   std::vector<int> input_byte_offsets_;
+
+  // Indexes of the rows of the batch that are evaluated by the next JNI call.
+  std::vector<int> batch_rows_;
+
+  // Copies of the string arguments of the rows in batch_rows_.
+  std::string batch_string_data_;
+
+  // Total time spent in and number of batched JNI calls. Shared by all Hive UDFs of
+  // the fragment instance.
+  RuntimeProfile::Counter* batch_jni_timer_;
+  RuntimeProfile::Counter* num_batch_jni_calls_;
 };
 
 }
@@ -12,30 +12,190 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <math.h>
 #include <sstream>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_set.hpp>
 
 #include "exprs/in-predicate.h"
 #include "codegen/llvm-codegen.h"
+#include "runtime/decimal-value.h"
 #include "runtime/raw-value.h"
 #include "runtime/string-value.inline.h"
+#include "runtime/timestamp-value.h"
+#include "util/hash-util.h"
 
 using namespace llvm;
 using namespace std;
 
 namespace impala {
 
+// Hash function for the values in a ValueSet.
+template<typename T>
+struct ValueSetHash {
+  size_t operator()(const T& v) const { return boost::hash<T>()(v); }
+};
+
+// boost doesn't hash 128 bit ints.
+template<>
+struct ValueSetHash<int128_t> {
+  size_t operator()(const int128_t& v) const { return HashUtil::Hash(&v, sizeof(v), 0); }
+};
+
+// NaN is not equal to anything, including itself, so it is left out of value sets.
+template<typename T> static inline bool IsNaN(const T& v) { return false; }
+template<> inline bool IsNaN(const float& v) { return isnan(v); }
+template<> inline bool IsNaN(const double& v) { return isnan(v); }
+
+template<typename T>
+class InPredicate::ValueSet : public InPredicate::ValueSetBase {
+ public:
+  // Adds 'v' to the set. Must be called before Finalize().
+  void Insert(const T& v) {
+    if (!IsNaN(v)) values_.push_back(v);
+  }
+
+  // Removes duplicate values and builds the hash set if there are too many values
+  // for a binary search.
+  void Finalize() {
+    sort(values_.begin(), values_.end());
+    values_.erase(unique(values_.begin(), values_.end()), values_.end());
+    if (values_.size() > MAX_SORTED_SET_SIZE) {
+      hash_set_.insert(values_.begin(), values_.end());
+    }
+  }
+
+  bool Contains(const T& v) const {
+    if (values_.size() <= MAX_SORTED_SET_SIZE) {
+      return binary_search(values_.begin(), values_.end(), v);
+    }
+    return hash_set_.find(v) != hash_set_.end();
+  }
+
+  // The distinct values, in ascending order.
+  const vector<T>& values() const { return values_; }
+
+ private:
+  vector<T> values_;
+
+  // Only populated if there are more than MAX_SORTED_SET_SIZE values.
+  boost::unordered_set<T, ValueSetHash<T> > hash_set_;
+};
+
 InPredicate::InPredicate(const TExprNode& node)
   : Predicate(node),
-    is_not_in_(node.in_predicate.is_not_in) {
+    is_not_in_(node.in_predicate.is_not_in),
+    set_has_null_(false) {
 }
 
 Status InPredicate::Prepare(RuntimeState* state, const RowDescriptor& desc) {
   DCHECK_GE(children_.size(), 2);
   Expr::PrepareChildren(state, desc);
   compute_fn_ = ComputeFn;
+  for (int i = 1; i < children_.size(); ++i) {
+    if (!IsPrepareTimeConstant(children_[i])) return Status::OK;
+  }
+  if (!PrepareValueSet()) value_set_.reset();
   return Status::OK;
 }
 
+bool InPredicate::IsPrepareTimeConstant(Expr* e) {
+  // UDFs are only callable once they are opened.
+  if (e->is_udf_call_ || !e->IsConstant()) return false;
+  for (int i = 0; i < e->children_.size(); ++i) {
+    if (!IsPrepareTimeConstant(e->children_[i])) return false;
+  }
+  return true;
+}
+
+template<typename T>
+void InPredicate::BuildValueSet() {
+  ValueSet<T>* value_set = new ValueSet<T>();
+  value_set_.reset(value_set);
+  for (int i = 1; i < children_.size(); ++i) {
+    void* value = children_[i]->GetValue(NULL);
+    if (value == NULL) {
+      set_has_null_ = true;
+      continue;
+    }
+    value_set->Insert(*reinterpret_cast<T*>(value));
+  }
+  value_set->Finalize();
+  compute_fn_ = SetLookupFn<T>;
+}
+
+// The strings are copied since the children's results are only valid until they are
+// evaluated again.
+template<>
+void InPredicate::BuildValueSet<StringValue>() {
+  ValueSet<StringValue>* value_set = new ValueSet<StringValue>();
+  value_set_.reset(value_set);
+  // Reserved so that the StringValues stay valid while the vector is filled.
+  set_string_data_.reserve(children_.size());
+  for (int i = 1; i < children_.size(); ++i) {
+    StringValue* value = reinterpret_cast<StringValue*>(children_[i]->GetValue(NULL));
+    if (value == NULL) {
+      set_has_null_ = true;
+      continue;
+    }
+    set_string_data_.push_back(string(value->ptr, value->len));
+    value_set->Insert(StringValue(set_string_data_.back()));
+  }
+  value_set->Finalize();
+  compute_fn_ = SetLookupFn<StringValue>;
+}
+
+bool InPredicate::PrepareValueSet() {
+  const ColumnType& type = children_[0]->type();
+  switch (type.type) {
+    case TYPE_BOOLEAN:
+      BuildValueSet<bool>();
+      return true;
+    case TYPE_TINYINT:
+      BuildValueSet<int8_t>();
+      return true;
+    case TYPE_SMALLINT:
+      BuildValueSet<int16_t>();
+      return true;
+    case TYPE_INT:
+      BuildValueSet<int32_t>();
+      return true;
+    case TYPE_BIGINT:
+      BuildValueSet<int64_t>();
+      return true;
+    case TYPE_FLOAT:
+      BuildValueSet<float>();
+      return true;
+    case TYPE_DOUBLE:
+      BuildValueSet<double>();
+      return true;
+    case TYPE_STRING:
+      BuildValueSet<StringValue>();
+      return true;
+    case TYPE_TIMESTAMP:
+      BuildValueSet<TimestampValue>();
+      return true;
+    case TYPE_DECIMAL:
+      // Decimals are compared by their unscaled values.
+      switch (type.GetByteSize()) {
+        case 4:
+          BuildValueSet<int32_t>();
+          return true;
+        case 8:
+          BuildValueSet<int64_t>();
+          return true;
+        case 16:
+          BuildValueSet<int128_t>();
+          return true;
+        default:
+          return false;
+      }
+    default:
+      return false;
+  }
+}
+
 string InPredicate::DebugString() const {
   stringstream out;
   out << "InPredicate(" << GetChild(0)->DebugString() << " " << is_not_in_ << ",[";
@@ -72,6 +232,22 @@ void* InPredicate::ComputeFn(Expr* e, TupleRow* row) {
   return &e->result_.bool_val;
 }
 
+template<typename T>
+void* InPredicate::SetLookupFn(Expr* e, TupleRow* row) {
+  void* cmp_val = e->children()[0]->GetValue(row);
+  if (cmp_val == NULL) return NULL;
+  InPredicate* in_pred = static_cast<InPredicate*>(e);
+  const ValueSet<T>* value_set =
+      static_cast<const ValueSet<T>*>(in_pred->value_set_.get());
+  if (value_set->Contains(*reinterpret_cast<T*>(cmp_val))) {
+    e->result_.bool_val = !in_pred->is_not_in_;
+    return &e->result_.bool_val;
+  }
+  if (in_pred->set_has_null_) return NULL;
+  e->result_.bool_val = in_pred->is_not_in_;
+  return &e->result_.bool_val;
+}
+
 // LLVM IR generation for InPredicate. Resulting IR looks like:
 //
 // define i1 @InPredicate(i8** %row, i8* %state_data, i1* %is_null) {
@@ -111,18 +287,25 @@ void* InPredicate::ComputeFn(Expr* e, TupleRow* row) {
 //   store i1 false, i1* %is_null
 //   ret i1 false
 // }
-// TODO: for int types, this can be made more efficient by generating the code
-// as a switch statement.  For example, if the query is int_col in (1,3,5),
-// we could generate:
-//  int cmp_val = children(0)->Eval();
-//  switch (cmp_val) {
-//    case 1: case 3: case 5: return true;
-//    default: return false;
-//  }
-// We'll want to investigate how the resulting asm differs from this implementation
-// i.e. if (cmp_val == 1 || cmp_val == 3 || cmp_val == 5) return true
+// This is only used for IN lists that are not constant and for short constant lists of
+// non-integer types. Constant lists of integers are codegen'd by CodegenSwitch().
 Function* InPredicate::Codegen(LlvmCodeGen* codegen) {
   DCHECK_GE(GetNumChildren(), 1);
+  if (value_set_.get() != NULL) {
+    switch (children()[0]->type().type) {
+      case TYPE_BOOLEAN:
+      case TYPE_TINYINT:
+      case TYPE_SMALLINT:
+      case TYPE_INT:
+      case TYPE_BIGINT:
+        return CodegenSwitch(codegen);
+      default:
+        // Comparing against each value would be slower than the interpreted set
+        // lookup, so call that instead.
+        if (GetNumChildren() - 1 > MAX_SORTED_SET_SIZE) return Expr::Codegen(codegen);
+        break;
+    }
+  }
   for (int i = 0; i < GetNumChildren(); ++i) {
     // Codegen the child exprs
     if (children()[i]->Codegen(codegen) == NULL) return NULL;
@@ -198,4 +381,108 @@ Function* InPredicate::Codegen(LlvmCodeGen* codegen) {
   return codegen->FinalizeFunction(function);
 }
 
+
+// Codegen for constant IN lists of integers. For 'int_col in (1, 3, 5)' the resulting
+// IR looks like:
+//
+// define i1 @InPredicate(i8** %row, i8* %state_data, i1* %is_null) {
+// entry:
+//   %cmp_value = call i32 @SlotRef(i8** %row, i8* %state_data, i1* %is_null)
+//   %child_null = load i1* %is_null
+//   br i1 %child_null, label %null, label %lookup
+//
+// lookup:                                           ; preds = %entry
+//   switch i32 %cmp_value, label %not_found [
+//     i32 1, label %found
+//     i32 3, label %found
+//     i32 5, label %found
+//   ]
+//
+// found:                                            ; preds = %lookup, %lookup, %lookup
+//   store i1 false, i1* %is_null
+//   ret i1 true
+//
+// not_found:                                        ; preds = %lookup
+//   store i1 false, i1* %is_null
+//   ret i1 false
+//
+// null:                                             ; preds = %entry
+//   store i1 true, i1* %is_null
+//   ret i1 false
+// }
+//
+// If the list contains a NULL, not_found returns NULL instead.
+Function* InPredicate::CodegenSwitch(LlvmCodeGen* codegen) {
+  DCHECK(value_set_.get() != NULL);
+  Expr* cmp_expr = children()[0];
+  if (cmp_expr->Codegen(codegen) == NULL) return NULL;
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+
+  Function* function = CreateComputeFnPrototype(codegen, "InPredicate");
+  BasicBlock* entry_block = BasicBlock::Create(context, "entry", function);
+  BasicBlock* lookup_block = BasicBlock::Create(context, "lookup", function);
+  BasicBlock* found_block = BasicBlock::Create(context, "found", function);
+  BasicBlock* not_found_block = BasicBlock::Create(context, "not_found", function);
+  BasicBlock* null_block = BasicBlock::Create(context, "null", function);
+
+  Value* cmp_value = cmp_expr->CodegenGetValue(codegen, entry_block, null_block,
+      lookup_block, "cmp_value");
+
+  builder.SetInsertPoint(lookup_block);
+  int num_values = GetNumChildren() - 1;
+  SwitchInst* switch_inst = builder.CreateSwitch(cmp_value, not_found_block, num_values);
+  switch (cmp_expr->type().type) {
+    case TYPE_BOOLEAN:
+      AddSwitchCases<bool>(codegen, switch_inst, found_block);
+      break;
+    case TYPE_TINYINT:
+      AddSwitchCases<int8_t>(codegen, switch_inst, found_block);
+      break;
+    case TYPE_SMALLINT:
+      AddSwitchCases<int16_t>(codegen, switch_inst, found_block);
+      break;
+    case TYPE_INT:
+      AddSwitchCases<int32_t>(codegen, switch_inst, found_block);
+      break;
+    case TYPE_BIGINT:
+      AddSwitchCases<int64_t>(codegen, switch_inst, found_block);
+      break;
+    default:
+      DCHECK(false) << cmp_expr->type();
+      return NULL;
+  }
+
+  builder.SetInsertPoint(found_block);
+  CodegenSetIsNullArg(codegen, found_block, false);
+  builder.CreateRet(is_not_in_ ? codegen->false_value() : codegen->true_value());
+
+  builder.SetInsertPoint(not_found_block);
+  if (set_has_null_) {
+    CodegenSetIsNullArg(codegen, not_found_block, true);
+    builder.CreateRet(GetNullReturnValue(codegen));
+  } else {
+    CodegenSetIsNullArg(codegen, not_found_block, false);
+    builder.CreateRet(is_not_in_ ? codegen->true_value() : codegen->false_value());
+  }
+
+  builder.SetInsertPoint(null_block);
+  CodegenSetIsNullArg(codegen, null_block, true);
+  builder.CreateRet(GetNullReturnValue(codegen));
+
+  return codegen->FinalizeFunction(function);
+}
+
+template<typename T>
+void InPredicate::AddSwitchCases(LlvmCodeGen* codegen, SwitchInst* switch_inst,
+    BasicBlock* found_block) {
+  const vector<T>& values = static_cast<const ValueSet<T>*>(value_set_.get())->values();
+  IntegerType* type = cast<IntegerType>(codegen->GetType(children()[0]->type()));
+  for (int i = 0; i < values.size(); ++i) {
+    switch_inst->addCase(
+        ConstantInt::get(type, static_cast<int64_t>(values[i]), true), found_block);
+  }
+}
+
 }
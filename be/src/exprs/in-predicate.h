@@ -17,10 +17,21 @@
 #define IMPALA_EXPRS_IN_PREDICATE_H_
 
 #include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
 #include "exprs/predicate.h"
 
+namespace llvm {
+  class SwitchInst;
+}
+
 namespace impala {
 
+// If all values in the IN list are constant, they are evaluated once in Prepare() and
+// rows are probed against a set of them: a sorted array with binary search for short
+// lists and a hash set for longer ones. For integer types the codegen'd function is a
+// switch over the values instead, which llvm lowers to jump tables and binary
+// searches. Otherwise each value in the list is evaluated and compared for each row.
 class InPredicate : public Predicate {
  public:
   virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
@@ -34,8 +45,51 @@ class InPredicate : public Predicate {
   virtual std::string DebugString() const;
 
  private:
-   const bool is_not_in_;
-   static void* ComputeFn(Expr* e, TupleRow* row);
+  // Constant IN lists with more distinct values than this are probed with a hash set,
+  // shorter ones with a binary search.
+  static const int MAX_SORTED_SET_SIZE = 32;
+
+  // The distinct non-NULL values of a constant IN list. Implemented by the typed
+  // ValueSet<T>.
+  class ValueSetBase {
+   public:
+    virtual ~ValueSetBase() { }
+  };
+  template<typename T> class ValueSet;
+
+  const bool is_not_in_;
+
+  // Set in Prepare() if the IN list is constant, NULL otherwise.
+  boost::scoped_ptr<ValueSetBase> value_set_;
+
+  // True if the constant IN list contains a NULL.
+  bool set_has_null_;
+
+  // Copies of the strings in value_set_ for string IN lists.
+  std::vector<std::string> set_string_data_;
+
+  // Returns true if 'e' is constant and can be evaluated before it is opened.
+  static bool IsPrepareTimeConstant(Expr* e);
+
+  // Builds value_set_ from the IN list and sets compute_fn_ to probe it. Returns
+  // false if there is no set implementation for the type of the values.
+  bool PrepareValueSet();
+
+  // Evaluates the constant IN list into value_set_, which holds values of type T.
+  template<typename T> void BuildValueSet();
+
+  // Codegens the switch over the values in value_set_. Only valid for integer types.
+  llvm::Function* CodegenSwitch(LlvmCodeGen* codegen);
+
+  // Adds a case to 'switch_inst' for each value in value_set_.
+  template<typename T> void AddSwitchCases(LlvmCodeGen* codegen,
+      llvm::SwitchInst* switch_inst, llvm::BasicBlock* found_block);
+
+  // Compute function for IN lists that are not constant.
+  static void* ComputeFn(Expr* e, TupleRow* row);
+
+  // Compute function for constant IN lists with values of type T.
+  template<typename T> static void* SetLookupFn(Expr* e, TupleRow* row);
 };
 
 }
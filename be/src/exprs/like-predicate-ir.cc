@@ -0,0 +1,60 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef IR_COMPILE
+#include <re2/re2.h>
+#include <re2/stringpiece.h>
+
+#include "runtime/string-search.h"
+#include "runtime/string-value.inline.h"
+
+using namespace impala;
+
+// Functions called by the codegen'd LikePredicate for constant patterns. The first
+// argument is the state LikePredicate::Prepare() derived from the pattern.
+
+extern "C"
+bool IrLikeSubstring(const StringSearch* search, const StringValue* str) {
+  return search->Search(str) != -1;
+}
+
+extern "C"
+bool IrLikeStartsWith(const StringValue* prefix, const StringValue* str) {
+  if (str->len < prefix->len) return false;
+  return prefix->Eq(StringValue(str->ptr, prefix->len));
+}
+
+extern "C"
+bool IrLikeEndsWith(const StringValue* suffix, const StringValue* str) {
+  if (str->len < suffix->len) return false;
+  return suffix->Eq(StringValue(str->ptr + str->len - suffix->len, suffix->len));
+}
+
+extern "C"
+bool IrLikeEquals(const StringValue* pattern, const StringValue* str) {
+  return pattern->Eq(*str);
+}
+
+extern "C"
+bool IrLikeRegexFullMatch(const re2::RE2* regex, const StringValue* str) {
+  return RE2::FullMatch(re2::StringPiece(str->ptr, str->len), *regex);
+}
+
+extern "C"
+bool IrLikeRegexPartialMatch(const re2::RE2* regex, const StringValue* str) {
+  return RE2::PartialMatch(re2::StringPiece(str->ptr, str->len), *regex);
+}
+#else
+#error "This file should only be used for cross compiling to IR."
+#endif
@@ -20,9 +20,11 @@
 #include <re2/re2.h>
 #include <re2/stringpiece.h>
 
+#include "codegen/llvm-codegen.h"
 #include "runtime/string-value.inline.h"
 
 using namespace boost;
+using namespace llvm;
 using namespace std;
 
 namespace impala {
@@ -221,6 +223,35 @@ Status LikePredicate::Prepare(RuntimeState* state, const RowDescriptor& row_desc
   return Status::OK;
 }
 
+Function* LikePredicate::Codegen(LlvmCodeGen* codegen) {
+  IRFunction::Type ir_fn;
+  const void* state;
+  if (compute_fn_ == ConstantSubstringFn) {
+    ir_fn = IRFunction::LIKE_SUBSTRING;
+    state = &substring_pattern_;
+  } else if (compute_fn_ == ConstantStartsWithFn) {
+    ir_fn = IRFunction::LIKE_STARTS_WITH;
+    state = &search_string_sv_;
+  } else if (compute_fn_ == ConstantEndsWithFn) {
+    ir_fn = IRFunction::LIKE_ENDS_WITH;
+    state = &search_string_sv_;
+  } else if (compute_fn_ == ConstantEqualsFn) {
+    ir_fn = IRFunction::LIKE_EQUALS;
+    state = &search_string_sv_;
+  } else if (compute_fn_ == ConstantRegexFn) {
+    ir_fn = IRFunction::LIKE_REGEX_FULL_MATCH;
+    state = regex_.get();
+  } else if (compute_fn_ == ConstantRegexFnPartial) {
+    ir_fn = IRFunction::LIKE_REGEX_PARTIAL_MATCH;
+    state = regex_.get();
+  } else {
+    // The pattern is not constant, or is NULL.
+    return Expr::Codegen(codegen);
+  }
+  return CodegenCallIrFn(codegen, "LikePredicate", codegen->GetFunction(ir_fn), state,
+      vector<int>(1, 0));
+}
+
 void LikePredicate::ConvertLikePattern(
     const StringValue* pattern, string* re_pattern) const {
   re_pattern->clear();
@@ -33,6 +33,10 @@ class LikePredicate: public Predicate {
  public:
   ~LikePredicate();
 
+  // Constant patterns are codegen'd to calls to cross-compiled functions that use the
+  // state computed in Prepare(). Other patterns use the interpreted path.
+  virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
+
  protected:
   friend class Expr;
   virtual Status Prepare(RuntimeState* state, const RowDescriptor& row_desc);
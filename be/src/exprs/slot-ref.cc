@@ -18,6 +18,7 @@
 
 #include "codegen/llvm-codegen.h"
 #include "gen-cpp/Exprs_types.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 
 using namespace std;
@@ -84,6 +85,40 @@ Status SlotRef::Prepare(RuntimeState* state, const RowDescriptor& row_desc) {
   return Status::OK;
 }
 
+template<typename T>
+void SlotRef::GatherSlots(RowBatch* batch, ExprValueVector* result) {
+  T* values = result->values<T>();
+  bool* is_null = result->is_null();
+  int num_rows = batch->num_rows();
+  for (int i = 0; i < num_rows; ++i) {
+    Tuple* t = batch->GetRow(i)->GetTuple(tuple_idx_);
+    DCHECK(tuple_is_nullable_ || t != NULL);
+    is_null[i] = t == NULL || t->IsNull(null_indicator_offset_);
+    if (!is_null[i]) values[i] = *reinterpret_cast<T*>(t->GetSlot(slot_offset_));
+  }
+}
+
+void SlotRef::EvalBatch(RowBatch* batch, const bool* selected, ExprValueVector* result) {
+  // Slots are copied by size. Unselected rows are copied as well, which is cheaper than
+  // checking 'selected'.
+  switch (type_.GetByteSize()) {
+    case 1:
+      GatherSlots<int8_t>(batch, result);
+      break;
+    case 2:
+      GatherSlots<int16_t>(batch, result);
+      break;
+    case 4:
+      GatherSlots<int32_t>(batch, result);
+      break;
+    case 8:
+      GatherSlots<int64_t>(batch, result);
+      break;
+    default:
+      Expr::EvalBatch(batch, selected, result);
+  }
+}
+
 int SlotRef::GetSlotIds(vector<SlotId>* slot_ids) const {
   slot_ids->push_back(slot_id_);
   return 1;
@@ -0,0 +1,51 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef IR_COMPILE
+#include "runtime/string-search.h"
+#include "runtime/string-value.inline.h"
+
+using namespace impala;
+
+// Functions called by codegen'd FunctionCalls of string functions that return
+// non-string values. They implement the same semantics as the StringFunctions
+// compute functions.
+
+extern "C"
+int32_t IrStringLength(const StringValue* str) {
+  return str->len;
+}
+
+extern "C"
+int32_t IrStringAscii(const StringValue* str) {
+  // Hive returns 0 when given an empty string.
+  return (str->len == 0) ? 0 : static_cast<int32_t>(str->ptr[0]);
+}
+
+// Used for both instr(str, substr) and locate(substr, str).
+extern "C"
+int32_t IrStringInstr(const StringValue* str, const StringValue* substr) {
+  StringSearch search(substr);
+  // Hive returns positions starting from 1.
+  return search.Search(str) + 1;
+}
+
+// Used for instr() and locate() if the string to find is constant.
+extern "C"
+int32_t IrStringFindConstant(const StringSearch* search, const StringValue* str) {
+  return search->Search(str) + 1;
+}
+#else
+#error "This file should only be used for cross compiling to IR."
+#endif
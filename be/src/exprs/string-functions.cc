@@ -396,21 +396,35 @@ void* StringFunctions::Ascii(Expr* e, TupleRow* row) {
 void* StringFunctions::Instr(Expr* e, TupleRow* row) {
   DCHECK_EQ(e->GetNumChildren(), 2);
   StringValue* str = reinterpret_cast<StringValue*>(e->children()[0]->GetValue(row));
+  if (str == NULL) return NULL;
+  // Hive returns positions starting from 1.
+  const StringSearch* constant_search =
+      static_cast<FunctionCall*>(e)->GetConstantSearch();
+  if (constant_search != NULL) {
+    e->result_.int_val = constant_search->Search(str) + 1;
+    return &e->result_.int_val;
+  }
   StringValue* substr = reinterpret_cast<StringValue*>(e->children()[1]->GetValue(row));
-  if (str == NULL || substr == NULL) return NULL;
+  if (substr == NULL) return NULL;
   StringSearch search(substr);
-  // Hive returns positions starting from 1.
   e->result_.int_val = search.Search(str) + 1;
   return &e->result_.int_val;
 }
 
 void* StringFunctions::Locate(Expr* e, TupleRow* row) {
   DCHECK_EQ(e->GetNumChildren(), 2);
-  StringValue* substr = reinterpret_cast<StringValue*>(e->children()[0]->GetValue(row));
   StringValue* str = reinterpret_cast<StringValue*>(e->children()[1]->GetValue(row));
-  if (str == NULL || substr == NULL) return NULL;
-  StringSearch search(substr);
+  if (str == NULL) return NULL;
   // Hive returns positions starting from 1.
+  const StringSearch* constant_search =
+      static_cast<FunctionCall*>(e)->GetConstantSearch();
+  if (constant_search != NULL) {
+    e->result_.int_val = constant_search->Search(str) + 1;
+    return &e->result_.int_val;
+  }
+  StringValue* substr = reinterpret_cast<StringValue*>(e->children()[0]->GetValue(row));
+  if (substr == NULL) return NULL;
+  StringSearch search(substr);
   e->result_.int_val = search.Search(str) + 1;
   return &e->result_.int_val;
 }
@@ -27,6 +27,11 @@ TimestampLiteral::TimestampLiteral(double val)
   result_.timestamp_val = TimestampValue(val);
 }
 
+TimestampLiteral::TimestampLiteral(const TimestampValue& v)
+  : Expr(TYPE_TIMESTAMP) {
+  result_.timestamp_val = v;
+}
+
 void* TimestampLiteral::ComputeFn(Expr* e, TupleRow* row) {
   TimestampLiteral* l = static_cast<TimestampLiteral*>(e);
   return &l->result_.timestamp_val;
@@ -28,6 +28,7 @@ class TimestampLiteral: public Expr {
   friend class Expr;
 
   TimestampLiteral(double d);
+  TimestampLiteral(const TimestampValue& v);
 
   virtual Status Prepare(RuntimeState* state, const RowDescriptor& row_desc);
   virtual std::string DebugString() const;
@@ -28,6 +28,10 @@ class TExprNode;
 // on non-nullable tuples (see IMPALA-904).
 // TODO: Implement codegen to eliminate overhead on non-nullable tuples.
 class TupleIsNullPredicate: public Predicate {
+ public:
+  // Depends on the row even though it has no children.
+  virtual bool IsConstant() const { return false; }
+
  protected:
   friend class Expr;
 
@@ -0,0 +1,272 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <gtest/gtest.h>
+
+#include "runtime/buffered-block-mgr.h"
+#include "runtime/mem-tracker.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+static const int BLOCK_SIZE = 1024;
+
+TEST(BufferedBlockMgrTest, Reservations) {
+  MemTracker tracker;
+  BufferedBlockMgr block_mgr(&tracker, 4 * BLOCK_SIZE, BLOCK_SIZE);
+  EXPECT_EQ(block_mgr.max_blocks(), 4);
+
+  BufferedBlockMgr::Client* client1;
+  BufferedBlockMgr::Client* client2;
+  BufferedBlockMgr::Client* client3;
+  EXPECT_TRUE(block_mgr.RegisterClient(3, "client1", &client1).ok());
+  EXPECT_EQ(block_mgr.num_unfulfilled_reservations(), 3);
+  // The reservation is backed by consumed memory.
+  EXPECT_EQ(tracker.consumption(), 3 * BLOCK_SIZE);
+  // Only one block is left to reserve.
+  Status status = block_mgr.RegisterClient(2, "client2", &client2);
+  EXPECT_TRUE(status.IsMemLimitExceeded());
+  EXPECT_TRUE(block_mgr.RegisterClient(0, "client3", &client3).ok());
+
+  // client3 can take the one unreserved block but not more.
+  BufferedBlockMgr::Block* block3;
+  EXPECT_TRUE(block_mgr.GetNewBlock(client3, &block3).ok());
+  ASSERT_TRUE(block3 != NULL);
+  BufferedBlockMgr::Block* block;
+  EXPECT_TRUE(block_mgr.GetNewBlock(client3, &block).ok());
+  EXPECT_TRUE(block == NULL);
+
+  // client1 can always get its reserved blocks.
+  vector<BufferedBlockMgr::Block*> blocks;
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(block_mgr.GetNewBlock(client1, &block).ok());
+    ASSERT_TRUE(block != NULL);
+    blocks.push_back(block);
+  }
+  EXPECT_EQ(block_mgr.num_pinned_blocks(), 4);
+  EXPECT_EQ(block_mgr.num_unfulfilled_reservations(), 0);
+  EXPECT_TRUE(block_mgr.GetNewBlock(client1, &block).ok());
+  EXPECT_TRUE(block == NULL);
+
+  block3->Delete();
+  for (int i = 0; i < blocks.size(); ++i) {
+    blocks[i]->Delete();
+  }
+  EXPECT_EQ(block_mgr.num_pinned_blocks(), 0);
+  EXPECT_EQ(block_mgr.num_unfulfilled_reservations(), 3);
+  block_mgr.UnregisterClient(client1);
+  block_mgr.UnregisterClient(client3);
+  EXPECT_EQ(block_mgr.num_unfulfilled_reservations(), 0);
+  // Buffers are freed once no client needs them.
+  EXPECT_EQ(tracker.consumption(), 0);
+}
+
+// Tests that the blocks count against the memory limit of the mgr's parent tracker,
+// both for reservations and for blocks beyond them.
+TEST(BufferedBlockMgrTest, ParentMemLimit) {
+  MemTracker query_tracker(2 * BLOCK_SIZE);
+  BufferedBlockMgr block_mgr(&query_tracker, 4 * BLOCK_SIZE, BLOCK_SIZE);
+
+  BufferedBlockMgr::Client* client;
+  Status status = block_mgr.RegisterClient(3, "client", &client);
+  EXPECT_TRUE(status.IsMemLimitExceeded());
+  // Buffers allocated for the failed reservation are freed.
+  EXPECT_EQ(query_tracker.consumption(), 0);
+
+  EXPECT_TRUE(block_mgr.RegisterClient(1, "client", &client).ok());
+  EXPECT_EQ(query_tracker.consumption(), BLOCK_SIZE);
+  BufferedBlockMgr::Block* reserved_block;
+  EXPECT_TRUE(block_mgr.GetNewBlock(client, &reserved_block).ok());
+  ASSERT_TRUE(reserved_block != NULL);
+  BufferedBlockMgr::Block* unreserved_block;
+  EXPECT_TRUE(block_mgr.GetNewBlock(client, &unreserved_block).ok());
+  ASSERT_TRUE(unreserved_block != NULL);
+  EXPECT_EQ(query_tracker.consumption(), 2 * BLOCK_SIZE);
+  // The pool has room for more blocks, but the parent's limit doesn't.
+  BufferedBlockMgr::Block* block;
+  EXPECT_TRUE(block_mgr.GetNewBlock(client, &block).ok());
+  EXPECT_TRUE(block == NULL);
+
+  reserved_block->Delete();
+  unreserved_block->Delete();
+  block_mgr.UnregisterClient(client);
+  EXPECT_EQ(query_tracker.consumption(), 0);
+}
+
+// Tests that a block beyond a client's reservation doesn't take the buffer backing
+// another client's reservation.
+TEST(BufferedBlockMgrTest, ReservedBuffers) {
+  MemTracker tracker;
+  BufferedBlockMgr block_mgr(&tracker, 2 * BLOCK_SIZE, BLOCK_SIZE);
+  BufferedBlockMgr::Client* reserved_client;
+  BufferedBlockMgr::Client* unreserved_client;
+  EXPECT_TRUE(block_mgr.RegisterClient(1, "reserved", &reserved_client).ok());
+  EXPECT_TRUE(block_mgr.RegisterClient(0, "unreserved", &unreserved_client).ok());
+
+  // The free buffer backs the reservation, a new one is allocated.
+  BufferedBlockMgr::Block* unreserved_block;
+  EXPECT_TRUE(block_mgr.GetNewBlock(unreserved_client, &unreserved_block).ok());
+  ASSERT_TRUE(unreserved_block != NULL);
+  EXPECT_EQ(tracker.consumption(), 2 * BLOCK_SIZE);
+
+  BufferedBlockMgr::Block* reserved_block;
+  EXPECT_TRUE(block_mgr.GetNewBlock(reserved_client, &reserved_block).ok());
+  ASSERT_TRUE(reserved_block != NULL);
+  BufferedBlockMgr::Block* block;
+  EXPECT_TRUE(block_mgr.GetNewBlock(unreserved_client, &block).ok());
+  EXPECT_TRUE(block == NULL);
+
+  reserved_block->Delete();
+  unreserved_block->Delete();
+  block_mgr.UnregisterClient(reserved_client);
+  block_mgr.UnregisterClient(unreserved_client);
+}
+
+// Tests that unpinned blocks are written to scratch when their memory is needed and
+// read back when they are pinned.
+TEST(BufferedBlockMgrTest, Eviction) {
+  MemTracker tracker;
+  BufferedBlockMgr block_mgr(&tracker, 2 * BLOCK_SIZE, BLOCK_SIZE);
+  BufferedBlockMgr::Client* client;
+  EXPECT_TRUE(block_mgr.RegisterClient(1, "client", &client).ok());
+
+  // Fill four blocks with different values, unpinning each one after it is written.
+  const int num_blocks = 4;
+  const int num_values = BLOCK_SIZE / sizeof(int32_t);
+  vector<BufferedBlockMgr::Block*> blocks;
+  for (int i = 0; i < num_blocks; ++i) {
+    BufferedBlockMgr::Block* block;
+    EXPECT_TRUE(block_mgr.GetNewBlock(client, &block).ok());
+    ASSERT_TRUE(block != NULL);
+    int32_t* data = block->Allocate<int32_t>(BLOCK_SIZE);
+    ASSERT_TRUE(data != NULL);
+    EXPECT_EQ(block->BytesRemaining(), 0);
+    for (int j = 0; j < num_values; ++j) data[j] = i * num_values + j;
+    EXPECT_TRUE(block->Unpin().ok());
+    blocks.push_back(block);
+  }
+  // Only two blocks fit in memory.
+  EXPECT_EQ(block_mgr.num_blocks_written(), num_blocks - 2);
+
+  for (int i = 0; i < num_blocks; ++i) {
+    bool pinned;
+    EXPECT_TRUE(blocks[i]->Pin(&pinned).ok());
+    ASSERT_TRUE(pinned);
+    const int32_t* data = reinterpret_cast<const int32_t*>(blocks[i]->buffer());
+    for (int j = 0; j < num_values; ++j) {
+      ASSERT_EQ(data[j], i * num_values + j);
+    }
+    EXPECT_TRUE(blocks[i]->Unpin().ok());
+  }
+
+  for (int i = 0; i < num_blocks; ++i) {
+    blocks[i]->Delete();
+  }
+  block_mgr.UnregisterClient(client);
+  EXPECT_EQ(tracker.consumption(), 0);
+}
+
+
+// Fragment instances of the same query share a block mgr and its limit.
+TEST(BufferedBlockMgrTest, QueryBlockMgr) {
+  MemTracker tracker;
+  TUniqueId query_id;
+  query_id.hi = 1;
+  TUniqueId other_query_id;
+  other_query_id.hi = 2;
+  shared_ptr<BufferedBlockMgr> block_mgr1 = BufferedBlockMgr::GetQueryBlockMgr(
+      query_id, &tracker, 2 * BLOCK_SIZE, BLOCK_SIZE, "/tmp");
+  shared_ptr<BufferedBlockMgr> block_mgr2 = BufferedBlockMgr::GetQueryBlockMgr(
+      query_id, &tracker, 2 * BLOCK_SIZE, BLOCK_SIZE, "/tmp");
+  shared_ptr<BufferedBlockMgr> other_block_mgr = BufferedBlockMgr::GetQueryBlockMgr(
+      other_query_id, &tracker, 2 * BLOCK_SIZE, BLOCK_SIZE, "/tmp");
+  EXPECT_EQ(block_mgr1.get(), block_mgr2.get());
+  EXPECT_NE(block_mgr1.get(), other_block_mgr.get());
+
+  // The second instance can't reserve what the first one did.
+  BufferedBlockMgr::Client* client1;
+  BufferedBlockMgr::Client* client2;
+  EXPECT_TRUE(block_mgr1->RegisterClient(2, "client1", &client1).ok());
+  EXPECT_FALSE(block_mgr2->RegisterClient(1, "client2", &client2).ok());
+  block_mgr1->UnregisterClient(client1);
+  EXPECT_TRUE(block_mgr2->RegisterClient(1, "client2", &client2).ok());
+  block_mgr2->UnregisterClient(client2);
+
+  // Once all instances are done, the next one gets a new mgr.
+  block_mgr1.reset();
+  block_mgr2.reset();
+  EXPECT_EQ(tracker.consumption(), 0);
+  block_mgr1 = BufferedBlockMgr::GetQueryBlockMgr(
+      query_id, &tracker, 2 * BLOCK_SIZE, BLOCK_SIZE, "/tmp");
+  EXPECT_EQ(block_mgr1->num_blocks_written(), 0);
+}
+
+// Writes 'num_blocks' blocks of 'client' with values derived from 'thread_id',
+// unpinning each one, then pins them again and checks their contents.
+static void WriteAndReadBlocks(BufferedBlockMgr* block_mgr,
+    BufferedBlockMgr::Client* client, int thread_id, int num_blocks) {
+  const int num_values = BLOCK_SIZE / sizeof(int32_t);
+  vector<BufferedBlockMgr::Block*> blocks;
+  for (int i = 0; i < num_blocks; ++i) {
+    BufferedBlockMgr::Block* block;
+    EXPECT_TRUE(block_mgr->GetNewBlock(client, &block).ok());
+    ASSERT_TRUE(block != NULL);
+    int32_t* data = block->Allocate<int32_t>(BLOCK_SIZE);
+    for (int j = 0; j < num_values; ++j) data[j] = thread_id * num_blocks + i + j;
+    EXPECT_TRUE(block->Unpin().ok());
+    blocks.push_back(block);
+  }
+  for (int i = 0; i < num_blocks; ++i) {
+    bool pinned;
+    EXPECT_TRUE(blocks[i]->Pin(&pinned).ok());
+    ASSERT_TRUE(pinned);
+    const int32_t* data = reinterpret_cast<const int32_t*>(blocks[i]->buffer());
+    for (int j = 0; j < num_values; ++j) {
+      ASSERT_EQ(data[j], thread_id * num_blocks + i + j);
+    }
+    blocks[i]->Delete();
+  }
+}
+
+// Several clients evict each other's blocks concurrently. Scratch I/O is done without
+// holding the mgr's lock, so blocks may be pinned or deleted while they are written.
+TEST(BufferedBlockMgrTest, ConcurrentEviction) {
+  MemTracker tracker;
+  const int num_threads = 4;
+  BufferedBlockMgr block_mgr(&tracker, num_threads * BLOCK_SIZE, BLOCK_SIZE);
+  vector<BufferedBlockMgr::Client*> clients(num_threads);
+  thread_group threads;
+  for (int i = 0; i < num_threads; ++i) {
+    EXPECT_TRUE(block_mgr.RegisterClient(1, "client", &clients[i]).ok());
+    threads.add_thread(
+        new thread(bind(WriteAndReadBlocks, &block_mgr, clients[i], i, 16)));
+  }
+  threads.join_all();
+  EXPECT_GT(block_mgr.num_blocks_written(), 0);
+  for (int i = 0; i < num_threads; ++i) block_mgr.UnregisterClient(clients[i]);
+  EXPECT_EQ(tracker.consumption(), 0);
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
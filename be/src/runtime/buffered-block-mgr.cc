@@ -0,0 +1,469 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/buffered-block-mgr.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sstream>
+
+#include "runtime/mem-tracker.h"
+#include "util/debug-util.h"
+#include "util/error-util.h"
+
+using namespace boost;
+using namespace impala;
+using namespace std;
+
+mutex BufferedBlockMgr::static_block_mgrs_lock_;
+BufferedBlockMgr::BlockMgrsMap BufferedBlockMgr::query_to_block_mgrs_;
+
+// Per-client state.
+struct BufferedBlockMgr::Client {
+  // Used in error messages and DebugString().
+  string label;
+
+  // Number of blocks this client is guaranteed to be able to pin.
+  int num_reserved_blocks;
+
+  // Number of blocks this client currently has pinned.
+  int num_pinned_blocks;
+
+  // Number of blocks this client has that are not deleted.
+  int num_blocks;
+
+  Client(const string& label, int num_reserved_blocks)
+    : label(label), num_reserved_blocks(num_reserved_blocks),
+      num_pinned_blocks(0), num_blocks(0) {
+  }
+};
+
+BufferedBlockMgr::Block::Block(BufferedBlockMgr* block_mgr)
+  : block_mgr_(block_mgr), client_(NULL), buffer_(NULL), valid_data_len_(0),
+    scratch_offset_(-1), is_dirty_(false), is_pinned_(false), in_write_(false) {
+}
+
+int64_t BufferedBlockMgr::Block::BytesRemaining() const {
+  return block_mgr_->block_size_ - valid_data_len_;
+}
+
+Status BufferedBlockMgr::Block::Pin(bool* pinned) {
+  return block_mgr_->PinBlock(this, pinned);
+}
+
+Status BufferedBlockMgr::Block::Unpin() {
+  return block_mgr_->UnpinBlock(this);
+}
+
+void BufferedBlockMgr::Block::Delete() {
+  block_mgr_->DeleteBlock(this);
+}
+
+string BufferedBlockMgr::Block::DebugString() const {
+  stringstream ss;
+  ss << "Block: " << (void*)this
+     << " client=" << (client_ == NULL ? "" : client_->label)
+     << " pinned=" << is_pinned_
+     << " in_memory=" << (buffer_ != NULL)
+     << " dirty=" << is_dirty_
+     << " scratch_offset=" << scratch_offset_
+     << " valid_data_len=" << valid_data_len_;
+  return ss.str();
+}
+
+BufferedBlockMgr::BufferedBlockMgr(MemTracker* parent, int64_t mem_limit,
+    int64_t block_size, const string& scratch_dir)
+  : block_size_(block_size),
+    max_blocks_(mem_limit / block_size),
+    scratch_dir_(scratch_dir),
+    mem_tracker_(new MemTracker(mem_limit, "Buffered Block Mgr", parent)),
+    num_allocated_buffers_(0),
+    num_pinned_blocks_(0),
+    num_unfulfilled_reservations_(0),
+    scratch_fd_(-1),
+    scratch_file_size_(0),
+    num_blocks_written_(0),
+    is_query_block_mgr_(false) {
+  DCHECK_GT(block_size_, 0);
+}
+
+shared_ptr<BufferedBlockMgr> BufferedBlockMgr::GetQueryBlockMgr(
+    const TUniqueId& query_id, MemTracker* parent, int64_t mem_limit,
+    int64_t block_size, const string& scratch_dir) {
+  lock_guard<mutex> l(static_block_mgrs_lock_);
+  BlockMgrsMap::iterator it = query_to_block_mgrs_.find(query_id);
+  if (it != query_to_block_mgrs_.end()) {
+    // The weak ptr is expired if the last user is destroying the mgr right now. A new
+    // mgr is created in that case.
+    shared_ptr<BufferedBlockMgr> block_mgr = it->second.lock();
+    if (block_mgr.get() != NULL) {
+      DCHECK_EQ(block_mgr->block_size_, block_size);
+      DCHECK_EQ(block_mgr->scratch_dir_, scratch_dir);
+      return block_mgr;
+    }
+  }
+  shared_ptr<BufferedBlockMgr> block_mgr(
+      new BufferedBlockMgr(parent, mem_limit, block_size, scratch_dir));
+  block_mgr->query_id_ = query_id;
+  block_mgr->is_query_block_mgr_ = true;
+  query_to_block_mgrs_[query_id] = block_mgr;
+  return block_mgr;
+}
+
+BufferedBlockMgr::~BufferedBlockMgr() {
+  DCHECK_EQ(num_pinned_blocks_, 0) << DebugString();
+  DCHECK_EQ(num_unfulfilled_reservations_, 0) << DebugString();
+  for (list<Block*>::iterator it = unpinned_blocks_.begin();
+       it != unpinned_blocks_.end(); ++it) {
+    free_buffers_.push_back((*it)->buffer_);
+  }
+  DCHECK_EQ(free_buffers_.size(), num_allocated_buffers_);
+  for (int i = 0; i < free_buffers_.size(); ++i) {
+    delete[] free_buffers_[i];
+  }
+  mem_tracker_->Release(num_allocated_buffers_ * block_size_);
+  if (scratch_fd_ != -1) {
+    close(scratch_fd_);
+    unlink(scratch_file_path_.c_str());
+  }
+  mem_tracker_->UnregisterFromParent();
+
+  if (is_query_block_mgr_) {
+    lock_guard<mutex> l(static_block_mgrs_lock_);
+    // Don't erase a new mgr for the same query that replaced this one.
+    BlockMgrsMap::iterator it = query_to_block_mgrs_.find(query_id_);
+    if (it != query_to_block_mgrs_.end() && it->second.expired()) {
+      query_to_block_mgrs_.erase(it);
+    }
+  }
+}
+
+Status BufferedBlockMgr::RegisterClient(int num_reserved_blocks, const string& label,
+    Client** client) {
+  DCHECK_GE(num_reserved_blocks, 0);
+  lock_guard<mutex> l(lock_);
+  // Blocks that are pinned or reserved by other clients cannot be given to this client.
+  int num_available = max_blocks_ - num_pinned_blocks_ - num_unfulfilled_reservations_;
+  if (num_reserved_blocks > num_available) {
+    stringstream ss;
+    ss << "Buffered block mgr could not reserve "
+       << PrettyPrinter::Print(num_reserved_blocks * block_size_, TCounterType::BYTES)
+       << " for " << label << ". Only "
+       << PrettyPrinter::Print(::max(0, num_available) * block_size_,
+           TCounterType::BYTES)
+       << " of " << PrettyPrinter::Print(max_blocks_ * block_size_, TCounterType::BYTES)
+       << " are available.";
+    return Status(TStatusCode::MEM_LIMIT_EXCEEDED, ss.str());
+  }
+  // Back the reservation with buffers, so that its memory counts against the limits
+  // now rather than when the blocks are pinned.
+  int num_needed =
+      num_pinned_blocks_ + num_unfulfilled_reservations_ + num_reserved_blocks;
+  while (num_allocated_buffers_ < num_needed) {
+    uint8_t* buffer = AllocateBuffer();
+    if (buffer == NULL) {
+      FreeUnneededBuffers();
+      stringstream ss;
+      ss << "Buffered block mgr could not reserve "
+         << PrettyPrinter::Print(num_reserved_blocks * block_size_, TCounterType::BYTES)
+         << " for " << label << " without exceeding the memory limit.";
+      return Status(TStatusCode::MEM_LIMIT_EXCEEDED, ss.str());
+    }
+    free_buffers_.push_back(buffer);
+  }
+  *client = obj_pool_.Add(new Client(label, num_reserved_blocks));
+  num_unfulfilled_reservations_ += num_reserved_blocks;
+  return Status::OK;
+}
+
+void BufferedBlockMgr::UnregisterClient(Client* client) {
+  lock_guard<mutex> l(lock_);
+  DCHECK_EQ(client->num_blocks, 0) << client->label;
+  DCHECK_EQ(client->num_pinned_blocks, 0) << client->label;
+  num_unfulfilled_reservations_ -= client->num_reserved_blocks;
+  client->num_reserved_blocks = 0;
+  DCHECK_GE(num_unfulfilled_reservations_, 0);
+  FreeUnneededBuffers();
+}
+
+Status BufferedBlockMgr::GetNewBlock(Client* client, Block** block) {
+  *block = NULL;
+  unique_lock<mutex> l(lock_);
+  if (!CanPin(client)) return Status::OK;
+  uint8_t* buffer;
+  RETURN_IF_ERROR(FindBuffer(&l, client, &buffer));
+  if (buffer == NULL) return Status::OK;
+
+  Block* new_block;
+  if (free_block_objs_.empty()) {
+    new_block = obj_pool_.Add(new Block(this));
+  } else {
+    new_block = free_block_objs_.back();
+    free_block_objs_.pop_back();
+  }
+  new_block->client_ = client;
+  new_block->buffer_ = buffer;
+  new_block->valid_data_len_ = 0;
+  new_block->scratch_offset_ = -1;
+  new_block->is_dirty_ = true;
+  new_block->is_pinned_ = true;
+  new_block->in_write_ = false;
+  ++client->num_blocks;
+  PinnedBlock(client);
+  *block = new_block;
+  return Status::OK;
+}
+
+Status BufferedBlockMgr::PinBlock(Block* block, bool* pinned) {
+  unique_lock<mutex> l(lock_);
+  WaitForWrite(&l, block);
+  *pinned = block->is_pinned_;
+  if (block->is_pinned_) return Status::OK;
+  if (!CanPin(block->client_)) return Status::OK;
+
+  if (block->buffer_ != NULL) {
+    // The block was not evicted, just take it off the unpinned list.
+    unpinned_blocks_.erase(block->unpinned_it_);
+  } else {
+    uint8_t* buffer;
+    RETURN_IF_ERROR(FindBuffer(&l, block->client_, &buffer));
+    if (buffer == NULL) return Status::OK;
+    block->buffer_ = buffer;
+    Status status = ReadFromScratch(&l, block);
+    if (!status.ok()) {
+      free_buffers_.push_back(block->buffer_);
+      block->buffer_ = NULL;
+      return status;
+    }
+  }
+  block->is_pinned_ = true;
+  PinnedBlock(block->client_);
+  *pinned = true;
+  return Status::OK;
+}
+
+Status BufferedBlockMgr::UnpinBlock(Block* block) {
+  lock_guard<mutex> l(lock_);
+  if (!block->is_pinned_) return Status::OK;
+  DCHECK(block->buffer_ != NULL);
+  block->is_pinned_ = false;
+  block->unpinned_it_ = unpinned_blocks_.insert(unpinned_blocks_.end(), block);
+  UnpinnedBlock(block->client_);
+  return Status::OK;
+}
+
+void BufferedBlockMgr::DeleteBlock(Block* block) {
+  unique_lock<mutex> l(lock_);
+  WaitForWrite(&l, block);
+  if (block->is_pinned_) {
+    UnpinnedBlock(block->client_);
+  } else if (block->buffer_ != NULL) {
+    unpinned_blocks_.erase(block->unpinned_it_);
+  }
+  if (block->buffer_ != NULL) free_buffers_.push_back(block->buffer_);
+  if (block->scratch_offset_ != -1) {
+    free_scratch_offsets_.push_back(block->scratch_offset_);
+  }
+  --block->client_->num_blocks;
+  DCHECK_GE(block->client_->num_blocks, 0);
+  block->client_ = NULL;
+  block->buffer_ = NULL;
+  block->is_pinned_ = false;
+  free_block_objs_.push_back(block);
+}
+
+bool BufferedBlockMgr::CanPin(Client* client) const {
+  if (client->num_pinned_blocks < client->num_reserved_blocks) return true;
+  return num_pinned_blocks_ + num_unfulfilled_reservations_ < max_blocks_;
+}
+
+void BufferedBlockMgr::PinnedBlock(Client* client) {
+  if (client->num_pinned_blocks < client->num_reserved_blocks) {
+    --num_unfulfilled_reservations_;
+  }
+  ++client->num_pinned_blocks;
+  ++num_pinned_blocks_;
+}
+
+void BufferedBlockMgr::UnpinnedBlock(Client* client) {
+  --client->num_pinned_blocks;
+  --num_pinned_blocks_;
+  if (client->num_pinned_blocks < client->num_reserved_blocks) {
+    ++num_unfulfilled_reservations_;
+  }
+  DCHECK_GE(client->num_pinned_blocks, 0);
+  DCHECK_GE(num_pinned_blocks_, 0);
+}
+
+bool BufferedBlockMgr::CanReuseBuffer(Client* client) const {
+  // A block within the client's reservation takes the place of an unfulfilled
+  // reservation. Other blocks may only take buffers that no reservation needs.
+  return client->num_pinned_blocks < client->num_reserved_blocks ||
+      num_allocated_buffers_ > num_pinned_blocks_ + num_unfulfilled_reservations_;
+}
+
+Status BufferedBlockMgr::FindBuffer(unique_lock<mutex>* lock, Client* client,
+    uint8_t** buffer) {
+  *buffer = NULL;
+  if (CanReuseBuffer(client) && !free_buffers_.empty()) {
+    *buffer = free_buffers_.back();
+    free_buffers_.pop_back();
+    return Status::OK;
+  }
+
+  *buffer = AllocateBuffer();
+  if (*buffer != NULL) return Status::OK;
+
+  if (!CanReuseBuffer(client) || unpinned_blocks_.empty()) return Status::OK;
+  Block* victim = unpinned_blocks_.front();
+  RETURN_IF_ERROR(WriteUnpinnedBlock(lock, victim));
+  // Other threads may have pinned blocks while lock_ was released for the write. If
+  // the victim's buffer may no longer be used for this client, it becomes a free
+  // buffer instead.
+  if (CanPin(client) && CanReuseBuffer(client)) {
+    *buffer = victim->buffer_;
+  } else {
+    free_buffers_.push_back(victim->buffer_);
+  }
+  victim->buffer_ = NULL;
+  return Status::OK;
+}
+
+uint8_t* BufferedBlockMgr::AllocateBuffer() {
+  if (num_allocated_buffers_ == max_blocks_) return NULL;
+  if (!mem_tracker_->TryConsume(block_size_)) return NULL;
+  ++num_allocated_buffers_;
+  return new uint8_t[block_size_];
+}
+
+void BufferedBlockMgr::FreeUnneededBuffers() {
+  while (!free_buffers_.empty() &&
+      num_allocated_buffers_ > num_pinned_blocks_ + num_unfulfilled_reservations_) {
+    delete[] free_buffers_.back();
+    free_buffers_.pop_back();
+    --num_allocated_buffers_;
+    mem_tracker_->Release(block_size_);
+  }
+}
+
+Status BufferedBlockMgr::WriteUnpinnedBlock(unique_lock<mutex>* lock, Block* block) {
+  DCHECK(!block->is_pinned_);
+  DCHECK(!block->in_write_);
+  DCHECK(block->buffer_ != NULL);
+  // Once the block is off the unpinned list, no other thread evicts it or takes its
+  // buffer.
+  unpinned_blocks_.erase(block->unpinned_it_);
+  if (!block->is_dirty_) return Status::OK;
+
+  Status status = InitScratchFile();
+  if (status.ok()) {
+    if (block->scratch_offset_ == -1) {
+      if (!free_scratch_offsets_.empty()) {
+        block->scratch_offset_ = free_scratch_offsets_.back();
+        free_scratch_offsets_.pop_back();
+      } else {
+        block->scratch_offset_ = scratch_file_size_;
+        scratch_file_size_ += block_size_;
+      }
+    }
+    block->in_write_ = true;
+    int fd = scratch_fd_;
+    lock->unlock();
+    int64_t bytes_written =
+        pwrite(fd, block->buffer_, block->valid_data_len_, block->scratch_offset_);
+    string error_msg = bytes_written != block->valid_data_len_ ? GetStrErrMsg() : "";
+    lock->lock();
+    block->in_write_ = false;
+    write_done_cv_.notify_all();
+    if (bytes_written != block->valid_data_len_) {
+      stringstream ss;
+      ss << "Error writing to scratch file " << scratch_file_path_ << ": " << error_msg;
+      status = Status(ss.str());
+    } else {
+      block->is_dirty_ = false;
+      ++num_blocks_written_;
+    }
+  }
+  if (!status.ok()) {
+    // The block keeps its buffer and is the next to be evicted.
+    block->unpinned_it_ = unpinned_blocks_.insert(unpinned_blocks_.begin(), block);
+  }
+  return status;
+}
+
+Status BufferedBlockMgr::ReadFromScratch(unique_lock<mutex>* lock, Block* block) {
+  DCHECK(block->buffer_ != NULL);
+  DCHECK_NE(block->scratch_offset_, -1);
+  DCHECK_NE(scratch_fd_, -1);
+  int fd = scratch_fd_;
+  lock->unlock();
+  int64_t bytes_read =
+      pread(fd, block->buffer_, block->valid_data_len_, block->scratch_offset_);
+  string error_msg = bytes_read != block->valid_data_len_ ? GetStrErrMsg() : "";
+  lock->lock();
+  if (bytes_read != block->valid_data_len_) {
+    stringstream ss;
+    ss << "Error reading from scratch file " << scratch_file_path_ << ": " << error_msg;
+    return Status(ss.str());
+  }
+  // Clients can modify the block through buffer() once it is pinned, so the scratch
+  // copy must be rewritten the next time the block is evicted.
+  // TODO: add a way to pin blocks read-only to avoid rewriting unmodified blocks.
+  block->is_dirty_ = true;
+  return Status::OK;
+}
+
+void BufferedBlockMgr::WaitForWrite(unique_lock<mutex>* lock, Block* block) {
+  while (block->in_write_) write_done_cv_.wait(*lock);
+}
+
+Status BufferedBlockMgr::InitScratchFile() {
+  if (scratch_fd_ != -1) return Status::OK;
+  string path_template = scratch_dir_ + "/impala-scratch-XXXXXX";
+  vector<char> path(path_template.begin(), path_template.end());
+  path.push_back('\0');
+  scratch_fd_ = mkstemp(&path[0]);
+  if (scratch_fd_ == -1) {
+    stringstream ss;
+    ss << "Could not create scratch file in " << scratch_dir_ << ": " << GetStrErrMsg();
+    return Status(ss.str());
+  }
+  scratch_file_path_ = &path[0];
+  return Status::OK;
+}
+
+int BufferedBlockMgr::num_pinned_blocks() const {
+  lock_guard<mutex> l(lock_);
+  return num_pinned_blocks_;
+}
+
+int BufferedBlockMgr::num_unfulfilled_reservations() const {
+  lock_guard<mutex> l(lock_);
+  return num_unfulfilled_reservations_;
+}
+
+string BufferedBlockMgr::DebugString() const {
+  stringstream ss;
+  ss << "Buffered block mgr:" << endl
+     << "  Block size: " << block_size_ << endl
+     << "  Max blocks: " << max_blocks_ << endl
+     << "  Allocated buffers: " << num_allocated_buffers_ << endl
+     << "  Free buffers: " << free_buffers_.size() << endl
+     << "  Pinned blocks: " << num_pinned_blocks_ << endl
+     << "  Unfulfilled reservations: " << num_unfulfilled_reservations_ << endl
+     << "  Unpinned blocks in memory: " << unpinned_blocks_.size() << endl
+     << "  Blocks written: " << num_blocks_written_;
+  return ss.str();
+}
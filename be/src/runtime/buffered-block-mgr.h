@@ -0,0 +1,335 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_RUNTIME_BUFFERED_BLOCK_MGR_H
+#define IMPALA_RUNTIME_BUFFERED_BLOCK_MGR_H
+
+#include <list>
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "common/logging.h"
+#include "common/object-pool.h"
+#include "common/status.h"
+#include "util/uid-util.h"
+
+namespace impala {
+
+class MemTracker;
+
+// The BufferedBlockMgr is a pool of fixed-size memory blocks. All fragment instances of
+// a query on a backend share one (see GetQueryBlockMgr() and RuntimeState::block_mgr()),
+// so its limit applies to the query as a whole. Operators that need large amounts of
+// memory allocate it in blocks from this pool rather than from the heap, so that there
+// is a single place that enforces how much memory these operators use and that can move
+// data to disk when memory runs out.
+//
+// The model is borrowed from the experimental sorter's BufferPool
+// (experiments/sorting/buffer-pool.h):
+//  - Clients register with the mgr and claim a minimum reservation of blocks,
+//    typically in the operator's Prepare(). The memory for the reserved blocks is
+//    allocated and consumed from the MemTracker at registration. Registration fails
+//    immediately if the pool or the query's memory limit cannot accommodate the
+//    reservation, so a query fails up front rather than midway through execution when
+//    some lazy allocation fails.
+//  - A client can always pin as many blocks as it has reserved. Blocks beyond the
+//    reservation are handed out first come first serve from the unreserved part of the
+//    pool. GetNewBlock() returns NULL (not an error) if no block is available; the
+//    client should then unpin some of its blocks or switch to a lower memory mode.
+//  - Blocks can be unpinned by the client. An unpinned block keeps its data in memory
+//    until the mgr needs its buffer for another pin, at which point its contents are
+//    written to a scratch file. Pinning the block again reads it back.
+//
+// Eviction is done in WriteUnpinnedBlock(), the only place that writes to scratch.
+// Unpinned blocks are evicted in LRU order. Scratch reads and writes are done without
+// holding lock_; a block that is being written is taken off the unpinned list first,
+// and pinning or deleting it waits until the write is done.
+//
+// Memory for the blocks is tracked against the mgr's MemTracker, whose limit is the size
+// of the pool and whose parent is the query's MemTracker, so the blocks count against
+// the query's memory limit. The allocated buffers are never fewer than the pinned
+// blocks plus the unfulfilled reservations: a buffer is only given to a block beyond
+// its client's reservation if it isn't needed to back a reservation. Buffers no client
+// needs are freed when a client is unregistered.
+//
+// All public APIs are thread-safe.
+// TODO: issue scratch writes asynchronously via the DiskIoMgr.
+class BufferedBlockMgr {
+ public:
+  // Opaque handle for a client of the mgr, defined in buffered-block-mgr.cc.
+  struct Client;
+
+  // A fixed-size block of memory from the pool. Blocks are owned by the mgr; clients
+  // hold pointers to them until they call Delete().
+  class Block {
+   public:
+    // Returns the buffer for this block. Only valid while the block is pinned.
+    uint8_t* buffer() const {
+      DCHECK(is_pinned_);
+      return buffer_;
+    }
+
+    // Returns the number of bytes of the block that hold valid data.
+    int64_t valid_data_len() const { return valid_data_len_; }
+
+    // Returns the number of bytes that can still be allocated from this block.
+    int64_t BytesRemaining() const;
+
+    // Allocates 'size' bytes at the end of the valid data in this block and returns
+    // a pointer to it. Returns NULL if there is not enough space left. The block must
+    // be pinned.
+    template <typename T> T* Allocate(int size) {
+      DCHECK(is_pinned_);
+      if (BytesRemaining() < size) return NULL;
+      T* result = reinterpret_cast<T*>(buffer_ + valid_data_len_);
+      valid_data_len_ += size;
+      return result;
+    }
+
+    // Returns the last 'size' bytes allocated from this block.
+    void ReturnAllocation(int size) {
+      DCHECK_GE(valid_data_len_, size);
+      valid_data_len_ -= size;
+    }
+
+    bool is_pinned() const { return is_pinned_; }
+
+    // Pins this block. If the block was evicted, a buffer is found for it and its
+    // contents are read back from scratch. Sets *pinned to false if there was no
+    // buffer available, in which case the block stays unpinned.
+    Status Pin(bool* pinned);
+
+    // Unpins this block. Its contents may be written to scratch if the memory is
+    // needed by another pin.
+    Status Unpin();
+
+    // Deletes this block, returning its buffer and scratch space to the mgr. The
+    // block must not be used after this call.
+    void Delete();
+
+    std::string DebugString() const;
+
+   private:
+    friend class BufferedBlockMgr;
+
+    Block(BufferedBlockMgr* block_mgr);
+
+    BufferedBlockMgr* block_mgr_;
+
+    // The client that allocated this block.
+    Client* client_;
+
+    // The memory for this block. NULL if the block is evicted.
+    uint8_t* buffer_;
+
+    // Length of the valid data in buffer_.
+    int64_t valid_data_len_;
+
+    // Offset of this block's contents in the scratch file, -1 if this block has
+    // never been written.
+    int64_t scratch_offset_;
+
+    // True if the buffer holds data not yet written to scratch.
+    bool is_dirty_;
+
+    bool is_pinned_;
+
+    // True while WriteUnpinnedBlock() writes this block to scratch without holding
+    // lock_.
+    bool in_write_;
+
+    // Iterator into block_mgr_->unpinned_blocks_ if this block is unpinned and still
+    // has its buffer.
+    std::list<Block*>::iterator unpinned_it_;
+  };
+
+  // Creates a block mgr with 'mem_limit' bytes worth of blocks of 'block_size' bytes.
+  // Memory for the blocks is tracked by a new MemTracker that is a child of 'parent'.
+  // Blocks evicted from memory are written to files in 'scratch_dir'.
+  BufferedBlockMgr(MemTracker* parent, int64_t mem_limit, int64_t block_size,
+      const std::string& scratch_dir = "/tmp");
+
+  // Frees all buffers and removes the scratch file. All clients must have been
+  // unregistered.
+  ~BufferedBlockMgr();
+
+  // Returns the block mgr of query 'query_id', creating it if this is the first
+  // fragment instance of the query on this backend. The mgr is destroyed when the last
+  // reference to it goes away. The arguments must be the same for all calls with the
+  // same id; see the constructor for their meaning.
+  static boost::shared_ptr<BufferedBlockMgr> GetQueryBlockMgr(const TUniqueId& query_id,
+      MemTracker* parent, int64_t mem_limit, int64_t block_size,
+      const std::string& scratch_dir);
+
+  // Registers a client that is guaranteed to be able to pin 'num_reserved_blocks'
+  // blocks at any time. Buffers backing the reservation are allocated right away.
+  // 'label' is used in error messages. Returns MEM_LIMIT_EXCEEDED if the pool cannot
+  // guarantee the reservation or the memory for it can't be consumed. On success,
+  // *client is an opaque handle to pass to the other APIs.
+  Status RegisterClient(int num_reserved_blocks, const std::string& label,
+      Client** client);
+
+  // Unregisters the client, releasing its reservation and freeing the buffers that are
+  // no longer needed. All the client's blocks must have been deleted.
+  void UnregisterClient(Client* client);
+
+  // Returns a new, empty, pinned block for 'client' in *block. Sets *block to NULL if
+  // 'client' has used up its reservation and there are no unreserved blocks available.
+  // Returns an error only if evicting another block failed.
+  Status GetNewBlock(Client* client, Block** block);
+
+  int64_t block_size() const { return block_size_; }
+
+  // Returns the total number of blocks in the pool.
+  int max_blocks() const { return max_blocks_; }
+
+  // Returns the number of blocks that are currently pinned.
+  int num_pinned_blocks() const;
+
+  // Returns the number of blocks that are unused but reserved by some client.
+  int num_unfulfilled_reservations() const;
+
+  // Returns the number of blocks that have been written to scratch.
+  int64_t num_blocks_written() const { return num_blocks_written_; }
+
+  MemTracker* mem_tracker() const { return mem_tracker_.get(); }
+
+  std::string DebugString() const;
+
+ private:
+  friend class Block;
+
+  // Returns true if 'client' can pin another block without taking a block reserved by
+  // another client. lock_ must be taken.
+  bool CanPin(Client* client) const;
+
+  // Updates the pinned and reservation counts for 'client' pinning or unpinning a
+  // block. lock_ must be taken.
+  void PinnedBlock(Client* client);
+  void UnpinnedBlock(Client* client);
+
+  // Returns true if a block of 'client' that is about to be pinned may take an
+  // existing buffer: the block is within the client's reservation or the buffer isn't
+  // needed to back another reservation. lock_ must be taken.
+  bool CanReuseBuffer(Client* client) const;
+
+  // Finds a buffer for a block of 'client' that is about to be pinned: a free buffer, a
+  // newly allocated one if the pool is not fully allocated, or the buffer of the least
+  // recently unpinned block, which is evicted. Existing buffers are only used if
+  // CanReuseBuffer(). Sets *buffer to NULL if none of these are available. 'lock' holds
+  // lock_ and is released while an evicted block is written.
+  Status FindBuffer(boost::unique_lock<boost::mutex>* lock, Client* client,
+      uint8_t** buffer);
+
+  // Allocates a new buffer and consumes its memory. Returns NULL if the pool is fully
+  // allocated or the memory can't be consumed. lock_ must be taken.
+  uint8_t* AllocateBuffer();
+
+  // Frees free buffers that are not needed for the pinned blocks and unfulfilled
+  // reservations. lock_ must be taken.
+  void FreeUnneededBuffers();
+
+  // Writes the contents of 'block' to the scratch file if it is dirty and takes it off
+  // the unpinned list, so that the caller can take its buffer. This is the only place
+  // blocks are evicted. 'lock' holds lock_ and is released during the write.
+  Status WriteUnpinnedBlock(boost::unique_lock<boost::mutex>* lock, Block* block);
+
+  // Reads the contents of 'block' back from scratch into its buffer. 'lock' holds lock_
+  // and is released during the read. 'block' must not be visible to other threads,
+  // i.e. neither pinned nor on the unpinned list.
+  Status ReadFromScratch(boost::unique_lock<boost::mutex>* lock, Block* block);
+
+  // Waits until 'block' is not being written to scratch. 'lock' holds lock_.
+  void WaitForWrite(boost::unique_lock<boost::mutex>* lock, Block* block);
+
+  // Opens the scratch file if it is not already open. lock_ must be taken.
+  Status InitScratchFile();
+
+  // Implementations of the Block APIs.
+  Status PinBlock(Block* block, bool* pinned);
+  Status UnpinBlock(Block* block);
+  void DeleteBlock(Block* block);
+
+  const int64_t block_size_;
+  const int max_blocks_;
+  const std::string scratch_dir_;
+
+  // Tracks the memory of all allocated buffers.
+  boost::scoped_ptr<MemTracker> mem_tracker_;
+
+  // Protects all members below.
+  mutable boost::mutex lock_;
+
+  // Signalled when a scratch write done without holding lock_ finishes.
+  boost::condition_variable write_done_cv_;
+
+  // Owns the Block and Client objects.
+  ObjectPool obj_pool_;
+
+  // Block objects that were deleted and can be reused.
+  std::vector<Block*> free_block_objs_;
+
+  // Allocated buffers that are not used by any block.
+  std::vector<uint8_t*> free_buffers_;
+
+  // Number of buffers that have been allocated.
+  int num_allocated_buffers_;
+
+  // Sum of the pinned blocks of all clients.
+  int num_pinned_blocks_;
+
+  // Sum over all clients of the blocks they have reserved but not pinned. These
+  // blocks cannot be handed out to other clients.
+  int num_unfulfilled_reservations_;
+
+  // Unpinned blocks that still have their buffer, in the order they were unpinned.
+  std::list<Block*> unpinned_blocks_;
+
+  // File descriptor of the scratch file, -1 if it has not been created yet.
+  int scratch_fd_;
+  std::string scratch_file_path_;
+
+  // Size of the scratch file. New blocks are appended at this offset.
+  int64_t scratch_file_size_;
+
+  // Offsets of scratch space freed by deleted blocks, reused before growing the file.
+  std::vector<int64_t> free_scratch_offsets_;
+
+  int64_t num_blocks_written_;
+
+  // Only valid for block mgrs returned from GetQueryBlockMgr().
+  TUniqueId query_id_;
+  bool is_query_block_mgr_;
+
+  // Protects query_to_block_mgrs_.
+  static boost::mutex static_block_mgrs_lock_;
+
+  // The block mgrs handed out by GetQueryBlockMgr() that are still in use. Like the
+  // query MemTrackers, the map only holds weak ptrs, and a block mgr removes itself
+  // when it is destroyed.
+  typedef boost::unordered_map<TUniqueId, boost::weak_ptr<BufferedBlockMgr> >
+      BlockMgrsMap;
+  static BlockMgrsMap query_to_block_mgrs_;
+};
+
+}
+
+#endif
@@ -59,6 +59,11 @@ bool DiskIoMgr::ScanRange::EnqueueBuffer(BufferDescriptor* buffer) {
       // are pulled off, throttle this range more).
       --ready_buffers_capacity_;
     }
+    if (blocked_on_queue_) {
+      // The buffers are not being consumed as fast as they are read, use smaller
+      // reads so less memory sits in the queue.
+      read_size_ = ::max(read_size_ / 2, static_cast<int64_t>(io_mgr_->min_read_size_));
+    }
   }
 
   buffer_ready_cv_.notify_one();
@@ -79,6 +84,8 @@ Status DiskIoMgr::ScanRange::GetNext(BufferDescriptor** buffer) {
       // IO. Increase the capacity to allow for more queueing.
       ++ready_buffers_capacity_ ;
       ready_buffers_capacity_ = ::min(ready_buffers_capacity_, MAX_QUEUE_CAPACITY);
+      // The disk is not keeping up, issue larger reads.
+      read_size_ = ::min(read_size_ * 2, static_cast<int64_t>(io_mgr_->max_buffer_size_));
     }
 
     while (ready_buffers_.empty() && !is_cancelled_) {
@@ -185,7 +192,8 @@ string DiskIoMgr::ScanRange::DebugString() const {
   ss << "file=" << file_ << " disk_id=" << disk_id_ << " offset=" << offset_
      << " len=" << len_ << " bytes_read=" << bytes_read_
      << " buffer_queue=" << ready_buffers_.size()
-     << " capacity=" << ready_buffers_capacity_;
+     << " capacity=" << ready_buffers_capacity_
+     << " read_size=" << read_size_;
   return ss.str();
 }
 
@@ -239,6 +247,7 @@ void DiskIoMgr::ScanRange::InitInternal(DiskIoMgr* io_mgr, ReaderContext* reader
   eosr_queued_= false;
   eosr_returned_= false;
   blocked_on_queue_ = false;
+  read_size_ = io_mgr->max_buffer_size_;
   if (ready_buffers_capacity_ <= 0) {
     ready_buffers_capacity_ = reader->initial_scan_range_queue_capacity();
     DCHECK_GE(ready_buffers_capacity_, MIN_QUEUE_CAPACITY);
@@ -318,14 +327,15 @@ void DiskIoMgr::ScanRange::Close() {
 // TODO: how do we best use the disk here.  e.g. is it good to break up a
 // 1MB read into 8 128K reads?
 // TODO: look at linux disk scheduling
-Status DiskIoMgr::ScanRange::Read(char* buffer, int64_t* bytes_read, bool* eosr) {
+Status DiskIoMgr::ScanRange::Read(char* buffer, int64_t buffer_len, int64_t* bytes_read,
+    bool* eosr) {
   unique_lock<mutex> hdfs_lock(hdfs_lock_);
   if (is_cancelled_) return Status::CANCELLED;
 
   *eosr = false;
   *bytes_read = 0;
-  int bytes_to_read =
-      min(static_cast<int64_t>(io_mgr_->max_buffer_size_), len_ - bytes_read_);
+  DCHECK_LE(buffer_len, io_mgr_->max_buffer_size_);
+  int bytes_to_read = min(buffer_len, len_ - bytes_read_);
 
   if (reader_->hdfs_connection_ != NULL) {
     DCHECK(hdfs_file_ != NULL);
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <sched.h>
+#include <limits>
 #include <boost/bind.hpp>
 #include <boost/thread/thread.hpp>
 
@@ -600,6 +601,59 @@ TEST_F(DiskIoMgrTest, StressTest) {
   test.Run(2); // In seconds
 }
 
+// Tests that a range whose consumer is slower than the disk is read with smaller
+// buffers, and that the data is still returned correctly.
+TEST_F(DiskIoMgrTest, AdaptiveReadSize) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
+  const char* data = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  int len = strlen(data);
+  CreateTempFile(tmp_file, data);
+
+  const int max_read_size = 16;
+  pool_.reset(new ObjectPool);
+  DiskIoMgr io_mgr(1, 1, 1, max_read_size);
+  Status status = io_mgr.Init(&mem_tracker);
+  ASSERT_TRUE(status.ok());
+  MemTracker reader_mem_tracker;
+  DiskIoMgr::ReaderContext* reader;
+  status = io_mgr.RegisterReader(NULL, &reader, &reader_mem_tracker);
+  ASSERT_TRUE(status.ok());
+
+  vector<DiskIoMgr::ScanRange*> ranges;
+  ranges.push_back(InitRange(2, tmp_file, 0, len, 0));
+  status = io_mgr.AddScanRanges(reader, ranges);
+  ASSERT_TRUE(status.ok());
+
+  DiskIoMgr::ScanRange* range;
+  status = io_mgr.GetNextRange(reader, &range);
+  ASSERT_TRUE(status.ok());
+  ASSERT_TRUE(range != NULL);
+
+  char result[len + 1];
+  memset(result, 0, len + 1);
+  int64_t min_read_len = max_read_size;
+  while (true) {
+    // Give the disk thread time to fill up the queue.
+    usleep(100 * 1000);
+    DiskIoMgr::BufferDescriptor* buffer;
+    status = range->GetNext(&buffer);
+    ASSERT_TRUE(status.ok());
+    if (buffer == NULL) break;
+    EXPECT_LE(buffer->len(), max_read_size);
+    memcpy(result + buffer->scan_range_offset(), buffer->buffer(), buffer->len());
+    if (!buffer->eosr()) min_read_len = min(min_read_len, buffer->len());
+    bool eosr = buffer->eosr();
+    buffer->Return();
+    if (eosr) break;
+  }
+  EXPECT_EQ(strncmp(result, data, len), 0);
+  EXPECT_LT(min_read_len, max_read_size);
+
+  io_mgr.UnregisterReader(reader);
+  EXPECT_EQ(reader_mem_tracker.consumption(), 0);
+}
+
 TEST_F(DiskIoMgrTest, Buffers) {
   // Test default min/max buffer size
   int min_buffer_size = 1024;
@@ -635,7 +689,7 @@ TEST_F(DiskIoMgrTest, Buffers) {
   EXPECT_EQ(mem_tracker.consumption(), min_buffer_size * 3);
 
   // gc unused buffer
-  io_mgr.GcIoBuffers();
+  EXPECT_EQ(io_mgr.GcIoBuffers(numeric_limits<int64_t>::max()), min_buffer_size);
   EXPECT_EQ(io_mgr.num_allocated_buffers_, 1);
   EXPECT_EQ(mem_tracker.consumption(), min_buffer_size * 2);
 
@@ -649,8 +703,49 @@ TEST_F(DiskIoMgrTest, Buffers) {
   io_mgr.ReturnFreeBuffer(buf, buffer_len);
   EXPECT_EQ(mem_tracker.consumption(), min_buffer_size * 2 + max_buffer_size);
 
+  // a targeted gc only frees the largest buffer
+  EXPECT_EQ(io_mgr.GcIoBuffers(1), max_buffer_size);
+  EXPECT_EQ(io_mgr.num_allocated_buffers_, 1);
+  EXPECT_EQ(mem_tracker.consumption(), min_buffer_size * 2);
+
   // gc buffers
-  io_mgr.GcIoBuffers();
+  EXPECT_EQ(io_mgr.GcIoBuffers(numeric_limits<int64_t>::max()), min_buffer_size * 2);
+  EXPECT_EQ(io_mgr.num_allocated_buffers_, 0);
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
+// Tests that TrimFreeBuffers() only releases buffers that were not reused since the
+// previous trim.
+TEST_F(DiskIoMgrTest, TrimBuffers) {
+  int min_buffer_size = 1024;
+  int max_buffer_size = 8 * 1024;
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+
+  DiskIoMgr io_mgr(1, 1, min_buffer_size, max_buffer_size);
+  Status status = io_mgr.Init(&mem_tracker);
+  ASSERT_TRUE(status.ok());
+
+  int64_t buffer_len = min_buffer_size;
+  char* buf1 = io_mgr.GetFreeBuffer(&buffer_len);
+  char* buf2 = io_mgr.GetFreeBuffer(&buffer_len);
+  io_mgr.ReturnFreeBuffer(buf1, buffer_len);
+  io_mgr.ReturnFreeBuffer(buf2, buffer_len);
+  EXPECT_EQ(io_mgr.num_allocated_buffers_, 2);
+
+  // The buffers were just returned, nothing is released yet.
+  io_mgr.TrimFreeBuffers();
+  EXPECT_EQ(io_mgr.num_allocated_buffers_, 2);
+  EXPECT_EQ(mem_tracker.consumption(), min_buffer_size * 2);
+
+  // Only one buffer is needed during this interval, the other one is released.
+  buf1 = io_mgr.GetFreeBuffer(&buffer_len);
+  io_mgr.ReturnFreeBuffer(buf1, buffer_len);
+  io_mgr.TrimFreeBuffers();
+  EXPECT_EQ(io_mgr.num_allocated_buffers_, 1);
+  EXPECT_EQ(mem_tracker.consumption(), min_buffer_size);
+
+  // No buffers are needed, release the remaining one.
+  io_mgr.TrimFreeBuffers();
   EXPECT_EQ(io_mgr.num_allocated_buffers_, 0);
   EXPECT_EQ(mem_tracker.consumption(), 0);
 }
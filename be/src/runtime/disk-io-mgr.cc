@@ -15,6 +15,8 @@
 #include "runtime/disk-io-mgr.h"
 #include "runtime/disk-io-mgr-internal.h"
 
+#include <limits>
+
 using namespace boost;
 using namespace impala;
 using namespace std;
@@ -32,11 +34,20 @@ DEFINE_int32(num_threads_per_disk, 0, "number of threads per disk");
 DEFINE_int32(read_size, 8 * 1024 * 1024, "Read Size (in bytes)");
 DEFINE_int32(min_buffer_size, 1024, "The minimum read buffer size (in bytes)");
 
+// If true, each scan range adjusts its read size to how quickly its buffers are
+// consumed. See the DiskIoMgr class comment.
+DEFINE_bool(adaptive_read_size, true, "(Advanced) If true, the IoMgr issues smaller "
+    "reads for scan ranges whose consumer is slower than the disk.");
+
 // Turning this to false will make asan much more effective for IO buffer related
 // bugs.
 DEFINE_bool(reuse_io_buffers, true, "(Advanced) If true, IoMgr will reuse IoBuffers "
                                      "across queries.");
 
+DEFINE_int32(io_buffer_gc_interval_ms, 10000, "(Advanced) Interval at which the IoMgr "
+    "releases free io buffers that were not reused since the last interval. If 0, free "
+    "buffers are only released when the process memory limit is reached.");
+
 // Rotational disks should have 1 thread per disk to minimize seeks.  Non-rotational
 // don't have this penalty and benefit from multiple concurrent IO requests.
 static const int THREADS_PER_ROTATIONAL_DISK = 1;
@@ -47,6 +58,10 @@ static const int THREADS_PER_FLASH_DISK = 8;
 // current queue size.
 static const int LOW_MEMORY = 64 * 1024 * 1024;
 
+// With adaptive read sizes, a scan range's reads are never shrunk below
+// max_buffer_size_ / MAX_READ_SIZE_REDUCTION (512KB with the default 8MB read size).
+static const int MAX_READ_SIZE_REDUCTION = 16;
+
 const int DiskIoMgr::DEFAULT_QUEUE_CAPACITY = 2;
 
 // This class provides a cache of ReaderContext objects.  ReaderContexts are recycled.
@@ -196,12 +211,17 @@ DiskIoMgr::DiskIoMgr() :
     num_threads_per_disk_(FLAGS_num_threads_per_disk),
     max_buffer_size_(FLAGS_read_size),
     min_buffer_size_(FLAGS_min_buffer_size),
+    min_read_size_(::min(FLAGS_read_size,
+        ::max(FLAGS_min_buffer_size, FLAGS_read_size / MAX_READ_SIZE_REDUCTION))),
     cached_read_options_(NULL),
     shut_down_(false),
     total_bytes_read_counter_(TCounterType::BYTES),
     read_timer_(TCounterType::TIME_NS) {
   int64_t max_buffer_size_scaled = BitUtil::Ceil(max_buffer_size_, min_buffer_size_);
-  free_buffers_.resize(BitUtil::Log2(max_buffer_size_scaled) + 1);
+  int num_free_lists = BitUtil::Log2(max_buffer_size_scaled) + 1;
+  free_buffers_.resize(CpuInfo::num_numa_nodes(), vector<list<char*> >(num_free_lists));
+  free_buffers_low_water_.resize(CpuInfo::num_numa_nodes(),
+      vector<int>(num_free_lists, 0));
   int num_disks = FLAGS_num_disks;
   if (num_disks == 0) num_disks = DiskInfo::num_disks();
   disk_queues_.resize(num_disks);
@@ -213,19 +233,29 @@ DiskIoMgr::DiskIoMgr(int num_disks, int threads_per_disk, int min_buffer_size,
     num_threads_per_disk_(threads_per_disk),
     max_buffer_size_(max_buffer_size),
     min_buffer_size_(min_buffer_size),
+    min_read_size_(::min(max_buffer_size,
+        ::max(min_buffer_size, max_buffer_size / MAX_READ_SIZE_REDUCTION))),
     cached_read_options_(NULL),
     shut_down_(false),
     total_bytes_read_counter_(TCounterType::BYTES),
     read_timer_(TCounterType::TIME_NS) {
   int64_t max_buffer_size_scaled = BitUtil::Ceil(max_buffer_size_, min_buffer_size_);
-  free_buffers_.resize(BitUtil::Log2(max_buffer_size_scaled) + 1);
+  int num_free_lists = BitUtil::Log2(max_buffer_size_scaled) + 1;
+  free_buffers_.resize(CpuInfo::num_numa_nodes(), vector<list<char*> >(num_free_lists));
+  free_buffers_low_water_.resize(CpuInfo::num_numa_nodes(),
+      vector<int>(num_free_lists, 0));
   if (num_disks == 0) num_disks = DiskInfo::num_disks();
   disk_queues_.resize(num_disks);
   CheckSseSupport();
 }
 
 DiskIoMgr::~DiskIoMgr() {
-  shut_down_ = true;
+  {
+    unique_lock<mutex> lock(free_buffers_lock_);
+    shut_down_ = true;
+  }
+  gc_thread_shutdown_cv_.notify_all();
+  if (gc_thread_.get() != NULL) gc_thread_->Join();
   // Notify all worker threads and shut them down.
   for (int i = 0; i < disk_queues_.size(); ++i) {
     if (disk_queues_[i] == NULL) continue;
@@ -256,11 +286,13 @@ DiskIoMgr::~DiskIoMgr() {
 
   // Delete all allocated buffers
   int num_free_buffers = 0;
-  for (int idx = 0; idx < free_buffers_.size(); ++idx) {
-    num_free_buffers += free_buffers_[idx].size();
+  for (int node = 0; node < free_buffers_.size(); ++node) {
+    for (int idx = 0; idx < free_buffers_[node].size(); ++idx) {
+      num_free_buffers += free_buffers_[node][idx].size();
+    }
   }
   DCHECK_EQ(num_allocated_buffers_, num_free_buffers);
-  GcIoBuffers();
+  GcIoBuffers(numeric_limits<int64_t>::max());
 
   for (int i = 0; i < disk_queues_.size(); ++i) {
     delete disk_queues_[i];
@@ -272,7 +304,8 @@ Status DiskIoMgr::Init(MemTracker* process_mem_tracker) {
   process_mem_tracker_ = process_mem_tracker;
   // If we hit the process limit, see if we can reclaim some memory by removing
   // previously allocated (but unused) io buffers.
-  process_mem_tracker->AddGcFunction(boost::bind(&DiskIoMgr::GcIoBuffers, this));
+  process_mem_tracker->AddGcFunction("io-buffers", MemTracker::GC_PRIORITY_FREE_BUFFERS,
+      boost::bind(&DiskIoMgr::GcIoBuffers, this, _1));
 
   for (int i = 0; i < disk_queues_.size(); ++i) {
     disk_queues_[i] = new DiskQueue(i);
@@ -293,6 +326,10 @@ Status DiskIoMgr::Init(MemTracker* process_mem_tracker) {
   }
   reader_cache_.reset(new ReaderCache(this));
 
+  if (FLAGS_io_buffer_gc_interval_ms > 0) {
+    gc_thread_.reset(new Thread("disk-io-mgr", "io-buffer-gc", &DiskIoMgr::GcLoop, this));
+  }
+
   return Status::OK;
 }
 
@@ -594,9 +631,26 @@ char* DiskIoMgr::GetFreeBuffer(int64_t* buffer_size) {
   // convert to bytes
   *buffer_size = (1 << idx) * min_buffer_size_;
 
+  // Look for a free buffer on this thread's node first, then on the other nodes.
+  int local_node = CpuInfo::GetCurrentNumaNode();
+  int num_nodes = free_buffers_.size();
   unique_lock<mutex> lock(free_buffers_lock_);
   char* buffer = NULL;
-  if (free_buffers_[idx].empty()) {
+  for (int i = 0; i < num_nodes; ++i) {
+    int node = (local_node + i) % num_nodes;
+    list<char*>& free_list = free_buffers_[node][idx];
+    if (free_list.empty()) continue;
+    buffer = free_list.front();
+    free_list.pop_front();
+    int& low_water = free_buffers_low_water_[node][idx];
+    low_water = ::min(low_water, static_cast<int>(free_list.size()));
+    if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
+      ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(-1L);
+    }
+    break;
+  }
+
+  if (buffer == NULL) {
     ++num_allocated_buffers_;
     if (ImpaladMetrics::IO_MGR_NUM_BUFFERS != NULL) {
       ImpaladMetrics::IO_MGR_NUM_BUFFERS->Increment(1L);
@@ -608,43 +662,84 @@ char* DiskIoMgr::GetFreeBuffer(int64_t* buffer_size) {
     // a read for the next reader (DiskIoMgr::GetNextScanRange)
     process_mem_tracker_->Consume(*buffer_size);
     buffer = new char[*buffer_size];
-  } else {
-    if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
-      ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(-1L);
-    }
-    buffer = free_buffers_[idx].front();
-    free_buffers_[idx].pop_front();
   }
   DCHECK(buffer != NULL);
   return buffer;
 }
 
-void DiskIoMgr::GcIoBuffers() {
-  unique_lock<mutex> lock(free_buffers_lock_);
-  int buffers_freed = 0;
-  int bytes_freed = 0;
-  for (int idx = 0; idx < free_buffers_.size(); ++idx) {
-    for (list<char*>::iterator iter = free_buffers_[idx].begin();
-         iter != free_buffers_[idx].end(); ++iter) {
-      int64_t buffer_size = (1 << idx) * min_buffer_size_;
-      process_mem_tracker_->Release(buffer_size);
-      --num_allocated_buffers_;
-      delete[] *iter;
-
-      ++buffers_freed;
-      bytes_freed += buffer_size;
-    }
-    free_buffers_[idx].clear();
+int64_t DiskIoMgr::FreeBuffers(int idx, int num_buffers, list<char*>* buffers) {
+  DCHECK_LE(num_buffers, buffers->size());
+  int64_t buffer_size = (1 << idx) * min_buffer_size_;
+  for (int i = 0; i < num_buffers; ++i) {
+    delete[] buffers->front();
+    buffers->pop_front();
   }
+  int64_t bytes_freed = num_buffers * buffer_size;
+  process_mem_tracker_->Release(bytes_freed);
+  num_allocated_buffers_ -= num_buffers;
 
   if (ImpaladMetrics::IO_MGR_NUM_BUFFERS != NULL) {
-    ImpaladMetrics::IO_MGR_NUM_BUFFERS->Increment(-buffers_freed);
+    ImpaladMetrics::IO_MGR_NUM_BUFFERS->Increment(-num_buffers);
   }
   if (ImpaladMetrics::IO_MGR_TOTAL_BYTES != NULL) {
     ImpaladMetrics::IO_MGR_TOTAL_BYTES->Increment(-bytes_freed);
   }
   if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
-    ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Update(0);
+    ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(-num_buffers);
+  }
+  return bytes_freed;
+}
+
+int64_t DiskIoMgr::GcIoBuffers(int64_t bytes_to_free) {
+  unique_lock<mutex> lock(free_buffers_lock_);
+  int64_t bytes_freed = 0;
+  // Free the largest buffers first so that as few buffers as possible are freed.
+  int num_sizes = free_buffers_.empty() ? 0 : free_buffers_[0].size();
+  for (int idx = num_sizes - 1; idx >= 0 && bytes_freed < bytes_to_free; --idx) {
+    int64_t buffer_size = (1 << idx) * min_buffer_size_;
+    for (int node = 0; node < free_buffers_.size() && bytes_freed < bytes_to_free;
+        ++node) {
+      list<char*>* free_list = &free_buffers_[node][idx];
+      int64_t num_needed = (bytes_to_free - bytes_freed - 1) / buffer_size + 1;
+      int num_buffers = ::min(num_needed, static_cast<int64_t>(free_list->size()));
+      if (num_buffers == 0) continue;
+      bytes_freed += FreeBuffers(idx, num_buffers, free_list);
+      free_buffers_low_water_[node][idx] =
+          ::min(free_buffers_low_water_[node][idx], static_cast<int>(free_list->size()));
+    }
+  }
+  return bytes_freed;
+}
+
+void DiskIoMgr::TrimFreeBuffers() {
+  unique_lock<mutex> lock(free_buffers_lock_);
+  int64_t bytes_freed = 0;
+  for (int node = 0; node < free_buffers_.size(); ++node) {
+    for (int idx = 0; idx < free_buffers_[node].size(); ++idx) {
+      list<char*>* free_list = &free_buffers_[node][idx];
+      int num_unused = ::min(free_buffers_low_water_[node][idx],
+          static_cast<int>(free_list->size()));
+      if (num_unused > 0) bytes_freed += FreeBuffers(idx, num_unused, free_list);
+      free_buffers_low_water_[node][idx] = free_list->size();
+    }
+  }
+  if (bytes_freed > 0) {
+    VLOG_FILE << "IoMgr released " << bytes_freed << " bytes of unused io buffers";
+  }
+}
+
+void DiskIoMgr::GcLoop() {
+  unique_lock<mutex> lock(free_buffers_lock_);
+  while (!shut_down_) {
+    system_time timeout = get_system_time()
+        + posix_time::milliseconds(FLAGS_io_buffer_gc_interval_ms);
+    // Like the disk threads, this relies on shut_down_ rather than the return value
+    // of timed_wait() to decide whether to exit.
+    gc_thread_shutdown_cv_.timed_wait(lock, timeout);
+    if (shut_down_) break;
+    lock.unlock();
+    TrimFreeBuffers();
+    lock.lock();
   }
 }
 
@@ -655,8 +750,9 @@ void DiskIoMgr::ReturnFreeBuffer(char* buffer, int64_t buffer_size) {
       << "buffer_size_ / min_buffer_size_ should be power of 2, got buffer_size = "
       << buffer_size << ", min_buffer_size_ = " << min_buffer_size_;
   if (FLAGS_reuse_io_buffers) {
+    int node = CpuInfo::GetCurrentNumaNode();
     unique_lock<mutex> lock(free_buffers_lock_);
-    free_buffers_[idx].push_back(buffer);
+    free_buffers_[node][idx].push_back(buffer);
   } else {
     process_mem_tracker_->Release(buffer_size);
     --num_allocated_buffers_;
@@ -830,6 +926,24 @@ void DiskIoMgr::HandleReadFinished(DiskQueue* disk_queue, ReaderContext* reader,
   state.DecrementReadThread();
 }
 
+int64_t DiskIoMgr::ComputeReadSize(ReaderContext* reader, ScanRange* range) {
+  int64_t bytes_remaining = range->len_ - range->bytes_read_;
+  int64_t read_size = max_buffer_size_;
+  if (FLAGS_adaptive_read_size) {
+    unique_lock<mutex> scan_range_lock(range->lock_);
+    read_size = range->read_size_;
+    // A range without queued buffers always gets its full read size so the consumer
+    // is not starved (and so that sync reads are done with a single buffer).
+    if (reader->mem_tracker_ != NULL && !range->ready_buffers_.empty()) {
+      int64_t spare_capacity = reader->mem_tracker_->SpareCapacity();
+      int64_t per_buffer_budget = spare_capacity / range->ready_buffers_capacity_;
+      read_size = ::min(read_size,
+          ::max(per_buffer_budget, static_cast<int64_t>(min_read_size_)));
+    }
+  }
+  return ::min(bytes_remaining, read_size);
+}
+
 // The thread waits until there is work or the entire system is being shut down.
 // If there is work, it reads the next chunk of the next scan range for the first
 // reader in the queue and round robins across the readers.
@@ -852,14 +966,13 @@ void DiskIoMgr::ReadLoop(DiskQueue* disk_queue) {
       break;
     }
 
-    int64_t bytes_remaining = range->len_ - range->bytes_read_;
-    int64_t buffer_size = ::min(bytes_remaining, static_cast<int64_t>(max_buffer_size_));
+    int64_t buffer_size = ComputeReadSize(reader, range);
     bool enough_memory = true;
     if (reader->mem_tracker_ != NULL) {
       enough_memory = reader->mem_tracker_->SpareCapacity() > LOW_MEMORY;
       if (!enough_memory) {
         // Low memory, GC and try again.
-        GcIoBuffers();
+        GcIoBuffers(numeric_limits<int64_t>::max());
         enough_memory = reader->mem_tracker_->SpareCapacity() > LOW_MEMORY;
       }
     }
@@ -907,7 +1020,8 @@ void DiskIoMgr::ReadLoop(DiskQueue* disk_queue) {
       SCOPED_TIMER(&read_timer_);
       SCOPED_TIMER(reader->read_timer_);
 
-      buffer_desc->status_ = range->Read(buffer, &buffer_desc->len_, &buffer_desc->eosr_);
+      buffer_desc->status_ = range->Read(
+          buffer, buffer_size, &buffer_desc->len_, &buffer_desc->eosr_);
       buffer_desc->scan_range_offset_ = range->bytes_read_ - buffer_desc->len_;
 
       if (reader->bytes_read_counter_ != NULL) {
@@ -930,6 +1044,6 @@ int DiskIoMgr::free_buffers_idx(int64_t buffer_size) {
   int64_t buffer_size_scaled = BitUtil::Ceil(buffer_size, min_buffer_size_);
   int idx = BitUtil::Log2(buffer_size_scaled);
   DCHECK_GE(idx, 0);
-  DCHECK_LT(idx, free_buffers_.size());
+  DCHECK_LT(idx, free_buffers_[0].size());
   return idx;
 }
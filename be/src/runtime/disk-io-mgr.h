@@ -110,6 +110,16 @@ class MemTracker;
 // 72 * 5 * 8MB = 2.8GB in io buffers memory usage. This should remain roughly constant
 // regardless of how many concurrent readers are running.
 //
+// The read size is also adjusted per scan range (see --adaptive_read_size). A range
+// starts with reads of max_buffer_size_. If the disk threads fill the range's queue
+// (the consumer is slower than the disk), the read size is halved, down to
+// min_read_size_. If the consumer finds the queue empty (the disk is slower than the
+// consumer), the read size is doubled again. Ranges consumed by slow, selective
+// scanners therefore hold small buffers while ranges that are scanned sequentially
+// at disk speed keep issuing large reads. Once a range has a buffer queued, its
+// reads are further capped so that a full queue fits in the reader's MemTracker
+// spare capacity.
+//
 // Buffer Management:
 // Buffers are allocated by the IoMgr as necessary to service reads. These buffers
 // are directly returned to the caller. The caller must call Return() on the buffer
@@ -276,9 +286,10 @@ class DiskIoMgr {
     // Closes the file for this range. This function only modifies state in this range.
     void Close();
 
-    // Reads from this range into 'buffer'. Buffer is preallocated. Returns the number
-    // of bytes read. Updates range to keep track of where in the file we are.
-    Status Read(char* buffer, int64_t* bytes_read, bool* eosr);
+    // Reads from this range into 'buffer', reading at most 'buffer_len' bytes. Buffer
+    // is preallocated. Returns the number of bytes read. Updates range to keep track
+    // of where in the file we are.
+    Status Read(char* buffer, int64_t buffer_len, int64_t* bytes_read, bool* eosr);
 
     // Reads from the DN cache. On success, sets cached_buffer_ to the DN buffer
     // and *read_succeeded to true.
@@ -355,6 +366,11 @@ class DiskIoMgr {
     // from ready_buffers_.
     int ready_buffers_capacity_;
 
+    // The size of the next read issued for this range. Adjusted between
+    // io_mgr_->min_read_size_ and io_mgr_->max_buffer_size_ along with
+    // ready_buffers_capacity_ (see class comment).
+    int64_t read_size_;
+
     // Lock that should be taken during hdfs calls. Only one thread (the disk reading
     // thread) calls into hdfs at a time so this lock does not have performance impact.
     // This lock only serves to coordinate cleanup. Specifically it serves to ensure
@@ -492,6 +508,7 @@ class DiskIoMgr {
   class ReaderCache;
 
   friend class DiskIoMgrTest_Buffers_Test;
+  friend class DiskIoMgrTest_TrimBuffers_Test;
 
   // Pool to allocate BufferDescriptors
   ObjectPool pool_;
@@ -509,6 +526,10 @@ class DiskIoMgr {
   // The minimum size of each read buffer.
   const int min_buffer_size_;
 
+  // The smallest read size an adaptive scan range is shrunk to. Reads can still be
+  // smaller than this at the end of a range.
+  const int min_read_size_;
+
   // Thread group containing all the worker threads.
   ThreadGroup disk_thread_group_;
 
@@ -531,21 +552,37 @@ class DiskIoMgr {
   // contention.
   boost::scoped_ptr<ReaderCache> reader_cache_;
 
-  // Protects free_buffers_ and free_buffer_descs_
+  // Protects free_buffers_, free_buffers_low_water_ and free_buffer_descs_
   boost::mutex free_buffers_lock_;
 
-  // Free buffers that can be handed out to clients. There is one list for each buffer
-  // size, indexed by the Log2 of the buffer size in units of min_buffer_size_. The
-  // maximum buffer size is max_buffer_size_, so the maximum index is
-  // Log2(max_buffer_size_ / min_buffer_size_).
+  // Free buffers that can be handed out to clients. There is one set of lists per NUMA
+  // node, indexed by the node the buffer was returned from. Buffers are preferably
+  // handed out to a thread running on the same node, so that the disk thread that
+  // reads into a buffer and the scanner thread that consumes it reuse memory that is
+  // local to their socket.
+  // Within a node, there is one list for each buffer size, indexed by the Log2 of the
+  // buffer size in units of min_buffer_size_. The maximum buffer size is
+  // max_buffer_size_, so the maximum index is Log2(max_buffer_size_ / min_buffer_size_).
   //
   // E.g. if min_buffer_size_ = 1024 bytes:
-  //  free_buffers_[0]  => list of free buffers with size 1024 B
-  //  free_buffers_[1]  => list of free buffers with size 2048 B
-  //  free_buffers_[10] => list of free buffers with size 1 MB
-  //  free_buffers_[13] => list of free buffers with size 8 MB
-  //  free_buffers_[n]  => list of free buffers with size 2^n * 1024 B
-  std::vector<std::list<char*> > free_buffers_;
+  //  free_buffers_[node][0]  => list of free buffers with size 1024 B
+  //  free_buffers_[node][1]  => list of free buffers with size 2048 B
+  //  free_buffers_[node][10] => list of free buffers with size 1 MB
+  //  free_buffers_[node][13] => list of free buffers with size 8 MB
+  //  free_buffers_[node][n]  => list of free buffers with size 2^n * 1024 B
+  std::vector<std::vector<std::list<char*> > > free_buffers_;
+
+  // The smallest size of each list in free_buffers_ since the last call to
+  // TrimFreeBuffers(). This many buffers were not needed by any reader during the
+  // last interval and are released by the next trim.
+  std::vector<std::vector<int> > free_buffers_low_water_;
+
+  // Thread that periodically calls TrimFreeBuffers(). NULL if
+  // --io_buffer_gc_interval_ms is 0.
+  boost::scoped_ptr<Thread> gc_thread_;
+
+  // Used to wake up gc_thread_ on shutdown. Protected by free_buffers_lock_.
+  boost::condition_variable gc_thread_shutdown_cv_;
 
   // List of free buffer desc objects that can be handed out to clients
   std::list<BufferDescriptor*> free_buffer_descs_;
@@ -577,21 +614,42 @@ class DiskIoMgr {
   // the reader and disk queue state.
   void ReturnBuffer(BufferDescriptor* buffer);
 
+  // Returns the number of bytes the next read for 'range' should request. This is
+  // the range's adaptive read size, capped by the bytes remaining in the range and,
+  // if the range already has a buffer queued, by the reader's spare memory.
+  int64_t ComputeReadSize(ReaderContext* reader, ScanRange* range);
+
   // Returns a buffer to read into with size between *buffer_size and max_buffer_size_, and
   // *buffer_size is set to the size of the buffer. If there is an appropriately-sized
   // free buffer in the 'free_buffers_', that is returned, otherwise a new one is
-  // allocated. *buffer_size must be between 0 and max_buffer_size_.
+  // allocated. Free buffers from the caller's NUMA node are preferred over buffers
+  // from other nodes. *buffer_size must be between 0 and max_buffer_size_.
   char* GetFreeBuffer(int64_t* buffer_size);
 
-  // Garbage collect all unused io buffers. This is currently only triggered when the
-  // process wide limit is hit. This is not good enough. While it is sufficient for
-  // the IoMgr, other components do not trigger this GC.
-  // TODO: make this run periodically?
-  void GcIoBuffers();
-
-  // Returns a buffer to the free list. buffer_size / min_buffer_size_ should be a power
-  // of 2, and buffer_size should be <= max_buffer_size_. These constraints will be met if
-  // buffer was acquired via GetFreeBuffer() (which it should have been).
+  // Garbage collect unused io buffers, largest first, until at least 'bytes_to_free'
+  // bytes are freed or there are no unused buffers left. Returns the number of bytes
+  // freed. This is triggered when the process wide limit is hit. Unused buffers are
+  // also released in the background by TrimFreeBuffers().
+  int64_t GcIoBuffers(int64_t bytes_to_free);
+
+  // Releases the free buffers that were not needed since the last call, i.e. the low
+  // water mark of each free list, and resets the low water marks. Buffers that were
+  // reused during the interval are kept for the next one.
+  void TrimFreeBuffers();
+
+  // Loop run by gc_thread_. Calls TrimFreeBuffers() every
+  // --io_buffer_gc_interval_ms until the IoMgr is shut down.
+  void GcLoop();
+
+  // Frees the first 'num_buffers' buffers in 'buffers', which must all be of the size
+  // stored at index 'idx'. Returns the number of bytes freed. free_buffers_lock_ must
+  // be taken.
+  int64_t FreeBuffers(int idx, int num_buffers, std::list<char*>* buffers);
+
+  // Returns a buffer to the free list of the caller's NUMA node. buffer_size /
+  // min_buffer_size_ should be a power of 2, and buffer_size should be <=
+  // max_buffer_size_. These constraints will be met if buffer was acquired via
+  // GetFreeBuffer() (which it should have been).
   void ReturnFreeBuffer(char* buffer, int64_t buffer_size);
 
   // Disk worker thread loop. This function reads the next range from the
@@ -28,6 +28,7 @@
 #include "runtime/hdfs-fs-cache.h"
 #include "runtime/lib-cache.h"
 #include "runtime/mem-tracker.h"
+#include "runtime/size-class-arena.h"
 #include "runtime/thread-resource-mgr.h"
 #include "scheduling/request-pool-service.h"
 #include "statestore/simple-scheduler.h"
@@ -67,6 +68,15 @@ DECLARE_int32(num_cores);
 DECLARE_int32(be_port);
 DECLARE_string(mem_limit);
 
+DEFINE_string(buffer_pool_limit, "80%", "Limit on the memory used by the buffered block "
+    "mgr of a query on this backend, either in bytes or as a percentage of the process "
+    "memory limit. Memory is only allocated as operators need it and also counts "
+    "against the query's memory limit.");
+DEFINE_int32(buffer_pool_block_size, 8 * 1024 * 1024, "(Advanced) Size of the blocks "
+    "allocated by the buffered block mgr, in bytes.");
+DEFINE_string(scratch_dir, "/tmp", "Directory in which the buffered block mgr writes "
+    "blocks that are evicted from memory.");
+
 DEFINE_bool(enable_rm, false, "Whether to enable resource management. If enabled, "
                               "-fair_scheduler_allocation_path is required.");
 DEFINE_int32(llama_callback_port, 28000,
@@ -94,6 +104,23 @@ DEFINE_int32(resource_broker_recv_timeout, 0, "Time to wait, in ms, "
 
 namespace impala {
 
+#ifndef ADDRESS_SANITIZER
+// Returns free memory held by tcmalloc to the system, at least 'bytes_to_free' bytes if
+// tcmalloc has that much. Returns the number of bytes that were released.
+static int64_t ReleaseTcmallocMemory(int64_t bytes_to_free) {
+  MallocExtension* malloc_extension = MallocExtension::instance();
+  size_t unmapped_before = 0;
+  size_t unmapped_after = 0;
+  malloc_extension->GetNumericProperty("tcmalloc.pageheap_unmapped_bytes",
+      &unmapped_before);
+  malloc_extension->ReleaseToSystem(bytes_to_free);
+  malloc_extension->GetNumericProperty("tcmalloc.pageheap_unmapped_bytes",
+      &unmapped_after);
+  // Memory that was unmapped before may have been reused in the meantime.
+  return unmapped_after > unmapped_before ? unmapped_after - unmapped_before : 0;
+}
+#endif
+
 ExecEnv* ExecEnv::exec_env_ = NULL;
 
 ExecEnv::ExecEnv()
@@ -102,6 +129,7 @@ ExecEnv::ExecEnv()
     catalogd_client_cache_(new CatalogServiceClientCache()),
     htable_factory_(new HBaseTableFactory()),
     disk_io_mgr_(new DiskIoMgr()),
+    block_mgr_limit_(-1),
     webserver_(new Webserver()),
     metrics_(new Metrics()),
     mem_tracker_(NULL),
@@ -155,6 +183,7 @@ ExecEnv::ExecEnv(const string& hostname, int backend_port, int subscriber_port,
     catalogd_client_cache_(new CatalogServiceClientCache()),
     htable_factory_(new HBaseTableFactory()),
     disk_io_mgr_(new DiskIoMgr()),
+    block_mgr_limit_(-1),
     webserver_(new Webserver(webserver_port)),
     metrics_(new Metrics()),
     mem_tracker_(NULL),
@@ -251,16 +280,22 @@ Status ExecEnv::StartServices() {
                                     bytes_limit > 0 ? bytes_limit : -1, "Process"));
 
   // Since tcmalloc does not free unused memory, we may exceed the process mem limit even
-  // if Impala is not actually using that much memory. Add a callback to free any unused
-  // memory if we hit the process limit.
-  mem_tracker_->AddGcFunction(boost::bind(&MallocExtension::ReleaseFreeMemory,
-                                          MallocExtension::instance()));
+  // if Impala is not actually using that much memory. Free unused tcmalloc memory if we
+  // hit the process limit, and again after each GcFunction frees memory.
+  mem_tracker_->SetGcReleaseFunction(&ReleaseTcmallocMemory);
 #else
   // tcmalloc metrics aren't defined in ASAN builds, just use the default behavior to
   // track process memory usage (sum of all children trackers).
   mem_tracker_.reset(new MemTracker(bytes_limit > 0 ? bytes_limit : -1, "Process"));
 #endif
 
+  // Free memory caches before cached data, which may have to be reloaded later.
+  mem_tracker_->AddGcFunction("size-class-arena", MemTracker::GC_PRIORITY_FREE_BUFFERS,
+      boost::bind(&SizeClassArena::ReleaseFreeMemory, SizeClassArena::instance(), _1));
+  if (LibCache::instance() != NULL) {
+    mem_tracker_->AddGcFunction("lib-cache", MemTracker::GC_PRIORITY_CACHED_DATA,
+        boost::bind(&LibCache::EvictUnusedEntries, LibCache::instance(), _1));
+  }
   mem_tracker_->RegisterMetrics(metrics_.get(), "mem-tracker.process");
 
   if (bytes_limit > MemInfo::physical_mem()) {
@@ -274,6 +309,20 @@ Status ExecEnv::StartServices() {
 
   RETURN_IF_ERROR(disk_io_mgr_->Init(mem_tracker_.get()));
 
+  block_mgr_limit_ = ParseUtil::ParseMemSpec(FLAGS_buffer_pool_limit, &is_percent);
+  if (block_mgr_limit_ <= 0) {
+    return Status("Failed to parse buffer pool limit from '" + FLAGS_buffer_pool_limit +
+        "'.");
+  }
+  if (is_percent && bytes_limit > 0) {
+    // ParseMemSpec() computes percentages of physical memory, scale them to the
+    // process limit instead.
+    block_mgr_limit_ = block_mgr_limit_ * bytes_limit / MemInfo::physical_mem();
+  }
+  if (bytes_limit > 0) block_mgr_limit_ = min(block_mgr_limit_, bytes_limit);
+  LOG(INFO) << "Using buffer pool limit: "
+            << PrettyPrinter::Print(block_mgr_limit_, TCounterType::BYTES);
+
   // Start services in order to ensure that dependencies between them are met
   if (enable_webserver_) {
     AddDefaultPathHandlers(webserver_.get(), mem_tracker_.get());
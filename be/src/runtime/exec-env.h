@@ -80,6 +80,9 @@ class ExecEnv {
   }
   HBaseTableFactory* htable_factory() { return htable_factory_.get(); }
   DiskIoMgr* disk_io_mgr() { return disk_io_mgr_.get(); }
+  // Maximum size of the buffered block mgr of a query, in bytes. -1 if
+  // StartServices() wasn't called.
+  int64_t block_mgr_limit() const { return block_mgr_limit_; }
   Webserver* webserver() { return webserver_.get(); }
   Metrics* metrics() { return metrics_.get(); }
   MemTracker* process_mem_tracker() { return mem_tracker_.get(); }
@@ -115,6 +118,8 @@ class ExecEnv {
   boost::scoped_ptr<CatalogServiceClientCache> catalogd_client_cache_;
   boost::scoped_ptr<HBaseTableFactory> htable_factory_;
   boost::scoped_ptr<DiskIoMgr> disk_io_mgr_;
+  // Set in StartServices() once the process memory limit is known.
+  int64_t block_mgr_limit_;
   boost::scoped_ptr<Webserver> webserver_;
   boost::scoped_ptr<Metrics> metrics_;
   boost::scoped_ptr<MemTracker> mem_tracker_;
@@ -61,10 +61,11 @@ TEST(FreePoolTest, Basic) {
   pool.Free(p2);
   pool.Free(p3);
 
-  // We know have 2 1 byte allocations. Make a two byte allocation.
-  uint8_t* p4 = pool.Allocate(2);
-  memset(p4, 2, 123);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 48);
+  // We know have 2 1 byte allocations. Make a 9 byte allocation, which is in the next
+  // size class.
+  uint8_t* p4 = pool.Allocate(9);
+  memset(p4, 2, 9);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 56);
   EXPECT_TRUE(p4 != p1);
   EXPECT_TRUE(p4 != p2);
   EXPECT_TRUE(p4 != p3);
@@ -75,14 +76,14 @@ TEST(FreePoolTest, Basic) {
   *p1 = 123;
   p2 = pool.Allocate(1);
   *p2 = 123;
-  p3 = pool.Allocate(2);
-  memset(p3, 123, 2);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 48);
+  p3 = pool.Allocate(9);
+  memset(p3, 123, 9);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 56);
 
   // Make another 1 byte allocation.
   p4 = pool.Allocate(1);
   *p4 = 1;
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 64);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 72);
 
   mem_pool.FreeAll();
 }
@@ -149,19 +150,20 @@ TEST(FreePoolTest, ReAlloc) {
   ptr = pool.Reallocate(ptr, 0);
   EXPECT_EQ(mem_pool.total_allocated_bytes(), 0);
 
+  // 600 bytes is in the 640 byte size class.
   ptr = pool.Reallocate(ptr, 600);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 1024 + 8);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 640 + 8);
   uint8_t* ptr2 = pool.Reallocate(ptr, 200);
   EXPECT_TRUE(ptr == ptr2);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 1024 + 8);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 640 + 8);
 
   uint8_t* ptr3 = pool.Reallocate(ptr, 2000);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 1024 + 8 + 2048 + 8);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 640 + 8 + 2048 + 8);
   EXPECT_TRUE(ptr2 != ptr3);
 
   // The original 600 allocation should be there.
   ptr = pool.Allocate(600);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 1024 + 8 + 2048 + 8);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 640 + 8 + 2048 + 8);
 
   mem_pool.FreeAll();
 }
@@ -21,14 +21,14 @@
 #include <string>
 #include "common/logging.h"
 #include "runtime/mem-pool.h"
-#include "util/bit-util.h"
+#include "runtime/size-class-arena.h"
 
 namespace impala {
 
 // Implementation of a free pool to recycle allocations. The pool is broken
-// up into 64 lists, one for each power of 2. Each allocation is rounded up
-// to the next power of 2. When the allocation is freed, it is added to the
-// corresponding free list.
+// up into one list per SizeClassArena size class. Each allocation is rounded up
+// to its size class, which wastes at most 20% of the allocation. When the allocation
+// is freed, it is added to the corresponding free list.
 // Each allocation has an 8 byte header that immediately precedes the actual
 // allocation. If the allocation is owned by the user, the header contains
 // the ptr to the list that it should be added to on Free().
@@ -37,12 +37,15 @@ namespace impala {
 // This has O(1) Allocate() and Free().
 // This is not thread safe.
 // TODO: consider integrating this with MemPool.
-// TODO: consider changing to something more granular than doubling.
 class FreePool {
  public:
   // C'tor, initializes the FreePool to be empty. All allocations come from the
   // 'mem_pool'.
-  FreePool(MemPool* mem_pool) : mem_pool_(mem_pool) {
+  FreePool(MemPool* mem_pool)
+    : mem_pool_(mem_pool),
+      num_allocations_(0),
+      requested_bytes_(0),
+      allocated_bytes_(0) {
     memset(&lists_, 0, sizeof(lists_));
   }
 
@@ -51,16 +54,18 @@ class FreePool {
     // This is the typical malloc behavior. NULL is reserved for failures.
     if (size == 0) return reinterpret_cast<uint8_t*>(0x1);
 
-    // Do ceil(log_2(size))
-    int free_list_idx = BitUtil::Log2(size);
+    int free_list_idx = SizeClassArena::SizeClass(size);
     DCHECK_LT(free_list_idx, NUM_LISTS);
+    int class_size = SizeClassArena::ClassSize(free_list_idx);
+    ++num_allocations_;
+    requested_bytes_ += size;
+    allocated_bytes_ += class_size;
 
     FreeListNode* allocation = lists_[free_list_idx].next;
     if (allocation == NULL) {
       // There wasn't an existing allocation of the right size, allocate a new one.
-      size = 1 << free_list_idx;
       allocation = reinterpret_cast<FreeListNode*>(
-          mem_pool_->Allocate(size + sizeof(FreeListNode)));
+          mem_pool_->Allocate(class_size + sizeof(FreeListNode)));
     } else {
       // Remove this allocation from the list.
       lists_[free_list_idx].next = allocation->next;
@@ -96,13 +101,14 @@ class FreePool {
 #endif
     int bucket_idx = (list - &lists_[0]);
     // This is the actual size of ptr.
-    int allocation_size = 1 << bucket_idx;
+    int allocation_size = SizeClassArena::ClassSize(bucket_idx);
 
     // If it's already big enough, just return the ptr.
     if (allocation_size >= size) return ptr;
 
-    // Make a new one. Since Allocate() already rounds up to powers of 2, this
-    // effectively doubles for the caller.
+    // Make a new one. Since Allocate() rounds up to size classes, which grow
+    // geometrically, callers that grow a buffer a little at a time still only copy it
+    // an amortized constant number of times.
     uint8_t* new_ptr = Allocate(size);
     memcpy(new_ptr, ptr, allocation_size);
     Free(ptr);
@@ -111,8 +117,15 @@ class FreePool {
 
   MemTracker* mem_tracker() { return mem_pool_->mem_tracker(); }
 
+  // Number of Allocate() calls, the sum of the sizes they asked for and the sum of the
+  // size classes they were rounded up to. The difference between the last two is the
+  // internal fragmentation of the pool.
+  int64_t num_allocations() const { return num_allocations_; }
+  int64_t requested_bytes() const { return requested_bytes_; }
+  int64_t allocated_bytes() const { return allocated_bytes_; }
+
  private:
-  static const int NUM_LISTS = 64;
+  static const int NUM_LISTS = SizeClassArena::NUM_SIZE_CLASSES;
 
   struct FreeListNode {
     // Union for clarity when manipulating the node.
@@ -134,10 +147,12 @@ class FreePool {
   // MemPool to allocate from. Unowned.
   MemPool* mem_pool_;
 
-  // One list head for each allocation size indexed by the LOG_2 of the allocation size.
-  // While it doesn't make too much sense to use this for very small (e.g. 8 byte)
-  // allocations, it makes the indexing easy.
+  // One list head for each allocation size indexed by its size class.
   FreeListNode lists_[NUM_LISTS];
+
+  int64_t num_allocations_;
+  int64_t requested_bytes_;
+  int64_t allocated_bytes_;
 };
 
 }
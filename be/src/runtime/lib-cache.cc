@@ -21,6 +21,7 @@
 #include "codegen/llvm-codegen.h"
 #include "runtime/hdfs-fs-cache.h"
 #include "runtime/runtime-state.h"
+#include "util/debug-util.h"
 #include "util/dynamic-util.h"
 #include "util/fe-test-info.h"
 #include "util/hash-util.h"
@@ -269,6 +270,55 @@ void LibCache::DropCache() {
   lib_cache_.clear();
 }
 
+int64_t LibCache::EvictUnusedEntries(int64_t bytes_to_free) {
+  unique_lock<mutex> lib_cache_lock(lock_);
+  int64_t bytes_freed = 0;
+  int64_t file_bytes_freed = 0;
+  LibMap::iterator it = lib_cache_.begin();
+  while (it != lib_cache_.end() && bytes_freed < bytes_to_free) {
+    LibMap::iterator entry_iter = it++;
+    LibCacheEntry* entry = entry_iter->second;
+    int64_t entry_bytes;
+    {
+      // Don't wait for entries that are being loaded.
+      unique_lock<mutex> entry_lock(entry->lock, try_to_lock);
+      if (!entry_lock.owns_lock() || entry->use_count > 0) continue;
+      entry_bytes = EntryBytes(entry);
+      file_bytes_freed += EntryFileBytes(entry);
+    }
+    // A thread that looked up the entry before we took lock_ may start using it before
+    // it is removed. RemoveEntryInternal() then leaves it to be deleted by that thread.
+    string hdfs_lib_file = entry_iter->first;
+    RemoveEntryInternal(hdfs_lib_file, entry_iter);
+    bytes_freed += entry_bytes;
+  }
+  if (bytes_freed > 0 || file_bytes_freed > 0) {
+    VLOG(1) << "Evicted " << PrettyPrinter::Print(bytes_freed, TCounterType::BYTES)
+            << " of memory and "
+            << PrettyPrinter::Print(file_bytes_freed, TCounterType::BYTES)
+            << " of local files of unused lib cache entries";
+  }
+  return bytes_freed;
+}
+
+int64_t LibCache::EntryBytes(const LibCacheEntry* entry) {
+  int64_t bytes = 0;
+  BOOST_FOREACH(const LibCacheEntry::SymbolMap::value_type& v, entry->symbol_cache) {
+    bytes += v.first.size() + sizeof(v);
+  }
+  BOOST_FOREACH(const string& symbol, entry->symbols) {
+    bytes += symbol.size() + sizeof(symbol);
+  }
+  return bytes;
+}
+
+int64_t LibCache::EntryFileBytes(const LibCacheEntry* entry) {
+  if (entry->local_path.empty()) return 0;
+  boost::system::error_code ec;
+  uintmax_t file_size = filesystem::file_size(entry->local_path, ec);
+  return ec ? 0 : file_size;
+}
+
 Status LibCache::GetCacheEntry(const string& hdfs_lib_file, LibType type,
                                unique_lock<mutex>* entry_lock, LibCacheEntry** entry) {
   DCHECK(!hdfs_lib_file.empty());
@@ -105,6 +105,14 @@ class LibCache {
   // Removes all cached entries.
   void DropCache();
 
+  // Removes cached entries that are not in use until at least 'bytes_to_free' bytes
+  // are freed or there are no unused entries left. Entries that are locked, e.g.
+  // because they are being copied from HDFS, are skipped. Returns an estimate of the
+  // memory freed by the entries' cached symbols. The local copies of the libraries are
+  // deleted too, but they are on disk and are only logged, not counted. Called when the
+  // process memory limit is hit.
+  int64_t EvictUnusedEntries(int64_t bytes_to_free);
+
  private:
   // Singleton instance. Instantiated in Init().
   static boost::scoped_ptr<LibCache> instance_;
@@ -131,6 +139,13 @@ class LibCache {
 
   Status InitInternal();
 
+  // Returns the estimated memory used by 'entry'. The entry's lock must be taken.
+  static int64_t EntryBytes(const LibCacheEntry* entry);
+
+  // Returns the size of the local copy of 'entry's library, or 0 if there is none.
+  // The entry's lock must be taken.
+  static int64_t EntryFileBytes(const LibCacheEntry* entry);
+
   // Returns the cache entry for 'hdfs_lib_file'. If this library has not been
   // copied locally, it will copy it and add a new LibCacheEntry to 'lib_cache_'.
   // Result is returned in *entry.
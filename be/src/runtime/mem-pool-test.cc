@@ -36,52 +36,53 @@ TEST(MemPoolTest, Basic) {
     }
     // we handed back 24K
     EXPECT_EQ(p.total_allocated_bytes(), 24 * 1024);
-    // .. and allocated 28K of chunks (4, 8, 16)
-    EXPECT_EQ(p.GetTotalChunkSizes(), 28 * 1024);
+    // .. and allocated 30K of chunks (4, 6, 8, 12)
+    EXPECT_EQ(p.GetTotalChunkSizes(), 30 * 1024);
 
-    // we're passing on the first two chunks, containing 12K of data; we're left with
-    // one chunk of 16K containing 12K of data
+    // we're passing on the first three chunks, containing 18K of data; we're left with
+    // one chunk of 12K containing 6K of data
     p2.AcquireData(&p, true);
-    EXPECT_EQ(p.total_allocated_bytes(), 12 * 1024);
-    EXPECT_EQ(p.GetTotalChunkSizes(), 16 * 1024);
+    EXPECT_EQ(p.total_allocated_bytes(), 6 * 1024);
+    EXPECT_EQ(p.GetTotalChunkSizes(), 12 * 1024);
 
     // we allocate 8K, for which there isn't enough room in the current chunk,
-    // so another one is allocated (32K)
+    // so another one is allocated (16K)
     p.Allocate(8 * 1024);
-    EXPECT_EQ(p.GetTotalChunkSizes(), (16 + 32) * 1024);
+    EXPECT_EQ(p.GetTotalChunkSizes(), (12 + 16) * 1024);
 
     // we allocate 65K, which doesn't fit into the current chunk or the default
-    // size of the next allocated chunk (64K)
+    // size of the next allocated chunk (24K), and gets a chunk of its size class (80K)
     p.Allocate(65 * 1024);
-    EXPECT_EQ(p.total_allocated_bytes(), (12 + 8 + 65) * 1024);
+    EXPECT_EQ(p.total_allocated_bytes(), (6 + 8 + 65) * 1024);
     if (iter == 0) {
-      EXPECT_EQ(p.peak_allocated_bytes(), (12 + 8 + 65) * 1024);
+      EXPECT_EQ(p.peak_allocated_bytes(), (6 + 8 + 65) * 1024);
     } else {
       EXPECT_EQ(p.peak_allocated_bytes(), (1 + 120 + 33) * 1024);
     }
-    EXPECT_EQ(p.GetTotalChunkSizes(), (16 + 32 + 65) * 1024);
+    EXPECT_EQ(p.GetTotalChunkSizes(), (12 + 16 + 80) * 1024);
 
     // Clear() resets allocated data, but doesn't remove any chunks
     p.Clear();
     EXPECT_EQ(p.total_allocated_bytes(), 0);
     if (iter == 0) {
-      EXPECT_EQ(p.peak_allocated_bytes(), (12 + 8 + 65) * 1024);
+      EXPECT_EQ(p.peak_allocated_bytes(), (6 + 8 + 65) * 1024);
     } else {
       EXPECT_EQ(p.peak_allocated_bytes(), (1 + 120 + 33) * 1024);
     }
-    EXPECT_EQ(p.GetTotalChunkSizes(), (16 + 32 + 65) * 1024);
+    EXPECT_EQ(p.GetTotalChunkSizes(), (12 + 16 + 80) * 1024);
 
     // next allocation reuses existing chunks
     p.Allocate(1024);
     EXPECT_EQ(p.total_allocated_bytes(), 1024);
     if (iter == 0) {
-      EXPECT_EQ(p.peak_allocated_bytes(), (12 + 8 + 65) * 1024);
+      EXPECT_EQ(p.peak_allocated_bytes(), (6 + 8 + 65) * 1024);
     } else {
       EXPECT_EQ(p.peak_allocated_bytes(), (1 + 120 + 33) * 1024);
     }
-    EXPECT_EQ(p.GetTotalChunkSizes(), (16 + 32 + 65) * 1024);
+    EXPECT_EQ(p.GetTotalChunkSizes(), (12 + 16 + 80) * 1024);
 
-    // ... unless it doesn't fit into any available chunk
+    // ... unless it doesn't fit into any available chunk (120K rounds up to the 128K
+    // size class)
     p.Allocate(120 * 1024);
     EXPECT_EQ(p.total_allocated_bytes(), (1 + 120) * 1024);
     if (iter == 0) {
@@ -89,12 +90,12 @@ TEST(MemPoolTest, Basic) {
     } else {
       EXPECT_EQ(p.peak_allocated_bytes(), (1 + 120 + 33) * 1024);
     }
-    EXPECT_EQ(p.GetTotalChunkSizes(), (130 + 16 + 32 + 65) * 1024);
+    EXPECT_EQ(p.GetTotalChunkSizes(), (128 + 12 + 16 + 80) * 1024);
 
     // ... Try another chunk that fits into an existing chunk
     p.Allocate(33 * 1024);
     EXPECT_EQ(p.total_allocated_bytes(), (1 + 120 + 33) * 1024);
-    EXPECT_EQ(p.GetTotalChunkSizes(), (130 + 16 + 32 + 65) * 1024);
+    EXPECT_EQ(p.GetTotalChunkSizes(), (128 + 12 + 16 + 80) * 1024);
 
     // we're releasing 3 chunks, which get added to p2
     p2.AcquireData(&p, false);
@@ -102,9 +103,9 @@ TEST(MemPoolTest, Basic) {
     EXPECT_EQ(p.peak_allocated_bytes(), (1 + 120 + 33) * 1024);
     EXPECT_EQ(p.GetTotalChunkSizes(), 0);
 
-    p3.AcquireData(&p2, true);  // we're keeping the 65k chunk
+    p3.AcquireData(&p2, true);  // we're keeping the 80k chunk
     EXPECT_EQ(p2.total_allocated_bytes(), 33 * 1024);
-    EXPECT_EQ(p2.GetTotalChunkSizes(), 65 * 1024);
+    EXPECT_EQ(p2.GetTotalChunkSizes(), 80 * 1024);
 
     p.FreeAll();
     p2.FreeAll();
@@ -123,6 +124,7 @@ TEST(MemPoolTest, Offsets) {
     data[i] = p.Allocate(8);
     offset += 8;
   }
+  EXPECT_EQ(p.num_allocations(), 1024);
 
   // test GetOffset()
   offset = 0;
@@ -234,24 +236,25 @@ TEST(MemPoolTest, Limits) {
   EXPECT_FALSE(limit3.LimitExceeded());
   EXPECT_EQ(limit3.consumption(), 80);
 
+  // Chunks are rounded up to their size class (96 bytes).
   p1->Allocate(88);
   EXPECT_TRUE(limit1.LimitExceeded());
-  EXPECT_EQ(limit1.consumption(), 168);
+  EXPECT_EQ(limit1.consumption(), 176);
   EXPECT_FALSE(limit3.LimitExceeded());
-  EXPECT_EQ(limit3.consumption(), 168);
+  EXPECT_EQ(limit3.consumption(), 176);
 
   // p2 exceeds a shared limit
   p2->Allocate(80);
   EXPECT_FALSE(limit2.LimitExceeded());
   EXPECT_EQ(limit2.consumption(), 80);
   EXPECT_FALSE(limit3.LimitExceeded());
-  EXPECT_EQ(limit3.consumption(), 248);
+  EXPECT_EQ(limit3.consumption(), 256);
 
   p2->Allocate(80);
   EXPECT_FALSE(limit2.LimitExceeded());
   EXPECT_EQ(limit2.consumption(), 160);
   EXPECT_TRUE(limit3.LimitExceeded());
-  EXPECT_EQ(limit3.consumption(), 328);
+  EXPECT_EQ(limit3.consumption(), 336);
 
   // deleting pools reduces consumption
   p1->FreeAll();
@@ -14,6 +14,7 @@
 
 #include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
+#include "runtime/size-class-arena.h"
 #include "util/impalad-metrics.h"
 
 #include <algorithm>
@@ -37,6 +38,7 @@ MemPool::MemPool(MemTracker* mem_tracker, int chunk_size)
     total_allocated_bytes_(0),
     peak_allocated_bytes_(0),
     total_reserved_bytes_(0),
+    num_allocations_(0),
     mem_tracker_(mem_tracker) {
   DCHECK_GE(chunk_size_, 0);
   DCHECK(mem_tracker != NULL);
@@ -44,7 +46,7 @@ MemPool::MemPool(MemTracker* mem_tracker, int chunk_size)
 
 MemPool::ChunkInfo::ChunkInfo(int size)
   : owns_data(true),
-    data(new uint8_t[size]),
+    data(SizeClassArena::instance()->Allocate(size)),
     size(size),
     cumulative_allocated_bytes(0),
     allocated_bytes(0) {
@@ -58,7 +60,7 @@ MemPool::~MemPool() {
   for (size_t i = 0; i < chunks_.size(); ++i) {
     if (!chunks_[i].owns_data) continue;
     total_bytes_released += chunks_[i].size;
-    delete [] chunks_[i].data;
+    SizeClassArena::instance()->Free(chunks_[i].data, chunks_[i].size);
   }
 
   DCHECK(chunks_.empty()) << "Must call FreeAll() or AcquireData() for this pool";
@@ -72,7 +74,7 @@ void MemPool::FreeAll() {
   for (size_t i = 0; i < chunks_.size(); ++i) {
     if (!chunks_[i].owns_data) continue;
     total_bytes_released += chunks_[i].size;
-    delete [] chunks_[i].data;
+    SizeClassArena::instance()->Free(chunks_[i].data, chunks_[i].size);
   }
   chunks_.clear();
   current_chunk_idx_ = -1;
@@ -113,11 +115,14 @@ bool MemPool::FindChunk(int min_size, bool check_limits) {
       if (current_chunk_idx_ == 0) {
         chunk_size = DEFAULT_INITIAL_CHUNK_SIZE;
       } else {
-        // double the size of the last chunk in the list
-        chunk_size = chunks_[current_chunk_idx_ - 1].size * 2;
+        // grow by two size classes over the last chunk in the list
+        int last_size_class =
+            SizeClassArena::SizeClass(chunks_[current_chunk_idx_ - 1].size);
+        chunk_size = SizeClassArena::ClassSize(last_size_class + 2);
       }
     }
-    chunk_size = ::max(min_size, chunk_size);
+    // The arena hands out whole size classes, so let the chunk use all of it.
+    chunk_size = SizeClassArena::RoundUp(::max(min_size, chunk_size));
 
     if (check_limits) {
       if (!mem_tracker_->TryConsume(chunk_size)) {
@@ -43,8 +43,11 @@ class MemTracker;
 // satisfy the allocation request, the free chunks are searched for one that is
 // big enough otherwise a new chunk is added to the list.
 // The current_chunk_idx_ always points to the last chunk with allocated memory.
-// In order to keep allocation overhead low, chunk sizes double with each new one
-// added, until they hit a maximum size.
+// Chunks are allocated from the SizeClassArena, so freed chunks are recycled across
+// pools and threads and chunk sizes are always arena size classes. In order to keep
+// allocation overhead low, each new chunk is two size classes larger than the last
+// one, i.e. 1.33x - 1.5x as large. Compared to doubling, this bounds the unused tail
+// of the pool's last chunk to about a third of its memory rather than half.
 //
 //     Example:
 //     MemPool* p = new MemPool();
@@ -52,12 +55,12 @@ class MemTracker;
 // returns 8-byte aligned memory (effectively 24 bytes):
 //       .. = p->Allocate(17);
 //     }
-// at this point, 17K have been handed out in response to Allocate() calls and
-// 28K of chunks have been allocated (chunk sizes: 4K, 8K, 16K)
+// at this point, 24K have been handed out in response to Allocate() calls and
+// 30K of chunks have been allocated (chunk sizes: 4K, 6K, 8K, 12K)
 // We track total and peak allocated bytes. At this point they would be the same:
-// 28k bytes.  A call to Clear will return the allocated memory so
+// 24k bytes.  A call to Clear will return the allocated memory so
 // total_allocate_bytes_
-// becomes 0 while peak_allocate_bytes_ remains at 28k.
+// becomes 0 while peak_allocate_bytes_ remains at 24k.
 //     p->Clear();
 // the entire 1st chunk is returned:
 //     .. = p->Allocate(4 * 1024);
@@ -150,6 +153,9 @@ class MemPool {
   int64_t total_reserved_bytes() const { return total_reserved_bytes_; }
   MemTracker* mem_tracker() { return mem_tracker_; }
 
+  // Number of Allocate() and TryAllocate() calls made on this pool.
+  int64_t num_allocations() const { return num_allocations_; }
+
   // Return sum of chunk_sizes_.
   int64_t GetTotalChunkSizes() const;
 
@@ -225,6 +231,8 @@ class MemPool {
   // sum of all bytes allocated in chunks_
   int64_t total_reserved_bytes_;
 
+  int64_t num_allocations_;
+
   std::vector<ChunkInfo> chunks_;
 
   // The current and peak memory footprint of this pool. This is different from
@@ -255,6 +263,7 @@ class MemPool {
   template <bool CHECK_LIMIT_FIRST>
   uint8_t* Allocate(int size) {
     if (size == 0) return NULL;
+    ++num_allocations_;
 
     int num_bytes = ((size + 7) / 8) * 8;  // round up to nearest 8 bytes
     if (current_chunk_idx_ == -1
@@ -13,6 +13,8 @@
 // limitations under the License.
 
 #include <string>
+#include <vector>
+#include <boost/bind.hpp>
 #include <gtest/gtest.h>
 
 #include "runtime/mem-tracker.h"
@@ -136,7 +138,10 @@ class GcFunctionHelper {
 
   GcFunctionHelper(MemTracker* tracker) : tracker_(tracker) { }
 
-  void GcFunc() { tracker_->Release(NUM_RELEASE_BYTES); }
+  int64_t GcFunc(int64_t bytes_to_free) {
+    tracker_->Release(NUM_RELEASE_BYTES);
+    return NUM_RELEASE_BYTES;
+  }
 
  private:
   MemTracker* tracker_;
@@ -156,7 +161,8 @@ TEST(MemTestTest, GcFunctions) {
 
   // Attach GcFunction that releases 1 byte
   GcFunctionHelper gc_func_helper(&t);
-  t.AddGcFunction(boost::bind(&GcFunctionHelper::GcFunc, &gc_func_helper));
+  t.AddGcFunction("gc-func-helper", MemTracker::GC_PRIORITY_FREE_BUFFERS,
+      boost::bind(&GcFunctionHelper::GcFunc, &gc_func_helper, _1));
   EXPECT_TRUE(t.TryConsume(2));
   EXPECT_EQ(t.consumption(), 10);
   EXPECT_FALSE(t.LimitExceeded());
@@ -180,15 +186,69 @@ TEST(MemTestTest, GcFunctions) {
   // Add more GcFunctions, test that we only call them until the limit is no longer
   // exceeded
   GcFunctionHelper gc_func_helper2(&t);
-  t.AddGcFunction(boost::bind(&GcFunctionHelper::GcFunc, &gc_func_helper2));
+  t.AddGcFunction("gc-func-helper2", MemTracker::GC_PRIORITY_FREE_BUFFERS,
+      boost::bind(&GcFunctionHelper::GcFunc, &gc_func_helper2, _1));
   GcFunctionHelper gc_func_helper3(&t);
-  t.AddGcFunction(boost::bind(&GcFunctionHelper::GcFunc, &gc_func_helper3));
+  t.AddGcFunction("gc-func-helper3", MemTracker::GC_PRIORITY_FREE_BUFFERS,
+      boost::bind(&GcFunctionHelper::GcFunc, &gc_func_helper3, _1));
   t.Consume(1);
   EXPECT_EQ(t.consumption(), 11);
   EXPECT_FALSE(t.LimitExceeded());
   EXPECT_EQ(t.consumption(), 10);
 }
 
+// Frees up to 'available_bytes_' and records the order in which it was called.
+class TargetedGcFunctionHelper {
+ public:
+  TargetedGcFunctionHelper(MemTracker* tracker, int64_t available_bytes, int id,
+      vector<int>* calls)
+    : tracker_(tracker), available_bytes_(available_bytes), id_(id), calls_(calls) { }
+
+  int64_t GcFunc(int64_t bytes_to_free) {
+    calls_->push_back(id_);
+    int64_t bytes_freed = min(bytes_to_free, available_bytes_);
+    available_bytes_ -= bytes_freed;
+    tracker_->Release(bytes_freed);
+    return bytes_freed;
+  }
+
+ private:
+  MemTracker* tracker_;
+  int64_t available_bytes_;
+  int id_;
+  vector<int>* calls_;
+};
+
+TEST(MemTestTest, GcFunctionPriorities) {
+  MemTracker t(100);
+  t.Consume(100);
+  vector<int> calls;
+  TargetedGcFunctionHelper query_state(&t, 100, 2, &calls);
+  TargetedGcFunctionHelper cached_data(&t, 100, 1, &calls);
+  TargetedGcFunctionHelper free_buffers(&t, 5, 0, &calls);
+  t.AddGcFunction("query-state", MemTracker::GC_PRIORITY_QUERY_STATE,
+      boost::bind(&TargetedGcFunctionHelper::GcFunc, &query_state, _1));
+  t.AddGcFunction("cached-data", MemTracker::GC_PRIORITY_CACHED_DATA,
+      boost::bind(&TargetedGcFunctionHelper::GcFunc, &cached_data, _1));
+  t.AddGcFunction("free-buffers", MemTracker::GC_PRIORITY_FREE_BUFFERS,
+      boost::bind(&TargetedGcFunctionHelper::GcFunc, &free_buffers, _1));
+
+  // Only the cheapest function is needed.
+  EXPECT_TRUE(t.TryConsume(5));
+  ASSERT_EQ(calls.size(), 1);
+  EXPECT_EQ(calls[0], 0);
+  EXPECT_EQ(t.consumption(), 100);
+
+  // The free buffers are used up, so the cached data is freed next, but only as much
+  // as is needed. The query state is left alone.
+  calls.clear();
+  EXPECT_TRUE(t.TryConsume(20));
+  ASSERT_EQ(calls.size(), 2);
+  EXPECT_EQ(calls[0], 0);
+  EXPECT_EQ(calls[1], 1);
+  EXPECT_EQ(t.consumption(), 100);
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -45,6 +45,7 @@ MemTracker::MemTracker(int64_t byte_limit, const string& label, MemTracker* pare
     consumption_(&local_counter_),
     local_counter_(TCounterType::BYTES),
     consumption_metric_(NULL),
+    metrics_(NULL),
     auto_unregister_(false),
     enable_logging_(false),
     log_stack_(false),
@@ -65,6 +66,7 @@ MemTracker::MemTracker(
     consumption_(profile->AddHighWaterMarkCounter(COUNTER_NAME, TCounterType::BYTES)),
     local_counter_(TCounterType::BYTES),
     consumption_metric_(NULL),
+    metrics_(NULL),
     auto_unregister_(false),
     enable_logging_(false),
     log_stack_(false),
@@ -84,6 +86,7 @@ MemTracker::MemTracker(Metrics::PrimitiveMetric<uint64_t>* consumption_metric,
     consumption_(&local_counter_),
     local_counter_(TCounterType::BYTES),
     consumption_metric_(consumption_metric),
+    metrics_(NULL),
     auto_unregister_(false),
     enable_logging_(false),
     log_stack_(false),
@@ -186,6 +189,29 @@ MemTracker::~MemTracker() {
   pool_to_mem_trackers_.erase(pool_name_);
 }
 
+void MemTracker::AddGcFunction(const string& name, GcPriority priority,
+    const GcFunction& f) {
+  ScopedSpinLock l(&gc_lock_);
+  GcFunctionEntry entry;
+  entry.name = name;
+  entry.priority = priority;
+  entry.fn = f;
+  entry.bytes_freed_metric = NULL;
+  if (metrics_ != NULL) RegisterGcFunctionMetric(&entry);
+  // Insert after all functions with the same or a lower priority.
+  vector<GcFunctionEntry>::iterator it = gc_functions_.begin();
+  while (it != gc_functions_.end() && it->priority <= priority) ++it;
+  gc_functions_.insert(it, entry);
+}
+
+void MemTracker::RegisterGcFunctionMetric(GcFunctionEntry* entry) {
+  DCHECK(metrics_ != NULL);
+  stringstream key;
+  key << metrics_prefix_ << ".bytes-freed-by-" << entry->name;
+  entry->bytes_freed_metric =
+      metrics_->RegisterMetric(new Metrics::BytesMetric(key.str(), 0L));
+}
+
 void MemTracker::RegisterMetrics(Metrics* metrics, const string& prefix) {
   stringstream num_gcs_key;
   num_gcs_key << prefix << ".num-gcs";
@@ -200,6 +226,13 @@ void MemTracker::RegisterMetrics(Metrics* metrics, const string& prefix) {
   bytes_over_limit_key << prefix << ".bytes-over-limit";
   bytes_over_limit_metric_ = metrics->RegisterMetric(
       new Metrics::BytesMetric(bytes_over_limit_key.str(), -1));
+
+  ScopedSpinLock l(&gc_lock_);
+  metrics_ = metrics;
+  metrics_prefix_ = prefix;
+  for (int i = 0; i < gc_functions_.size(); ++i) {
+    RegisterGcFunctionMetric(&gc_functions_[i]);
+  }
 }
 
 // Calling this on the query tracker results in output like:
@@ -255,11 +288,25 @@ bool MemTracker::GcMemory(int64_t max_consumption) {
   if (pre_gc_consumption < max_consumption) return false;
   if (num_gcs_metric_ != NULL) num_gcs_metric_->Increment(1);
 
-  // Try to free up some memory
-  for (int i = 0; i < gc_functions_.size(); ++i) {
-    gc_functions_[i]();
+  // Memory that was already freed may only need to be returned to the system.
+  if (!gc_release_function_.empty()) {
+    gc_release_function_(consumption() - max_consumption);
+    if (consumption_metric_ != NULL) consumption_->Set(consumption_metric_->value());
+  }
+
+  // Try to free up some memory, cheapest functions first.
+  for (int i = 0; i < gc_functions_.size() && consumption() > max_consumption; ++i) {
+    GcFunctionEntry* entry = &gc_functions_[i];
+    int64_t bytes_freed = entry->fn(consumption() - max_consumption);
+    if (bytes_freed > 0) {
+      VLOG_FILE << "GC function " << entry->name << " freed "
+                << PrettyPrinter::Print(bytes_freed, TCounterType::BYTES);
+      if (entry->bytes_freed_metric != NULL) {
+        entry->bytes_freed_metric->Increment(bytes_freed);
+      }
+      if (!gc_release_function_.empty()) gc_release_function_(bytes_freed);
+    }
     if (consumption_metric_ != NULL) consumption_->Set(consumption_metric_->value());
-    if (consumption() <= max_consumption) break;
   }
 
   if (bytes_freed_by_last_gc_metric_ != NULL) {
@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <map>
 #include <vector>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/thread/mutex.hpp>
@@ -52,10 +53,15 @@ class QueryResourceMgr;
 //
 // GcFunctions can be attached to a MemTracker in order to free up memory if the limit is
 // reached. If LimitExceeded() is called and the limit is exceeded, it will first call the
-// GcFunctions to try to free memory and recheck the limit. For example, the process
-// tracker has a GcFunction that releases any unused memory still held by tcmalloc, so
-// this will be called before the process limit is reported as exceeded. GcFunctions are
-// called in the order they are added, so expensive functions should be added last.
+// GcFunctions to try to free memory and recheck the limit. Each GcFunction is passed the
+// number of bytes needed to get back under the limit and returns the number of bytes it
+// freed. GcFunctions are called in order of their GcPriority, cheapest first (e.g.
+// cached free buffers before cached data that may need to be recomputed), and only
+// until the tracker is back under its limit.
+// A tracker whose consumption comes from a tcmalloc metric also needs the freed memory
+// to be returned to the system before it shows up in the metric. The process tracker
+// has a release function that does that, which is called before the GcFunctions and
+// again after each GcFunction that freed memory.
 //
 // This class is thread-safe.
 class MemTracker {
@@ -248,15 +254,35 @@ class MemTracker {
   MemTracker* parent() const { return parent_; }
 
   // Signature for function that can be called to free some memory after limit is reached.
-  typedef boost::function<void ()> GcFunction;
-
-  // Add a function 'f' to be called if the limit is reached.
+  // The argument is the number of bytes the caller would like freed. The function may
+  // free less or more than that and returns the number of bytes it actually freed.
+  typedef boost::function<int64_t (int64_t bytes_to_free)> GcFunction;
+
+  // Order in which GcFunctions are called. Functions with the same priority are called
+  // in the order they are added.
+  enum GcPriority {
+    // Free memory that is cached for reuse but holds no data, e.g. free IO buffers.
+    GC_PRIORITY_FREE_BUFFERS = 0,
+    // Cached data that can be reloaded if it is needed again, e.g. cached UDF libraries.
+    GC_PRIORITY_CACHED_DATA = 1,
+    // Memory held on behalf of queries that can be given up without failing them, e.g.
+    // result caches of running queries.
+    GC_PRIORITY_QUERY_STATE = 2
+  };
+
+  // Add a function 'f' to be called if the limit is reached. 'name' identifies the
+  // function in the metrics registered by RegisterMetrics().
   // 'f' does not need to be thread-safe as long as it is added to only one MemTracker.
   // Note that 'f' must be valid for the lifetime of this MemTracker.
-  void AddGcFunction(GcFunction f) { gc_functions_.push_back(f); }
+  void AddGcFunction(const std::string& name, GcPriority priority, const GcFunction& f);
+
+  // Sets the function that returns memory freed by the process to the system, e.g. by
+  // releasing it from tcmalloc. Only useful if consumption comes from a metric.
+  void SetGcReleaseFunction(const GcFunction& f) { gc_release_function_ = f; }
 
   // Register this MemTracker's metrics. Each key will be of the form
-  // "<prefix>.<metric name>".
+  // "<prefix>.<metric name>". The bytes freed by each GcFunction are reported in
+  // "<prefix>.bytes-freed-by-<name>".
   void RegisterMetrics(Metrics* metrics, const std::string& prefix);
 
   // Logs the usage of this tracker and all of its children (recursively).
@@ -334,8 +360,29 @@ class MemTracker {
   // remove.
   std::list<MemTracker*>::iterator child_tracker_it_;
 
-  // Functions to call after the limit is reached to free memory.
-  std::vector<GcFunction> gc_functions_;
+  struct GcFunctionEntry {
+    std::string name;
+    GcPriority priority;
+    GcFunction fn;
+
+    // Total bytes freed by 'fn'. NULL until RegisterMetrics() is called.
+    Metrics::BytesMetric* bytes_freed_metric;
+  };
+
+  // Registers the bytes freed metric for 'entry'. metrics_ must be set.
+  void RegisterGcFunctionMetric(GcFunctionEntry* entry);
+
+  // Functions to call after the limit is reached to free memory, sorted by priority.
+  // Protected by gc_lock_.
+  std::vector<GcFunctionEntry> gc_functions_;
+
+  // If set, called before the GcFunctions and after each GcFunction that freed memory.
+  GcFunction gc_release_function_;
+
+  // Metrics that the GcFunctions' metrics are registered with, and the prefix for their
+  // keys. NULL until RegisterMetrics() is called.
+  Metrics* metrics_;
+  std::string metrics_prefix_;
 
   // If true, calls UnregisterFromParent() in the dtor. This is only used for
   // the query wide trackers to remove it from the process mem tracker. The
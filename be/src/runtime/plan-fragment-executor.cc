@@ -44,6 +44,9 @@
 
 DEFINE_bool(serialize_batch, false, "serialize and deserialize each returned row batch");
 DEFINE_int32(status_report_interval, 5, "interval between profile reports; in seconds");
+DEFINE_bool(async_codegen, true, "if true, fragments start executing with interpreted "
+    "code while the codegen'd functions are compiled in a background thread, and switch "
+    "to the compiled functions once they are ready");
 DECLARE_bool(enable_rm);
 
 using namespace std;
@@ -242,8 +245,14 @@ Status PlanFragmentExecutor::Prepare(const TExecPlanFragmentParams& request) {
 }
 
 void PlanFragmentExecutor::OptimizeLlvmModule() {
-  if (runtime_state_->codegen() == NULL) return;
-  Status status = runtime_state_->codegen()->FinalizeModule();
+  LlvmCodeGen* codegen = runtime_state_->codegen();
+  if (codegen == NULL) return;
+  if (FLAGS_async_codegen && codegen->CanFinalizeAsync()) {
+    codegen_thread_.reset(new Thread("plan-fragment-executor", "codegen",
+        &PlanFragmentExecutor::FinalizeLlvmModuleAsync, this));
+    return;
+  }
+  Status status = codegen->FinalizeModule();
   if (!status.ok()) {
     stringstream ss;
     ss << "Error with codegen for this query: " << status.GetErrorMsg();
@@ -251,6 +260,28 @@ void PlanFragmentExecutor::OptimizeLlvmModule() {
   }
 }
 
+void PlanFragmentExecutor::FinalizeLlvmModuleAsync() {
+  LlvmCodeGen* codegen = runtime_state_->codegen();
+  Status status = codegen->FinalizeModule();
+  if (!status.ok()) {
+    // The fragment keeps running the interpreted functions. The error only goes to the
+    // log and the codegen profile; the query's error log is left to the fragment
+    // thread.
+    LOG(WARNING) << "Error with codegen for fragment instance "
+                 << runtime_state_->fragment_instance_id() << ": "
+                 << status.GetErrorMsg();
+    codegen->runtime_profile()->AddInfoString("CodegenError", status.GetErrorMsg());
+  }
+}
+
+void PlanFragmentExecutor::JoinCodegenThread() {
+  if (codegen_thread_.get() == NULL) return;
+  // The compilation cannot be interrupted, so this may have to wait for it to finish
+  // if the fragment completed or was cancelled quickly.
+  codegen_thread_->Join();
+  codegen_thread_.reset();
+}
+
 void PlanFragmentExecutor::PrintVolumeIds(
     const PerNodeScanRanges& per_node_scan_ranges) {
   if (per_node_scan_ranges.empty())
@@ -523,6 +554,8 @@ void PlanFragmentExecutor::ReleaseThreadToken() {
 
 void PlanFragmentExecutor::Close() {
   if (closed_) return;
+  // The codegen thread writes to the exec nodes.
+  JoinCodegenThread();
   row_batch_.reset();
   // Prepare may not have been called, which sets runtime_state_
   if (runtime_state_.get() != NULL) {
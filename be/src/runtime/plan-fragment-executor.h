@@ -149,6 +149,10 @@ class PlanFragmentExecutor {
   boost::condition_variable report_thread_started_cv_;
   bool report_thread_active_;  // true if we started the thread
 
+  // Thread that compiles the codegen'd functions while the fragment starts executing
+  // with the interpreted ones. NULL if the module was compiled in Open().
+  boost::scoped_ptr<Thread> codegen_thread_;
+
   // true if plan_->GetNext() indicated that it's done
   bool done_;
 
@@ -229,8 +233,17 @@ class PlanFragmentExecutor {
   // PlanFragmentExecutor()::Prepare() to allow starting plan fragments more
   // quickly and in parallel (in a deep plan tree, the fragments are started
   // in level order).
+  // If --async_codegen is set and all codegen'd functions have an interpreted
+  // fallback, the module is compiled in codegen_thread_ and this returns immediately.
   void OptimizeLlvmModule();
 
+  // Finalizes the codegen module in codegen_thread_. Errors are logged and added to the
+  // codegen profile, but not to the query's error log.
+  void FinalizeLlvmModuleAsync();
+
+  // Waits for codegen_thread_ to finish, if it was started.
+  void JoinCodegenThread();
+
   // Executes Open() logic and returns resulting status. Does not set status_.
   // If this plan fragment has no sink, OpenInternal() does nothing.
   // If this plan fragment has a sink and OpenInternal() returns without an
@@ -249,9 +249,7 @@ int RowBatch::GetBatchSize(const TRowBatch& batch) {
 }
 
 void RowBatch::AcquireState(RowBatch* src) {
-  DCHECK(row_desc_.Equals(src->row_desc_));
-  DCHECK_EQ(num_tuples_per_row_, src->num_tuples_per_row_);
-  DCHECK_EQ(tuple_ptrs_size_, src->tuple_ptrs_size_);
+  DCHECK(src->row_desc_.IsPrefixOf(row_desc_));
   DCHECK_EQ(capacity_, src->capacity_);
   DCHECK_EQ(auxiliary_mem_usage_, 0);
 
@@ -270,8 +268,19 @@ void RowBatch::AcquireState(RowBatch* src) {
 
   has_in_flight_row_ = src->has_in_flight_row_;
   num_rows_ = src->num_rows_;
-  capacity_ = src->capacity_;
-  std::swap(tuple_ptrs_, src->tuple_ptrs_);
+  if (num_tuples_per_row_ == src->num_tuples_per_row_) {
+    DCHECK_EQ(tuple_ptrs_size_, src->tuple_ptrs_size_);
+    std::swap(tuple_ptrs_, src->tuple_ptrs_);
+  } else {
+    // Our rows are wider than src's, e.g. a join probing in place hands its output
+    // batch to a scan. Copy src's tuples into the prefix of each row; swapping
+    // would leave us with a tuple_ptrs_ buffer that is too small.
+    for (int i = 0; i < num_rows_; ++i) {
+      TupleRow* row = GetRow(i);
+      ClearRow(row);
+      src->CopyRow(src->GetRow(i), row);
+    }
+  }
   tuple_data_pool_->AcquireData(src->tuple_data_pool_.get(), false);
   auxiliary_mem_usage_ += src->tuple_data_pool_->total_allocated_bytes();
 }
@@ -162,7 +162,8 @@ class RowBatch {
 
   // Acquires state from the 'src' row batch into this row batch. This includes all IO
   // buffers and tuple data.
-  // This row batch must be empty and have the same row descriptor as the src batch.
+  // This row batch must be empty and src's row descriptor must be a prefix of this
+  // batch's. If this batch's rows are wider, the remaining tuples are set to NULL.
   // This is used for scan nodes which produce RowBatches asynchronously.  Typically,
   // an ExecNode is handed a row batch to populate (pull model) but ScanNodes have
   // multiple threads which push row batches.
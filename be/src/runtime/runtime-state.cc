@@ -22,6 +22,7 @@
 #include "common/object-pool.h"
 #include "common/status.h"
 #include "exprs/expr.h"
+#include "runtime/buffered-block-mgr.h"
 #include "runtime/descriptors.h"
 #include "runtime/runtime-state.h"
 #include "runtime/timestamp-value.h"
@@ -38,6 +39,8 @@
 #include <iostream>
 
 DECLARE_int32(max_errors);
+DECLARE_int32(buffer_pool_block_size);
+DECLARE_string(scratch_dir);
 
 using namespace boost;
 using namespace llvm;
@@ -82,6 +85,7 @@ RuntimeState::RuntimeState(const TQueryContext& query_ctxt)
 
 RuntimeState::~RuntimeState() {
   if (udf_pool_.get() != NULL) udf_pool_->FreeAll();
+  block_mgr_.reset();
   // query_mem_tracker_ must be valid as long as instance_mem_tracker_ is so
   // delete instance_mem_tracker_ first.
   // LogUsage() walks the MemTracker tree top-down when the memory limit is exceeded.
@@ -145,6 +149,15 @@ Status RuntimeState::InitMemTrackers(const TUniqueId& query_id,
   udf_mem_tracker_.reset(
       new MemTracker(-1, "UDFs", instance_mem_tracker_.get()));
   udf_pool_.reset(new MemPool(udf_mem_tracker_.get()));
+
+  // All fragment instances of the query on this backend share the block mgr, which is
+  // never larger than the query's memory limit. The limits of the query tracker and its
+  // ancestors are also enforced when blocks are allocated.
+  int64_t block_mgr_limit = exec_env_->block_mgr_limit();
+  if (block_mgr_limit < 0) block_mgr_limit = MemInfo::physical_mem();
+  if (query_bytes_limit > 0) block_mgr_limit = min(block_mgr_limit, query_bytes_limit);
+  block_mgr_ = BufferedBlockMgr::GetQueryBlockMgr(query_id, query_mem_tracker_.get(),
+      block_mgr_limit, FLAGS_buffer_pool_block_size, FLAGS_scratch_dir);
   return Status::OK;
 }
 
@@ -278,4 +291,10 @@ void RuntimeState::AddBitmapFilter(SlotId slot, const Bitmap* bitmap) {
   }
 }
 
+bool RuntimeState::AddSlotBoundFilter(SlotId slot, SlotBoundFilter* filter) {
+  DCHECK(filter != NULL);
+  lock_guard<mutex> l(bitmap_lock_);
+  return slot_bound_filters_.insert(make_pair(slot, filter)).second;
+}
+
 }
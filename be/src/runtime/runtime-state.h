@@ -42,12 +42,14 @@
 namespace impala {
 
 class Bitmap;
+class BufferedBlockMgr;
 class DescriptorTbl;
 class ObjectPool;
 class Status;
 class ExecEnv;
 class Expr;
 class LlvmCodeGen;
+class SlotBoundFilter;
 class TimestampValue;
 class DataStreamRecvr;
 
@@ -84,6 +86,7 @@ class RuntimeState {
   // when they are initialized. This function also initializes a user function mem
   // tracker (in the fifth level). If 'request_pool' is null, no request pool mem
   // tracker is set up, i.e. query pools will have the process mem pool as the parent.
+  // Also creates the block mgr, whose tracker is a child of the query tracker.
   Status InitMemTrackers(const TUniqueId& query_id, const std::string* request_pool,
       int64_t query_bytes_limit);
 
@@ -124,6 +127,10 @@ class RuntimeState {
   DiskIoMgr* io_mgr() { return exec_env_->disk_io_mgr(); }
   MemTracker* instance_mem_tracker() { return instance_mem_tracker_.get(); }
   MemTracker* query_mem_tracker() { return query_mem_tracker_.get(); }
+  // Pool of memory blocks for the operators of the query's fragment instances on this
+  // backend. Its memory counts against the query mem tracker. Set by
+  // InitMemTrackers().
+  BufferedBlockMgr* block_mgr() { return block_mgr_.get(); }
   ThreadResourceMgr::ResourcePool* resource_pool() { return resource_pool_; }
 
   FileMoveMap* hdfs_files_to_move() { return &hdfs_files_to_move_; }
@@ -158,6 +165,20 @@ class RuntimeState {
     return slot_bitmap_filters_[slot];
   }
 
+  // Adds a bound filter on slot 'slot'. There can be at most one bound filter per slot,
+  // returns false if 'slot' already has one. The filter is not owned.
+  // Like bitmap filters, all bound filters must be added before the node consuming
+  // them is opened.
+  bool AddSlotBoundFilter(SlotId slot, SlotBoundFilter* filter);
+
+  // Returns the bound filter on 'slot', NULL if there is none.
+  SlotBoundFilter* GetSlotBoundFilter(SlotId slot) {
+    boost::lock_guard<boost::mutex> l(bitmap_lock_);
+    boost::unordered_map<SlotId, SlotBoundFilter*>::iterator it =
+        slot_bound_filters_.find(slot);
+    return it == slot_bound_filters_.end() ? NULL : it->second;
+  }
+
   // Returns runtime state profile
   RuntimeProfile* runtime_profile() { return &profile_; }
 
@@ -343,6 +364,10 @@ class RuntimeState {
   // Memory usage of this fragment instance
   boost::scoped_ptr<MemTracker> instance_mem_tracker_;
 
+  // Shared by all fragment instances of the query on this backend. Its MemTracker is a
+  // child of query_mem_tracker_, so it must be released before it.
+  boost::shared_ptr<BufferedBlockMgr> block_mgr_;
+
   // if true, execution should stop with a CANCELLED status
   bool is_cancelled_;
 
@@ -373,13 +398,16 @@ class RuntimeState {
   // details.
   PlanNodeId root_node_id_;
 
-  // Lock protecting slot_bitmap_filters_
+  // Lock protecting slot_bitmap_filters_ and slot_bound_filters_
   boost::mutex bitmap_lock_;
 
   // Bitmap filter on the hash for 'SlotId'. If bitmap[hash(slot]] is unset, this
   // value can be filtered out. These filters are generated during the query execution.
   boost::unordered_map<SlotId, Bitmap*> slot_bitmap_filters_;
 
+  // Bound filters on slots, see SlotBoundFilter.
+  boost::unordered_map<SlotId, SlotBoundFilter*> slot_bound_filters_;
+
   // prohibit copies
   RuntimeState(const RuntimeState&);
 };
@@ -0,0 +1,145 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <limits>
+#include <string.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <gtest/gtest.h>
+
+#include "runtime/size-class-arena.h"
+#include "util/promise.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+TEST(SizeClassArenaTest, SizeClasses) {
+  EXPECT_EQ(SizeClassArena::RoundUp(1), 8);
+  EXPECT_EQ(SizeClassArena::RoundUp(8), 8);
+  EXPECT_EQ(SizeClassArena::RoundUp(9), 16);
+  EXPECT_EQ(SizeClassArena::RoundUp(64), 64);
+  EXPECT_EQ(SizeClassArena::RoundUp(65), 80);
+  EXPECT_EQ(SizeClassArena::RoundUp(81), 96);
+  EXPECT_EQ(SizeClassArena::RoundUp(120 * 1024), 128 * 1024);
+  EXPECT_EQ(SizeClassArena::RoundUp(129 * 1024), 160 * 1024);
+
+  // Classes are increasing, every size maps to the smallest class that fits it and
+  // no class wastes more than 20% of its size.
+  int64_t last_class_size = 0;
+  for (int i = 0; i < SizeClassArena::NUM_SIZE_CLASSES; ++i) {
+    int64_t class_size = SizeClassArena::ClassSize(i);
+    EXPECT_GT(class_size, last_class_size);
+    EXPECT_EQ(SizeClassArena::SizeClass(class_size), i);
+    EXPECT_EQ(SizeClassArena::SizeClass(last_class_size + 1), i);
+    if (i >= 8) EXPECT_LE((class_size - last_class_size - 1) * 5, class_size);
+    last_class_size = class_size;
+  }
+  EXPECT_LT(SizeClassArena::SizeClass(numeric_limits<int>::max()),
+      SizeClassArena::NUM_SIZE_CLASSES);
+
+  // Powers of 2 are size classes.
+  for (int i = 3; i < 31; ++i) {
+    EXPECT_EQ(SizeClassArena::RoundUp(1L << i), 1L << i);
+  }
+}
+
+TEST(SizeClassArenaTest, Recycle) {
+  SizeClassArena* arena = SizeClassArena::instance();
+  uint8_t* buffer1 = arena->Allocate(1000);
+  ASSERT_TRUE(buffer1 != NULL);
+  memset(buffer1, 1, SizeClassArena::RoundUp(1000));
+  arena->Free(buffer1, 1000);
+
+  // Any size in the same class gets the cached buffer back.
+  int64_t num_system_allocations = arena->num_system_allocations();
+  uint8_t* buffer2 = arena->Allocate(1024);
+  EXPECT_TRUE(buffer1 == buffer2);
+  EXPECT_EQ(arena->num_system_allocations(), num_system_allocations);
+
+  // A different class needs a new buffer.
+  uint8_t* buffer3 = arena->Allocate(2000);
+  EXPECT_TRUE(buffer3 != buffer2);
+  EXPECT_EQ(arena->num_system_allocations(), num_system_allocations + 1);
+  arena->Free(buffer2, 1024);
+  arena->Free(buffer3, 2000);
+
+  // Buffers larger than the thread cache go to the central cache and are freed by
+  // ReleaseFreeMemory(), largest first and only as many as are needed.
+  int64_t size = 2 * 1024 * 1024;
+  uint8_t* buffer4 = arena->Allocate(size);
+  uint8_t* buffer5 = arena->Allocate(size);
+  uint8_t* buffer6 = arena->Allocate(2 * size);
+  arena->Free(buffer4, size);
+  arena->Free(buffer5, size);
+  arena->Free(buffer6, 2 * size);
+  EXPECT_EQ(arena->central_cache_bytes(), 4 * size);
+  EXPECT_EQ(arena->ReleaseFreeMemory(1), 2 * size);
+  EXPECT_EQ(arena->central_cache_bytes(), 2 * size);
+  EXPECT_EQ(arena->ReleaseFreeMemory(size + 1), 2 * size);
+  EXPECT_EQ(arena->central_cache_bytes(), 0);
+
+  // Once the central cache is empty, the calling thread's cache is freed.
+  EXPECT_EQ(arena->ReleaseFreeMemory(size),
+      SizeClassArena::RoundUp(1000) + SizeClassArena::RoundUp(2000));
+  EXPECT_EQ(arena->ReleaseFreeMemory(size), 0);
+  num_system_allocations = arena->num_system_allocations();
+  arena->Free(arena->Allocate(1000), 1000);
+  EXPECT_EQ(arena->num_system_allocations(), num_system_allocations + 1);
+}
+
+// Caches a buffer in the calling thread's cache, waits for 'released' and then returns
+// the number of system allocations needed to allocate a buffer of the same size.
+static void AllocateAfterRelease(Promise<bool>* cached, Promise<bool>* released,
+    int64_t* num_system_allocations) {
+  SizeClassArena* arena = SizeClassArena::instance();
+  arena->Free(arena->Allocate(5000), 5000);
+  cached->Set(true);
+  released->Get();
+  int64_t start = arena->num_system_allocations();
+  uint8_t* buffer = arena->Allocate(5000);
+  *num_system_allocations = arena->num_system_allocations() - start;
+  arena->Free(buffer, 5000);
+}
+
+// The caches of other threads are freed when they next use the arena.
+TEST(SizeClassArenaTest, ReleaseOtherThreadCaches) {
+  SizeClassArena* arena = SizeClassArena::instance();
+  Promise<bool> cached;
+  Promise<bool> released;
+  int64_t num_system_allocations = -1;
+  thread t(bind(&AllocateAfterRelease, &cached, &released, &num_system_allocations));
+  cached.Get();
+  arena->ReleaseFreeMemory(1);
+  released.Set(true);
+  t.join();
+  EXPECT_EQ(num_system_allocations, 1);
+
+  // Without a release the cached buffer is reused.
+  Promise<bool> cached2;
+  Promise<bool> released2;
+  thread t2(bind(&AllocateAfterRelease, &cached2, &released2, &num_system_allocations));
+  cached2.Get();
+  released2.Set(true);
+  t2.join();
+  EXPECT_EQ(num_system_allocations, 0);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
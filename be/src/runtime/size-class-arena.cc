@@ -0,0 +1,227 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/size-class-arena.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include <gflags/gflags.h>
+
+#include "common/compiler-util.h"
+#include "util/debug-util.h"
+
+using namespace std;
+
+DEFINE_int64(arena_thread_cache_size, 1024 * 1024, "(Advanced) Maximum number of "
+    "bytes of free buffers each thread keeps cached for reuse.");
+DEFINE_int64(arena_central_cache_size, 64L * 1024 * 1024, "(Advanced) Maximum number "
+    "of bytes of free buffers shared by all threads that are kept cached for reuse.");
+
+namespace impala {
+
+const int SizeClassArena::NUM_SIZE_CLASSES;
+const int64_t SizeClassArena::MAX_CACHED_SIZE;
+
+struct SizeClassArena::ThreadCache {
+  FreeBuffer* lists[NUM_SIZE_CLASSES];
+
+  // Sum of the sizes of the buffers in lists.
+  int64_t bytes;
+
+  // Value of SizeClassArena::release_count_ when the buffers were last freed.
+  int64_t release_count;
+
+  ThreadCache(int64_t release_count) : bytes(0), release_count(release_count) {
+    memset(lists, 0, sizeof(lists));
+  }
+};
+
+__thread SizeClassArena::ThreadCache* SizeClassArena::thread_cache_ = NULL;
+
+// Used to call ReleaseThreadCache() on thread exit.
+static pthread_key_t thread_cache_key;
+
+SizeClassArena* SizeClassArena::instance() {
+  static SizeClassArena arena;
+  return &arena;
+}
+
+SizeClassArena::SizeClassArena() {
+  int ret = pthread_key_create(&thread_cache_key, &SizeClassArena::ReleaseThreadCache);
+  DCHECK_EQ(ret, 0);
+}
+
+SizeClassArena::ThreadCache* SizeClassArena::GetThreadCache() {
+  if (LIKELY(thread_cache_ != NULL)) return thread_cache_;
+  thread_cache_ = new ThreadCache(release_count_);
+  pthread_setspecific(thread_cache_key, thread_cache_);
+  return thread_cache_;
+}
+
+uint8_t* SizeClassArena::Allocate(int64_t size) {
+  int size_class = SizeClass(size);
+  int64_t class_size = ClassSize(size_class);
+  ++num_allocations_;
+  allocated_bytes_ += class_size;
+  if (class_size <= MAX_CACHED_SIZE) {
+    ThreadCache* cache = GetThreadCache();
+    CheckThreadCacheReleased(cache);
+    FreeBuffer* buffer = cache->lists[size_class];
+    if (buffer != NULL) {
+      cache->lists[size_class] = buffer->next;
+      cache->bytes -= class_size;
+      return reinterpret_cast<uint8_t*>(buffer);
+    }
+
+    CentralList* list = &central_lists_[size_class];
+    {
+      ScopedSpinLock l(&list->lock);
+      buffer = list->head;
+      if (buffer != NULL) list->head = buffer->next;
+    }
+    if (buffer != NULL) {
+      central_cache_bytes_ -= class_size;
+      return reinterpret_cast<uint8_t*>(buffer);
+    }
+  }
+  ++num_system_allocations_;
+  return reinterpret_cast<uint8_t*>(malloc(class_size));
+}
+
+void SizeClassArena::Free(uint8_t* buffer, int64_t size) {
+  if (buffer == NULL) return;
+  int size_class = SizeClass(size);
+  int64_t class_size = ClassSize(size_class);
+  if (class_size > MAX_CACHED_SIZE) {
+    free(buffer);
+    return;
+  }
+
+  FreeBuffer* free_buffer = reinterpret_cast<FreeBuffer*>(buffer);
+  ThreadCache* cache = GetThreadCache();
+  CheckThreadCacheReleased(cache);
+  if (cache->bytes + class_size <= FLAGS_arena_thread_cache_size) {
+    free_buffer->next = cache->lists[size_class];
+    cache->lists[size_class] = free_buffer;
+    cache->bytes += class_size;
+    return;
+  }
+  FreeToCentralCache(free_buffer, size_class);
+}
+
+void SizeClassArena::FreeToCentralCache(FreeBuffer* buffer, int size_class) {
+  int64_t class_size = ClassSize(size_class);
+  // The check against the limit is racy, so the central cache can grow slightly
+  // beyond it.
+  if (central_cache_bytes_ + class_size > FLAGS_arena_central_cache_size) {
+    free(buffer);
+    return;
+  }
+  CentralList* list = &central_lists_[size_class];
+  {
+    ScopedSpinLock l(&list->lock);
+    buffer->next = list->head;
+    list->head = buffer;
+  }
+  central_cache_bytes_ += class_size;
+}
+
+void SizeClassArena::ReleaseThreadCache(void* cache_ptr) {
+  ThreadCache* cache = reinterpret_cast<ThreadCache*>(cache_ptr);
+  SizeClassArena* arena = instance();
+  for (int i = 0; i < NUM_SIZE_CLASSES; ++i) {
+    FreeBuffer* buffer = cache->lists[i];
+    while (buffer != NULL) {
+      FreeBuffer* next = buffer->next;
+      arena->FreeToCentralCache(buffer, i);
+      buffer = next;
+    }
+  }
+  delete cache;
+}
+
+int64_t SizeClassArena::FreeThreadCache(ThreadCache* cache) {
+  int64_t bytes_freed = cache->bytes;
+  for (int i = 0; i < NUM_SIZE_CLASSES; ++i) {
+    FreeBuffer* buffer = cache->lists[i];
+    while (buffer != NULL) {
+      FreeBuffer* next = buffer->next;
+      free(buffer);
+      buffer = next;
+    }
+    cache->lists[i] = NULL;
+  }
+  cache->bytes = 0;
+  return bytes_freed;
+}
+
+void SizeClassArena::CheckThreadCacheReleased(ThreadCache* cache) {
+  int64_t release_count = release_count_;
+  if (LIKELY(cache->release_count == release_count)) return;
+  cache->release_count = release_count;
+  FreeThreadCache(cache);
+}
+
+int64_t SizeClassArena::ReleaseFreeMemory(int64_t bytes_to_free) {
+  // Tells the other threads to free their caches.
+  ++release_count_;
+  int64_t bytes_freed = 0;
+  for (int i = NUM_SIZE_CLASSES - 1; i >= 0 && bytes_freed < bytes_to_free; --i) {
+    CentralList* list = &central_lists_[i];
+    int64_t class_size = ClassSize(i);
+    // Only unlink the buffers that are needed to reach the target.
+    FreeBuffer* buffer;
+    {
+      ScopedSpinLock l(&list->lock);
+      buffer = list->head;
+      FreeBuffer* last = NULL;
+      int64_t bytes = bytes_freed;
+      for (FreeBuffer* b = buffer; b != NULL && bytes < bytes_to_free; b = b->next) {
+        last = b;
+        bytes += class_size;
+      }
+      if (last == NULL) continue;
+      list->head = last->next;
+      last->next = NULL;
+    }
+    while (buffer != NULL) {
+      FreeBuffer* next = buffer->next;
+      free(buffer);
+      bytes_freed += class_size;
+      buffer = next;
+    }
+  }
+  central_cache_bytes_ -= bytes_freed;
+
+  if (bytes_freed < bytes_to_free && thread_cache_ != NULL) {
+    thread_cache_->release_count = release_count_;
+    bytes_freed += FreeThreadCache(thread_cache_);
+  }
+  VLOG_FILE << "SizeClassArena released "
+            << PrettyPrinter::Print(bytes_freed, TCounterType::BYTES);
+  return bytes_freed;
+}
+
+string SizeClassArena::DebugString() const {
+  stringstream ss;
+  ss << "SizeClassArena(allocations=" << num_allocations_
+     << " allocated_bytes=" << allocated_bytes_
+     << " system_allocations=" << num_system_allocations_
+     << " central_cache_bytes=" << central_cache_bytes_ << ")";
+  return ss.str();
+}
+
+}
@@ -0,0 +1,157 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_RUNTIME_SIZE_CLASS_ARENA_H
+#define IMPALA_RUNTIME_SIZE_CLASS_ARENA_H
+
+#include <string>
+
+#include "common/atomic.h"
+#include "common/logging.h"
+#include "util/spinlock.h"
+
+namespace impala {
+
+// Process-wide allocator of buffers rounded up to a fixed set of size classes.
+// MemPool allocates its chunks from here and FreePool uses the same size classes for
+// its free lists.
+//
+// Size classes are multiples of 8 bytes up to 64 bytes. Above that there are four
+// classes per power of 2 (e.g. 64, 80, 96, 112, 128, 160, ...), so rounding an
+// allocation up to its class wastes at most 20% of the buffer instead of the up to
+// 50% that rounding to the next power of 2 wastes. Powers of 2 are always size
+// classes.
+//
+// Freed buffers are cached rather than returned to the system. Each thread has a
+// small cache that is accessed without any locking; buffers that don't fit in it go
+// to a central cache with a spinlock per size class. Buffers that don't fit in
+// either cache, or are larger than MAX_CACHED_SIZE, are freed. The caches are bounded
+// by --arena_thread_cache_size and --arena_central_cache_size.
+//
+// The arena does not track memory against MemTrackers; callers do that. Memory in
+// the caches shows up in the process' tcmalloc consumption, and ReleaseFreeMemory()
+// frees cached buffers when the process is under memory pressure. Thread caches can
+// only be accessed by their thread, so other threads free their caches the next time
+// they use the arena.
+class SizeClassArena {
+ public:
+  // Number of size classes, enough to cover any int size.
+  static const int NUM_SIZE_CLASSES = 8 + 4 * (32 - 6);
+
+  // Largest buffer that is cached once freed.
+  static const int64_t MAX_CACHED_SIZE = 8 * 1024 * 1024;
+
+  // Returns the process-wide arena.
+  static SizeClassArena* instance();
+
+  // Returns the index of the smallest size class that fits 'size' bytes. 'size' must
+  // be greater than 0.
+  static int SizeClass(int64_t size) {
+    DCHECK_GT(size, 0);
+    if (size <= 64) return (size + 7) / 8 - 1;
+    int64_t s = size - 1;
+    int log2 = 63 - __builtin_clzll(s);
+    int sub_class = (s >> (log2 - 2)) & 3;
+    return 8 + (log2 - 6) * 4 + sub_class;
+  }
+
+  // Returns the number of bytes in buffers of size class 'size_class'.
+  static int64_t ClassSize(int size_class) {
+    DCHECK_GE(size_class, 0);
+    DCHECK_LT(size_class, NUM_SIZE_CLASSES);
+    if (size_class < 8) return (size_class + 1) * 8;
+    int log2 = 6 + (size_class - 8) / 4;
+    int sub_class = (size_class - 8) % 4;
+    return static_cast<int64_t>(5 + sub_class) << (log2 - 2);
+  }
+
+  // Returns 'size' rounded up to its size class.
+  static int64_t RoundUp(int64_t size) { return ClassSize(SizeClass(size)); }
+
+  // Returns a buffer of RoundUp(size) bytes. Returns NULL if the system is out of
+  // memory.
+  uint8_t* Allocate(int64_t size);
+
+  // Returns 'buffer', which was allocated with Allocate(size), to the arena.
+  void Free(uint8_t* buffer, int64_t size);
+
+  // Frees buffers in the central cache, largest first, until at least 'bytes_to_free'
+  // bytes are freed or the central cache is empty, then the calling thread's cache if
+  // that wasn't enough. Returns the number of bytes freed. The caches of the other
+  // threads are freed the next time they call Allocate() or Free().
+  int64_t ReleaseFreeMemory(int64_t bytes_to_free);
+
+  // Number of Allocate() calls and the bytes they returned.
+  int64_t num_allocations() const { return num_allocations_; }
+  int64_t allocated_bytes() const { return allocated_bytes_; }
+
+  // Number of Allocate() calls that had to go to the system for a new buffer.
+  int64_t num_system_allocations() const { return num_system_allocations_; }
+
+  // Bytes of free buffers in the central cache.
+  int64_t central_cache_bytes() const { return central_cache_bytes_; }
+
+  std::string DebugString() const;
+
+ private:
+  // Free buffers are linked through their first bytes.
+  struct FreeBuffer {
+    FreeBuffer* next;
+  };
+
+  struct ThreadCache;
+
+  struct CentralList {
+    SpinLock lock;
+    FreeBuffer* head;
+    CentralList() : head(NULL) { }
+  };
+
+  SizeClassArena();
+
+  // Returns the calling thread's cache, creating it if this is the thread's first call.
+  ThreadCache* GetThreadCache();
+
+  // Pushes 'buffer' of size class 'size_class' onto the central cache, or frees it if
+  // the central cache is full.
+  void FreeToCentralCache(FreeBuffer* buffer, int size_class);
+
+  // Called on thread exit to move a thread's cached buffers to the central cache.
+  static void ReleaseThreadCache(void* cache);
+
+  // Frees all buffers in 'cache' and returns the number of bytes freed.
+  static int64_t FreeThreadCache(ThreadCache* cache);
+
+  // Frees the buffers in 'cache' if ReleaseFreeMemory() was called since they were last
+  // freed.
+  void CheckThreadCacheReleased(ThreadCache* cache);
+
+  // The calling thread's cache, NULL until the thread first uses the arena.
+  static __thread ThreadCache* thread_cache_;
+
+  CentralList central_lists_[NUM_SIZE_CLASSES];
+
+  // Number of ReleaseFreeMemory() calls.
+  AtomicInt<int64_t> release_count_;
+
+  AtomicInt<int64_t> central_cache_bytes_;
+  AtomicInt<int64_t> num_allocations_;
+  AtomicInt<int64_t> allocated_bytes_;
+  AtomicInt<int64_t> num_system_allocations_;
+};
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "runtime/slot-bound-filter.h"
+#include "runtime/string-value.h"
+#include "util/cpu-info.h"
+
+namespace impala {
+
+TEST(SlotBoundFilterTest, Ascending) {
+  SlotBoundFilter filter(TYPE_INT, true, false);
+  SlotBoundFilter::Snapshot snapshot;
+  filter.InitSnapshot(&snapshot);
+  int32_t small = 1;
+  int32_t bound = 10;
+  int32_t large = 100;
+
+  // Nothing is rejected until there is a bound.
+  filter.Refresh(&snapshot);
+  EXPECT_FALSE(snapshot.Rejects(&large));
+  EXPECT_FALSE(snapshot.Rejects(NULL));
+
+  filter.SetBound(&bound);
+  // The snapshot doesn't change until it is refreshed.
+  EXPECT_FALSE(snapshot.Rejects(&large));
+  filter.Refresh(&snapshot);
+  EXPECT_FALSE(snapshot.Rejects(&small));
+  EXPECT_FALSE(snapshot.Rejects(&bound));
+  EXPECT_TRUE(snapshot.Rejects(&large));
+  // NULLs sort last.
+  EXPECT_TRUE(snapshot.Rejects(NULL));
+
+  filter.SetBound(&small);
+  filter.Refresh(&snapshot);
+  EXPECT_FALSE(snapshot.Rejects(&small));
+  EXPECT_TRUE(snapshot.Rejects(&bound));
+}
+
+TEST(SlotBoundFilterTest, IsBound) {
+  SlotBoundFilter filter(TYPE_INT, true, false);
+  SlotBoundFilter::Snapshot snapshot;
+  filter.InitSnapshot(&snapshot);
+  int32_t bound = 10;
+  int32_t equal = 10;
+  int32_t other = 5;
+
+  EXPECT_FALSE(snapshot.IsBound(&bound));
+  EXPECT_FALSE(snapshot.IsBound(NULL));
+
+  filter.SetBound(&bound);
+  filter.Refresh(&snapshot);
+  EXPECT_TRUE(snapshot.IsBound(&equal));
+  EXPECT_FALSE(snapshot.IsBound(&other));
+  EXPECT_FALSE(snapshot.IsBound(NULL));
+
+  filter.SetBound(NULL);
+  filter.Refresh(&snapshot);
+  EXPECT_TRUE(snapshot.IsBound(NULL));
+  EXPECT_FALSE(snapshot.IsBound(&equal));
+}
+
+TEST(SlotBoundFilterTest, Descending) {
+  SlotBoundFilter filter(TYPE_DOUBLE, false, true);
+  SlotBoundFilter::Snapshot snapshot;
+  filter.InitSnapshot(&snapshot);
+  double small = -1.5;
+  double bound = 2.5;
+  double large = 1000;
+
+  filter.SetBound(&bound);
+  filter.Refresh(&snapshot);
+  EXPECT_TRUE(snapshot.Rejects(&small));
+  EXPECT_FALSE(snapshot.Rejects(&bound));
+  EXPECT_FALSE(snapshot.Rejects(&large));
+  // NULLs sort first.
+  EXPECT_FALSE(snapshot.Rejects(NULL));
+}
+
+TEST(SlotBoundFilterTest, NullBound) {
+  int64_t value = 0;
+
+  // If NULLs sort first and the bound is NULL, only NULLs can be in the TopN.
+  SlotBoundFilter nulls_first(TYPE_BIGINT, true, true);
+  SlotBoundFilter::Snapshot snapshot;
+  nulls_first.InitSnapshot(&snapshot);
+  nulls_first.SetBound(NULL);
+  nulls_first.Refresh(&snapshot);
+  EXPECT_TRUE(snapshot.Rejects(&value));
+  EXPECT_FALSE(snapshot.Rejects(NULL));
+
+  // If NULLs sort last, a NULL bound doesn't reject anything.
+  SlotBoundFilter nulls_last(TYPE_BIGINT, true, false);
+  nulls_last.InitSnapshot(&snapshot);
+  nulls_last.SetBound(NULL);
+  nulls_last.Refresh(&snapshot);
+  EXPECT_FALSE(snapshot.Rejects(&value));
+  EXPECT_FALSE(snapshot.Rejects(NULL));
+}
+
+TEST(SlotBoundFilterTest, String) {
+  SlotBoundFilter filter(TYPE_STRING, true, false);
+  SlotBoundFilter::Snapshot snapshot;
+  filter.InitSnapshot(&snapshot);
+  char bound_data[] = "def";
+  StringValue bound(bound_data, 3);
+  StringValue equal("def");
+  StringValue before("abc");
+  StringValue after("xyz");
+
+  filter.SetBound(&bound);
+  // The filter has its own copy of the bound.
+  bound_data[0] = 'z';
+  filter.Refresh(&snapshot);
+  EXPECT_FALSE(snapshot.Rejects(&before));
+  EXPECT_FALSE(snapshot.Rejects(&equal));
+  EXPECT_TRUE(snapshot.Rejects(&after));
+  EXPECT_TRUE(snapshot.IsBound(&equal));
+
+  // Copies of a snapshot are independent of it.
+  SlotBoundFilter::Snapshot copy = snapshot;
+  StringValue new_bound("b");
+  filter.SetBound(&new_bound);
+  filter.Refresh(&snapshot);
+  EXPECT_TRUE(snapshot.Rejects(&equal));
+  EXPECT_FALSE(copy.Rejects(&equal));
+}
+
+}
+
+int main(int argc, char **argv) {
+  google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,90 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/slot-bound-filter.h"
+
+#include <string.h>
+
+#include "common/logging.h"
+#include "runtime/string-value.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+bool SlotBoundFilter::IsSupportedType(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+    case TYPE_TIMESTAMP:
+    case TYPE_STRING:
+      return true;
+    default:
+      return false;
+  }
+}
+
+SlotBoundFilter::SlotBoundFilter(const ColumnType& type, bool is_asc, bool nulls_first)
+  : type_(type),
+    is_asc_(is_asc),
+    nulls_first_(nulls_first),
+    version_(0) {
+  DCHECK(IsSupportedType(type)) << type.DebugString();
+  InitSnapshot(&bound_);
+}
+
+void SlotBoundFilter::SetBound(const void* value) {
+  lock_guard<mutex> l(lock_);
+  bound_.has_bound_ = true;
+  bound_.bound_is_null_ = value == NULL;
+  if (value != NULL) {
+    if (type_.type == TYPE_STRING) {
+      const StringValue* string_value = reinterpret_cast<const StringValue*>(value);
+      bound_.string_bound_.assign(string_value->ptr, string_value->len);
+    } else {
+      DCHECK_LE(type_.GetByteSize(), sizeof(bound_.bound_));
+      memcpy(bound_.bound_, value, type_.GetByteSize());
+    }
+  }
+  // Refresh() compares version_ without taking lock_.
+  bound_.version_ = version_.UpdateAndFetch(1);
+}
+
+void SlotBoundFilter::InitSnapshot(Snapshot* snapshot) const {
+  snapshot->type_ = type_;
+  snapshot->is_asc_ = is_asc_;
+  snapshot->nulls_first_ = nulls_first_;
+  snapshot->version_ = 0;
+  snapshot->has_bound_ = false;
+  snapshot->bound_is_null_ = false;
+  snapshot->string_bound_.clear();
+}
+
+void SlotBoundFilter::Refresh(Snapshot* snapshot) {
+  if (snapshot->version_ == version_) return;
+  lock_guard<mutex> l(lock_);
+  snapshot->version_ = bound_.version_;
+  snapshot->has_bound_ = bound_.has_bound_;
+  snapshot->bound_is_null_ = bound_.bound_is_null_;
+  memcpy(snapshot->bound_, bound_.bound_, sizeof(bound_.bound_));
+  snapshot->string_bound_ = bound_.string_bound_;
+}
+
+}
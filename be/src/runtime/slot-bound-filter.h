@@ -0,0 +1,123 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_RUNTIME_SLOT_BOUND_FILTER_H
+#define IMPALA_RUNTIME_SLOT_BOUND_FILTER_H
+
+#include <string>
+#include <boost/thread/mutex.hpp>
+
+#include "common/atomic.h"
+#include "runtime/raw-value.h"
+#include "runtime/types.h"
+
+namespace impala {
+
+// Filter on the values of a slot that rejects the values sorting after a bound, in the
+// order given by an ORDER BY element. The bound is set while the query runs and only
+// ever tightens, e.g. TopNNode sets it to the value of its first ordering expr for the
+// last row of its TopN once it has LIMIT + OFFSET rows. Filters are registered with
+// the RuntimeState (see RuntimeState::AddSlotBoundFilter()) and evaluated by the
+// scanners that materialize the slot.
+// SetBound() may be called concurrently with Refresh() on other threads. Each thread
+// evaluates the filter with a Snapshot of its own, so that evaluating it doesn't
+// require any synchronization.
+class SlotBoundFilter {
+ public:
+  // Copy of the bound of a filter, owned by a single thread.
+  class Snapshot {
+   public:
+    Snapshot() : version_(0), has_bound_(false), bound_is_null_(false) { }
+
+    // Returns true if 'value' sorts after the bound, i.e. if the row it belongs to
+    // can be discarded. 'value' is NULL for a NULL slot.
+    bool Rejects(const void* value) const {
+      if (!has_bound_) return false;
+      if (bound_is_null_) return nulls_first_ && value != NULL;
+      if (value == NULL) return !nulls_first_;
+      int result = CompareToBound(value);
+      return is_asc_ ? result > 0 : result < 0;
+    }
+
+    // Returns true if there is a bound and it is equal to 'value', which is NULL for a
+    // NULL bound.
+    bool IsBound(const void* value) const {
+      if (!has_bound_) return false;
+      if (bound_is_null_ || value == NULL) return bound_is_null_ && value == NULL;
+      return CompareToBound(value) == 0;
+    }
+
+   private:
+    friend class SlotBoundFilter;
+
+    // Compares the non-NULL 'value' to the non-NULL bound.
+    int CompareToBound(const void* value) const {
+      if (type_.type == TYPE_STRING) {
+        StringValue bound(const_cast<char*>(string_bound_.data()), string_bound_.size());
+        return RawValue::Compare(value, &bound, type_);
+      }
+      return RawValue::Compare(value, bound_, type_);
+    }
+
+    ColumnType type_;
+    bool is_asc_;
+    bool nulls_first_;
+
+    // Version of the filter's bound this is a copy of.
+    int64_t version_;
+
+    bool has_bound_;
+    bool bound_is_null_;
+
+    // The bound, if it isn't NULL. The data of a string bound is stored in
+    // string_bound_, other types in bound_, which is large enough for all supported
+    // types.
+    int64_t bound_[2];
+    std::string string_bound_;
+  };
+
+  // Returns true if filters on slots of type 'type' are supported.
+  static bool IsSupportedType(const ColumnType& type);
+
+  SlotBoundFilter(const ColumnType& type, bool is_asc, bool nulls_first);
+
+  // Sets the bound to 'value', which may be NULL. Values sorting after it are rejected.
+  // The new bound must not sort after the previous one. Thread safe.
+  void SetBound(const void* value);
+
+  // Initializes 'snapshot', which evaluates nothing until the first Refresh().
+  void InitSnapshot(Snapshot* snapshot) const;
+
+  // Updates 'snapshot' to the current bound. Cheap if the bound didn't change since
+  // the last call. Thread safe.
+  void Refresh(Snapshot* snapshot);
+
+ private:
+  const ColumnType type_;
+  const bool is_asc_;
+  const bool nulls_first_;
+
+  // Incremented by every SetBound(), after the bound is updated. Read without taking
+  // lock_ by Refresh() to skip copying a bound that didn't change.
+  AtomicInt<int64_t> version_;
+
+  // Protects the bound below.
+  boost::mutex lock_;
+  Snapshot bound_;
+};
+
+}
+
+#endif
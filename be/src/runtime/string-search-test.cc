@@ -0,0 +1,115 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string>
+#include <gtest/gtest.h>
+
+#include "runtime/string-search.h"
+#include "util/cpu-info.h"
+
+using namespace std;
+
+namespace impala {
+
+StringValue FromStdString(const string& str) {
+  char* ptr = const_cast<char*>(str.c_str());
+  int len = str.size();
+  return StringValue(ptr, len);
+}
+
+// Searches for 'pattern' in 'str' with and without SSE4.2 and checks both results
+// against string::find().
+void TestSearch(const string& str, const string& pattern) {
+  size_t expected_pos = str.find(pattern);
+  int expected = expected_pos == string::npos || pattern.empty() ? -1 : expected_pos;
+
+  // Copy the string to a buffer of exactly its length so reading past the end shows up
+  // in ASAN builds.
+  char* buffer = reinterpret_cast<char*>(malloc(str.size() + 1));
+  memcpy(buffer, str.data(), str.size());
+  StringValue str_value(buffer, str.size());
+  StringValue pattern_value = FromStdString(pattern);
+  StringSearch search(&pattern_value);
+
+  bool has_sse4_2 = CpuInfo::IsSupported(CpuInfo::SSE4_2);
+  EXPECT_EQ(expected, search.Search(&str_value))
+      << "str=" << str << " pattern=" << pattern;
+  CpuInfo::EnableFeature(CpuInfo::SSE4_2, false);
+  EXPECT_EQ(expected, search.Search(&str_value))
+      << "str=" << str << " pattern=" << pattern << " (no sse)";
+  if (has_sse4_2) CpuInfo::EnableFeature(CpuInfo::SSE4_2, true);
+  free(buffer);
+}
+
+TEST(StringSearchTest, Basic) {
+  TestSearch("", "");
+  TestSearch("", "a");
+  TestSearch("abc", "");
+  TestSearch("abc", "a");
+  TestSearch("abc", "c");
+  TestSearch("abc", "d");
+  TestSearch("abc", "abc");
+  TestSearch("abc", "abcd");
+  TestSearch("abc", "bc");
+  TestSearch("aaab", "aab");
+  TestSearch(string("a\0bc", 4), string("\0b", 2));
+}
+
+TEST(StringSearchTest, LongStrings) {
+  string alphabet = "abcdefghijklmnopqrstuvwxyz";
+  string str = alphabet + alphabet + alphabet;
+  // Matches at the start, at block boundaries, spanning blocks and at the end.
+  for (int i = 0; i < str.size(); ++i) {
+    TestSearch(str, str.substr(i, 2));
+    TestSearch(str, str.substr(i, 5));
+    TestSearch(str, str.substr(i, 16));
+    TestSearch(str, str.substr(i, 17));
+    TestSearch(str, str.substr(i, 40));
+  }
+  // The pattern prefix matches near the end of the string but the pattern doesn't fit.
+  TestSearch(str, "xyzabc_");
+  TestSearch(str, alphabet.substr(20) + "0");
+  // Long patterns that only differ after the first 16 bytes.
+  TestSearch(str, alphabet.substr(0, 20) + "0");
+  TestSearch(string(100, 'a') + "b", string(30, 'a') + "b");
+  TestSearch(string(100, 'a'), string(30, 'a') + "b");
+}
+
+TEST(StringSearchTest, Random) {
+  srand(0);
+  for (int i = 0; i < 10000; ++i) {
+    // Small alphabets to get many partial matches.
+    int alphabet_size = 2 + rand() % 3;
+    string str;
+    int str_len = rand() % 80;
+    for (int j = 0; j < str_len; ++j) str += 'a' + rand() % alphabet_size;
+    string pattern;
+    int pattern_len = 1 + rand() % 24;
+    if (rand() % 2 == 0 && pattern_len <= str_len) {
+      pattern = str.substr(rand() % (str_len - pattern_len + 1), pattern_len);
+    } else {
+      for (int j = 0; j < pattern_len; ++j) pattern += 'a' + rand() % alphabet_size;
+    }
+    TestSearch(str, pattern);
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
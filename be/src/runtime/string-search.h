@@ -16,20 +16,26 @@
 #ifndef IMPALA_RUNTIME_STRING_SEARCH_H
 #define IMPALA_RUNTIME_STRING_SEARCH_H
 
+#include <algorithm>
 #include <vector>
 #include <cstring>
 #include <boost/cstdint.hpp>
 
 #include "common/logging.h"
 #include "runtime/string-value.h"
+#include "util/cpu-info.h"
+#include "util/sse-util.h"
 
 namespace impala {
 
-// TODO: This can be sped up with SIDD_CMP_EQUAL_ORDERED or at the very least rewritten
-// from published algorithms.
+// On machines with SSE4.2, Search() finds candidate matches 16 bytes at a time with
+// the SIDD_CMP_EQUAL_ORDERED string compare, which compares the first 16 bytes of the
+// pattern against every offset in a block, and verifies candidates with memcmp. The
+// last partial block is searched with the scalar algorithm, so no bytes past the end
+// of the string are read.
 //
-// This is taken from the python search string function doing string search (substring)
-// using an optimized boyer-moore-horspool algorithm.
+// The scalar algorithm is taken from the python search string function doing string
+// search (substring) using an optimized boyer-moore-horspool algorithm.
 // http://hg.python.org/cpython/file/6b6c79eba944/Objects/stringlib/fastsearch.h
 //
 // PYTHON SOFTWARE FOUNDATION LICENSE VERSION 2
@@ -83,15 +89,23 @@ namespace impala {
 class StringSearch {
 
  public:
-  StringSearch() : pattern_(NULL), mask_(0) {}
+  StringSearch() : pattern_(NULL), mask_(0), skip_(0), prefix_len_(0) {}
 
   // Initialize/Precompute a StringSearch object from the pattern
-  StringSearch(const StringValue* pattern) : pattern_(pattern), mask_(0), skip_(0) {
+  StringSearch(const StringValue* pattern)
+    : pattern_(pattern), mask_(0), skip_(0), prefix_len_(0) {
     // Special cases
     if (pattern_->len <= 1) {
       return;
     }
 
+    // The first (up to) 16 bytes of the pattern, zero padded, for the SSE4.2 search.
+    // This is kept as a char array rather than an __m128i so the layout of this class
+    // doesn't depend on whether the including file is compiled with SSE4.2.
+    prefix_len_ = std::min(pattern_->len, SSEUtil::CHARS_PER_128_BIT_REGISTER);
+    memset(prefix_, 0, sizeof(prefix_));
+    memcpy(prefix_, pattern_->ptr, prefix_len_);
+
     // Build compressed lookup table
     int mlast = pattern_->len - 1;
     skip_ = mlast - 1;
@@ -113,8 +127,6 @@ class StringSearch {
       return -1;
     }
 
-    int mlast = pattern_->len - 1;
-    int w = str->len - pattern_->len;
     int n = str->len;
     int m = pattern_->len;
     const char* s = str->ptr;
@@ -127,7 +139,50 @@ class StringSearch {
       return -1;
     }
 
-    // General case.
+#ifdef __SSE4_2__
+    if (CpuInfo::IsSupported(CpuInfo::SSE4_2)) return SearchSSE(s, n);
+#endif
+    return SearchScalar(s, n);
+  }
+
+ private:
+#ifdef __SSE4_2__
+  // Searches 's' a 16 byte block at a time. For each block, the string compare returns
+  // the first offset at which the pattern prefix starts, including offsets near the end
+  // of the block where only the start of the prefix is in the block, so matches that
+  // span blocks are not missed.
+  int SearchSSE(const char* s, int n) const {
+    int m = pattern_->len;
+    if (n < m) return -1;
+    const __m128i needle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix_));
+    int i = 0;
+    while (i + SSEUtil::CHARS_PER_128_BIT_REGISTER <= n) {
+      const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+      int offset = _mm_cmpestri(needle, prefix_len_, block,
+          SSEUtil::CHARS_PER_128_BIT_REGISTER, SSEUtil::STRSTR_MODE);
+      if (offset == SSEUtil::CHARS_PER_128_BIT_REGISTER) {
+        i += SSEUtil::CHARS_PER_128_BIT_REGISTER;
+        continue;
+      }
+      int candidate = i + offset;
+      // Candidates are found in increasing order, so no later one can fit either.
+      if (candidate > n - m) return -1;
+      if (memcmp(s + candidate, pattern_->ptr, m) == 0) return candidate;
+      i = candidate + 1;
+    }
+    int result = SearchScalar(s + i, n - i);
+    return result == -1 ? -1 : i + result;
+  }
+#endif
+
+  // Boyer-moore-horspool search of the first 'n' bytes of 's'. The pattern must be at
+  // least 2 bytes.
+  int SearchScalar(const char* s, int n) const {
+    int m = pattern_->len;
+    int mlast = m - 1;
+    int w = n - m;
+    const char* p = pattern_->ptr;
+
     int j;
     // TODO: the original code seems to have an off by one error. It is possible
     // to index at w + m which is the length of the input string. Checks have
@@ -156,7 +211,6 @@ class StringSearch {
     return -1;
   }
 
- private:
   static const int BLOOM_WIDTH = 64;
 
   void BloomAdd(char c) {
@@ -170,6 +224,10 @@ class StringSearch {
   const StringValue* pattern_;
   int64_t mask_;
   int64_t skip_;
+
+  // Zero padded first prefix_len_ bytes of the pattern.
+  char prefix_[SSEUtil::CHARS_PER_128_BIT_REGISTER];
+  int prefix_len_;
 };
 
 }
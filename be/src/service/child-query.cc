@@ -115,11 +115,12 @@ void ChildQuery::SetQueryOptions(const TQueryOptions& parent_options,
     TExecuteStatementReq* exec_stmt_req) {
   // If this DCHECK is hit then handle the missing query option below.
   DCHECK_EQ(_TImpalaQueryOptions_VALUES_TO_NAMES.size(),
-      TImpalaQueryOptions::DISABLE_CACHED_READS + 1);
+      TImpalaQueryOptions::PARQUET_REENCODE_PAGES + 1);
   SET_QUERY_OPTION(abort_on_default_limit_exceeded, ABORT_ON_DEFAULT_LIMIT_EXCEEDED);
   SET_QUERY_OPTION(abort_on_error, ABORT_ON_ERROR);
   SET_QUERY_OPTION(allow_unsupported_formats, ALLOW_UNSUPPORTED_FORMATS);
   SET_QUERY_OPTION(batch_size, BATCH_SIZE);
+  SET_QUERY_OPTION(compression_codec, COMPRESSION_CODEC);
   // Ignore debug actions on child queries because they may cause deadlock.
   SET_QUERY_OPTION(default_order_by_limit, DEFAULT_ORDER_BY_LIMIT);
   SET_QUERY_OPTION(disable_cached_reads, DISABLE_CACHED_READS);
@@ -135,6 +136,7 @@ void ChildQuery::SetQueryOptions(const TQueryOptions& parent_options,
   SET_QUERY_OPTION(num_scanner_threads, NUM_SCANNER_THREADS);
   SET_QUERY_OPTION(parquet_compression_codec, PARQUET_COMPRESSION_CODEC);
   SET_QUERY_OPTION(parquet_file_size, PARQUET_FILE_SIZE);
+  SET_QUERY_OPTION(parquet_reencode_pages, PARQUET_REENCODE_PAGES);
   SET_QUERY_OPTION(request_pool, REQUEST_POOL);
   SET_QUERY_OPTION(reservation_request_timeout, RESERVATION_REQUEST_TIMEOUT);
   SET_QUERY_OPTION(sync_ddl, SYNC_DDL);
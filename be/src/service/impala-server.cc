@@ -465,6 +465,23 @@ void ImpalaServer::AuditEventLoggerFlushThread() {
   }
 }
 
+int64_t ImpalaServer::ReleaseResultCaches(int64_t bytes_to_free) {
+  vector<shared_ptr<QueryExecState> > exec_states;
+  {
+    // This may be called by a thread that holds query_exec_state_map_lock_.
+    unique_lock<mutex> l(query_exec_state_map_lock_, try_to_lock);
+    if (!l.owns_lock()) return 0;
+    BOOST_FOREACH(const QueryExecStateMap::value_type& v, query_exec_state_map_) {
+      exec_states.push_back(v.second);
+    }
+  }
+  int64_t bytes_freed = 0;
+  for (int i = 0; i < exec_states.size() && bytes_freed < bytes_to_free; ++i) {
+    bytes_freed += exec_states[i]->TryReleaseResultCache();
+  }
+  return bytes_freed;
+}
+
 void ImpalaServer::ArchiveQuery(const QueryExecState& query) {
   const string& encoded_profile_str = query.profile().SerializeToArchiveString();
 
@@ -954,6 +971,27 @@ Status ImpalaServer::SetQueryOptions(const string& key, const string& value,
         query_options->__set_disable_cached_reads(
             iequals(value, "true") || iequals(value, "1"));
         break;
+      case TImpalaQueryOptions::COMPRESSION_CODEC: {
+        if (value.empty()) break;
+        if (iequals(value, "none")) {
+          query_options->__set_compression_codec(THdfsCompression::NONE);
+        } else if (iequals(value, "gzip")) {
+          query_options->__set_compression_codec(THdfsCompression::GZIP);
+        } else if (iequals(value, "bzip2")) {
+          query_options->__set_compression_codec(THdfsCompression::BZIP2);
+        } else if (iequals(value, "snappy")) {
+          query_options->__set_compression_codec(THdfsCompression::SNAPPY);
+        } else {
+          stringstream ss;
+          ss << "Invalid compression codec: " << value;
+          return Status(ss.str());
+        }
+        break;
+      }
+      case TImpalaQueryOptions::PARQUET_REENCODE_PAGES:
+        query_options->__set_parquet_reencode_pages(
+            iequals(value, "true") || iequals(value, "1"));
+        break;
       default:
         // We hit this DCHECK(false) if we forgot to add the corresponding entry here
         // when we add a new query option.
@@ -1227,6 +1265,12 @@ void ImpalaServer::TQueryOptionsToMap(const TQueryOptions& query_option,
       case TImpalaQueryOptions::DISABLE_CACHED_READS:
         val << query_option.disable_cached_reads;
         break;
+      case TImpalaQueryOptions::COMPRESSION_CODEC:
+        val << query_option.compression_codec;
+        break;
+      case TImpalaQueryOptions::PARQUET_REENCODE_PAGES:
+        val << query_option.parquet_reencode_pages;
+        break;
       default:
         // We hit this DCHECK(false) if we forgot to add the corresponding entry here
         // when we add a new query option.
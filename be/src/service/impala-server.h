@@ -243,6 +243,11 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
   void CatalogUpdateCallback(const StatestoreSubscriber::TopicDeltaMap& topic_deltas,
       std::vector<TTopicDelta>* topic_updates);
 
+  // Drops the result caches of registered queries until at least 'bytes_to_free' bytes
+  // are freed. Queries that are busy, e.g. fetching rows, are skipped. Returns the
+  // number of bytes freed. Registered as a GcFunction of the process mem tracker.
+  int64_t ReleaseResultCaches(int64_t bytes_to_free);
+
   // Returns true if Impala is offline (and not accepting queries), false otherwise.
   bool IsOffline() {
     boost::lock_guard<boost::mutex> l(is_offline_lock_);
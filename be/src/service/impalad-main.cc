@@ -18,6 +18,7 @@
 
 #include <unistd.h>
 #include <jni.h>
+#include <boost/bind.hpp>
 
 #include "common/logging.h"
 #include "common/init.h"
@@ -28,6 +29,7 @@
 #include "common/status.h"
 #include "runtime/coordinator.h"
 #include "runtime/exec-env.h"
+#include "runtime/mem-tracker.h"
 #include "util/jni-util.h"
 #include "util/network-util.h"
 #include "rpc/thrift-util.h"
@@ -80,6 +82,12 @@ int main(int argc, char** argv) {
     exit(1);
   }
 
+  // The process mem tracker is created by StartServices(). If the process limit is
+  // hit, the result caches of running queries are dropped before failing queries.
+  exec_env.process_mem_tracker()->AddGcFunction("query-result-caches",
+      MemTracker::GC_PRIORITY_QUERY_STATE,
+      boost::bind<int64_t>(&ImpalaServer::ReleaseResultCaches, server, _1));
+
   // this blocks until the beeswax and hs2 servers terminate
   EXIT_IF_ERROR(beeswax_server->Start());
   EXIT_IF_ERROR(hs2_server->Start());
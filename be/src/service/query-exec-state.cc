@@ -59,6 +59,7 @@ ImpalaServer::QueryExecState::QueryExecState(
     schedule_(NULL),
     coord_(NULL),
     result_cache_max_size_(-1),
+    result_cache_released_(false),
     profile_(&profile_pool_, "Query"),  // assign name w/ id after planning
     server_profile_(&profile_pool_, "ImpalaServer"),
     summary_profile_(&profile_pool_, "Summary"),
@@ -490,11 +491,16 @@ Status ImpalaServer::QueryExecState::RestartFetch() {
     return Status(TStatusCode::RECOVERABLE_ERROR,
         "Restarting of fetch requires enabling of query result caching.");
   }
-  // The cache overflowed on a previous fetch.
+  // The cache overflowed on a previous fetch or was dropped to free memory.
   if (result_cache_.get() == NULL) {
     stringstream ss;
-    ss << "The query result cache exceeded its limit of " << result_cache_max_size_
-       << " rows. Restarting the fetch is not possible.";
+    if (result_cache_released_) {
+      ss << "The query result cache was released because the process memory limit was "
+         << "reached. Restarting the fetch is not possible.";
+    } else {
+      ss << "The query result cache exceeded its limit of " << result_cache_max_size_
+         << " rows. Restarting the fetch is not possible.";
+    }
     return Status(TStatusCode::RECOVERABLE_ERROR, ss.str());
   }
   // Reset fetch state to start over.
@@ -861,6 +867,19 @@ Status ImpalaServer::QueryExecState::WaitForChildQueries() {
   return Status::OK;
 }
 
+int64_t ImpalaServer::QueryExecState::TryReleaseResultCache() {
+  unique_lock<mutex> fetch_rows_lock(fetch_rows_lock_, try_to_lock);
+  if (!fetch_rows_lock.owns_lock()) return 0;
+  unique_lock<mutex> l(lock_, try_to_lock);
+  if (!l.owns_lock() || result_cache_ == NULL) return 0;
+  int64_t bytes_freed = result_cache_->BytesSize();
+  ClearResultCache();
+  result_cache_released_ = true;
+  VLOG_QUERY << "Released result cache of query " << PrintId(query_id_) << ": "
+             << PrettyPrinter::Print(bytes_freed, TCounterType::BYTES);
+  return bytes_freed;
+}
+
 void ImpalaServer::QueryExecState::ClearResultCache() {
   if (result_cache_ == NULL) return;
   // Update result set cache metrics and mem limit accounting.
@@ -120,6 +120,12 @@ class ImpalaServer::QueryExecState {
   // Returns a non-ok status if max_size exceeds the per-impalad allowed maximum.
   Status SetResultCache(QueryResultSet* cache, int64_t max_size);
 
+  // Drops the result cache to free memory if no other thread is using this query.
+  // Afterwards, clients cannot restart fetching. Returns the number of bytes freed.
+  // Called when the process memory limit is hit, possibly by a thread that holds this
+  // query's locks, so it only try-locks fetch_rows_lock_ and lock_.
+  int64_t TryReleaseResultCache();
+
   ImpalaServer::SessionState* session() const { return session_.get(); }
   const std::string& connected_user() const { return query_ctxt_.session.connected_user; }
   const std::string& do_as_user() const { return session_->do_as_user; }
@@ -215,6 +221,10 @@ class ImpalaServer::QueryExecState {
   // Max size of the result_cache_ in number of rows. A value <= 0 means no caching.
   int64_t result_cache_max_size_;
 
+  // True if result_cache_ was dropped by TryReleaseResultCache() rather than because
+  // its bound was exceeded.
+  bool result_cache_released_;
+
   // local runtime_state_ in case we don't have a coord_
   boost::scoped_ptr<RuntimeState> local_runtime_state_;
   ObjectPool profile_pool_;
@@ -31,6 +31,10 @@ TupleDescBuilder& DescriptorTblBuilder::DeclareTuple() {
   return *tuple_builder;
 }
 
+void DescriptorTblBuilder::AddTableDescriptor(const TTableDescriptor& table_desc) {
+  table_descs_.push_back(table_desc);
+}
+
 static TSlotDescriptor MakeSlotDescriptor(int id, int parent_id, const ColumnType& type,
     int slot_idx, int byte_offset) {
   int null_byte = slot_idx / 8;
@@ -83,6 +87,7 @@ DescriptorTbl* DescriptorTblBuilder::Build() {
         MakeTupleDescriptor(tuple_id, byte_offset, num_null_bytes));
   }
 
+  thrift_desc_tbl.__set_tableDescriptors(table_descs_);
   Status status = DescriptorTbl::Create(obj_pool_, thrift_desc_tbl, &desc_tbl);
   DCHECK(status.ok());
   return desc_tbl;
@@ -38,6 +38,10 @@ class DescriptorTblBuilder {
   DescriptorTblBuilder(ObjectPool* object_pool);
 
   TupleDescBuilder& DeclareTuple();
+
+  // Adds 'table_desc' to the descriptor table, e.g. for the target table of a sink.
+  void AddTableDescriptor(const TTableDescriptor& table_desc);
+
   DescriptorTbl* Build();
 
  private:
@@ -45,6 +49,7 @@ class DescriptorTblBuilder {
   ObjectPool* obj_pool_;
 
   std::vector<TupleDescBuilder*> tuples_descs_;
+  std::vector<TTableDescriptor> table_descs_;
 };
 
 class TupleDescBuilder {
@@ -83,6 +83,7 @@ class FunctionContextImpl {
 
   bool debug() { return debug_; }
   bool closed() { return closed_; }
+  FreePool* pool() { return pool_; }
 
  private:
   friend class impala_udf::FunctionContext;
@@ -0,0 +1,127 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "runtime/mem-tracker.h"
+#include "util/block-compressor.h"
+#include "util/codec.h"
+#include "util/thread.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+// Returns 'num_blocks' blocks of text, with different contents and lengths.
+vector<string> MakeBlocks(int num_blocks, int seed) {
+  vector<string> blocks(num_blocks);
+  for (int i = 0; i < num_blocks; ++i) {
+    int num_lines = 100 * (seed + i) + 1;
+    for (int j = 0; j < num_lines; ++j) {
+      stringstream line;
+      line << j << "," << seed << ",value" << (j % 7) << "\n";
+      blocks[i] += line.str();
+    }
+  }
+  return blocks;
+}
+
+// Decompresses 'compressed' and checks that it matches 'expected'.
+void CheckBlocks(THdfsCompression::type codec, const vector<string>& expected,
+    const vector<StringValue>& compressed) {
+  MemTracker tracker;
+  MemPool pool(&tracker);
+  scoped_ptr<Codec> decompressor;
+  EXPECT_TRUE(Codec::CreateDecompressor(&pool, false, codec, &decompressor).ok());
+  ASSERT_EQ(expected.size(), compressed.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    uint8_t* output;
+    int output_len;
+    EXPECT_TRUE(decompressor->ProcessBlock(false, compressed[i].len,
+        reinterpret_cast<uint8_t*>(compressed[i].ptr), &output_len, &output).ok());
+    EXPECT_EQ(expected[i], string(reinterpret_cast<char*>(output), output_len));
+  }
+  decompressor->Close();
+  pool.FreeAll();
+}
+
+void TestCompressor(THdfsCompression::type codec) {
+  MemTracker tracker;
+  BlockCompressor compressor(codec, &tracker, NULL);
+  EXPECT_TRUE(compressor.Init().ok());
+
+  // Hand in the next set before collecting the previous one, like the table writers.
+  vector<string> expected = MakeBlocks(3, 0);
+  vector<string> blocks = expected;
+  compressor.Compress(&blocks);
+  EXPECT_TRUE(compressor.has_pending_blocks());
+  for (int set = 1; set < 5; ++set) {
+    vector<string> next_expected = MakeBlocks(3, set);
+    vector<StringValue> compressed;
+    EXPECT_TRUE(compressor.GetCompressedBlocks(&compressed).ok());
+    EXPECT_FALSE(compressor.has_pending_blocks());
+    CheckBlocks(codec, expected, compressed);
+    // The previous buffers are handed back empty.
+    blocks = next_expected;
+    compressor.Compress(&blocks);
+    for (int i = 0; i < blocks.size(); ++i) EXPECT_TRUE(blocks[i].empty());
+    expected = next_expected;
+  }
+  vector<StringValue> compressed;
+  EXPECT_TRUE(compressor.GetCompressedBlocks(&compressed).ok());
+  CheckBlocks(codec, expected, compressed);
+  compressor.Close();
+  EXPECT_EQ(0, tracker.consumption());
+}
+
+TEST(BlockCompressorTest, Gzip) {
+  TestCompressor(THdfsCompression::GZIP);
+}
+
+TEST(BlockCompressorTest, Bzip) {
+  TestCompressor(THdfsCompression::BZIP2);
+}
+
+TEST(BlockCompressorTest, Snappy) {
+  TestCompressor(THdfsCompression::SNAPPY);
+}
+
+TEST(BlockCompressorTest, SnappyBlocked) {
+  TestCompressor(THdfsCompression::SNAPPY_BLOCKED);
+}
+
+// Closing with blocks that were never collected must not hang.
+TEST(BlockCompressorTest, CloseWithPendingBlocks) {
+  MemTracker tracker;
+  BlockCompressor compressor(THdfsCompression::GZIP, &tracker, NULL);
+  EXPECT_TRUE(compressor.Init().ok());
+  vector<string> blocks = MakeBlocks(2, 1);
+  compressor.Compress(&blocks);
+  compressor.Close();
+  EXPECT_FALSE(compressor.has_pending_blocks());
+}
+
+}
+
+int main(int argc, char** argv) {
+  impala::InitGoogleLoggingSafe(argv[0]);
+  impala::InitThreading();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,152 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/block-compressor.h"
+
+#include "common/logging.h"
+#include "runtime/mem-tracker.h"
+#include "util/codec.h"
+#include "util/stopwatch.h"
+#include "util/thread.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+BlockCompressor::BlockCompressor(THdfsCompression::type codec, MemTracker* mem_tracker,
+    RuntimeProfile* profile)
+  : codec_(codec),
+    mem_tracker_(mem_tracker),
+    compress_timer_(NULL),
+    compress_wait_timer_(NULL),
+    pending_(false),
+    has_input_(false),
+    shutdown_(false),
+    output_pool_idx_(0) {
+  DCHECK_NE(codec, THdfsCompression::NONE);
+  if (profile != NULL) {
+    compress_timer_ = ADD_TIMER(profile, "CompressTimer");
+    compress_wait_timer_ = ADD_TIMER(profile, "CompressWaitTimer");
+  }
+}
+
+BlockCompressor::~BlockCompressor() {
+  Close();
+}
+
+Status BlockCompressor::Init() {
+  DCHECK(compression_thread_.get() == NULL);
+  for (int i = 0; i < 2; ++i) {
+    output_pools_[i].reset(new MemPool(mem_tracker_));
+    // The codecs don't reuse their output buffer, since all blocks of a set must stay
+    // valid until the caller is done with them.
+    RETURN_IF_ERROR(Codec::CreateCompressor(
+        output_pools_[i].get(), false, codec_, &compressors_[i]));
+  }
+  compression_thread_.reset(new Thread("block-compressor", "compression",
+      &BlockCompressor::CompressionLoop, this));
+  return Status::OK;
+}
+
+void BlockCompressor::Compress(vector<string>* blocks) {
+  DCHECK(compression_thread_.get() != NULL);
+  DCHECK(!pending_);
+  {
+    lock_guard<mutex> l(lock_);
+    DCHECK(!has_input_);
+    // Swap the buffers of the previous set back to the caller.
+    input_blocks_.swap(*blocks);
+    for (int i = 0; i < blocks->size(); ++i) (*blocks)[i].clear();
+    has_input_ = true;
+  }
+  pending_ = true;
+  input_cv_.notify_one();
+}
+
+Status BlockCompressor::GetCompressedBlocks(vector<StringValue>* compressed) {
+  DCHECK(pending_);
+  pending_ = false;
+  SCOPED_TIMER(compress_wait_timer_);
+  unique_lock<mutex> l(lock_);
+  while (has_input_) output_cv_.wait(l);
+  RETURN_IF_ERROR(output_status_);
+  *compressed = output_blocks_;
+  return Status::OK;
+}
+
+void BlockCompressor::Close() {
+  if (compression_thread_.get() != NULL) {
+    {
+      lock_guard<mutex> l(lock_);
+      shutdown_ = true;
+    }
+    input_cv_.notify_one();
+    compression_thread_->Join();
+    compression_thread_.reset();
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (compressors_[i].get() != NULL) {
+      compressors_[i]->Close();
+      compressors_[i].reset();
+    }
+    if (output_pools_[i].get() != NULL) {
+      output_pools_[i]->FreeAll();
+      output_pools_[i].reset();
+    }
+  }
+  pending_ = false;
+}
+
+void BlockCompressor::CompressionLoop() {
+  while (true) {
+    {
+      unique_lock<mutex> l(lock_);
+      while (!has_input_ && !shutdown_) input_cv_.wait(l);
+      // Blocks that were handed in but not collected are dropped on shutdown.
+      if (shutdown_) return;
+    }
+
+    // The caller doesn't touch the blocks or the output until 'has_input_' is reset,
+    // so they are accessed without holding the lock.
+    MonotonicStopWatch timer;
+    timer.Start();
+    // The pool of the set before the caller's current one is no longer used.
+    Codec* compressor = compressors_[output_pool_idx_].get();
+    output_pools_[output_pool_idx_]->Clear();
+    output_pool_idx_ = 1 - output_pool_idx_;
+    output_blocks_.resize(input_blocks_.size());
+    Status status;
+    for (int i = 0; i < input_blocks_.size() && status.ok(); ++i) {
+      string& block = input_blocks_[i];
+      uint8_t* output = NULL;
+      int output_len = 0;
+      status = compressor->ProcessBlock(false, block.size(),
+          reinterpret_cast<uint8_t*>(const_cast<char*>(block.data())), &output_len,
+          &output);
+      output_blocks_[i] = StringValue(reinterpret_cast<char*>(output), output_len);
+    }
+    timer.Stop();
+    if (compress_timer_ != NULL) COUNTER_UPDATE(compress_timer_, timer.ElapsedTime());
+
+    {
+      lock_guard<mutex> l(lock_);
+      output_status_ = status;
+      has_input_ = false;
+    }
+    output_cv_.notify_one();
+  }
+}
+
+}
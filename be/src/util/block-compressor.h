@@ -0,0 +1,136 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_BLOCK_COMPRESSOR_H
+#define IMPALA_UTIL_BLOCK_COMPRESSOR_H
+
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/status.h"
+#include "runtime/mem-pool.h"
+#include "runtime/string-value.h"
+#include "util/runtime-profile.h"
+#include "gen-cpp/Descriptors_types.h"
+
+namespace impala {
+
+class Codec;
+class MemTracker;
+class Thread;
+
+// Compresses blocks of data on a separate thread, so that the caller can produce the
+// next block while the previous one is compressed. Used by the table writers to write
+// compressed files without stalling the fragment thread on compression.
+// At most one set of blocks is compressed at a time. The usage is:
+//   Compress(blocks 1)
+//   (produce blocks 2)
+//   GetCompressedBlocks() -> compressed blocks 1
+//   Compress(blocks 2)
+//   (write compressed blocks 1, produce blocks 3)
+//   GetCompressedBlocks() -> compressed blocks 2
+//   ...
+// Each block of a set is compressed separately, e.g. the key and value buffers of a
+// sequence file block.
+// This class is not thread safe: all calls must be made from the same thread.
+class BlockCompressor {
+ public:
+  // 'codec' is the compression codec to use, which must not be NONE. Memory for the
+  // compressed blocks is counted against 'mem_tracker'. If 'profile' is not NULL, the
+  // time spent compressing and the time the caller waited for compressed blocks are
+  // added to its CompressTimer and CompressWaitTimer.
+  BlockCompressor(THdfsCompression::type codec, MemTracker* mem_tracker,
+      RuntimeProfile* profile);
+
+  // Stops the compression thread, if Close() wasn't called.
+  ~BlockCompressor();
+
+  // Creates the codec and starts the compression thread.
+  Status Init();
+
+  // Hands 'blocks' to the compression thread. The contents of 'blocks' are swapped
+  // with the buffers of the previous set of blocks, which are cleared, so the caller
+  // can reuse their capacity. GetCompressedBlocks() must have been called for the
+  // previous set.
+  void Compress(std::vector<std::string>* blocks);
+
+  // Waits until the blocks passed to the last Compress() call are compressed. Sets
+  // 'compressed' to the compressed blocks, in the same order. The compressed data is
+  // owned by this object and valid until the next call to GetCompressedBlocks(), so
+  // it can be written out while the next set is compressed.
+  // Returns an error if any of the blocks could not be compressed.
+  Status GetCompressedBlocks(std::vector<StringValue>* compressed);
+
+  // Returns true if blocks were passed to Compress() for which GetCompressedBlocks()
+  // hasn't been called.
+  bool has_pending_blocks() const { return pending_; }
+
+  // Stops the compression thread and frees the compressed blocks.
+  void Close();
+
+  THdfsCompression::type codec() const { return codec_; }
+
+ private:
+  // Main loop of compression_thread_: waits for blocks and compresses them.
+  void CompressionLoop();
+
+  const THdfsCompression::type codec_;
+  MemTracker* mem_tracker_;
+  RuntimeProfile::Counter* compress_timer_;
+  RuntimeProfile::Counter* compress_wait_timer_;
+
+  // Set if Compress() was called without a matching GetCompressedBlocks().
+  bool pending_;
+
+  // Protects the state below, which is shared with compression_thread_.
+  boost::mutex lock_;
+
+  // Signalled when there are blocks to compress or the thread should stop.
+  boost::condition_variable input_cv_;
+
+  // Signalled when the blocks are compressed.
+  boost::condition_variable output_cv_;
+
+  // True if 'input_blocks_' need to be compressed. Only compression_thread_ accesses
+  // the blocks and the output while it is true.
+  bool has_input_;
+  bool shutdown_;
+
+  std::vector<std::string> input_blocks_;
+
+  // Compressed blocks and the status of compressing them.
+  std::vector<StringValue> output_blocks_;
+  Status output_status_;
+
+  // Pools for the compressed blocks, created in Init(). Consecutive sets are compressed
+  // into alternating pools, so the caller's set stays valid while the next set is
+  // compressed. Only used by compression_thread_, except in Close().
+  boost::scoped_ptr<MemPool> output_pools_[2];
+
+  // Index of the pool for the next set.
+  int output_pool_idx_;
+
+  // Codecs that allocate from each of 'output_pools_'.
+  boost::scoped_ptr<Codec> compressors_[2];
+
+  boost::scoped_ptr<Thread> compression_thread_;
+};
+
+}
+
+#endif
@@ -118,8 +118,7 @@ int BzipCompressor::MaxOutputLen(int input_len, const uint8_t* input) {
 Status BzipCompressor::ProcessBlock(bool output_preallocated,
                                     int input_length, uint8_t* input,
                                     int *output_length, uint8_t** output) {
-  // The bz2 library does not allow input to be NULL, even when input_length is 0. This
-  // should be OK because we do not write any file formats that support bzip compression.
+  // The bz2 library does not allow input to be NULL, even when input_length is 0.
   DCHECK(input != NULL);
 
   // If length is set then the output has been allocated.
@@ -164,7 +163,6 @@ Status BzipCompressor::ProcessBlock(bool output_preallocated,
   return Status::OK;
 }
 
-// Currently this is only use for testing of the decompressor.
 SnappyBlockCompressor::SnappyBlockCompressor(MemPool* mem_pool, bool reuse_buffer)
   : Codec(mem_pool, reuse_buffer) {
 }
@@ -180,10 +178,14 @@ Status SnappyBlockCompressor::ProcessBlock(bool output_preallocated,
   // Hadoop uses a block compression scheme on top of snappy.  First there is
   // an integer which is the size of the decompressed data followed by a
   // sequence of compressed blocks each preceded with an integer size.
-  // For testing purposes we are going to generate two blocks.
-  int block_size = input_length / 2;
-  size_t length = snappy::MaxCompressedLength(block_size) * 2;
-  length += 3 * sizeof (int32_t);
+  // Hadoop decompresses each block into a fixed size buffer (256KB by default), so
+  // the blocks must not be larger than that. Smaller inputs are split into two
+  // blocks, which also exercises readers that expect more than one.
+  int block_size = min((input_length + 1) / 2, MAX_SNAPPY_BLOCK_SIZE);
+  int num_blocks = block_size == 0 ? 0 : (input_length + block_size - 1) / block_size;
+  size_t length =
+      (snappy::MaxCompressedLength(block_size) + sizeof(int32_t)) * num_blocks;
+  length += sizeof(int32_t);
   DCHECK(!output_preallocated || length <= *output_length);
 
   if (output_preallocated) {
@@ -204,12 +206,13 @@ Status SnappyBlockCompressor::ProcessBlock(bool output_preallocated,
     sizep = outp;
     outp += sizeof (int32_t);
     size_t size;
+    int len = min(block_size, input_length);
     snappy::RawCompress(reinterpret_cast<const char*>(input),
-        static_cast<size_t>(block_size), reinterpret_cast<char*>(outp), &size);
+        static_cast<size_t>(len), reinterpret_cast<char*>(outp), &size);
 
     ReadWriteUtil::PutInt(sizep, static_cast<uint32_t>(size));
-    input += block_size;
-    input_length -= block_size;
+    input += len;
+    input_length -= len;
     outp += size;
   }
 
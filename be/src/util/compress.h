@@ -92,6 +92,9 @@ class SnappyBlockCompressor : public Codec {
   friend class Codec;
   SnappyBlockCompressor(MemPool* mem_pool, bool reuse_buffer);
   virtual Status Init() { return Status::OK; }
+
+  // Largest block of input that is compressed separately.
+  static const int MAX_SNAPPY_BLOCK_SIZE = 64 * 1024;
 };
 
 class SnappyCompressor : public Codec {
@@ -19,6 +19,9 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -39,6 +42,8 @@ int64_t CpuInfo::original_hardware_flags_;
 long CpuInfo::cache_sizes_[L3_CACHE + 1];
 int64_t CpuInfo::cycles_per_ms_;
 int CpuInfo::num_cores_ = 1;
+int CpuInfo::num_numa_nodes_ = 1;
+vector<int> CpuInfo::core_to_numa_node_;
 string CpuInfo::model_name_ = "unknown";
 
 static struct {
@@ -126,9 +131,50 @@ void CpuInfo::Init() {
   
   if (FLAGS_num_cores > 0) num_cores_ = FLAGS_num_cores;
 
+  InitNuma();
+
   initialized_ = true;
 }
 
+// Each NUMA node has a directory /sys/devices/system/node/node<N> which contains
+// a cpu<M> entry for each core on that node.
+void CpuInfo::InitNuma() {
+  const string node_path = "/sys/devices/system/node";
+  num_numa_nodes_ = 1;
+  core_to_numa_node_.clear();
+
+  DIR* node_dir = opendir(node_path.c_str());
+  if (node_dir == NULL) return;
+  int max_node = -1;
+  struct dirent* node_entry;
+  while ((node_entry = readdir(node_dir)) != NULL) {
+    int node;
+    if (sscanf(node_entry->d_name, "node%d", &node) != 1) continue;
+    max_node = max(max_node, node);
+    string cpus_path = node_path + "/" + node_entry->d_name;
+    DIR* cpu_dir = opendir(cpus_path.c_str());
+    if (cpu_dir == NULL) continue;
+    struct dirent* cpu_entry;
+    while ((cpu_entry = readdir(cpu_dir)) != NULL) {
+      int core;
+      if (sscanf(cpu_entry->d_name, "cpu%d", &core) != 1) continue;
+      if (core >= core_to_numa_node_.size()) core_to_numa_node_.resize(core + 1, 0);
+      core_to_numa_node_[core] = node;
+    }
+    closedir(cpu_dir);
+  }
+  closedir(node_dir);
+  if (max_node >= 0) num_numa_nodes_ = max_node + 1;
+}
+
+int CpuInfo::GetCurrentNumaNode() {
+  DCHECK(initialized_);
+  if (num_numa_nodes_ == 1) return 0;
+  int core = sched_getcpu();
+  if (core < 0 || core >= core_to_numa_node_.size()) return 0;
+  return core_to_numa_node_[core];
+}
+
 void CpuInfo::EnableFeature(long flag, bool enable) {
   DCHECK(initialized_);
   if (!enable) {
@@ -149,6 +195,7 @@ string CpuInfo::DebugString() {
   stream << "Cpu Info:" << endl
          << "  Model: " << model_name_ << endl
          << "  Cores: " << num_cores_ << endl
+         << "  NUMA Nodes: " << num_numa_nodes_ << endl
          << "  L1 Cache: " << PrettyPrinter::Print(L1, TCounterType::BYTES) << endl
          << "  L2 Cache: " << PrettyPrinter::Print(L2, TCounterType::BYTES) << endl
          << "  L3 Cache: " << PrettyPrinter::Print(L3, TCounterType::BYTES) << endl
@@ -17,6 +17,7 @@
 #define IMPALA_UTIL_CPU_INFO_H
 
 #include <string>
+#include <vector>
 #include <boost/cstdint.hpp>
 
 #include "common/logging.h"
@@ -78,6 +79,17 @@ class CpuInfo {
     return num_cores_; 
   }
 
+  // Returns the number of NUMA nodes on this machine. This is 1 if the machine is not
+  // NUMA or the topology could not be determined.
+  static int num_numa_nodes() {
+    DCHECK(initialized_);
+    return num_numa_nodes_;
+  }
+
+  // Returns the NUMA node of the core the calling thread is currently running on. The
+  // thread can be migrated at any time so this is only a hint.
+  static int GetCurrentNumaNode();
+
   // Returns the model name of the cpu (e.g. Intel i7-2600)
   static std::string model_name() { 
     DCHECK(initialized_);
@@ -93,7 +105,13 @@ class CpuInfo {
   static long cache_sizes_[L3_CACHE + 1];
   static int64_t cycles_per_ms_;
   static int num_cores_;
+  static int num_numa_nodes_;
+  // Maps a core id to its NUMA node, read from /sys/devices/system/node.
+  static std::vector<int> core_to_numa_node_;
   static std::string model_name_;
+
+  // Populates num_numa_nodes_ and core_to_numa_node_.
+  static void InitNuma();
 };
 
 }
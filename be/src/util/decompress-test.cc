@@ -55,6 +55,9 @@ class DecompressorTest : public ::testing::Test {
         Codec::CreateDecompressor(&mem_pool_, true, format, &decompressor).ok());
 
     CompressAndDecompress(compressor.get(), decompressor.get(), sizeof(input_), input_);
+    // Odd length, e.g. for codecs that split the input into several blocks.
+    CompressAndDecompress(compressor.get(), decompressor.get(), sizeof(input_) - 1,
+        input_);
     if (format != THdfsCompression::BZIP2) {
       CompressAndDecompress(compressor.get(), decompressor.get(), 0, NULL);
     } else {
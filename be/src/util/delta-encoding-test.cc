@@ -0,0 +1,142 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <limits>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common/init.h"
+#include "util/delta-encoding.h"
+
+using namespace std;
+
+namespace impala {
+
+// Encodes 'values' as values of 'value_bits' bits, checks that they decode to the same
+// values and returns the encoded size.
+int ValidateRoundTrip(const vector<int64_t>& values, int value_bits = 64) {
+  int buffer_len = 64 + values.size() * 10;
+  vector<uint8_t> buffer(buffer_len);
+  int len = DeltaEncoder::Encode(values.empty() ? NULL : &values[0], values.size(),
+      value_bits, &buffer[0], buffer_len);
+  EXPECT_GT(len, 0);
+
+  DeltaDecoder decoder(&buffer[0], len);
+  EXPECT_TRUE(decoder.Init());
+  for (int i = 0; i < values.size(); ++i) {
+    int64_t v;
+    EXPECT_TRUE(decoder.Get(&v)) << i;
+    // 32-bit values are only correct in the low 32 bits.
+    if (value_bits == 32) v = static_cast<int32_t>(v);
+    EXPECT_EQ(values[i], v) << i;
+  }
+  // Make sure we get false when reading past the end a couple times.
+  int64_t v;
+  EXPECT_FALSE(decoder.Get(&v));
+  EXPECT_FALSE(decoder.Get(&v));
+  return len;
+}
+
+TEST(DeltaEncoding, Empty) {
+  vector<int64_t> values;
+  ValidateRoundTrip(values);
+}
+
+TEST(DeltaEncoding, Sorted) {
+  // Sorted values with small gaps need a few bits per value. Also covers partial
+  // blocks and miniblocks.
+  int sizes[] = { 1, 2, 31, 32, 33, 128, 129, 1000, 10000 };
+  for (int i = 0; i < sizeof(sizes) / sizeof(int); ++i) {
+    vector<int64_t> values;
+    int64_t v = 1000000000000L;
+    for (int j = 0; j < sizes[i]; ++j) {
+      values.push_back(v);
+      v += rand() % 16;
+    }
+    int len = ValidateRoundTrip(values);
+    if (sizes[i] >= 1000) EXPECT_LT(len, sizes[i]);
+  }
+}
+
+TEST(DeltaEncoding, Constant) {
+  vector<int64_t> values(1000, -5);
+  // Only the headers are stored.
+  EXPECT_LT(ValidateRoundTrip(values), 64);
+}
+
+TEST(DeltaEncoding, Random) {
+  vector<int64_t> values;
+  for (int i = 0; i < 1000; ++i) values.push_back(rand() - RAND_MAX / 2);
+  ValidateRoundTrip(values);
+}
+
+TEST(DeltaEncoding, Extremes) {
+  // Deltas that overflow int64_t and need all 64 bits.
+  vector<int64_t> values;
+  for (int i = 0; i < 300; ++i) {
+    values.push_back(i % 2 == 0 ?
+        numeric_limits<int64_t>::min() : numeric_limits<int64_t>::max());
+    if (i % 7 == 0) values.push_back(0);
+  }
+  ValidateRoundTrip(values);
+}
+
+TEST(DeltaEncoding, Int32) {
+  // INT32 deltas wrap around at 32 bits: the deltas between these values are 1 and -1,
+  // not +/-(2^32 - 1), and need no more than 32 bits.
+  vector<int64_t> values;
+  for (int i = 0; i < 300; ++i) {
+    values.push_back(i % 2 == 0 ?
+        numeric_limits<int32_t>::min() : numeric_limits<int32_t>::max());
+  }
+  int len = ValidateRoundTrip(values, 32);
+  EXPECT_LT(len, 100);
+  EXPECT_LT(len, ValidateRoundTrip(values, 64));
+
+  values.clear();
+  for (int i = 0; i < 1000; ++i) {
+    values.push_back(static_cast<int32_t>((static_cast<uint32_t>(rand()) << 1) ^ rand()));
+  }
+  ValidateRoundTrip(values, 32);
+  // The deltas of random values take up to 32 bits, but not more. The 999 deltas are
+  // padded to 8 blocks of 128, plus up to 9 bytes per block header and 10 bytes for
+  // the page header.
+  vector<uint8_t> buffer(1024 * 4 + 8 * 9 + 10);
+  EXPECT_GT(DeltaEncoder::Encode(&values[0], values.size(), 32, &buffer[0],
+      buffer.size()), 0);
+}
+
+TEST(DeltaEncoding, BufferTooSmall) {
+  vector<int64_t> values;
+  for (int i = 0; i < 1000; ++i) values.push_back(rand());
+  uint8_t buffer[100];
+  EXPECT_EQ(DeltaEncoder::Encode(&values[0], values.size(), 64, buffer, sizeof(buffer)),
+      -1);
+}
+
+TEST(DeltaEncoding, InvalidHeader) {
+  // Block size of 0.
+  uint8_t buffer[] = { 0, 4, 1, 0 };
+  DeltaDecoder decoder(buffer, sizeof(buffer));
+  EXPECT_FALSE(decoder.Init());
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, true);
+  return RUN_ALL_TESTS();
+}
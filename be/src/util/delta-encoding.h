@@ -0,0 +1,267 @@
+// Copyright 2014 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_UTIL_DELTA_ENCODING_H
+#define IMPALA_UTIL_DELTA_ENCODING_H
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "common/compiler-util.h"
+#include "common/logging.h"
+#include "util/bit-stream-utils.inline.h"
+#include "util/bit-util.h"
+
+namespace impala {
+
+// Utility classes for the delta encoding of integers (DELTA_BINARY_PACKED in Parquet).
+// Values are stored as the differences between consecutive values, so sorted or
+// slowly changing values (e.g. keys or dates stored as integers) only need a few bits
+// each.
+// The encoded data starts with a header:
+//   <block size> <number of miniblocks per block> <number of values> <first value>
+// followed by blocks that store <block size> deltas each:
+//   <min delta> <bit width of each miniblock> <miniblocks>
+// The header values and the min delta are ULEB128 encoded; the first value and the min
+// delta are zigzag encoded first. The bit widths take a byte each. Each miniblock
+// stores its deltas minus the min delta of the block, bit packed with the bit width
+// of the miniblock. The last miniblock is padded to a full miniblock. Miniblocks
+// after the last value have no data and a bit width of 0.
+// Deltas are computed with wrap around arithmetic of the width of the values, 32 bits
+// for Parquet's INT32 and 64 bits for INT64, as the format requires. Any sequence of
+// values of that width can be encoded, and the packed deltas need at most that many
+// bits.
+class DeltaEncoder {
+ public:
+  static const int BLOCK_SIZE = 128;
+  static const int NUM_MINIBLOCKS = 4;
+  static const int MINIBLOCK_SIZE = BLOCK_SIZE / NUM_MINIBLOCKS;
+
+  // Encodes 'num_values' values into 'buffer'. 'value_bits' is the width of the values,
+  // 32 or 64. With 32, the values must be in the range of int32_t. Returns the number of
+  // bytes written or -1 if the encoded values don't fit in 'buffer_len' bytes.
+  static int Encode(const int64_t* values, int num_values, int value_bits,
+      uint8_t* buffer, int buffer_len);
+
+ private:
+  static bool PutUleb(BitWriter* writer, uint64_t v);
+
+  // Bit packs 'v' with 'num_bits' bits, which may be up to 64.
+  static bool PutBits(BitWriter* writer, uint64_t v, int num_bits);
+
+  static uint64_t ZigZag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+  }
+
+  // Returns the low 'num_bits' bits of 'v' as a signed value.
+  static int64_t SignExtend(uint64_t v, int num_bits) {
+    return static_cast<int64_t>(v << (64 - num_bits)) >> (64 - num_bits);
+  }
+};
+
+// Decoder for data encoded with DeltaEncoder. Any block size and number of miniblocks
+// that result in miniblocks of a multiple of 8 values can be decoded.
+// Values are accumulated with 64-bit wrap around arithmetic. For INT32 data, whose
+// deltas wrap around at 32 bits, the low 32 bits of the decoded values are the values.
+class DeltaDecoder {
+ public:
+  DeltaDecoder(uint8_t* buffer, int buffer_len)
+    : bit_reader_(buffer, buffer_len),
+      block_size_(0),
+      miniblock_size_(0),
+      num_values_left_(0),
+      value_idx_in_block_(0),
+      last_value_(0),
+      min_delta_(0),
+      first_value_read_(false) {
+  }
+
+  DeltaDecoder() {}
+
+  // Reads the header. Returns false if the header is invalid.
+  bool Init();
+
+  // Gets the next value. Returns false if there are no more values or the data is
+  // invalid.
+  bool Get(int64_t* v);
+
+ private:
+  // Reads the min delta and the bit widths of the next block.
+  bool ReadBlockHeader();
+
+  bool GetUleb(uint64_t* v);
+
+  // Reads a value bit packed with 'num_bits' bits, which may be up to 64.
+  bool GetBits(int num_bits, uint64_t* v);
+
+  static int64_t UnZigZag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+  }
+
+  BitReader bit_reader_;
+  int block_size_;
+  int miniblock_size_;
+
+  // Bit width of each miniblock of the current block.
+  std::vector<uint8_t> bit_widths_;
+
+  // Number of values that have not been returned by Get().
+  int num_values_left_;
+
+  // Number of deltas of the current block that have been read.
+  int value_idx_in_block_;
+
+  int64_t last_value_;
+  int64_t min_delta_;
+  bool first_value_read_;
+};
+
+inline bool DeltaEncoder::PutUleb(BitWriter* writer, uint64_t v) {
+  while (v >= 0x80) {
+    if (!writer->PutAligned<uint8_t>((v & 0x7F) | 0x80, 1)) return false;
+    v >>= 7;
+  }
+  return writer->PutAligned<uint8_t>(v, 1);
+}
+
+inline bool DeltaEncoder::PutBits(BitWriter* writer, uint64_t v, int num_bits) {
+  // BitWriter only supports up to 32 bits per value.
+  if (num_bits <= 32) return writer->PutValue(v, num_bits);
+  return writer->PutValue(v & 0xFFFFFFFF, 32) &&
+      writer->PutValue(v >> 32, num_bits - 32);
+}
+
+inline int DeltaEncoder::Encode(const int64_t* values, int num_values, int value_bits,
+    uint8_t* buffer, int buffer_len) {
+  DCHECK(value_bits == 32 || value_bits == 64) << value_bits;
+  uint64_t mask = value_bits == 64 ? ~0ULL : (1ULL << value_bits) - 1;
+  BitWriter writer(buffer, buffer_len);
+  if (!PutUleb(&writer, BLOCK_SIZE)) return -1;
+  if (!PutUleb(&writer, NUM_MINIBLOCKS)) return -1;
+  if (!PutUleb(&writer, num_values)) return -1;
+  if (!PutUleb(&writer, ZigZag(num_values > 0 ? values[0] : 0))) return -1;
+
+  uint64_t deltas[BLOCK_SIZE];
+  for (int start = 1; start < num_values; start += BLOCK_SIZE) {
+    int n = std::min(BLOCK_SIZE, num_values - start);
+    int64_t min_delta = 0;
+    for (int i = 0; i < n; ++i) {
+      deltas[i] = (static_cast<uint64_t>(values[start + i]) -
+          static_cast<uint64_t>(values[start + i - 1])) & mask;
+      int64_t delta = SignExtend(deltas[i], value_bits);
+      if (i == 0 || delta < min_delta) min_delta = delta;
+    }
+    if (!PutUleb(&writer, ZigZag(min_delta))) return -1;
+
+    uint8_t bit_widths[NUM_MINIBLOCKS];
+    for (int m = 0; m < NUM_MINIBLOCKS; ++m) {
+      uint64_t bits = 0;
+      int end = std::min((m + 1) * MINIBLOCK_SIZE, n);
+      for (int i = m * MINIBLOCK_SIZE; i < end; ++i) {
+        deltas[i] = (deltas[i] - static_cast<uint64_t>(min_delta)) & mask;
+        bits |= deltas[i];
+      }
+      bit_widths[m] = 0;
+      while (bit_widths[m] < 64 && (bits >> bit_widths[m]) != 0) ++bit_widths[m];
+      if (!writer.PutAligned<uint8_t>(bit_widths[m], 1)) return -1;
+    }
+
+    for (int m = 0; m * MINIBLOCK_SIZE < n; ++m) {
+      for (int i = m * MINIBLOCK_SIZE; i < (m + 1) * MINIBLOCK_SIZE; ++i) {
+        if (!PutBits(&writer, i < n ? deltas[i] : 0, bit_widths[m])) return -1;
+      }
+    }
+  }
+  writer.Flush();
+  return writer.bytes_written();
+}
+
+inline bool DeltaDecoder::GetUleb(uint64_t* v) {
+  *v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    uint8_t byte;
+    if (!bit_reader_.GetAligned<uint8_t>(1, &byte)) return false;
+    *v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+inline bool DeltaDecoder::GetBits(int num_bits, uint64_t* v) {
+  if (num_bits <= 32) return bit_reader_.GetValue(num_bits, v);
+  uint64_t high;
+  if (!bit_reader_.GetValue(32, v)) return false;
+  if (!bit_reader_.GetValue(num_bits - 32, &high)) return false;
+  *v |= high << 32;
+  return true;
+}
+
+inline bool DeltaDecoder::Init() {
+  uint64_t block_size, num_miniblocks, num_values, first_value;
+  if (!GetUleb(&block_size) || !GetUleb(&num_miniblocks) || !GetUleb(&num_values) ||
+      !GetUleb(&first_value)) {
+    return false;
+  }
+  if (block_size == 0 || num_miniblocks == 0 || block_size % num_miniblocks != 0 ||
+      (block_size / num_miniblocks) % 8 != 0 ||
+      num_values > std::numeric_limits<int32_t>::max()) {
+    return false;
+  }
+  block_size_ = block_size;
+  miniblock_size_ = block_size / num_miniblocks;
+  bit_widths_.resize(num_miniblocks);
+  num_values_left_ = num_values;
+  last_value_ = UnZigZag(first_value);
+  first_value_read_ = false;
+  // Start a new block with the first delta.
+  value_idx_in_block_ = block_size_;
+  return true;
+}
+
+inline bool DeltaDecoder::ReadBlockHeader() {
+  uint64_t min_delta;
+  if (!GetUleb(&min_delta)) return false;
+  min_delta_ = UnZigZag(min_delta);
+  for (int m = 0; m < bit_widths_.size(); ++m) {
+    if (!bit_reader_.GetAligned<uint8_t>(1, &bit_widths_[m])) return false;
+    if (bit_widths_[m] > 64) return false;
+  }
+  value_idx_in_block_ = 0;
+  return true;
+}
+
+inline bool DeltaDecoder::Get(int64_t* v) {
+  if (UNLIKELY(num_values_left_ == 0)) return false;
+  --num_values_left_;
+  if (UNLIKELY(!first_value_read_)) {
+    first_value_read_ = true;
+    *v = last_value_;
+    return true;
+  }
+  if (UNLIKELY(value_idx_in_block_ == block_size_)) {
+    if (!ReadBlockHeader()) return false;
+  }
+  uint64_t delta;
+  if (!GetBits(bit_widths_[value_idx_in_block_ / miniblock_size_], &delta)) return false;
+  ++value_idx_in_block_;
+  last_value_ = static_cast<int64_t>(static_cast<uint64_t>(last_value_) +
+      static_cast<uint64_t>(min_delta_) + delta);
+  *v = last_value_;
+  return true;
+}
+
+}
+
+#endif
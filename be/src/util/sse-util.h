@@ -34,6 +34,7 @@ namespace SSEUtil {
   // a flag to control what text operation to do.
   //   - SIDD_CMP_EQUAL_ANY ~ strchr 
   //   - SIDD_CMP_EQUAL_EACH ~ strcmp
+  //   - SIDD_CMP_EQUAL_ORDERED ~ strstr
   //   - SIDD_UBYTE_OPS - 8 bit chars (as opposed to 16 bit)
   //   - SIDD_NEGATIVE_POLARITY - toggles whether to set result to 1 or 0 when a
   //     match is found.
@@ -47,6 +48,11 @@ namespace SSEUtil {
   static const int STRCMP_MODE = _SIDD_CMP_EQUAL_EACH | _SIDD_UBYTE_OPS 
     | _SIDD_NEGATIVE_POLARITY;
 
+  // In this mode, sse text processing functions will return the index of the first
+  // position at which the needle occurs in the haystack, including a partial occurrence
+  // of the start of the needle at the end of the haystack.
+  static const int STRSTR_MODE = _SIDD_CMP_EQUAL_ORDERED | _SIDD_UBYTE_OPS;
+
   // Precomputed mask values up to 16 bits.
   static const int SSE_BITMASK[CHARS_PER_128_BIT_REGISTER] = {
     1 << 0,
@@ -48,6 +48,10 @@ struct TDataStreamSink {
 struct THdfsTableSink {
   1: required list<Exprs.TExpr> partition_key_exprs
   2: required bool overwrite
+
+  // True if the input rows are grouped by partition key. The sink then only keeps the
+  // current partition's file open and finalizes it as soon as the key changes.
+  3: optional bool input_is_clustered
 }
 
 // Union type of all table sinks.
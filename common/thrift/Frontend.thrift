@@ -59,6 +59,18 @@ struct THiveUdfExecutorCtorParams {
   // NULL.
   6: required i64 output_null_ptr
   7: required i64 output_buffer_ptr
+
+  // Columnar buffers for evaluating up to batch_size rows with one call. Input
+  // argument i of the r-th row is at
+  // batch_input_buffer_ptr[input_byte_offsets[i] * batch_size + r * <slot size of i>]
+  // and batch_input_nulls_ptr[i * batch_size + r] is true if it is null. The result
+  // of the r-th row is written to batch_output_buffer_ptr[r * <slot size of result>]
+  // and batch_output_nulls_ptr[r] is set to true if it is null.
+  8: optional i32 batch_size
+  9: optional i64 batch_input_nulls_ptr
+  10: optional i64 batch_input_buffer_ptr
+  11: optional i64 batch_output_nulls_ptr
+  12: optional i64 batch_output_buffer_ptr
 }
 
 // Arguments to getTableNames, which returns a list of tables that match an
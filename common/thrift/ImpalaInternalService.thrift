@@ -81,6 +81,13 @@ struct TQueryOptions {
   // 1. disable preferring to schedule to cached replicas
   // 2. disable the cached read path.
   23: optional bool disable_cached_reads = 0
+
+  // Compression codec for sequence file inserts.
+  24: optional CatalogObjects.THdfsCompression compression_codec =
+      CatalogObjects.THdfsCompression.NONE
+
+  // If true, the Parquet writer may write DELTA_BINARY_PACKED and RLE data pages.
+  25: optional bool parquet_reencode_pages = 0
 }
 
 // Impala currently has two types of sessions: Beeswax and HiveServer2
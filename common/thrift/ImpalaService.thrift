@@ -134,7 +134,18 @@ enum TImpalaQueryOptions {
   RESERVATION_REQUEST_TIMEOUT,
 
   // if true, disables cached reads
-  DISABLE_CACHED_READS
+  DISABLE_CACHED_READS,
+
+  // Compression codec when inserting into sequence file tables. Inserts into text
+  // tables fail if this is set, since Impala can't read compressed text files.
+  // Valid values are "snappy", "gzip", "bzip2" and "none".
+  // Leave blank to use default (no compression).
+  COMPRESSION_CODEC,
+
+  // If true, the Parquet writer re-encodes plain data pages with DELTA_BINARY_PACKED
+  // (integer columns) or RLE (boolean columns) if that makes them smaller. Off by
+  // default since older readers can't read these pages.
+  PARQUET_REENCODE_PAGES
 }
 
 // The summary of an insert.
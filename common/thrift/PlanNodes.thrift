@@ -151,7 +151,15 @@ enum TJoinOp {
   LEFT_SEMI_JOIN,
   RIGHT_OUTER_JOIN,
   FULL_OUTER_JOIN,
-  CROSS_JOIN
+  CROSS_JOIN,
+
+  // Returns the left rows without a match, e.g. for NOT EXISTS.
+  LEFT_ANTI_JOIN,
+
+  // LEFT_ANTI_JOIN with the NULL semantics of NOT IN: a left row is only returned if
+  // its key isn't NULL and the right side has no NULL key, unless the right side is
+  // empty. Requires exactly one equi-join conjunct.
+  NULL_AWARE_LEFT_ANTI_JOIN
 }
 
 struct THashJoinNode {
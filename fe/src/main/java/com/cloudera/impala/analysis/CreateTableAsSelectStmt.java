@@ -36,7 +36,8 @@ public class CreateTableAsSelectStmt extends StatementBase {
   private final CreateTableStmt createStmt_;
   private final InsertStmt insertStmt_;
   private final static EnumSet<THdfsFileFormat> SUPPORTED_INSERT_FORMATS =
-      EnumSet.of(THdfsFileFormat.PARQUET, THdfsFileFormat.TEXT);
+      EnumSet.of(THdfsFileFormat.PARQUET, THdfsFileFormat.SEQUENCE_FILE,
+          THdfsFileFormat.TEXT);
 
   /**
    * Builds a CREATE TABLE AS SELECT statement
@@ -83,7 +84,7 @@ public class CreateTableAsSelectStmt extends StatementBase {
       throw new AnalysisException(String.format("CREATE TABLE AS SELECT " +
           "does not support (%s) file format. Supported formats are: (%s)",
           createStmt_.getFileFormat().toString().replace("_", ""),
-          "PARQUET, TEXTFILE"));
+          "PARQUET, SEQUENCEFILE, TEXTFILE"));
     }
 
     // The full privilege check for the database will be done as part of the INSERT
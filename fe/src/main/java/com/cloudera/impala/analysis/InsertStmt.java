@@ -48,7 +48,8 @@ public class InsertStmt extends StatementBase {
 
   // Insert formats currently supported by Impala.
   private final static EnumSet<THdfsFileFormat> SUPPORTED_INSERT_FORMATS =
-      EnumSet.of(THdfsFileFormat.PARQUET, THdfsFileFormat.TEXT);
+      EnumSet.of(THdfsFileFormat.PARQUET, THdfsFileFormat.SEQUENCE_FILE,
+          THdfsFileFormat.TEXT);
 
   // List of inline views that may be referenced in queryStmt.
   private final WithClause withClause_;
@@ -91,6 +92,11 @@ public class InsertStmt extends StatementBase {
   // should decide whether to re-partition or not).
   private Boolean isRepartition_ = null;
 
+  // True if the CLUSTERED hint was given: the input is grouped by partition key, so the
+  // table sink only needs to keep one partition's file open at a time. Only allowed
+  // together with NOSHUFFLE.
+  private boolean isClustered_ = false;
+
   // Output expressions that produce the final results to write to the target table. May
   // include casts, and NullLiterals where an output column isn't explicitly mentioned.
   // Set in prepareExpressions(). The i'th expr produces the i'th column of the target
@@ -575,10 +581,17 @@ public class InsertStmt extends StatementBase {
           throw new AnalysisException("Conflicting INSERT hint: " + hint);
         }
         isRepartition_ = Boolean.FALSE;
+      } else if (hint.equalsIgnoreCase("CLUSTERED")) {
+        isClustered_ = true;
       } else {
         throw new AnalysisException("INSERT hint not recognized: " + hint);
       }
     }
+    // With a shuffle, the rows of a partition arrive interleaved from all senders, so
+    // the input of a sink is not grouped by partition key.
+    if (isClustered_ && (isRepartition_ == null || isRepartition_)) {
+      throw new AnalysisException("INSERT hint CLUSTERED requires NOSHUFFLE.");
+    }
     if (table_ instanceof HBaseTable && isRepartition_) {
       throw new AnalysisException("INSERT hints are only supported for inserting into " +
           "partitioned Hdfs tables.");
@@ -596,12 +609,14 @@ public class InsertStmt extends StatementBase {
   public QueryStmt getQueryStmt() { return queryStmt_; }
   public List<Expr> getPartitionKeyExprs() { return partitionKeyExprs_; }
   public Boolean isRepartition() { return isRepartition_; }
+  public boolean isClustered() { return isClustered_; }
   public ArrayList<Expr> getResultExprs() { return resultExprs_; }
 
   public DataSink createDataSink() {
     // analyze() must have been called before.
     Preconditions.checkState(table_ != null);
-    return DataSink.createDataSink(table_, partitionKeyExprs_, overwrite_);
+    return DataSink.createDataSink(table_, partitionKeyExprs_, overwrite_,
+        isClustered_);
   }
 
   @Override
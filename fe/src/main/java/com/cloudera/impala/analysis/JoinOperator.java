@@ -22,7 +22,11 @@ public enum JoinOperator {
   LEFT_SEMI_JOIN("LEFT SEMI JOIN", TJoinOp.LEFT_SEMI_JOIN),
   RIGHT_OUTER_JOIN("RIGHT OUTER JOIN", TJoinOp.RIGHT_OUTER_JOIN),
   FULL_OUTER_JOIN("FULL OUTER JOIN", TJoinOp.FULL_OUTER_JOIN),
-  CROSS_JOIN("CROSS JOIN", TJoinOp.CROSS_JOIN);
+  CROSS_JOIN("CROSS JOIN", TJoinOp.CROSS_JOIN),
+  LEFT_ANTI_JOIN("LEFT ANTI JOIN", TJoinOp.LEFT_ANTI_JOIN),
+  // Anti join with the NULL semantics of NOT IN, only created by the planner.
+  NULL_AWARE_LEFT_ANTI_JOIN("NULL AWARE LEFT ANTI JOIN",
+      TJoinOp.NULL_AWARE_LEFT_ANTI_JOIN);
 
   private final String description_;
   private final TJoinOp thriftJoinOp_;
@@ -51,6 +55,11 @@ public enum JoinOperator {
     return this == JoinOperator.LEFT_SEMI_JOIN;
   }
 
+  public boolean isAntiJoin() {
+    return this == JoinOperator.LEFT_ANTI_JOIN
+        || this == JoinOperator.NULL_AWARE_LEFT_ANTI_JOIN;
+  }
+
   public boolean isCrossJoin() {
     return this == JoinOperator.CROSS_JOIN;
   }
@@ -295,6 +295,8 @@ public abstract class TableRef implements ParseNode {
       case RIGHT_OUTER_JOIN: return "RIGHT OUTER JOIN";
       case FULL_OUTER_JOIN: return "FULL OUTER JOIN";
       case CROSS_JOIN: return "CROSS JOIN";
+      case LEFT_ANTI_JOIN: return "LEFT ANTI JOIN";
+      case NULL_AWARE_LEFT_ANTI_JOIN: return "NULL AWARE LEFT ANTI JOIN";
       default: return "bad join op: " + joinOp_.toString();
     }
   }
@@ -90,6 +90,15 @@ public class UdfExecutor {
   // Size of outBufferStringPtr_.
   private int outBufferCapacity_;
 
+  // Columnar buffers from the backend for evaluateBatch(), see
+  // THiveUdfExecutorCtorParams. batchSize_ is 0 if the backend doesn't evaluate
+  // batches.
+  private final int batchSize_;
+  private final long batchInputNullsPtr_;
+  private final long batchInputBufferPtr_;
+  private final long batchOutputNullsPtr_;
+  private final long batchOutputBufferPtr_;
+
   // Preconstructed input objects for the UDF. This minimizes object creation overhead
   // as these objects are reused across calls to evaluate().
   private Object[] inputObjects_;
@@ -128,6 +137,19 @@ public class UdfExecutor {
     for (int i = 0; i < request.input_byte_offsets.size(); ++i) {
       inputBufferOffsets_[i] = request.input_byte_offsets.get(i).intValue();
     }
+    if (request.isSetBatch_size()) {
+      batchSize_ = request.batch_size;
+      batchInputNullsPtr_ = request.batch_input_nulls_ptr;
+      batchInputBufferPtr_ = request.batch_input_buffer_ptr;
+      batchOutputNullsPtr_ = request.batch_output_nulls_ptr;
+      batchOutputBufferPtr_ = request.batch_output_buffer_ptr;
+    } else {
+      batchSize_ = 0;
+      batchInputNullsPtr_ = 0;
+      batchInputBufferPtr_ = 0;
+      batchOutputNullsPtr_ = 0;
+      batchOutputBufferPtr_ = 0;
+    }
 
     init(jarFile, className, retType, parameterTypes);
   }
@@ -162,6 +184,11 @@ public class UdfExecutor {
     allocations_.add(outputNullPtr_);
     outBufferStringPtr_ = 0;
     outBufferCapacity_ = 0;
+    batchSize_ = 0;
+    batchInputNullsPtr_ = 0;
+    batchInputBufferPtr_ = 0;
+    batchOutputNullsPtr_ = 0;
+    batchOutputBufferPtr_ = 0;
 
     init(jarFile, udfPath, retType, parameterTypes);
   }
@@ -212,6 +239,51 @@ public class UdfExecutor {
     }
   }
 
+  /**
+   * evaluateBatch function called by the backend. Evaluates the UDF for the first
+   * 'numRows' rows in the batch input buffers and writes the results to the batch
+   * output buffers. Each row is copied to the buffers evaluate() reads from and its
+   * result is copied back, which is much cheaper than a JNI call per row. Only
+   * called for fixed size return types.
+   * If the UDF throws for a row, the result of that row is NULL, like evaluate()
+   * returns NULL to the backend for that row, and the rest of the batch is still
+   * evaluated. An exception describing the failures is thrown at the end.
+   */
+  public void evaluateBatch(int numRows) throws ImpalaRuntimeException {
+    Preconditions.checkState(numRows <= batchSize_);
+    int retSlotSize = retType_.getSlotSize();
+    int numFailedRows = 0;
+    ImpalaRuntimeException firstFailure = null;
+    for (int r = 0; r < numRows; ++r) {
+      for (int i = 0; i < argTypes_.length; ++i) {
+        byte isNull = UnsafeUtil.UNSAFE.getByte(batchInputNullsPtr_ + i * batchSize_ + r);
+        UnsafeUtil.UNSAFE.putByte(inputNullsPtr_ + i, isNull);
+        if (isNull != 0) continue;
+        int slotSize = argTypes_[i].getSlotSize();
+        long columnPtr = batchInputBufferPtr_ + (long)inputBufferOffsets_[i] * batchSize_;
+        UnsafeUtil.UNSAFE.copyMemory(columnPtr + (long)r * slotSize,
+            inputBufferPtr_ + inputBufferOffsets_[i], slotSize);
+      }
+      try {
+        evaluate();
+      } catch (ImpalaRuntimeException e) {
+        UnsafeUtil.UNSAFE.putByte(batchOutputNullsPtr_ + r, (byte)1);
+        if (firstFailure == null) firstFailure = e;
+        ++numFailedRows;
+        continue;
+      }
+      byte isNull = UnsafeUtil.UNSAFE.getByte(outputNullPtr_);
+      UnsafeUtil.UNSAFE.putByte(batchOutputNullsPtr_ + r, isNull);
+      if (isNull != 0) continue;
+      UnsafeUtil.UNSAFE.copyMemory(outputBufferPtr_,
+          batchOutputBufferPtr_ + (long)r * retSlotSize, retSlotSize);
+    }
+    if (firstFailure != null) {
+      throw new ImpalaRuntimeException(String.format(
+          "UDF failed to evaluate %d of %d rows.", numFailedRows, numRows), firstFailure);
+    }
+  }
+
   /**
    * Evalutes the UDF with 'args' as the input to the UDF. This is exposed
    * for testing and not the version of evaluate() the backend uses.
@@ -55,11 +55,12 @@ public abstract class DataSink {
 
   /**
    * Returns an output sink appropriate for writing to the given table.
+   * 'inputIsClustered' is true if the input rows are grouped by partition key.
    */
   public static DataSink createDataSink(Table table, List<Expr> partitionKeyExprs,
-      boolean overwrite) {
+      boolean overwrite, boolean inputIsClustered) {
     if (table instanceof HdfsTable) {
-      return new HdfsTableSink(table, partitionKeyExprs, overwrite);
+      return new HdfsTableSink(table, partitionKeyExprs, overwrite, inputIsClustered);
     } else if (table instanceof HBaseTable) {
       // Partition clause doesn't make sense for an HBase table.
       Preconditions.checkState(partitionKeyExprs.isEmpty());
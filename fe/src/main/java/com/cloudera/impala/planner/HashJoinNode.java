@@ -108,7 +108,8 @@ public class HashJoinNode extends PlanNode {
     if (joinOp_.equals(JoinOperator.FULL_OUTER_JOIN)) {
       nullableTupleIds_.addAll(outer.getTupleIds());
       nullableTupleIds_.addAll(inner.getTupleIds());
-    } else if (joinOp_.equals(JoinOperator.LEFT_OUTER_JOIN)) {
+    } else if (joinOp_.equals(JoinOperator.LEFT_OUTER_JOIN) || joinOp_.isAntiJoin()) {
+      // Anti joins only return left rows without a match, with NULL right tuples.
       nullableTupleIds_.addAll(inner.getTupleIds());
     } else if (joinOp_.equals(JoinOperator.RIGHT_OUTER_JOIN)) {
       nullableTupleIds_.addAll(outer.getTupleIds());
@@ -211,7 +212,9 @@ public class HashJoinNode extends PlanNode {
 
     // Impose lower/upper bounds on the cardinality based on the join type.
     switch (joinOp_) {
-      case LEFT_SEMI_JOIN: {
+      case LEFT_SEMI_JOIN:
+      case LEFT_ANTI_JOIN:
+      case NULL_AWARE_LEFT_ANTI_JOIN: {
         if (getChild(0).cardinality_ != -1) {
           cardinality_ = Math.min(getChild(0).cardinality_, cardinality_);
         }
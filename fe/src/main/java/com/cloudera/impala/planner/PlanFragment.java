@@ -192,9 +192,10 @@ public class PlanFragment {
       boolean childResult = computeCanAddSlotFilters(node.getChild(0));
       if (!childResult) return false;
       if (hashJoinNode.getJoinOp().equals(JoinOperator.FULL_OUTER_JOIN) ||
-          hashJoinNode.getJoinOp().equals(JoinOperator.LEFT_OUTER_JOIN)) {
-        // Never correct to push through an outer join on the probe side. We can't
-        // filter those rows out.
+          hashJoinNode.getJoinOp().equals(JoinOperator.LEFT_OUTER_JOIN) ||
+          hashJoinNode.getJoinOp().isAntiJoin()) {
+        // Never correct to push through an outer or anti join on the probe side. We
+        // can't filter those rows out.
         return false;
       }
       // We can't push down predicates for partitioned joins yet.
@@ -664,13 +664,12 @@ public class AnalyzeDDLTest extends AnalyzerTest {
     AnalysisError("create table newtbl as select 1 as c1, 2 as c1",
         "Duplicate column name: c1");
 
+    AnalyzesOk("create table foo stored as sequencefile as select 1");
+
     // Unsupported file formats
-    AnalysisError("create table foo stored as sequencefile as select 1",
-        "CREATE TABLE AS SELECT does not support (SEQUENCEFILE) file format. " +
-         "Supported formats are: (PARQUET, TEXTFILE)");
     AnalysisError("create table foo stored as RCFILE as select 1",
         "CREATE TABLE AS SELECT does not support (RCFILE) file format. " +
-         "Supported formats are: (PARQUET, TEXTFILE)");
+         "Supported formats are: (PARQUET, SEQUENCEFILE, TEXTFILE)");
   }
 
   @Test
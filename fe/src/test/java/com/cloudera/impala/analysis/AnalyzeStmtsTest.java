@@ -1367,6 +1367,9 @@ public class AnalyzeStmtsTest extends AnalyzerTest {
     // Multiple non-conflicting hints and case insensitivity of hints.
     AnalyzesOk("insert into table functional.alltypessmall " +
         "partition (year, month) [shuffle, ShUfFlE] select * from functional.alltypes");
+    AnalyzesOk("insert into table functional.alltypessmall " +
+        "partition (year, month) [noshuffle, CluStereD] " +
+        "select * from functional.alltypes");
     // Unknown plan hint,
     AnalysisError("insert into functional.alltypessmall " +
         "partition (year, month) [badhint] select * from functional.alltypes",
@@ -1375,10 +1378,20 @@ public class AnalyzeStmtsTest extends AnalyzerTest {
     AnalysisError("insert into table functional.alltypessmall " +
         "partition (year, month) [shuffle, noshuffle] select * from functional.alltypes",
         "Conflicting INSERT hint: noshuffle");
+    // The clustered hint requires noshuffle.
+    AnalysisError("insert into table functional.alltypessmall " +
+        "partition (year, month) [clustered] select * from functional.alltypes",
+        "INSERT hint CLUSTERED requires NOSHUFFLE.");
+    AnalysisError("insert into table functional.alltypessmall " +
+        "partition (year, month) [shuffle, clustered] select * from functional.alltypes",
+        "INSERT hint CLUSTERED requires NOSHUFFLE.");
     // Plan hints require a partition clause.
     AnalysisError("insert into table functional.alltypesnopart [shuffle] " +
         "select * from functional.alltypesnopart",
         "INSERT hints are only supported for inserting into partitioned Hdfs tables.");
+    AnalysisError("insert into table functional.alltypesnopart [clustered] " +
+        "select * from functional.alltypesnopart",
+        "INSERT hints are only supported for inserting into partitioned Hdfs tables.");
     // Plan hints do not make sense for inserting into HBase tables.
     AnalysisError("insert into table functional_hbase.alltypes [shuffle] " +
         "select * from functional_hbase.alltypes",
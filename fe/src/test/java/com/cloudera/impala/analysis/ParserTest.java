@@ -1057,7 +1057,8 @@ public class ParserTest {
   private void testInsert() {
     for (String qualifier: new String[] {"overwrite", "into"}) {
       for (String optTbl: new String[] {"", "table"}) {
-        for (String optHints: new String[] {"[shuffle]", "[badhint,noshuffle]", ""}) {
+        for (String optHints: new String[] {"[shuffle]", "[badhint,noshuffle]",
+            "[clustered]", "[noshuffle,clustered]", ""}) {
           // Entire unpartitioned table.
           ParsesOk(String.format("insert %s %s t %s select a from src where b > 5",
               qualifier, optTbl, optHints));
@@ -17,11 +17,13 @@ package com.cloudera.impala.hive.executor;
 import static org.junit.Assert.assertArrayEquals;
 import static org.junit.Assert.assertEquals;
 import static org.junit.Assert.assertTrue;
+import static org.junit.Assert.fail;
 
 import java.lang.reflect.Method;
 import java.net.MalformedURLException;
 import java.util.ArrayList;
 
+import org.apache.hadoop.hive.ql.exec.UDF;
 import org.apache.hadoop.hive.ql.udf.UDFAbs;
 import org.apache.hadoop.hive.ql.udf.UDFAcos;
 import org.apache.hadoop.hive.ql.udf.UDFAscii;
@@ -65,13 +67,23 @@ import org.apache.hadoop.hive.ql.udf.UDFTrim;
 import org.apache.hadoop.hive.ql.udf.UDFUnhex;
 import org.apache.hadoop.hive.ql.udf.UDFUpper;
 import org.apache.hadoop.io.BytesWritable;
+import org.apache.hadoop.io.IntWritable;
 import org.apache.hadoop.io.Text;
 import org.apache.hadoop.io.Writable;
+import org.apache.thrift.TException;
+import org.apache.thrift.TSerializer;
+import org.apache.thrift.protocol.TBinaryProtocol;
 import org.junit.Test;
 
 import com.cloudera.impala.catalog.ColumnType;
 import com.cloudera.impala.catalog.PrimitiveType;
+import com.cloudera.impala.common.ImpalaException;
 import com.cloudera.impala.common.ImpalaRuntimeException;
+import com.cloudera.impala.thrift.TFunction;
+import com.cloudera.impala.thrift.TFunctionBinaryType;
+import com.cloudera.impala.thrift.TFunctionName;
+import com.cloudera.impala.thrift.THiveUdfExecutorCtorParams;
+import com.cloudera.impala.thrift.TScalarFunction;
 import com.cloudera.impala.util.UnsafeUtil;
 import com.google.common.base.Preconditions;
 import com.google.common.collect.Lists;
@@ -392,4 +404,62 @@ public class UdfExecutorTest {
     TestUdf(null, TestUdf.class, "ABCXYZ", "ABC", "XYZ");
     freeAllocations();
   }
+
+  // Returns 100 / a. Throws if a is 0.
+  public static class DivideUdf extends UDF {
+    public IntWritable evaluate(IntWritable a) {
+      if (a == null) return null;
+      return new IntWritable(100 / a.get());
+    }
+  }
+
+  @Test
+  // Tests that evaluateBatch() only returns NULL for the rows the UDF throws on.
+  public void BatchExceptionTest() throws ImpalaException, TException {
+    final int batchSize = 4;
+    int[] inputs = { 1, 0, 5, 0 };
+    TFunction fn = new TFunction();
+    fn.setName(new TFunctionName("divide"));
+    fn.setBinary_type(TFunctionBinaryType.HIVE);
+    fn.setArg_types(Lists.newArrayList(ColumnType.INT.toThrift()));
+    fn.setRet_type(ColumnType.INT.toThrift());
+    fn.setHas_var_args(false);
+    fn.setScalar_fn(new TScalarFunction(DivideUdf.class.getName()));
+    THiveUdfExecutorCtorParams params = new THiveUdfExecutorCtorParams();
+    params.setFn(fn);
+    params.setLocal_location(
+        DivideUdf.class.getProtectionDomain().getCodeSource().getLocation().getPath());
+    params.setInput_byte_offsets(Lists.newArrayList(0));
+    params.setInput_nulls_ptr(allocate(1));
+    params.setInput_buffer_ptr(allocate(4));
+    params.setOutput_null_ptr(allocate(1));
+    params.setOutput_buffer_ptr(allocate(4));
+    params.setBatch_size(batchSize);
+    params.setBatch_input_nulls_ptr(allocate(batchSize));
+    params.setBatch_input_buffer_ptr(allocate(batchSize * 4));
+    params.setBatch_output_nulls_ptr(allocate(batchSize));
+    params.setBatch_output_buffer_ptr(allocate(batchSize * 4));
+    for (int i = 0; i < batchSize; ++i) {
+      UnsafeUtil.UNSAFE.putByte(params.batch_input_nulls_ptr + i, (byte)0);
+      UnsafeUtil.UNSAFE.putInt(params.batch_input_buffer_ptr + i * 4, inputs[i]);
+    }
+
+    UdfExecutor e = new UdfExecutor(
+        new TSerializer(new TBinaryProtocol.Factory()).serialize(params));
+    try {
+      e.evaluateBatch(batchSize);
+      fail("evaluateBatch() should have thrown");
+    } catch (ImpalaRuntimeException ex) {
+      assertEquals("UDF failed to evaluate 2 of 4 rows.", ex.getMessage());
+    }
+    for (int i = 0; i < batchSize; ++i) {
+      boolean isNull = UnsafeUtil.UNSAFE.getByte(params.batch_output_nulls_ptr + i) != 0;
+      assertEquals(inputs[i] == 0, isNull);
+      if (isNull) continue;
+      assertEquals(100 / inputs[i],
+          UnsafeUtil.UNSAFE.getInt(params.batch_output_buffer_ptr + i * 4));
+    }
+    e.close();
+    freeAllocations();
+  }
 }
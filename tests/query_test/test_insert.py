@@ -13,6 +13,13 @@ from tests.common.test_dimensions import create_exec_option_dimension
 # TODO: Add Gzip back.  IMPALA-424
 PARQUET_CODECS = ['none', 'snappy']
 
+# Values of the COMPRESSION_CODEC query option for sequence file inserts.
+SEQUENCE_FILE_CODECS = ['none', 'gzip', 'bzip2', 'snappy']
+
+# The columns of alltypesnopart, i.e. alltypes without its partition columns.
+ALLTYPES_COLS = "id, bool_col, tinyint_col, smallint_col, int_col, bigint_col, "\
+    "float_col, double_col, date_string_col, string_col, timestamp_col"
+
 class TestInsertQueries(ImpalaTestSuite):
   @classmethod
   def get_workload(self):
@@ -128,6 +135,7 @@ class TestUnsupportedInsertFormats(ImpalaTestSuite):
     cls.TestMatrix.add_constraint(lambda v: \
         not (v.get_value('table_format').file_format == 'parquet' or
              v.get_value('table_format').file_format == 'hbase' or
+             v.get_value('table_format').file_format == 'seq' or
              (v.get_value('table_format').file_format == 'text' and
               v.get_value('table_format').compression_codec == 'none')))
 
@@ -138,6 +146,62 @@ class TestUnsupportedInsertFormats(ImpalaTestSuite):
       assert False, 'Query was expected to fail'
     except ImpalaBeeswaxException, e: pass
 
+class TestInsertSequenceFile(ImpalaTestSuite):
+  @classmethod
+  def get_workload(self):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestInsertSequenceFile, cls).add_test_dimensions()
+    cls.TestMatrix.add_dimension(create_exec_option_dimension(
+        cluster_sizes=[0], disable_codegen_options=[False], batch_sizes=[0]))
+    cls.TestMatrix.add_dimension(
+        TestDimension("compression_codec", *SEQUENCE_FILE_CODECS))
+
+    # The tables are created by the test, so only run it once per codec.
+    cls.TestMatrix.add_constraint(lambda v:\
+        v.get_value('table_format').file_format == 'text' and \
+        v.get_value('table_format').compression_codec == 'none')
+
+  @pytest.mark.execute_serially
+  def test_insert_sequence_file(self, vector):
+    """Writes a sequence file table with each codec and checks that the rows read back
+    are the ones that were inserted."""
+    codec = vector.get_value('compression_codec')
+    table_name = "functional.insert_seq_" + codec
+    self.execute_query("drop table if exists " + table_name)
+    self.execute_query("create table %s like functional.alltypesnopart "
+        "stored as sequencefile" % table_name)
+    # Insert alltypes four times so that the file has more than one compressed block.
+    for i in xrange(4):
+      self.execute_query("insert into %s select %s from functional.alltypes" %
+          (table_name, ALLTYPES_COLS), {'compression_codec': codec})
+
+    result = self.execute_query("select %s, count(*) from %s group by %s" %
+        (ALLTYPES_COLS, table_name, ALLTYPES_COLS))
+    expected = self.execute_query("select %s, cast(4 as bigint) from functional.alltypes"
+        % ALLTYPES_COLS)
+    assert len(result.data) == 7300
+    assert sorted(result.data) == sorted(expected.data)
+    self.execute_query("drop table " + table_name)
+
+  @pytest.mark.execute_serially
+  def test_compressed_text_insert_fails(self, vector):
+    """Impala can't read compressed text files, so it refuses to write them."""
+    codec = vector.get_value('compression_codec')
+    table_name = "functional.insert_text_" + codec
+    self.execute_query("drop table if exists " + table_name)
+    self.execute_query("create table %s (i int)" % table_name)
+    try:
+      self.execute_query("insert into %s values (1)" % table_name,
+          {'compression_codec': codec})
+      assert codec == 'none', 'Query was expected to fail'
+    except ImpalaBeeswaxException, e:
+      assert codec != 'none'
+      assert 'Writing compressed text files is not supported' in str(e)
+    self.execute_query("drop table " + table_name)
+
 class TestInsertPartKey(ImpalaTestSuite):
   """Regression test for IMPALA-875"""
   @classmethod
@@ -86,3 +86,38 @@ functional.insert_overwrite_nopart SELECT int_col FROM functional.tinyinttable""
     # Should have created exactly one file in the partition dir (not in a subdirectory)
     ls = self.hdfs_client.list_dir(partition_dir)
     assert len(ls['FileStatuses']['FileStatus']) == 1
+
+  @pytest.mark.execute_serially
+  def test_insert_clustered(self):
+    """Test that a clustered insert writes one file per partition if its input is
+    grouped by partition key, and falls back to keeping all partitions open if not"""
+    table_name = "functional.insert_clustered"
+    table_dir = "test-warehouse/functional.db/insert_clustered/"
+    self.execute_query("drop table if exists " + table_name)
+    self.execute_query("create table %s (c int) partitioned by (p int)" % table_name)
+
+    def num_files(p):
+      ls = self.hdfs_client.list_dir("%sp=%d" % (table_dir, p))
+      return len([f for f in ls['FileStatuses']['FileStatus']
+          if f['type'] == 'FILE' and not f['pathSuffix'].startswith('.')])
+
+    # Grouped input: the sink closes each partition when its key changes.
+    result = self.execute_query("insert overwrite %s partition(p) "
+        "[noshuffle, clustered] select 1, 1 union all select 2, 1 union all "
+        "select 3, 2 union all select 4, 2 union all select 5, 3" % table_name,
+        {'num_nodes': 1})
+    assert "ClusteredFallback" not in result.runtime_profile
+    assert [num_files(p) for p in [1, 2, 3]] == [1, 1, 1]
+    result = self.execute_query("select c, p from %s order by c" % table_name)
+    assert result.data == ["1\t1", "2\t1", "3\t2", "4\t2", "5\t3"]
+
+    # Key 1 reappears: it gets a second file, and after that all partitions stay open
+    # instead of writing a new file for every run of rows.
+    result = self.execute_query("insert overwrite %s partition(p) "
+        "[noshuffle, clustered] select 1, 1 union all select 2, 2 union all "
+        "select 3, 1 union all select 4, 2 union all select 5, 1" % table_name,
+        {'num_nodes': 1})
+    assert "ClusteredFallback" in result.runtime_profile
+    assert [num_files(p) for p in [1, 2]] == [2, 1]
+    result = self.execute_query("select c, p from %s order by c" % table_name)
+    assert result.data == ["1\t1", "2\t2", "3\t1", "4\t2", "5\t1"]
@@ -52,3 +52,50 @@ class TestInsertParquetQueries(ImpalaTestSuite):
     vector.get_value('exec_option')['PARQUET_COMPRESSION_CODEC'] = \
         vector.get_value('compression_codec')
     self.run_test_case('insert_parquet', vector, multiple_impalad=True)
+
+class TestInsertParquetReencodedPages(ImpalaTestSuite):
+  """Tests that data pages the writer re-encodes with DELTA_BINARY_PACKED and RLE are
+  read back correctly by the scanner."""
+  @classmethod
+  def get_workload(self):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestInsertParquetReencodedPages, cls).add_test_dimensions()
+    cls.TestMatrix.add_dimension(create_exec_option_dimension(
+        cluster_sizes=[0], disable_codegen_options=[False], batch_sizes=[0]))
+    cls.TestMatrix.add_dimension(TestDimension("reencode_pages", False, True))
+    cls.TestMatrix.add_constraint(lambda v:\
+        v.get_value('table_format').file_format == 'parquet' and \
+        v.get_value('table_format').compression_codec == 'none')
+
+  @pytest.mark.execute_serially
+  def test_reencoded_pages(self, vector):
+    reencode_pages = vector.get_value('reencode_pages')
+    table_name = "functional.parquet_reencoded_pages"
+    # 58400 rows, written to a single file so that each column has plain pages after
+    # the first dictionary page. id and bigint_col are unique and nearly sorted. bool_col
+    # has long runs. int_col alternates between values near the ends of the int range,
+    # so its deltas are only small with the 32-bit wrap around of INT32.
+    select_stmt = "select cast(a.id * 8 + b.id as int), a.id < 3650, "\
+        "cast(if(b.id % 2 = 0, -2147483648 + a.id * 8 + b.id, "\
+        "2147483647 - a.id * 8 - b.id) as int), "\
+        "cast(a.id * 8 + b.id as bigint) * 1000000 "\
+        "from functional.alltypes a cross join functional.alltypestiny b"
+    self.execute_query("drop table if exists " + table_name)
+    self.execute_query("create table %s (id int, bool_col boolean, int_col int, "
+        "bigint_col bigint) stored as parquet" % table_name)
+    result = self.execute_query("insert into %s %s" % (table_name, select_stmt),
+        {'num_nodes': 1, 'parquet_reencode_pages': str(reencode_pages).lower()})
+
+    for column, encoding in [("id", "DELTA_BINARY_PACKED"), ("bool_col", "RLE"),
+        ("int_col", "DELTA_BINARY_PACKED"), ("bigint_col", "DELTA_BINARY_PACKED")]:
+      counter = "%s %s" % (column, encoding)
+      assert (counter in result.runtime_profile) == reencode_pages, counter
+
+    result = self.execute_query("select * from " + table_name)
+    expected = self.execute_query(select_stmt)
+    assert len(result.data) == 58400
+    assert sorted(result.data) == sorted(expected.data)
+    self.execute_query("drop table " + table_name)
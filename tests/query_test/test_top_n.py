@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+# Copyright (c) 2014 Cloudera, Inc. All rights reserved.
+# Tests for the TopN node on rows of constants
+#
+import re
+import pytest
+from tests.common.impala_test_suite import ImpalaTestSuite
+
+class TestTopN(ImpalaTestSuite):
+  @classmethod
+  def get_workload(self):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestTopN, cls).add_test_dimensions()
+    # The tests only read tables of a fixed format, so only run them for one.
+    cls.TestMatrix.add_constraint(lambda v:\
+        v.get_value('table_format').file_format == 'text' and\
+        v.get_value('table_format').compression_codec == 'none')
+
+  def test_top_n_ordering(self, vector):
+    self.run_test_case('QueryTest/top-n-ordering', vector)
+
+  def test_top_n_compaction(self, vector):
+    # Every row replaces the top of the heap and leaves its 400KB string behind, so the
+    # tuple pool is compacted a few times. The heap must still hold the right strings.
+    rows = ", ".join(["(%d, concat(repeat('x', 400000), '%d'))" % (i, i)
+        for i in range(1, 9)])
+    query = "with t as (values((0 as id, 'y' as s), %s)) "\
+        "select id, length(s), substr(s, 400001) from t order by id desc limit 2" % rows
+    result = self.execute_query(query, vector.get_value('exec_option'))
+    assert result.data == ['8\t400001\t8', '7\t400001\t7']
+    compactions = re.findall(r'TupleCompactions: (\d+)', result.runtime_profile)
+    assert sum([int(c) for c in compactions]) > 0
+
+  def test_top_n_bound_filter(self, vector):
+    # The TopN pushes its bound down into the scan once its heap is full. With small
+    # batches and a single scanner thread, the scanner sees the bound long before it
+    # reaches the last partitions of alltypes, whose ids are the largest.
+    query = "select id, int_col from functional.alltypes order by id limit 5"
+    exec_option = dict(vector.get_value('exec_option'))
+    exec_option.update({'num_nodes': 1, 'batch_size': 16, 'num_scanner_threads': 1})
+    result = self.execute_query(query, exec_option)
+    assert result.data == ['0\t0', '1\t1', '2\t2', '3\t3', '4\t4']
+    assert 'Bound Filter Pushed Down' in result.runtime_profile
+    rejected = re.findall(r'BoundFilterRowsRejected: (\d+)', result.runtime_profile)
+    assert sum([int(r) for r in rejected]) > 0
+
+    # The bound must not change the result of a descending order with NULLs. Ordering
+    # by an expr rather than the slot itself doesn't push a bound down.
+    query = "select id, bigint_col from functional.alltypesagg "\
+        "order by %s desc nulls first, id limit 15"
+    with_filter = self.execute_query(query % "bigint_col", exec_option)
+    assert 'Bound Filter Pushed Down' in with_filter.runtime_profile
+    without_filter = self.execute_query(query % "bigint_col + 0", exec_option)
+    assert 'Bound Filter Pushed Down' not in without_filter.runtime_profile
+    assert with_filter.data == without_filter.data
@@ -6,6 +6,7 @@ from tests.common.test_vector import *
 from tests.common.impala_test_suite import *
 from tests.common.impala_cluster import ImpalaCluster
 from subprocess import call
+import re
 
 class TestUdfs(ImpalaTestSuite):
   @classmethod
@@ -48,6 +49,20 @@ class TestUdfs(ImpalaTestSuite):
     self.run_test_case('QueryTest/load-hive-udfs', vector)
     self.run_test_case('QueryTest/hive-udf', vector)
 
+  def test_hive_udf_batch_eval(self, vector):
+    """Hive UDFs in scan conjuncts and in aggregate inputs must be evaluated a batch at
+    a time, with one JNI call per batch instead of one per row."""
+    self.client.execute('create database if not exists udf_test')
+    self.client.execute('create database if not exists uda_test')
+    self.run_test_case('QueryTest/load-hive-udfs', vector)
+    for query, expected in [
+        ("select count(*) from functional.alltypes "
+         "where udf_test.identity(int_col) = 1", "730"),
+        ("select sum(udf_test.identity(int_col)) from functional.alltypes", "32850")]:
+      result = self.execute_query(query, vector.get_value('exec_option'))
+      assert result.data == [expected], query
+      assert re.search(r'HiveUdfBatchJniCalls: [1-9]', result.runtime_profile), query
+
   def test_libs_with_same_filenames(self, vector):
     self.run_test_case('QueryTest/libs_with_same_filenames', vector)
 